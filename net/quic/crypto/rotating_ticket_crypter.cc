@@ -0,0 +1,315 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/crypto/rotating_ticket_crypter.h"
+
+#include <string.h>
+
+#include "base/big_endian.h"
+#include "base/bind.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "crypto/openssl_util.h"
+#include "crypto/random.h"
+#include "crypto/sha2.h"
+#include "net/third_party/quiche/src/quic/core/quic_clock.h"
+
+namespace net {
+
+namespace {
+
+const size_t kKeyIdSize = 4;
+const size_t kIssueTimeSize = 8;
+const size_t kNonceSize = 12;
+const size_t kTagSize = EVP_AEAD_DEFAULT_TAG_LENGTH;
+// Key ID and issue time, which are authenticated as associated data.
+const size_t kHeaderSize = kKeyIdSize + kIssueTimeSize;
+const size_t kTicketHashSize = 16;
+
+double Share(size_t count, size_t total) {
+  return total == 0 ? 0 : static_cast<double>(count) / total;
+}
+
+}  // namespace
+
+RotatingTicketCrypter::Key::Key() = default;
+
+RotatingTicketCrypter::Key::~Key() = default;
+
+RotatingTicketCrypter::RotatingTicketCrypter(
+    const quic::QuicClock* clock,
+    base::TimeDelta ticket_lifetime,
+    base::TimeDelta anti_replay_window,
+    size_t max_tracked_tickets)
+    : clock_(clock),
+      ticket_lifetime_(ticket_lifetime),
+      anti_replay_window_(anti_replay_window),
+      max_tracked_tickets_(max_tracked_tickets) {
+  crypto::EnsureOpenSSLInit();
+  ssl_ctx_.reset(SSL_CTX_new(TLS_with_buffers_method()));
+}
+
+RotatingTicketCrypter::~RotatingTicketCrypter() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+}
+
+// static
+bool RotatingTicketCrypter::ParseKeys(const std::string& contents,
+                                      std::vector<std::string>* keys) {
+  keys->clear();
+  for (const base::StringPiece& line :
+       base::SplitStringPiece(contents, "\n", base::TRIM_WHITESPACE,
+                              base::SPLIT_WANT_NONEMPTY)) {
+    if (line.starts_with("#"))
+      continue;
+    std::vector<uint8_t> key;
+    if (!base::HexStringToBytes(line, &key) ||
+        (key.size() != 16 && key.size() != 32)) {
+      return false;
+    }
+    keys->emplace_back(key.begin(), key.end());
+  }
+  return !keys->empty();
+}
+
+bool RotatingTicketCrypter::SetKeys(const std::vector<std::string>& keys) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  if (keys.empty())
+    return false;
+
+  std::vector<std::unique_ptr<Key>> new_keys;
+  for (const std::string& key_bytes : keys) {
+    const EVP_AEAD* aead = key_bytes.size() == 32 ? EVP_aead_aes_256_gcm()
+                                                  : EVP_aead_aes_128_gcm();
+    auto key = std::make_unique<Key>();
+    if (!EVP_AEAD_CTX_init(
+            key->ctx.get(), aead,
+            reinterpret_cast<const uint8_t*>(key_bytes.data()),
+            key_bytes.size(), kTagSize, nullptr)) {
+      return false;
+    }
+    key->id = crypto::SHA256HashString(key_bytes).substr(0, kKeyIdSize);
+    new_keys.push_back(std::move(key));
+  }
+  keys_ = std::move(new_keys);
+  return true;
+}
+
+bool RotatingTicketCrypter::LoadKeysFromFile(const base::FilePath& path,
+                                             base::TimeDelta reload_period) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  std::string contents;
+  std::vector<std::string> keys;
+  if (!base::ReadFileToString(path, &contents) ||
+      !ParseKeys(contents, &keys) || !SetKeys(keys)) {
+    return false;
+  }
+  key_file_ = path;
+  reload_timer_.Start(FROM_HERE, reload_period,
+                      base::BindRepeating(&RotatingTicketCrypter::ReloadKeys,
+                                          base::Unretained(this)));
+  return true;
+}
+
+base::Value RotatingTicketCrypter::StatsToValue() const {
+  const size_t tickets_offered = stats_.tickets_accepted +
+                                 stats_.tickets_rejected +
+                                 stats_.tickets_expired;
+  base::Value dict(base::Value::Type::DICTIONARY);
+  // base::Value has no 64-bit integers.
+  dict.SetStringKey("tickets_issued",
+                    base::NumberToString(stats_.tickets_issued));
+  dict.SetStringKey("tickets_accepted",
+                    base::NumberToString(stats_.tickets_accepted));
+  dict.SetStringKey("tickets_rejected",
+                    base::NumberToString(stats_.tickets_rejected));
+  dict.SetStringKey("tickets_expired",
+                    base::NumberToString(stats_.tickets_expired));
+  dict.SetStringKey("tickets_replayed",
+                    base::NumberToString(stats_.tickets_replayed));
+  dict.SetStringKey("early_data_refused",
+                    base::NumberToString(stats_.early_data_refused));
+  dict.SetDoubleKey("resumption_rate",
+                    Share(stats_.tickets_accepted, tickets_offered));
+  dict.SetDoubleKey(
+      "early_data_rate",
+      Share(stats_.tickets_accepted - stats_.early_data_refused,
+            tickets_offered));
+  return dict;
+}
+
+void RotatingTicketCrypter::ReloadKeys() {
+  std::string contents;
+  std::vector<std::string> keys;
+  if (!base::ReadFileToString(key_file_, &contents) ||
+      !ParseKeys(contents, &keys) || !SetKeys(keys)) {
+    LOG(ERROR) << "Failed to reload session ticket keys from "
+               << key_file_.value();
+  }
+
+  const size_t tickets = stats_.tickets_issued + stats_.tickets_accepted +
+                         stats_.tickets_rejected + stats_.tickets_expired;
+  if (tickets != last_logged_tickets_) {
+    last_logged_tickets_ = tickets;
+    LOG(INFO) << "Session tickets: " << StatsToValue();
+  }
+}
+
+size_t RotatingTicketCrypter::MaxOverhead() {
+  return kHeaderSize + kNonceSize + kTagSize;
+}
+
+std::vector<uint8_t> RotatingTicketCrypter::Encrypt(
+    quiche::QuicheStringPiece in) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  if (keys_.empty())
+    return std::vector<uint8_t>();
+  const Key& key = *keys_[0];
+
+  std::vector<uint8_t> out(MaxOverhead() + in.size());
+  memcpy(out.data(), key.id.data(), kKeyIdSize);
+  base::WriteBigEndian(reinterpret_cast<char*>(out.data() + kKeyIdSize),
+                       clock_->WallNow().ToUNIXSeconds());
+  uint8_t* nonce = out.data() + kHeaderSize;
+  crypto::RandBytes(nonce, kNonceSize);
+
+  size_t out_len;
+  if (!EVP_AEAD_CTX_seal(key.ctx.get(), nonce + kNonceSize, &out_len,
+                         in.size() + kTagSize, nonce, kNonceSize,
+                         reinterpret_cast<const uint8_t*>(in.data()),
+                         in.size(), out.data(), kHeaderSize)) {
+    return std::vector<uint8_t>();
+  }
+  out.resize(kHeaderSize + kNonceSize + out_len);
+  ++stats_.tickets_issued;
+  return out;
+}
+
+void RotatingTicketCrypter::Decrypt(
+    quiche::QuicheStringPiece in,
+    std::unique_ptr<quic::ProofSource::DecryptCallback> callback) {
+  callback->Run(DecryptTicket(in));
+}
+
+std::vector<uint8_t> RotatingTicketCrypter::DecryptTicket(
+    quiche::QuicheStringPiece in) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  if (in.size() < MaxOverhead()) {
+    ++stats_.tickets_rejected;
+    return std::vector<uint8_t>();
+  }
+
+  const Key* key = nullptr;
+  for (const auto& candidate : keys_) {
+    if (memcmp(candidate->id.data(), in.data(), kKeyIdSize) == 0) {
+      key = candidate.get();
+      break;
+    }
+  }
+  if (!key) {
+    ++stats_.tickets_rejected;
+    return std::vector<uint8_t>();
+  }
+
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(in.data());
+  const uint8_t* nonce = data + kHeaderSize;
+  const uint8_t* ciphertext = nonce + kNonceSize;
+  const size_t ciphertext_len = in.size() - kHeaderSize - kNonceSize;
+  std::vector<uint8_t> out(ciphertext_len);
+  size_t out_len;
+  if (!EVP_AEAD_CTX_open(key->ctx.get(), out.data(), &out_len, out.size(),
+                         nonce, kNonceSize, ciphertext, ciphertext_len, data,
+                         kHeaderSize)) {
+    ++stats_.tickets_rejected;
+    return std::vector<uint8_t>();
+  }
+  out.resize(out_len);
+
+  uint64_t issue_seconds;
+  base::ReadBigEndian(in.data() + kKeyIdSize, &issue_seconds);
+  const quic::QuicWallTime issue_time =
+      quic::QuicWallTime::FromUNIXSeconds(issue_seconds);
+  const quic::QuicWallTime now = clock_->WallNow();
+  const int64_t age_us =
+      now.IsAfter(issue_time)
+          ? now.AbsoluteDifference(issue_time).ToMicroseconds()
+          : 0;
+  if (!ticket_lifetime_.is_zero() &&
+      age_us > ticket_lifetime_.InMicroseconds()) {
+    ++stats_.tickets_expired;
+    return std::vector<uint8_t>();
+  }
+
+  if (!anti_replay_window_.is_zero() &&
+      (age_us > anti_replay_window_.InMicroseconds() ||
+       !CheckAndRecordTicket(in, now))) {
+    // The early data of this ticket may have been seen before, so only let
+    // it resume the session.
+    out = RefuseEarlyData(std::move(out));
+    if (out.empty()) {
+      ++stats_.tickets_rejected;
+      return out;
+    }
+  }
+
+  ++stats_.tickets_accepted;
+  return out;
+}
+
+bool RotatingTicketCrypter::CheckAndRecordTicket(
+    quiche::QuicheStringPiece ticket,
+    quic::QuicWallTime now) {
+  // A ticket accepted now is refused early data once the window has passed
+  // since its issue time, which is no later than the window from now, so
+  // entries can be dropped in insertion order.
+  while (!accepted_tickets_by_expiry_.empty() &&
+         now.IsAfter(accepted_tickets_by_expiry_.front().first)) {
+    accepted_tickets_.erase(accepted_tickets_by_expiry_.front().second);
+    accepted_tickets_by_expiry_.pop_front();
+  }
+
+  std::string hash =
+      crypto::SHA256HashString(ticket).substr(0, kTicketHashSize);
+  if (accepted_tickets_.count(hash) > 0) {
+    ++stats_.tickets_replayed;
+    return false;
+  }
+  // An untracked ticket could be replayed unnoticed.
+  if (accepted_tickets_.size() >= max_tracked_tickets_)
+    return false;
+
+  accepted_tickets_.insert(hash);
+  accepted_tickets_by_expiry_.emplace_back(
+      now.Add(quic::QuicTime::Delta::FromMicroseconds(
+          anti_replay_window_.InMicroseconds())),
+      std::move(hash));
+  return true;
+}
+
+std::vector<uint8_t> RotatingTicketCrypter::RefuseEarlyData(
+    std::vector<uint8_t> session) {
+  bssl::UniquePtr<SSL_SESSION> parsed(
+      SSL_SESSION_from_bytes(session.data(), session.size(), ssl_ctx_.get()));
+  if (!parsed)
+    return std::vector<uint8_t>();
+  if (!SSL_SESSION_early_data_capable(parsed.get()))
+    return session;
+
+  bssl::UniquePtr<SSL_SESSION> without_early_data(
+      SSL_SESSION_copy_without_early_data(parsed.get()));
+  uint8_t* bytes;
+  size_t length;
+  if (!without_early_data ||
+      !SSL_SESSION_to_bytes_for_ticket(without_early_data.get(), &bytes,
+                                       &length)) {
+    return std::vector<uint8_t>();
+  }
+  bssl::UniquePtr<uint8_t> free_bytes(bytes);
+  ++stats_.early_data_refused;
+  return std::vector<uint8_t>(bytes, bytes + length);
+}
+
+}  // namespace net
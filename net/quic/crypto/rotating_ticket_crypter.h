@@ -0,0 +1,165 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_CRYPTO_ROTATING_TICKET_CRYPTER_H_
+#define NET_QUIC_CRYPTO_ROTATING_TICKET_CRYPTER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/containers/circular_deque.h"
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/sequence_checker.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "base/values.h"
+#include "net/base/net_export.h"
+#include "net/third_party/quiche/src/quic/core/crypto/proof_source.h"
+#include "net/third_party/quiche/src/quic/core/quic_time.h"
+#include "third_party/boringssl/src/include/openssl/aead.h"
+#include "third_party/boringssl/src/include/openssl/ssl.h"
+
+namespace quic {
+class QuicClock;
+}  // namespace quic
+namespace net {
+
+// Session ticket crypter whose AES-GCM keys are shared by every server in a
+// fleet, so that TLS resumption and 0-RTT work across server processes and
+// restarts.
+//
+// Keys are read from a file holding one hex-encoded 16- or 32-byte key per
+// line. The first line is the current key, which encrypts new tickets; the
+// other lines hold the previous and next keys, which are only used to decrypt.
+// Rotation is done by distributing the next key as a decrypt-only key first,
+// then promoting it to the first line, so that no server ever issues a ticket
+// another server cannot read.
+//
+// Tickets carry their issue time, and are rejected once they are older than
+// the ticket lifetime. A ticket may be used for any number of resumptions
+// within its lifetime, but only allows 0-RTT if the crypter can protect its
+// early data from replay: the first time it is used, within the anti-replay
+// window of its issue. The crypter remembers the tickets it accepted within
+// the window, in bounded memory. Other tickets, including those used once the
+// memory is full, are handed to the handshake as sessions without early data,
+// so that they resume with 1-RTT. The window is per process, so within it a
+// ticket's early data may still be replayed once to each other server of the
+// fleet.
+//
+// All methods must be called on the same sequence. Encryption and decryption
+// take no locks; reloading replaces the key set between handshakes.
+class NET_EXPORT_PRIVATE RotatingTicketCrypter
+    : public quic::ProofSource::TicketCrypter {
+ public:
+  struct Stats {
+    size_t tickets_issued = 0;
+    size_t tickets_accepted = 0;
+    // Tickets that failed to decrypt, including those for unknown keys.
+    size_t tickets_rejected = 0;
+    // Tickets older than the ticket lifetime.
+    size_t tickets_expired = 0;
+    // Tickets used again within the anti-replay window.
+    size_t tickets_replayed = 0;
+    // Accepted tickets whose early data was refused, including replayed
+    // ones.
+    size_t early_data_refused = 0;
+  };
+
+  // Tickets are accepted for |ticket_lifetime| after they are issued, or
+  // forever if it is zero. Their early data is only accepted on their first
+  // use within |anti_replay_window| of their issue, and while fewer than
+  // |max_tracked_tickets| tickets are remembered. A zero window disables
+  // replay protection, leaving the early data of every ticket unprotected.
+  RotatingTicketCrypter(const quic::QuicClock* clock,
+                        base::TimeDelta ticket_lifetime,
+                        base::TimeDelta anti_replay_window,
+                        size_t max_tracked_tickets);
+  ~RotatingTicketCrypter() override;
+
+  // Parses |contents| in the key file format. Returns false if it holds no
+  // keys or a malformed line.
+  static bool ParseKeys(const std::string& contents,
+                        std::vector<std::string>* keys);
+
+  // Replaces the keys with |keys|, the first of which becomes the current key.
+  bool SetKeys(const std::vector<std::string>& keys);
+
+  // Loads the keys from |path|, then reloads them every |reload_period| to
+  // pick up rotations. Returns false if the initial load fails; failed
+  // reloads keep the previous keys.
+  bool LoadKeysFromFile(const base::FilePath& path,
+                        base::TimeDelta reload_period);
+
+  const Stats& stats() const { return stats_; }
+
+  // Returns stats(), along with the share of offered tickets that resumed a
+  // session and the share that allowed 0-RTT. Also logged whenever the keys
+  // are reloaded from their file, if the stats changed.
+  base::Value StatsToValue() const;
+
+  // quic::ProofSource::TicketCrypter implementation.
+  size_t MaxOverhead() override;
+  std::vector<uint8_t> Encrypt(quiche::QuicheStringPiece in) override;
+  void Decrypt(quiche::QuicheStringPiece in,
+               std::unique_ptr<quic::ProofSource::DecryptCallback> callback)
+      override;
+
+ private:
+  struct Key {
+    Key();
+    ~Key();
+
+    // First bytes of SHA-256 of the key, which tickets use to name their key.
+    std::string id;
+    bssl::ScopedEVP_AEAD_CTX ctx;
+  };
+
+  void ReloadKeys();
+  std::vector<uint8_t> DecryptTicket(quiche::QuicheStringPiece in);
+  // Returns false if |ticket| was already accepted within the window, or if
+  // the window tracks too many tickets to record it.
+  bool CheckAndRecordTicket(quiche::QuicheStringPiece ticket,
+                            quic::QuicWallTime now);
+  // Returns |session|, a serialized TLS session, without early data, or an
+  // empty vector if it cannot be parsed.
+  std::vector<uint8_t> RefuseEarlyData(std::vector<uint8_t> session);
+
+  const quic::QuicClock* clock_;  // Not owned.
+  const base::TimeDelta ticket_lifetime_;
+  const base::TimeDelta anti_replay_window_;
+  const size_t max_tracked_tickets_;
+  // Only used to parse sessions.
+  bssl::UniquePtr<SSL_CTX> ssl_ctx_;
+
+  // keys_[0] is the current key.
+  std::vector<std::unique_ptr<Key>> keys_;
+
+  // Hashes of tickets accepted within the anti-replay window, and the same
+  // hashes in order of expiry.
+  std::set<std::string> accepted_tickets_;
+  base::circular_deque<std::pair<quic::QuicWallTime, std::string>>
+      accepted_tickets_by_expiry_;
+
+  base::FilePath key_file_;
+  base::RepeatingTimer reload_timer_;
+
+  Stats stats_;
+  // Number of tickets issued and offered when the stats were last logged.
+  size_t last_logged_tickets_ = 0;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(RotatingTicketCrypter);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_CRYPTO_ROTATING_TICKET_CRYPTER_H_
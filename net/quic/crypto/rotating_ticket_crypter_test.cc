@@ -0,0 +1,279 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/crypto/rotating_ticket_crypter.h"
+
+#include <string.h>
+
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "net/test/test_with_task_environment.h"
+#include "net/third_party/quiche/src/common/platform/api/quiche_text_utils.h"
+#include "net/third_party/quiche/src/quic/test_tools/mock_clock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/boringssl/src/include/openssl/ssl.h"
+
+namespace net {
+namespace test {
+namespace {
+
+const char kTicket[] = "resumption state";
+
+// A serialized 0-RTT capable TLS session, from
+// quic_client_session_cache_unittests.cc.
+const char kEarlyDataSession[] =
+    "3082068702010102020304040213010420b9c2a657e565db0babd09e192a9fc4d768fbd706"
+    "9f03f9278a4a0be62392e55b0420d87ed2ab8cafc986fd2e288bd2d654cd57c3a2bed1d532"
+    "20726e55fed39d021ea10602045ed16771a205020302a300a382025f3082025b30820143a0"
+    "03020102020104300d06092a864886f70d01010b0500302c3110300e060355040a13074163"
+    "6d6520436f311830160603550403130f496e7465726d656469617465204341301e170d3133"
+    "303130313130303030305a170d3233313233313130303030305a302d3110300e060355040a"
+    "130741636d6520436f3119301706035504031310746573742e6578616d706c652e636f6d30"
+    "59301306072a8648ce3d020106082a8648ce3d030107034200040526220e77278300d06bc0"
+    "86aff4f999a828a2ed5cc75adc2972794befe885aa3a9b843de321b36b0a795289cebff1a5"
+    "428bad5e34665ce5e36daad08fb3ffd8a3523050300e0603551d0f0101ff04040302078030"
+    "130603551d25040c300a06082b06010505070301300c0603551d130101ff04023000301b06"
+    "03551d11041430128210746573742e6578616d706c652e636f6d300d06092a864886f70d01"
+    "010b050003820101008c1f1e380831b6437a8b9284d28d4ead38d9503a9fc936db89048aa2"
+    "edd6ec2fb830d962ef7a4f384e679504f4d5520f3272e0b9e702b110aff31711578fa5aeb1"
+    "11e9d184c994b0f97e7b17d1995f3f477f25bc1258398ec0ec729caed55d594a009f48093a"
+    "17f33a7f3bb6e420cc3499838398a421d93c7132efa8bee5ed2645cbc55179c400da006feb"
+    "761badd356cac3bd7a0e6b22a511106a355ec62a4c0ac2541d2996adb4a918c866d10c3e31"
+    "62039a91d4ce600b276740d833380b37f66866d261bf6efa8855e7ae6c7d12a8a864cd9a1f"
+    "4663e07714b0204e51bbc189a2d04c2a5043202379ff1c8cbf30cbb44fde4ee9a1c0c976dc"
+    "4943df2c132ca4020400aa7f047d494e534543555245003072020101020203040402130104"
+    "000420d87ed2ab8cafc986fd2e288bd2d654cd57c3a2bed1d53220726e55fed39d021ea106"
+    "02045ed16771a205020302a300a4020400b20302011db5060404bd909308b807020500ffff"
+    "ffffb9050203093a80ba07040568332d3238bb030101ffbc03040100b20302011db3820307"
+    "30820303308201eba003020102020102300d06092a864886f70d01010b050030243110300e"
+    "060355040a130741636d6520436f3110300e06035504031307526f6f74204341301e170d31"
+    "33303130313130303030305a170d3233313233313130303030305a302c3110300e06035504"
+    "0a130741636d6520436f311830160603550403130f496e7465726d65646961746520434130"
+    "820122300d06092a864886f70d01010105000382010f003082010a0282010100cd3550e70a"
+    "6880e52bf0012b93110c50f723e1d8d2ed489aea3b649f82fae4ad2396a8a19b31d1d64ab2"
+    "79f1c18003184154a5303a82bd57109cfd5d34fd19d3211bcb06e76640e1278998822dd72e"
+    "0d5c059a740d45de325e784e81b4c86097f08b2a8ce057f6b9db5a53641d27e09347d993ee"
+    "acf67be7d297b1a6853775ffaaf78fae924e300b5654fd32f99d3cd82e95f56417ff26d265"
+    "e2b1786c835d67a4d8ae896b6eb34b35a5b1033c209779ed0bf8de25a13a507040ae9e0475"
+    "a26a2f15845b08c3e0554e47dbbc7925b02e580dbcaaa6f2eecde6b8028c5b00b33d44d0a6"
+    "bfb3e72e9d4670de45d1bd79bdc0f2470b71286091c29873152db4b1f30203010001a33830"
+    "36300e0603551d0f0101ff04040302020430130603551d25040c300a06082b060105050703"
+    "01300f0603551d130101ff040530030101ff300d06092a864886f70d01010b050003820101"
+    "00bc4f8234860558dd404a626403819bfc759029d625a002143e75ebdb2898d1befdd326c3"
+    "4b14dc3507d732bb29af7e6af31552db53052a2be0d950efee5e0f699304231611ed8bf73a"
+    "6f216a904c6c2f1a2186d1ed08a8005a7914394d71e7d4b643c808f86365c5fecad8b52934"
+    "2d3b3f03447126d278d75b1dab3ed53f23e36e9b3d695f28727916e5ee56ce22d387c81f05"
+    "919b2a37bd4981eb67d9f57b7072285dbbb61f48b6b14768c069a092aad5a094cf295dafd2"
+    "3ca008f89a5f5ab37a56e5f68df45091c7cb85574677127087a2887ba3baa6d4fc436c6e40"
+    "40885e81621d38974f0c7f0d792418c5adebb10e92a165f8d79b169617ff575c0d4a85b506"
+    "0404bd909308b603010100b70402020403b807020500ffffffffb9050203093a80ba070405"
+    "68332d3238bb030101ff";
+
+
+class TestDecryptCallback : public quic::ProofSource::DecryptCallback {
+ public:
+  explicit TestDecryptCallback(std::vector<uint8_t>* out) : out_(out) {}
+
+  void Run(std::vector<uint8_t> plaintext) override { *out_ = plaintext; }
+
+ private:
+  std::vector<uint8_t>* out_;
+};
+
+std::string Key(char c) {
+  return std::string(16, c);
+}
+
+class RotatingTicketCrypterTest : public TestWithTaskEnvironment {
+ protected:
+  std::unique_ptr<RotatingTicketCrypter> CreateCrypter(
+      const std::vector<std::string>& keys,
+      base::TimeDelta ticket_lifetime = base::TimeDelta(),
+      base::TimeDelta anti_replay_window = base::TimeDelta()) {
+    auto crypter = std::make_unique<RotatingTicketCrypter>(
+        &clock_, ticket_lifetime, anti_replay_window,
+        /*max_tracked_tickets=*/2);
+    EXPECT_TRUE(crypter->SetKeys(keys));
+    return crypter;
+  }
+
+  std::string Decrypt(RotatingTicketCrypter* crypter,
+                      const std::vector<uint8_t>& ticket) {
+    std::vector<uint8_t> out;
+    crypter->Decrypt(
+        quiche::QuicheStringPiece(reinterpret_cast<const char*>(ticket.data()),
+                                  ticket.size()),
+        std::make_unique<TestDecryptCallback>(&out));
+    return std::string(out.begin(), out.end());
+  }
+
+  // Returns true if |session| allows early data, and false if it does not or
+  // cannot be parsed.
+  bool AllowsEarlyData(const std::string& session) {
+    bssl::UniquePtr<SSL_CTX> ssl_ctx(SSL_CTX_new(TLS_with_buffers_method()));
+    bssl::UniquePtr<SSL_SESSION> parsed(SSL_SESSION_from_bytes(
+        reinterpret_cast<const uint8_t*>(session.data()), session.size(),
+        ssl_ctx.get()));
+    EXPECT_TRUE(parsed);
+    return parsed && SSL_SESSION_early_data_capable(parsed.get());
+  }
+
+  quic::MockClock clock_;
+};
+
+TEST_F(RotatingTicketCrypterTest, RoundTrip) {
+  auto crypter = CreateCrypter({Key('a')});
+  std::vector<uint8_t> ticket = crypter->Encrypt(kTicket);
+  EXPECT_EQ(strlen(kTicket) + crypter->MaxOverhead(), ticket.size());
+  EXPECT_EQ(kTicket, Decrypt(crypter.get(), ticket));
+  EXPECT_EQ(1u, crypter->stats().tickets_issued);
+  EXPECT_EQ(1u, crypter->stats().tickets_accepted);
+}
+
+TEST_F(RotatingTicketCrypterTest, Aes256Key) {
+  auto crypter = CreateCrypter({std::string(32, 'a')});
+  EXPECT_EQ(kTicket, Decrypt(crypter.get(), crypter->Encrypt(kTicket)));
+}
+
+TEST_F(RotatingTicketCrypterTest, Rotation) {
+  auto old_server = CreateCrypter({Key('a')});
+  // Another server that already has the next key, as a decrypt-only key.
+  auto staged_server = CreateCrypter({Key('a'), Key('b')});
+  // A server after rotation, keeping the previous key.
+  auto rotated_server = CreateCrypter({Key('b'), Key('a')});
+  auto unrelated_server = CreateCrypter({Key('c')});
+
+  std::vector<uint8_t> old_ticket = old_server->Encrypt(kTicket);
+  EXPECT_EQ(kTicket, Decrypt(staged_server.get(), old_ticket));
+  EXPECT_EQ(kTicket, Decrypt(rotated_server.get(), old_ticket));
+  EXPECT_EQ("", Decrypt(unrelated_server.get(), old_ticket));
+  EXPECT_EQ(1u, unrelated_server->stats().tickets_rejected);
+
+  std::vector<uint8_t> new_ticket = rotated_server->Encrypt(kTicket);
+  EXPECT_EQ(kTicket, Decrypt(staged_server.get(), new_ticket));
+}
+
+TEST_F(RotatingTicketCrypterTest, RejectsTamperedTicket) {
+  auto crypter = CreateCrypter({Key('a')});
+  std::vector<uint8_t> ticket = crypter->Encrypt(kTicket);
+  // The issue time is authenticated.
+  ticket[5] ^= 1;
+  EXPECT_EQ("", Decrypt(crypter.get(), ticket));
+  EXPECT_EQ("", Decrypt(crypter.get(), std::vector<uint8_t>(10)));
+  EXPECT_EQ(2u, crypter->stats().tickets_rejected);
+}
+
+TEST_F(RotatingTicketCrypterTest, TicketLifetime) {
+  auto crypter = CreateCrypter({Key('a')}, base::TimeDelta::FromDays(1));
+  std::vector<uint8_t> ticket = crypter->Encrypt(kTicket);
+  // Tickets may be used for more than one resumption.
+  EXPECT_EQ(kTicket, Decrypt(crypter.get(), ticket));
+  clock_.AdvanceTime(quic::QuicTime::Delta::FromSeconds(23 * 3600));
+  EXPECT_EQ(kTicket, Decrypt(crypter.get(), ticket));
+  EXPECT_EQ(2u, crypter->stats().tickets_accepted);
+
+  clock_.AdvanceTime(quic::QuicTime::Delta::FromSeconds(2 * 3600));
+  EXPECT_EQ("", Decrypt(crypter.get(), ticket));
+  EXPECT_EQ(1u, crypter->stats().tickets_expired);
+  EXPECT_EQ(kTicket, Decrypt(crypter.get(), crypter->Encrypt(kTicket)));
+}
+
+TEST_F(RotatingTicketCrypterTest, AntiReplay) {
+  const std::string session =
+      quiche::QuicheTextUtils::HexDecode(kEarlyDataSession);
+  ASSERT_TRUE(AllowsEarlyData(session));
+  auto crypter = CreateCrypter({Key('a')}, base::TimeDelta::FromDays(1),
+                               base::TimeDelta::FromSeconds(10));
+
+  // Only the first use of a ticket allows early data. Later ones resume the
+  // session with 1-RTT.
+  std::vector<uint8_t> ticket = crypter->Encrypt(session);
+  EXPECT_EQ(session, Decrypt(crypter.get(), ticket));
+  std::string replayed = Decrypt(crypter.get(), ticket);
+  EXPECT_FALSE(replayed.empty());
+  EXPECT_FALSE(AllowsEarlyData(replayed));
+  EXPECT_EQ(1u, crypter->stats().tickets_replayed);
+  EXPECT_EQ(1u, crypter->stats().early_data_refused);
+  EXPECT_EQ(2u, crypter->stats().tickets_accepted);
+
+  // Tickets older than the window no longer allow early data, as their
+  // first use may have been forgotten.
+  std::vector<uint8_t> old_ticket = crypter->Encrypt(session);
+  clock_.AdvanceTime(quic::QuicTime::Delta::FromSeconds(11));
+  std::string resumed = Decrypt(crypter.get(), old_ticket);
+  EXPECT_FALSE(resumed.empty());
+  EXPECT_FALSE(AllowsEarlyData(resumed));
+  EXPECT_EQ(2u, crypter->stats().early_data_refused);
+
+  // Tickets that are not TLS sessions cannot be stripped of early data, so
+  // they are rejected when it must be refused.
+  std::vector<uint8_t> fake_ticket = crypter->Encrypt(kTicket);
+  EXPECT_EQ(kTicket, Decrypt(crypter.get(), fake_ticket));
+  clock_.AdvanceTime(quic::QuicTime::Delta::FromSeconds(11));
+  EXPECT_EQ("", Decrypt(crypter.get(), fake_ticket));
+  EXPECT_EQ(1u, crypter->stats().tickets_rejected);
+
+  // Once |max_tracked_tickets| tickets are remembered, new ones do not allow
+  // early data either.
+  EXPECT_EQ(session, Decrypt(crypter.get(), crypter->Encrypt(session)));
+  EXPECT_EQ(session, Decrypt(crypter.get(), crypter->Encrypt(session)));
+  EXPECT_FALSE(
+      AllowsEarlyData(Decrypt(crypter.get(), crypter->Encrypt(session))));
+  EXPECT_EQ(3u, crypter->stats().early_data_refused);
+}
+
+TEST_F(RotatingTicketCrypterTest, StatsToValue) {
+  auto crypter = CreateCrypter({Key('a')});
+  std::vector<uint8_t> ticket = crypter->Encrypt(kTicket);
+  Decrypt(crypter.get(), ticket);
+  Decrypt(crypter.get(), ticket);
+  Decrypt(crypter.get(), std::vector<uint8_t>(10));
+  Decrypt(crypter.get(), std::vector<uint8_t>(10));
+
+  base::Value stats = crypter->StatsToValue();
+  EXPECT_EQ("1", *stats.FindStringKey("tickets_issued"));
+  EXPECT_EQ("2", *stats.FindStringKey("tickets_accepted"));
+  EXPECT_EQ("2", *stats.FindStringKey("tickets_rejected"));
+  EXPECT_EQ(0.5, stats.FindDoubleKey("resumption_rate"));
+}
+
+TEST_F(RotatingTicketCrypterTest, ParseKeys) {
+  std::vector<std::string> keys;
+  EXPECT_TRUE(RotatingTicketCrypter::ParseKeys(
+      "# current\n"
+      "000102030405060708090a0b0c0d0e0f\n"
+      "\n"
+      "101112131415161718191a1b1c1d1e1f\n",
+      &keys));
+  ASSERT_EQ(2u, keys.size());
+  EXPECT_EQ(16u, keys[0].size());
+  EXPECT_EQ('\x10', keys[1][0]);
+
+  EXPECT_FALSE(RotatingTicketCrypter::ParseKeys("", &keys));
+  EXPECT_FALSE(RotatingTicketCrypter::ParseKeys("not hex", &keys));
+  EXPECT_FALSE(RotatingTicketCrypter::ParseKeys("0001", &keys));
+}
+
+TEST_F(RotatingTicketCrypterTest, LoadKeysFromFile) {
+  base::ScopedTempDir dir;
+  ASSERT_TRUE(dir.CreateUniqueTempDir());
+  base::FilePath path = dir.GetPath().AppendASCII("ticket_keys");
+  const std::string contents = "61616161616161616161616161616161\n";
+  ASSERT_TRUE(base::WriteFile(path, contents.data(), contents.size()));
+
+  RotatingTicketCrypter crypter(&clock_, base::TimeDelta(), base::TimeDelta(),
+                                /*max_tracked_tickets=*/1);
+  ASSERT_TRUE(
+      crypter.LoadKeysFromFile(path, base::TimeDelta::FromMinutes(1)));
+  // The file holds Key('a').
+  auto other = CreateCrypter({Key('a')});
+  EXPECT_EQ(kTicket, Decrypt(&crypter, other->Encrypt(kTicket)));
+
+  EXPECT_FALSE(crypter.LoadKeysFromFile(dir.GetPath().AppendASCII("missing"),
+                                        base::TimeDelta::FromMinutes(1)));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -17,6 +17,7 @@
 #include "net/http/transport_security_state.h"
 #include "net/quic/crypto/proof_source_chromium.h"
 #include "net/quic/crypto/proof_verifier_chromium.h"
+#include "net/quic/crypto/rotating_ticket_crypter.h"
 #include "net/quic/platform/impl/quic_chromium_clock.h"
 #include "net/third_party/quiche/src/quic/platform/api/quic_flags.h"
 #include "net/third_party/quiche/src/quic/platform/api/quic_ptr_util.h"
@@ -38,6 +39,29 @@ DEFINE_QUIC_COMMAND_LINE_FLAG(std::string,
                               "",
                               "Path to the pkcs8 private key.");
 
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    session_ticket_key_file,
+    "",
+    "Path to a file of hex-encoded session ticket keys shared with other "
+    "servers, current key first. If empty, a random per-process key is used.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    session_ticket_lifetime_seconds,
+    7 * 24 * 3600,
+    "With --session_ticket_key_file, how long session tickets are accepted "
+    "after they are issued. 0 accepts them for as long as their key is "
+    "known.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    session_ticket_anti_replay_seconds,
+    10,
+    "With --session_ticket_key_file, how long after their issue session "
+    "tickets allow 0-RTT, on their first use only. 0 disables replay "
+    "protection, letting every ticket allow 0-RTT.");
+
 using net::CertVerifier;
 using net::CTVerifier;
 using net::MultiLogCTVerifier;
@@ -47,6 +71,34 @@ namespace quic {
 
 namespace {
 
+// How often shared session ticket keys are re-read to pick up rotations.
+const int kSessionTicketKeyReloadSeconds = 60;
+// Bounds the memory used to detect replayed session tickets.
+const size_t kMaxTrackedSessionTickets = 100000;
+
+std::unique_ptr<ProofSource::TicketCrypter> CreateTicketCrypter() {
+  std::string key_file = GetQuicFlag(FLAGS_session_ticket_key_file);
+  if (key_file.empty()) {
+    return std::make_unique<SimpleTicketCrypter>(
+        QuicChromiumClock::GetInstance());
+  }
+  auto ticket_crypter = std::make_unique<net::RotatingTicketCrypter>(
+      QuicChromiumClock::GetInstance(),
+      base::TimeDelta::FromSeconds(
+          GetQuicFlag(FLAGS_session_ticket_lifetime_seconds)),
+      base::TimeDelta::FromSeconds(
+          GetQuicFlag(FLAGS_session_ticket_anti_replay_seconds)),
+      kMaxTrackedSessionTickets);
+  CHECK(ticket_crypter->LoadKeysFromFile(
+#if defined(OS_WIN)
+      base::FilePath(base::UTF8ToUTF16(key_file)),
+#else
+      base::FilePath(key_file),
+#endif
+      base::TimeDelta::FromSeconds(kSessionTicketKeyReloadSeconds)));
+  return std::move(ticket_crypter);
+}
+
 std::set<std::string> UnknownRootAllowlistForHost(std::string host) {
   if (!GetQuicFlag(FLAGS_allow_unknown_root_cert)) {
     return std::set<std::string>();
@@ -88,8 +140,7 @@ std::unique_ptr<ProofVerifier> CreateDefaultProofVerifierImpl(
 
 std::unique_ptr<ProofSource> CreateDefaultProofSourceImpl() {
   auto proof_source = std::make_unique<net::ProofSourceChromium>();
-  proof_source->SetTicketCrypter(
-      std::make_unique<SimpleTicketCrypter>(QuicChromiumClock::GetInstance()));
+  proof_source->SetTicketCrypter(CreateTicketCrypter());
   CHECK(proof_source->Initialize(
 #if defined(OS_WIN)
       base::FilePath(base::UTF8ToUTF16(GetQuicFlag(FLAGS_certificate_file))),
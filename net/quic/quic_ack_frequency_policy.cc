@@ -0,0 +1,30 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_ack_frequency_policy.h"
+
+#include "net/third_party/quiche/src/quic/core/crypto/crypto_protocol.h"
+#include "net/third_party/quiche/src/quic/core/quic_time.h"
+
+namespace net {
+
+quic::QuicTag SelectAckDecimationConnectionOption(
+    base::TimeDelta srtt,
+    quic::QuicBandwidth bandwidth,
+    quic::QuicByteCount max_packet_length) {
+  if (srtt <= base::TimeDelta() || bandwidth.IsZero() ||
+      max_packet_length == 0) {
+    return 0;
+  }
+  quic::QuicByteCount bdp = bandwidth.ToBytesPerPeriod(
+      quic::QuicTime::Delta::FromMicroseconds(srtt.InMicroseconds()));
+  quic::QuicPacketCount bdp_packets = bdp / max_packet_length;
+  // kAKD3 and kAKD4 shorten the ack delay to an eighth of an RTT, so the only
+  // option which acks less often than the default is kAKDU.
+  if (bdp_packets >= kMinBdpPacketsForAckDecimation)
+    return quic::kAKDU;
+  return 0;
+}
+
+}  // namespace net
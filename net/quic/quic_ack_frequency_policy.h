@@ -0,0 +1,35 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_QUIC_ACK_FREQUENCY_POLICY_H_
+#define NET_QUIC_QUIC_ACK_FREQUENCY_POLICY_H_
+
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+#include "net/third_party/quiche/src/quic/core/quic_bandwidth.h"
+#include "net/third_party/quiche/src/quic/core/quic_packets.h"
+#include "net/third_party/quiche/src/quic/core/quic_tag.h"
+
+namespace net {
+
+// Bandwidth-delay product, in packets, at or above which the client acks less
+// often. The default ack decimation acks every quarter RTT but at least every
+// 10 packets, which on such paths means many acks per RTT; unlimited ack
+// decimation drops the packet limit, which saves CPU on both ends. Below it,
+// the default is kept, since the sender needs timely acks to grow its
+// congestion window.
+const quic::QuicPacketCount kMinBdpPacketsForAckDecimation = 64;
+
+// Returns the connection option selecting the client's ack decimation mode for
+// a path with smoothed RTT |srtt| and estimated bandwidth |bandwidth|, as
+// cached from a previous connection to the same server. Returns 0 if the
+// default mode should be used.
+NET_EXPORT_PRIVATE quic::QuicTag SelectAckDecimationConnectionOption(
+    base::TimeDelta srtt,
+    quic::QuicBandwidth bandwidth,
+    quic::QuicByteCount max_packet_length);
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_ACK_FREQUENCY_POLICY_H_
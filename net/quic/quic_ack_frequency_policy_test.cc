@@ -0,0 +1,61 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_ack_frequency_policy.h"
+
+#include "net/third_party/quiche/src/quic/core/crypto/crypto_protocol.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+const quic::QuicByteCount kPacketLength = 1000;
+
+TEST(QuicAckFrequencyPolicyTest, NoCachedStats) {
+  EXPECT_EQ(0u, SelectAckDecimationConnectionOption(
+                    base::TimeDelta(), quic::QuicBandwidth::FromKBitsPerSecond(
+                                           1000 * 1000),
+                    kPacketLength));
+  EXPECT_EQ(0u, SelectAckDecimationConnectionOption(
+                    base::TimeDelta::FromMilliseconds(50),
+                    quic::QuicBandwidth::Zero(), kPacketLength));
+}
+
+TEST(QuicAckFrequencyPolicyTest, SmallBdpKeepsDefault) {
+  // 10 Mbps * 20 ms = 25 packets.
+  EXPECT_EQ(0u, SelectAckDecimationConnectionOption(
+                    base::TimeDelta::FromMilliseconds(20),
+                    quic::QuicBandwidth::FromKBitsPerSecond(10 * 1000),
+                    kPacketLength));
+}
+
+TEST(QuicAckFrequencyPolicyTest, LargeBdpUsesUnlimitedDecimation) {
+  // 100 Mbps * 20 ms = 250 packets.
+  EXPECT_EQ(quic::kAKDU,
+            SelectAckDecimationConnectionOption(
+                base::TimeDelta::FromMilliseconds(20),
+                quic::QuicBandwidth::FromKBitsPerSecond(100 * 1000),
+                kPacketLength));
+  // 1 Gbps * 20 ms = 2500 packets.
+  EXPECT_EQ(quic::kAKDU,
+            SelectAckDecimationConnectionOption(
+                base::TimeDelta::FromMilliseconds(20),
+                quic::QuicBandwidth::FromKBitsPerSecond(1000 * 1000),
+                kPacketLength));
+}
+
+TEST(QuicAckFrequencyPolicyTest, NeverAcksMoreOftenThanDefault) {
+  for (int kbps : {1000, 10 * 1000, 100 * 1000, 1000 * 1000}) {
+    quic::QuicTag option = SelectAckDecimationConnectionOption(
+        base::TimeDelta::FromMilliseconds(20),
+        quic::QuicBandwidth::FromKBitsPerSecond(kbps), kPacketLength);
+    EXPECT_NE(quic::kAKD3, option);
+    EXPECT_NE(quic::kAKD4, option);
+  }
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -0,0 +1,143 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures packet protection throughput of each AEAD QUIC can negotiate, for
+// typical packet sizes, so that the AEAD order quiche picks from
+// HasAesGcmHardwareSupport() can be checked on a given host.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/timer/elapsed_timer.h"
+#include "net/quic/quic_aead_preference.h"
+#include "net/third_party/quiche/src/quic/core/crypto/aes_128_gcm_12_decrypter.h"
+#include "net/third_party/quiche/src/quic/core/crypto/aes_128_gcm_12_encrypter.h"
+#include "net/third_party/quiche/src/quic/core/crypto/aes_128_gcm_decrypter.h"
+#include "net/third_party/quiche/src/quic/core/crypto/aes_128_gcm_encrypter.h"
+#include "net/third_party/quiche/src/quic/core/crypto/chacha20_poly1305_decrypter.h"
+#include "net/third_party/quiche/src/quic/core/crypto/chacha20_poly1305_encrypter.h"
+#include "net/third_party/quiche/src/quic/core/crypto/chacha20_poly1305_tls_decrypter.h"
+#include "net/third_party/quiche/src/quic/core/crypto/chacha20_poly1305_tls_encrypter.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_decrypter.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_encrypter.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace net {
+namespace test {
+namespace {
+
+const size_t kPacketSizes[] = {64, 512, 1200, 1350};
+const int kNumPackets = 100000;
+// Ciphertexts are written round-robin to this many preallocated buffers,
+// which stay small enough to be cache-resident like a real send path.
+const int kNumBuffers = 1000;
+static_assert(kNumPackets % kNumBuffers == 0,
+              "every buffer must hold the same packet in both loops");
+const size_t kAssociatedDataSize = 20;
+
+const char kMetricPrefix[] = "QuicAead.";
+const char kMetricEncryptThroughput[] = "encrypt_throughput";
+const char kMetricDecryptThroughput[] = "decrypt_throughput";
+
+perf_test::PerfResultReporter SetUpReporter(const std::string& story) {
+  perf_test::PerfResultReporter reporter(kMetricPrefix, story);
+  reporter.RegisterImportantMetric(kMetricEncryptThroughput, "bytesPerSecond");
+  reporter.RegisterImportantMetric(kMetricDecryptThroughput, "bytesPerSecond");
+  return reporter;
+}
+
+// Encrypts and then decrypts |kNumPackets| packets of |packet_size| bytes,
+// reporting the throughput of each direction. |use_iv| selects the IETF QUIC
+// key schedule, where the whole nonce is derived from an IV.
+void RunAead(const std::string& name,
+             std::unique_ptr<quic::QuicEncrypter> encrypter,
+             std::unique_ptr<quic::QuicDecrypter> decrypter,
+             bool use_iv,
+             size_t packet_size) {
+  std::string key(encrypter->GetKeySize(), 'k');
+  ASSERT_TRUE(encrypter->SetKey(key));
+  ASSERT_TRUE(decrypter->SetKey(key));
+  if (use_iv) {
+    std::string iv(encrypter->GetIVSize(), 'i');
+    ASSERT_TRUE(encrypter->SetIV(iv));
+    ASSERT_TRUE(decrypter->SetIV(iv));
+  } else {
+    std::string nonce_prefix(encrypter->GetNoncePrefixSize(), 'n');
+    ASSERT_TRUE(encrypter->SetNoncePrefix(nonce_prefix));
+    ASSERT_TRUE(decrypter->SetNoncePrefix(nonce_prefix));
+  }
+
+  const std::string associated_data(kAssociatedDataSize, 'a');
+  const std::string plaintext(packet_size, 'p');
+  const size_t ciphertext_size = encrypter->GetCiphertextSize(packet_size);
+  std::vector<std::string> ciphertexts(kNumBuffers,
+                                       std::string(ciphertext_size, '\0'));
+
+  base::ElapsedTimer encrypt_timer;
+  for (int i = 0; i < kNumPackets; ++i) {
+    size_t output_length = 0;
+    ASSERT_TRUE(encrypter->EncryptPacket(
+        i, associated_data, plaintext, &ciphertexts[i % kNumBuffers][0],
+        &output_length, ciphertext_size));
+    ASSERT_EQ(ciphertext_size, output_length);
+  }
+  base::TimeDelta encrypt_time = encrypt_timer.Elapsed();
+
+  // Each buffer holds the last packet encrypted into it, and is decrypted
+  // with that packet's number.
+  const int first_kept_packet = kNumPackets - kNumBuffers;
+  std::string decrypted(packet_size, '\0');
+  base::ElapsedTimer decrypt_timer;
+  for (int i = 0; i < kNumPackets; ++i) {
+    const int buffer = i % kNumBuffers;
+    size_t output_length = 0;
+    ASSERT_TRUE(decrypter->DecryptPacket(
+        first_kept_packet + buffer, associated_data, ciphertexts[buffer],
+        &decrypted[0], &output_length, packet_size));
+    ASSERT_EQ(packet_size, output_length);
+  }
+  base::TimeDelta decrypt_time = decrypt_timer.Elapsed();
+
+  const double total_bytes = static_cast<double>(packet_size) * kNumPackets;
+  perf_test::PerfResultReporter reporter =
+      SetUpReporter(name + "_" + base::NumberToString(packet_size));
+  reporter.AddResult(kMetricEncryptThroughput,
+                     total_bytes / encrypt_time.InSecondsF());
+  reporter.AddResult(kMetricDecryptThroughput,
+                     total_bytes / decrypt_time.InSecondsF());
+}
+
+TEST(QuicAeadPerfTest, QuicCrypto) {
+  // Printed so that results can be compared with the order actually used.
+  LOG(INFO) << "AES-GCM hardware support: " << HasAesGcmHardwareSupport();
+  for (size_t packet_size : kPacketSizes) {
+    RunAead("aes_128_gcm_12", std::make_unique<quic::Aes128Gcm12Encrypter>(),
+            std::make_unique<quic::Aes128Gcm12Decrypter>(),
+            /*use_iv=*/false, packet_size);
+    RunAead("chacha20_poly1305",
+            std::make_unique<quic::ChaCha20Poly1305Encrypter>(),
+            std::make_unique<quic::ChaCha20Poly1305Decrypter>(),
+            /*use_iv=*/false, packet_size);
+  }
+}
+
+TEST(QuicAeadPerfTest, Tls) {
+  for (size_t packet_size : kPacketSizes) {
+    RunAead("tls_aes_128_gcm", std::make_unique<quic::Aes128GcmEncrypter>(),
+            std::make_unique<quic::Aes128GcmDecrypter>(),
+            /*use_iv=*/true, packet_size);
+    RunAead("tls_chacha20_poly1305",
+            std::make_unique<quic::ChaCha20Poly1305TlsEncrypter>(),
+            std::make_unique<quic::ChaCha20Poly1305TlsDecrypter>(),
+            /*use_iv=*/true, packet_size);
+  }
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
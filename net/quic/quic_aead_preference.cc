@@ -0,0 +1,17 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_aead_preference.h"
+
+#include "crypto/openssl_util.h"
+#include "third_party/boringssl/src/include/openssl/aead.h"
+
+namespace net {
+
+bool HasAesGcmHardwareSupport() {
+  crypto::EnsureOpenSSLInit();
+  return EVP_has_aes_hardware() == 1;
+}
+
+}  // namespace net
@@ -0,0 +1,22 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_QUIC_AEAD_PREFERENCE_H_
+#define NET_QUIC_QUIC_AEAD_PREFERENCE_H_
+
+#include "net/base/net_export.h"
+
+namespace net {
+
+// Returns true if this machine has instructions that make AES-GCM fast: AES-NI
+// and PCLMULQDQ on x86, or the AES and PMULL extensions on ARM. Without them,
+// ChaCha20-Poly1305 encrypts several times faster than AES-GCM.
+//
+// QuicCryptoClientConfig::SetDefaults() and BoringSSL's TLS 1.3 cipher suite
+// order both prefer AES-GCM only when this is true.
+NET_EXPORT_PRIVATE bool HasAesGcmHardwareSupport();
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_AEAD_PREFERENCE_H_
@@ -0,0 +1,26 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_aead_preference.h"
+
+#include "net/third_party/quiche/src/quic/core/crypto/crypto_protocol.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_crypto_client_config.h"
+#include "net/third_party/quiche/src/quic/test_tools/crypto_test_utils.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+// The factory relies on quiche's defaults to order the QUIC crypto AEADs.
+TEST(QuicAeadPreferenceTest, CryptoConfigDefaultsMatchHost) {
+  quic::QuicCryptoClientConfig crypto_config(
+      quic::test::crypto_test_utils::ProofVerifierForTesting());
+  ASSERT_FALSE(crypto_config.aead.empty());
+  EXPECT_EQ(HasAesGcmHardwareSupport(), crypto_config.aead[0] == quic::kAESG);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -35,6 +35,7 @@
 #include "net/quic/quic_chromium_connection_helper.h"
 #include "net/quic/quic_chromium_packet_writer.h"
 #include "net/quic/quic_connectivity_probing_manager.h"
+#include "net/quic/quic_context.h"
 #include "net/quic/quic_crypto_client_stream_factory.h"
 #include "net/quic/quic_server_info.h"
 #include "net/quic/quic_stream_factory.h"
@@ -252,6 +253,18 @@ std::string MigrationCauseToString(MigrationCause cause) {
   return "InvalidCause";
 }
 
+// Returns true if |status| ends a migration that was attempted, rather than
+// one that was not attempted because of the config or the session's state.
+bool IsFailedMigrationAttempt(QuicConnectionMigrationStatus status) {
+  switch (status) {
+    case MIGRATION_STATUS_INTERNAL_ERROR:
+    case MIGRATION_STATUS_TIMEOUT:
+      return true;
+    default:
+      return false;
+  }
+}
+
 base::Value NetLogQuicClientSessionParams(const quic::QuicServerId* server_id,
                                           int cert_verify_flags,
                                           bool require_confirmation) {
@@ -312,8 +325,11 @@ class QuicServerPushHelper : public ServerPushDelegate::ServerPushHelper {
       const GURL& url)
       : session_(session), request_url_(url) {}
 
+  // The delegate cancels pushes of URLs the client has cached, so later
+  // pushes of the same URL are cancelled as soon as they are promised.
   void Cancel() override {
     if (session_) {
+      session_->push_cache()->AddToDigest(request_url_);
       session_->CancelPush(request_url_);
     }
   }
@@ -521,6 +537,13 @@ QuicChromiumClientSession::Handle::GetPushPromiseIndex() {
   return session_->push_promise_index();
 }
 
+QuicRequestCoalescer* QuicChromiumClientSession::Handle::GetRequestCoalescer() {
+  if (!session_)
+    return nullptr;
+
+  return session_->request_coalescer();
+}
+
 int QuicChromiumClientSession::Handle::GetPeerAddress(
     IPEndPoint* address) const {
   if (!session_)
@@ -789,6 +812,7 @@ QuicChromiumClientSession::QuicChromiumClientSession(
       yield_after_packets_(yield_after_packets),
       yield_after_duration_(yield_after_duration),
       go_away_on_path_degrading_(go_away_on_path_degrading),
+      base_max_packet_length_(0),
       most_recent_path_degrading_timestamp_(base::TimeTicks()),
       most_recent_network_disconnected_timestamp_(base::TimeTicks()),
       tick_clock_(tick_clock),
@@ -819,9 +843,16 @@ QuicChromiumClientSession::QuicChromiumClientSession(
       streams_pushed_and_claimed_count_(0),
       bytes_pushed_count_(0),
       bytes_pushed_and_unclaimed_count_(0),
+      push_cache_(/*max_bytes=*/0,
+                  /*max_age=*/base::TimeDelta(),
+                  kMaxPushCacheDigestEntries),
       probing_manager_(this, task_runner_),
       retry_migrate_back_count_(0),
       current_migration_cause_(UNKNOWN_CAUSE),
+      num_migrations_(0),
+      num_migration_failures_(0),
+      receive_window_budget_(nullptr),
+      num_stream_window_increases_(0),
       send_packet_after_migration_(false),
       wait_for_new_network_(false),
       ignore_read_error_(false),
@@ -861,6 +892,7 @@ QuicChromiumClientSession::QuicChromiumClientSession(
     connection->SetMaxPacketLength(connection->max_packet_length() -
                                    kAdditionalOverheadForIPv6);
   }
+  base_max_packet_length_ = connection->max_packet_length();
   connect_timing_.dns_start = dns_resolution_start_time;
   connect_timing_.dns_end = dns_resolution_end_time;
   if (!retransmittable_on_wire_timeout.IsZero()) {
@@ -926,6 +958,8 @@ QuicChromiumClientSession::~QuicChromiumClientSession() {
   DCHECK_LE(bytes_pushed_and_unclaimed_count_, bytes_pushed_count_);
   UMA_HISTOGRAM_COUNTS_1M("Net.QuicSession.PushedAndUnclaimedBytes",
                           bytes_pushed_and_unclaimed_count_);
+  UMA_HISTOGRAM_COUNTS_1M("Net.QuicSession.PushedAndCancelledByDigest",
+                          push_cache_.stats().cancelled_by_digest);
 
   if (!OneRttKeysAvailable())
     return;
@@ -1194,6 +1228,7 @@ QuicChromiumClientSession::CreateOutgoingReliableStreamImpl(
   QuicChromiumClientStream* stream = new QuicChromiumClientStream(
       GetNextOutgoingBidirectionalStreamId(), this, quic::BIDIRECTIONAL,
       net_log_, traffic_annotation);
+  MaybeEnableStreamReceiveWindowAutoTuning(stream);
   ActivateStream(base::WrapUnique(stream));
   ++num_total_streams_;
   UMA_HISTOGRAM_COUNTS_1M("Net.QuicSession.NumOpenStreams",
@@ -1334,6 +1369,11 @@ int QuicChromiumClientSession::CryptoConnect(CompletionOnceCallback callback) {
   return ERR_IO_PENDING;
 }
 
+bool QuicChromiumClientSession::IsIdle() const {
+  return GetNumActiveStreams() == 0 && stream_requests_.empty() &&
+         handles_.empty();
+}
+
 int QuicChromiumClientSession::GetNumSentClientHellos() const {
   return crypto_stream_->num_sent_client_hellos();
 }
@@ -1354,15 +1394,15 @@ bool QuicChromiumClientSession::CanPool(
     // Privacy mode and socket tag must always match.
     return false;
   }
-  SSLInfo ssl_info;
-  if (!GetSSLInfo(&ssl_info) || !ssl_info.cert.get()) {
+  if (!pooling_descriptor_) {
     NOTREACHED() << "QUIC should always have certificates.";
     return false;
   }
 
-  return SpdySession::CanPool(transport_security_state_, ssl_info,
-                              *ssl_config_service_, session_key_.host(),
-                              hostname, network_isolation_key);
+  return pooling_descriptor_->CanPool(transport_security_state_,
+                                      *ssl_config_service_,
+                                      session_key_.host(), hostname,
+                                      network_isolation_key);
 }
 
 bool QuicChromiumClientSession::ShouldCreateIncomingStream(
@@ -1459,6 +1499,10 @@ QuicChromiumClientSession::CreateIncomingReliableStreamImpl(
 
   QuicChromiumClientStream* stream = new QuicChromiumClientStream(
       id, this, quic::READ_UNIDIRECTIONAL, net_log_, traffic_annotation);
+  MaybeEnableStreamReceiveWindowAutoTuning(stream);
+  stream->SetPushDataCallback(
+      base::BindRepeating(&QuicChromiumClientSession::OnPushStreamDataReceived,
+                          base::Unretained(this)));
   ActivateStream(base::WrapUnique(stream));
   ++num_total_streams_;
   return stream;
@@ -1472,6 +1516,10 @@ QuicChromiumClientSession::CreateIncomingReliableStreamImpl(
 
   QuicChromiumClientStream* stream = new QuicChromiumClientStream(
       pending, this, quic::READ_UNIDIRECTIONAL, net_log_, traffic_annotation);
+  MaybeEnableStreamReceiveWindowAutoTuning(stream);
+  stream->SetPushDataCallback(
+      base::BindRepeating(&QuicChromiumClientSession::OnPushStreamDataReceived,
+                          base::Unretained(this)));
   ActivateStream(base::WrapUnique(stream));
   ++num_total_streams_;
   return stream;
@@ -2296,6 +2344,14 @@ void QuicChromiumClientSession::OnWriteUnblocked() {
   }
 }
 
+void QuicChromiumClientSession::OnMessageTooBig(size_t packet_size) {
+  if (!stream_factory_)
+    return;
+  stream_factory_->OnPathMtuExceeded(
+      GetDefaultSocket()->GetBoundNetwork(),
+      ToIPEndPoint(connection()->peer_address()), packet_size);
+}
+
 void QuicChromiumClientSession::OnPathDegrading() {
   if (most_recent_path_degrading_timestamp_ == base::TimeTicks())
     most_recent_path_degrading_timestamp_ = tick_clock_->NowTicks();
@@ -2355,6 +2411,9 @@ void QuicChromiumClientSession::OnProofVerifyDetailsAvailable(
   std::unique_ptr<ct::CTVerifyResult> ct_verify_result_copy(
       new ct::CTVerifyResult(verify_details_chromium->ct_verify_result));
   ct_verify_result_ = std::move(ct_verify_result_copy);
+  // QUIC never sends client certificates.
+  pooling_descriptor_ = std::make_unique<QuicPoolingDescriptor>(
+      *cert_verify_result_, *ct_verify_result_, /*client_cert_sent=*/false);
   logger_->OnCertificateVerified(*cert_verify_result_);
   pkp_bypassed_ = verify_details_chromium->pkp_bypassed;
   is_fatal_cert_error_ = verify_details_chromium->is_fatal_cert_error;
@@ -2371,7 +2430,13 @@ void QuicChromiumClientSession::CloseSessionOnError(
     quic::QuicErrorCode quic_error,
     quic::ConnectionCloseBehavior behavior) {
   base::UmaHistogramSparse("Net.QuicSession.CloseSessionOnError", -net_error);
+  CloseSessionOnErrorInBatch(net_error, quic_error, behavior);
+}
 
+void QuicChromiumClientSession::CloseSessionOnErrorInBatch(
+    int net_error,
+    quic::QuicErrorCode quic_error,
+    quic::ConnectionCloseBehavior behavior) {
   if (!callback_.is_null()) {
     std::move(callback_).Run(net_error);
   }
@@ -2774,6 +2839,12 @@ void QuicChromiumClientSession::LogMetricsOnNetworkMadeDefault() {
 
 void QuicChromiumClientSession::LogMigrationResultToHistogram(
     QuicConnectionMigrationStatus status) {
+  if (status == MIGRATION_STATUS_SUCCESS) {
+    ++num_migrations_;
+  } else if (IsFailedMigrationAttempt(status)) {
+    ++num_migration_failures_;
+  }
+
   if (current_migration_cause_ == CHANGE_PORT_ON_PATH_DEGRADING) {
     UMA_HISTOGRAM_ENUMERATION("Net.QuicSession.PortMigration", status,
                               MIGRATION_STATUS_MAX);
@@ -2881,6 +2952,99 @@ base::Value QuicChromiumClientSession::GetInfoAsValue(
   return std::move(dict);
 }
 
+void QuicChromiumClientSession::GetStatsSnapshot(QuicSessionStats* stats) {
+  const quic::QuicSentPacketManager& sent_packet_manager =
+      connection()->sent_packet_manager();
+  const quic::RttStats* rtt_stats = sent_packet_manager.GetRttStats();
+  stats->smoothed_rtt_us = rtt_stats->smoothed_rtt().ToMicroseconds();
+  stats->min_rtt_us = rtt_stats->min_rtt().ToMicroseconds();
+  stats->latest_rtt_us = rtt_stats->latest_rtt().ToMicroseconds();
+  stats->congestion_window = sent_packet_manager.GetCongestionWindowInBytes();
+  stats->bytes_in_flight = sent_packet_manager.GetBytesInFlight();
+
+  const quic::QuicConnectionStats& connection_stats = connection()->GetStats();
+  stats->packets_sent = connection_stats.packets_sent;
+  stats->packets_received = connection_stats.packets_received;
+  stats->packets_lost = connection_stats.packets_lost;
+  stats->packets_retransmitted = connection_stats.packets_retransmitted;
+  stats->bytes_sent = connection_stats.bytes_sent;
+  stats->bytes_received = connection_stats.bytes_received;
+  stats->bytes_retransmitted = connection_stats.bytes_retransmitted;
+
+  stats->open_streams = GetNumActiveStreams();
+  stats->total_streams = num_total_streams_;
+  stats->migrations = num_migrations_;
+  stats->migration_failures = num_migration_failures_;
+
+  const QuicPushCache::Stats& push_stats = push_cache_.stats();
+  stats->pushes_promised = push_stats.promised;
+  stats->pushes_claimed = push_stats.claimed;
+  stats->pushes_cancelled = push_stats.cancelled;
+  stats->push_wasted_bytes = push_stats.wasted_bytes;
+  stats->push_claim_latency_us =
+      push_stats.total_claim_latency.InMicroseconds();
+
+  if (request_coalescer_) {
+    const QuicRequestCoalescer::Stats& coalescer_stats =
+        request_coalescer_->stats();
+    stats->requests_coalesced = coalescer_stats.requests_coalesced;
+    stats->coalesced_bytes_saved = coalescer_stats.bytes_saved;
+  } else {
+    stats->requests_coalesced = 0;
+    stats->coalesced_bytes_saved = 0;
+  }
+
+  stats->connected = connection()->connected();
+  stats->handshake_confirmed = OneRttKeysAvailable();
+  stats->going_away = going_away_;
+
+  if (session_window_tuner_) {
+    stats->receive_window = session_window_tuner_->window();
+    stats->receive_window_increases = session_window_tuner_->num_increases();
+    stats->stream_receive_window_increases = num_stream_window_increases_;
+  } else {
+    stats->receive_window =
+        config()->GetInitialSessionFlowControlWindowToSend();
+    stats->receive_window_increases = 0;
+    stats->stream_receive_window_increases = 0;
+  }
+}
+
+void QuicChromiumClientSession::EnableReceiveWindowAutoTuning(
+    QuicReceiveWindowBudget* budget) {
+  DCHECK(budget);
+  DCHECK(!session_window_tuner_);
+  receive_window_budget_ = budget;
+  session_window_tuner_ = std::make_unique<QuicReceiveWindowTuner>(
+      kQuicAutoTuneInitialSessionRecvWindowSize,
+      kQuicAutoTuneMaxSessionRecvWindowSize, budget);
+}
+
+void QuicChromiumClientSession::EnableRequestCoalescing() {
+  DCHECK(!request_coalescer_);
+  request_coalescer_ = std::make_unique<QuicRequestCoalescer>();
+}
+
+void QuicChromiumClientSession::MaybeEnableStreamReceiveWindowAutoTuning(
+    QuicChromiumClientStream* stream) {
+  if (!session_window_tuner_)
+    return;
+  stream->EnableReceiveWindowAutoTuning(
+      std::make_unique<QuicReceiveWindowTuner>(
+          kQuicAutoTuneInitialStreamRecvWindowSize,
+          kQuicAutoTuneMaxStreamRecvWindowSize, receive_window_budget_),
+      base::BindRepeating(&QuicChromiumClientSession::OnStreamDataRead,
+                          base::Unretained(this)));
+}
+
+void QuicChromiumClientSession::OnStreamDataRead(bool stream_window_grew) {
+  if (stream_window_grew)
+    ++num_stream_window_increases_;
+  session_window_tuner_->MaybeGrowWindow(
+      flow_controller(), connection()->clock()->ApproximateNow(),
+      connection()->sent_packet_manager().GetRttStats()->smoothed_rtt());
+}
+
 std::unique_ptr<QuicChromiumClientSession::Handle>
 QuicChromiumClientSession::CreateHandle(const HostPortPair& destination) {
   return std::make_unique<QuicChromiumClientSession::Handle>(
@@ -2966,6 +3130,7 @@ void QuicChromiumClientSession::NotifyFactoryOfSessionClosed() {
 
   going_away_ = true;
   DCHECK_EQ(0u, GetNumActiveStreams());
+  RecordValidatedPathMtu();
   // Will delete |this|.
   if (stream_factory_)
     stream_factory_->OnSessionClosed(this);
@@ -3006,6 +3171,31 @@ void QuicChromiumClientSession::OnCryptoHandshakeComplete() {
     StartMigrateBackToDefaultNetworkTimer(
         base::TimeDelta::FromSeconds(kMinRetryTimeForDefaultNetworkSecs));
   }
+
+  StartPathMtuDiscovery();
+}
+
+void QuicChromiumClientSession::StartPathMtuDiscovery() {
+  if (!stream_factory_)
+    return;
+  quic::QuicByteCount target = stream_factory_->GetPathMtuDiscoveryTarget(
+      GetDefaultSocket()->GetBoundNetwork(),
+      ToIPEndPoint(connection()->peer_address()));
+  if (target > connection()->max_packet_length())
+    connection()->SetMtuDiscoveryTarget(target);
+}
+
+void QuicChromiumClientSession::RecordValidatedPathMtu() {
+  // The connection only raises its max packet length once a probe of that
+  // size has been acknowledged.
+  if (!stream_factory_ ||
+      connection()->max_packet_length() <= base_max_packet_length_) {
+    return;
+  }
+  stream_factory_->OnPathMtuValidated(
+      GetDefaultSocket()->GetBoundNetwork(),
+      ToIPEndPoint(connection()->peer_address()),
+      connection()->max_packet_length());
 }
 
 MigrationResult QuicChromiumClientSession::Migrate(
@@ -3102,6 +3292,7 @@ bool QuicChromiumClientSession::MigrateToSocket(
     return false;
   }
 
+  RecordValidatedPathMtu();
   packet_readers_.push_back(std::move(reader));
   sockets_.push_back(std::move(socket));
   // Froce the writer to be blocked to prevent it being used until
@@ -3111,6 +3302,13 @@ bool QuicChromiumClientSession::MigrateToSocket(
   // TODO(jri): Make SetQuicPacketWriter take a scoped_ptr.
   connection()->SetQuicPacketWriter(writer.release(), /*owns_writer=*/true);
 
+  // The MTU of the new path is unknown, so fall back to the base packet size
+  // and re-validate a larger one by probing.
+  if (connection()->max_packet_length() > base_max_packet_length_)
+    connection()->SetMaxPacketLength(base_max_packet_length_);
+  if (OneRttKeysAvailable())
+    StartPathMtuDiscovery();
+
   // Post task to write the pending packet or a PING packet to the new
   // socket. This avoids reentrancy issues if there is a write error
   // on the write to the new socket.
@@ -3148,14 +3346,20 @@ bool QuicChromiumClientSession::HandlePromised(
     const spdy::SpdyHeaderBlock& headers) {
   bool result =
       quic::QuicSpdyClientSessionBase::HandlePromised(id, promised_id, headers);
+  GURL pushed_url;
+  bool client_has_url = false;
   if (result) {
+    pushed_url =
+        GURL(quic::SpdyServerPushUtils::GetPromisedUrlFromHeaders(headers));
+    client_has_url = !push_cache_.OnPushPromised(promised_id, pushed_url,
+                                                 tick_clock_->NowTicks());
+  }
+  if (result && !client_has_url) {
     // The push promise is accepted, notify the push_delegate that a push
     // promise has been received.
     if (push_delegate_) {
-      std::string pushed_url =
-          quic::SpdyServerPushUtils::GetPromisedUrlFromHeaders(headers);
       push_delegate_->OnPush(std::make_unique<QuicServerPushHelper>(
-                                 weak_factory_.GetWeakPtr(), GURL(pushed_url)),
+                                 weak_factory_.GetWeakPtr(), pushed_url),
                              net_log_);
     }
     if (headers_include_h2_stream_dependency_ ||
@@ -3180,21 +3384,38 @@ bool QuicChromiumClientSession::HandlePromised(
                       return NetLogQuicPushPromiseReceivedParams(
                           &headers, id, promised_id, capture_mode);
                     });
+  // Cancel pushes of URLs the client already has before any of their data is
+  // received.
+  if (client_has_url)
+    CancelPush(pushed_url);
   return result;
 }
 
 void QuicChromiumClientSession::DeletePromised(
     quic::QuicClientPromisedInfo* promised) {
-  if (IsOpenStream(promised->id()))
+  const quic::QuicStreamId id = promised->id();
+  if (IsOpenStream(id)) {
     streams_pushed_and_claimed_count_++;
+    if (push_cache_.Contains(id)) {
+      const base::TimeDelta claim_latency =
+          push_cache_.OnPushClaimed(id, tick_clock_->NowTicks());
+      UMA_HISTOGRAM_TIMES("Net.QuicSession.PushClaimLatency", claim_latency);
+    }
+  } else {
+    // The push was reset before its stream was created.
+    push_cache_.OnPushCancelled(id);
+  }
   quic::QuicSpdyClientSessionBase::DeletePromised(promised);
 }
 
 void QuicChromiumClientSession::OnPushStreamTimedOut(
     quic::QuicStreamId stream_id) {
   quic::QuicSpdyStream* stream = GetPromisedStream(stream_id);
-  if (stream != nullptr)
+  if (stream != nullptr) {
     bytes_pushed_and_unclaimed_count_ += stream->stream_bytes_read();
+    push_cache_.OnPushBytesReceived(stream_id, stream->stream_bytes_read());
+  }
+  push_cache_.OnPushCancelled(stream_id);
 }
 
 void QuicChromiumClientSession::CancelPush(const GURL& url) {
@@ -3204,18 +3425,48 @@ void QuicChromiumClientSession::CancelPush(const GURL& url) {
     // Push stream has already been claimed or is pending matched to a request.
     return;
   }
+  CancelPromised(promised_info);
+}
 
-  quic::QuicStreamId stream_id = promised_info->id();
+void QuicChromiumClientSession::CancelPromised(
+    quic::QuicClientPromisedInfo* promised) {
+  quic::QuicStreamId stream_id = promised->id();
 
   // Collect data on the cancelled push stream.
   quic::QuicSpdyStream* stream = GetPromisedStream(stream_id);
-  if (stream != nullptr)
+  if (stream != nullptr) {
     bytes_pushed_and_unclaimed_count_ += stream->stream_bytes_read();
+    push_cache_.OnPushBytesReceived(stream_id, stream->stream_bytes_read());
+  }
+  push_cache_.OnPushCancelled(stream_id);
 
   // Send the reset and remove the promised info from the promise index.
   quic::QuicSpdyClientSessionBase::ResetPromised(stream_id,
                                                  quic::QUIC_STREAM_CANCELLED);
-  DeletePromised(promised_info);
+  DeletePromised(promised);
+}
+
+void QuicChromiumClientSession::OnPushStreamDataReceived(
+    quic::QuicStreamId id,
+    uint64_t bytes_received) {
+  if (!push_cache_.Contains(id))
+    return;
+  push_cache_.OnPushBytesReceived(id, bytes_received);
+  MaybeCancelUnclaimedPushes();
+}
+
+void QuicChromiumClientSession::MaybeCancelUnclaimedPushes() {
+  for (quic::QuicStreamId id :
+       push_cache_.GetPushesToCancel(tick_clock_->NowTicks())) {
+    quic::QuicClientPromisedInfo* promised = GetPromisedById(id);
+    if (!promised) {
+      push_cache_.OnPushCancelled(id);
+      continue;
+    }
+    // Pushes being matched to a request are about to be claimed.
+    if (!promised->is_validating())
+      CancelPromised(promised);
+  }
 }
 
 const LoadTimingInfo::ConnectTiming&
@@ -3231,9 +3482,19 @@ quic::ParsedQuicVersion QuicChromiumClientSession::GetQuicVersion() const {
 
 size_t QuicChromiumClientSession::EstimateMemoryUsage() const {
   // TODO(xunjieli): Estimate |crypto_stream_|, quic::QuicSpdySession's
-  // quic::QuicHeaderList, quic::QuicSession's QuiCWriteBlockedList, open
-  // streams and unacked packet map.
-  return base::trace_event::EstimateMemoryUsage(packet_readers_);
+  // quic::QuicHeaderList, quic::QuicSession's QuiCWriteBlockedList and
+  // unacked packet map.
+  size_t memory_usage = base::trace_event::EstimateMemoryUsage(packet_readers_);
+  // Packets the connection queued while the writer was blocked.
+  memory_usage +=
+      connection()->NumQueuedPackets() * connection()->max_packet_length();
+  // Data streams have yet to send, and received data the reader has yet to
+  // consume.
+  for (const auto& stream : stream_map()) {
+    memory_usage += stream.second->BufferedDataBytes() +
+                    stream.second->sequencer()->NumBytesBuffered();
+  }
+  return memory_usage;
 }
 
 bool QuicChromiumClientSession::ValidateStatelessReset(
@@ -36,7 +36,12 @@
 #include "net/quic/quic_connectivity_probing_manager.h"
 #include "net/quic/quic_crypto_client_config_handle.h"
 #include "net/quic/quic_http3_logger.h"
+#include "net/quic/quic_pooling_descriptor.h"
+#include "net/quic/quic_push_cache.h"
+#include "net/quic/quic_receive_window_tuner.h"
+#include "net/quic/quic_request_coalescer.h"
 #include "net/quic/quic_session_key.h"
+#include "net/quic/quic_session_stats.h"
 #include "net/socket/socket_performance_watcher.h"
 #include "net/spdy/http2_priority_dependencies.h"
 #include "net/spdy/multiplexed_session.h"
@@ -216,6 +221,10 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
     // Returns the push promise index associated with the session.
     quic::QuicClientPushPromiseIndex* GetPushPromiseIndex();
 
+    // Returns the request coalescer of the session, or null if request
+    // coalescing is disabled or the session is gone.
+    QuicRequestCoalescer* GetRequestCoalescer();
+
     // Returns the session's server ID.
     quic::QuicServerId server_id() const { return server_id_; }
 
@@ -454,6 +463,9 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
   // |send_packet_after_migration_| is set and writer is not blocked after
   // writing queued packets.
   void OnWriteUnblocked() override;
+  // Tells |stream_factory_| that the current path no longer carries packets
+  // of |packet_size| bytes.
+  void OnMessageTooBig(size_t packet_size) override;
 
   // QuicConnectivityProbingManager::Delegate override.
   void OnProbeSucceeded(
@@ -549,6 +561,13 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
                            quic::QuicErrorCode quic_error,
                            quic::ConnectionCloseBehavior behavior);
 
+  // Like CloseSessionOnError(), but leaves recording the
+  // Net.QuicSession.CloseSessionOnError histogram to the caller, which closes
+  // many sessions at once and records it once for all of them.
+  void CloseSessionOnErrorInBatch(int net_error,
+                                  quic::QuicErrorCode quic_error,
+                                  quic::ConnectionCloseBehavior behavior);
+
   // Close the session because of |net_error| and notifies the factory
   // that this session has been closed later, which will delete the session.
   // |behavior| will suggest whether we should send connection close packets
@@ -559,12 +578,35 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
 
   base::Value GetInfoAsValue(const std::set<HostPortPair>& aliases);
 
+  // Fills |stats| with the current state of the session. Unlike
+  // GetInfoAsValue(), this allocates nothing, so it is suitable for frequent
+  // polling.
+  void GetStatsSnapshot(QuicSessionStats* stats);
+
+  // Grows the receive windows of the session and its streams as the reader
+  // keeps up with them, within |budget|, which must outlive the session. The
+  // session must have been configured with the auto-tuning initial windows.
+  void EnableReceiveWindowAutoTuning(QuicReceiveWindowBudget* budget);
+
+  // Lets identical GET requests in flight on the session share one request
+  // stream and its response.
+  void EnableRequestCoalescing();
+
+  // Returns null unless request coalescing is enabled.
+  QuicRequestCoalescer* request_coalescer() {
+    return request_coalescer_.get();
+  }
+
   const NetLogWithSource& net_log() const { return net_log_; }
 
   // Returns a Handle to this session.
   std::unique_ptr<QuicChromiumClientSession::Handle> CreateHandle(
       const HostPortPair& destination);
 
+  // Returns true if no request uses the session: it has no open streams, no
+  // pending stream requests and no handles.
+  bool IsIdle() const;
+
   // Returns the number of client hello messages that have been sent on the
   // crypto stream. If the handshake has completed then this is one greater
   // than the number of round-trips needed for the handshake.
@@ -585,6 +627,11 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
 
   const QuicSessionKey& quic_session_key() const { return session_key_; }
 
+  // Returns null until the certificate has been verified.
+  const QuicPoolingDescriptor* pooling_descriptor() const {
+    return pooling_descriptor_.get();
+  }
+
   // Attempts to migrate session when |writer| encounters a write error.
   // If |writer| is no longer actively used, abort migration.
   void MigrateSessionOnWriteError(int error_code,
@@ -658,13 +705,18 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
   // still active. Otherwise, no-op.
   void CancelPush(const GURL& url);
 
+  // Tracks the pushes of the session which are not claimed yet, and the URLs
+  // the client is known to have.
+  QuicPushCache* push_cache() { return &push_cache_; }
+
   const LoadTimingInfo::ConnectTiming& GetConnectTiming();
 
   quic::ParsedQuicVersion GetQuicVersion() const;
 
   // Returns the estimate of dynamically allocated memory in bytes.
   // See base/trace_event/memory_usage_estimator.h.
-  // TODO(xunjieli): It only tracks |packet_readers_|. Write a better estimate.
+  // Tracks |packet_readers_|, the packets queued by the connection, and the
+  // data buffered by streams.
   size_t EstimateMemoryUsage() const;
 
   bool require_confirmation() const { return require_confirmation_; }
@@ -772,6 +824,34 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
   // Called when default encryption level switches to forward secure.
   void OnCryptoHandshakeComplete();
 
+  // Starts path MTU discovery on the current path if it is enabled by
+  // |stream_factory_|.
+  void StartPathMtuDiscovery();
+
+  // Reports the packet size validated by path MTU discovery on the current
+  // path to |stream_factory_|, if it exceeds |base_max_packet_length_|.
+  void RecordValidatedPathMtu();
+
+  // Gives |stream| a receive window tuner if receive window auto-tuning is
+  // enabled.
+  void MaybeEnableStreamReceiveWindowAutoTuning(
+      QuicChromiumClientStream* stream);
+
+  // Called when the reader consumed data from a stream with a receive window
+  // tuner. Grows the session window if the reader keeps up with it.
+  void OnStreamDataRead(bool stream_window_grew);
+
+  // Resets |promised| and forgets it, counting its bytes as unclaimed.
+  void CancelPromised(quic::QuicClientPromisedInfo* promised);
+
+  // Called when data is received on a push stream which has no handle yet.
+  void OnPushStreamDataReceived(quic::QuicStreamId id,
+                                uint64_t bytes_received);
+
+  // Cancels the unclaimed pushes which exceed the age or byte limits of
+  // |push_cache_|.
+  void MaybeCancelUnclaimedPushes();
+
   QuicSessionKey session_key_;
   bool require_confirmation_;
   bool migrate_session_early_v2_;
@@ -793,6 +873,9 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
   int yield_after_packets_;
   quic::QuicTime::Delta yield_after_duration_;
   bool go_away_on_path_degrading_;
+  // Packet size used before path MTU discovery, restored after migrating to
+  // a path whose MTU has not been validated.
+  quic::QuicByteCount base_max_packet_length_;
 
   base::TimeTicks most_recent_path_degrading_timestamp_;
   base::TimeTicks most_recent_network_disconnected_timestamp_;
@@ -812,6 +895,8 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
   std::unique_ptr<QuicServerInfo> server_info_;
   std::unique_ptr<CertVerifyResult> cert_verify_result_;
   std::unique_ptr<ct::CTVerifyResult> ct_verify_result_;
+  // Built along with |cert_verify_result_| for CanPool().
+  std::unique_ptr<QuicPoolingDescriptor> pooling_descriptor_;
   std::string pinning_failure_log_;
   bool pkp_bypassed_;
   bool is_fatal_cert_error_;
@@ -839,6 +924,7 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
   int streams_pushed_and_claimed_count_;
   uint64_t bytes_pushed_count_;
   uint64_t bytes_pushed_and_unclaimed_count_;
+  QuicPushCache push_cache_;
   // Stores the packet that witnesses socket write error. This packet will be
   // written to an alternate socket when the migration completes and the
   // alternate socket is unblocked.
@@ -849,6 +935,18 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
   int retry_migrate_back_count_;
   base::OneShotTimer migrate_back_to_default_timer_;
   MigrationCause current_migration_cause_;
+  // Migrations which succeeded, and attempted migrations which failed, for
+  // GetStatsSnapshot().
+  uint32_t num_migrations_;
+  uint32_t num_migration_failures_;
+  // Receive window tuner of the session, and the budget its streams' tuners
+  // share. Only set if receive window auto-tuning is enabled.
+  QuicReceiveWindowBudget* receive_window_budget_;
+  std::unique_ptr<QuicReceiveWindowTuner> session_window_tuner_;
+  // Window increases of all streams of the session.
+  uint32_t num_stream_window_increases_;
+  // Only set if request coalescing is enabled.
+  std::unique_ptr<QuicRequestCoalescer> request_coalescer_;
   // True if a packet needs to be sent when packet writer is unblocked to
   // complete connection migration. The packet can be a cached packet if
   // |packet_| is set, a queued packet, or a PING packet.
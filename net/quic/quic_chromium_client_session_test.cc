@@ -1406,6 +1406,58 @@ TEST_P(QuicChromiumClientSessionTest, CancelPushBeforeReceivingResponse) {
             QuicChromiumClientSessionPeer::GetPushedBytesCount(session_.get()));
   EXPECT_EQ(0u, QuicChromiumClientSessionPeer::GetPushedAndUnclaimedBytesCount(
                     session_.get()));
+  EXPECT_TRUE(session_->push_cache()->empty());
+  EXPECT_EQ(1u, session_->push_cache()->stats().cancelled);
+  EXPECT_EQ(0u, session_->push_cache()->stats().claimed);
+}
+
+// A push of a URL the client has is cancelled as soon as it is promised.
+TEST_P(QuicChromiumClientSessionTest, CancelPushOfUrlInDigest) {
+  MockQuicData quic_data(version_);
+  int packet_num = 1;
+  if (VersionUsesHttp3(version_.transport_version)) {
+    quic_data.AddWrite(ASYNC,
+                       client_maker_.MakeInitialSettingsPacket(packet_num++));
+  }
+  quic_data.AddWrite(ASYNC, client_maker_.MakeRstPacket(
+                                packet_num++, true,
+                                GetNthServerInitiatedUnidirectionalStreamId(0),
+                                quic::QUIC_STREAM_CANCELLED));
+  quic_data.AddRead(ASYNC, ERR_IO_PENDING);
+  quic_data.AddRead(ASYNC, OK);  // EOF
+  quic_data.AddSocketDataToFactory(&socket_factory_);
+  Initialize();
+
+  ProofVerifyDetailsChromium details;
+  details.cert_verify_result.verified_cert =
+      ImportCertFromFile(GetTestCertsDirectory(), "spdy_pooling.pem");
+  ASSERT_TRUE(details.cert_verify_result.verified_cert.get());
+
+  CompleteCryptoHandshake();
+  session_->OnProofVerifyDetailsAvailable(details);
+
+  QuicChromiumClientStream* stream =
+      QuicChromiumClientSessionPeer::CreateOutgoingStream(session_.get());
+  EXPECT_TRUE(stream);
+
+  spdy::SpdyHeaderBlock promise_headers;
+  promise_headers[":method"] = "GET";
+  promise_headers[":authority"] = "www.example.org";
+  promise_headers[":scheme"] = "https";
+  promise_headers[":path"] = "/pushed.jpg";
+
+  GURL pushed_url("https://www.example.org/pushed.jpg");
+  session_->push_cache()->AddToDigest(pushed_url);
+  EXPECT_TRUE(session_->HandlePromised(
+      stream->id(), GetNthServerInitiatedUnidirectionalStreamId(0),
+      promise_headers));
+
+  EXPECT_FALSE(session_->GetPromisedByUrl(pushed_url.spec()));
+  const QuicPushCache::Stats& stats = session_->push_cache()->stats();
+  EXPECT_EQ(1u, stats.promised);
+  EXPECT_EQ(1u, stats.cancelled);
+  EXPECT_EQ(1u, stats.cancelled_by_digest);
+  EXPECT_TRUE(session_->push_cache()->empty());
 }
 
 TEST_P(QuicChromiumClientSessionTest, CancelPushAfterReceivingResponse) {
@@ -501,6 +501,13 @@ void QuicChromiumClientStream::OnPromiseHeaderList(
 }
 
 void QuicChromiumClientStream::OnBodyAvailable() {
+  if (!handle_ && push_data_callback_) {
+    // The data stays buffered until the push is claimed. The callback may
+    // cancel the push, so nothing else is done here.
+    push_data_callback_.Run(id(), stream_bytes_read());
+    return;
+  }
+
   if (!FinishedReadingHeaders() || !headers_delivered_) {
     // Buffer the data in the sequencer until the headers have been read.
     return;
@@ -618,9 +625,29 @@ int QuicChromiumClientStream::Read(IOBuffer* buf, int buf_len) {
   size_t bytes_read = Readv(&iov, 1);
   // Since HasBytesToRead is true, Readv() must of read some data.
   DCHECK_NE(0u, bytes_read);
+  if (receive_window_tuner_) {
+    quic::QuicConnection* connection = session_->connection();
+    bool window_grew = receive_window_tuner_->MaybeGrowWindow(
+        flow_controller(), connection->clock()->ApproximateNow(),
+        connection->sent_packet_manager().GetRttStats()->smoothed_rtt());
+    data_read_callback_.Run(window_grew);
+  }
   return bytes_read;
 }
 
+void QuicChromiumClientStream::EnableReceiveWindowAutoTuning(
+    std::unique_ptr<QuicReceiveWindowTuner> tuner,
+    base::RepeatingCallback<void(bool window_grew)> data_read_callback) {
+  receive_window_tuner_ = std::move(tuner);
+  data_read_callback_ = std::move(data_read_callback);
+}
+
+void QuicChromiumClientStream::SetPushDataCallback(
+    base::RepeatingCallback<void(quic::QuicStreamId id,
+                                 uint64_t bytes_received)> callback) {
+  push_data_callback_ = std::move(callback);
+}
+
 void QuicChromiumClientStream::NotifyHandleOfInitialHeadersAvailableLater() {
   DCHECK(handle_);
   base::ThreadTaskRunnerHandle::Get()->PostTask(
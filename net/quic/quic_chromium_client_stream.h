@@ -9,9 +9,10 @@
 
 #include <stddef.h>
 
+#include <memory>
 #include <vector>
 
-#include "base/callback_forward.h"
+#include "base/callback.h"
 #include "base/containers/circular_deque.h"
 #include "base/macros.h"
 #include "net/base/completion_once_callback.h"
@@ -22,6 +23,7 @@
 #include "net/http/http_response_info.h"
 #include "net/http/http_stream.h"
 #include "net/log/net_log_with_source.h"
+#include "net/quic/quic_receive_window_tuner.h"
 #include "net/third_party/quiche/src/common/platform/api/quiche_string_piece.h"
 #include "net/third_party/quiche/src/quic/core/http/quic_spdy_stream.h"
 #include "net/traffic_annotation/network_traffic_annotation.h"
@@ -258,6 +260,19 @@ class NET_EXPORT_PRIVATE QuicChromiumClientStream
   // Reads at most |buf_len| bytes into |buf|. Returns the number of bytes read.
   int Read(IOBuffer* buf, int buf_len);
 
+  // Lets |tuner| grow the receive window of this stream as data is read.
+  // |data_read_callback| runs after each read, with whether the window grew.
+  void EnableReceiveWindowAutoTuning(
+      std::unique_ptr<QuicReceiveWindowTuner> tuner,
+      base::RepeatingCallback<void(bool window_grew)> data_read_callback);
+
+  // Sets a callback to run with the total bytes received on this stream
+  // whenever data arrives while no handle reads the stream, as on a push
+  // stream that is not claimed yet. The callback may reset the stream.
+  void SetPushDataCallback(
+      base::RepeatingCallback<void(quic::QuicStreamId id,
+                                   uint64_t bytes_received)> callback);
+
   const NetLogWithSource& net_log() const { return net_log_; }
 
   // Prevents this stream from migrating to a cellular network. May be reset
@@ -312,6 +327,13 @@ class NET_EXPORT_PRIVATE QuicChromiumClientStream
   // Length of the HEADERS frame containing trailing headers.
   size_t trailing_headers_frame_len_;
 
+  // Only set if receive window auto-tuning is enabled.
+  std::unique_ptr<QuicReceiveWindowTuner> receive_window_tuner_;
+  base::RepeatingCallback<void(bool window_grew)> data_read_callback_;
+
+  base::RepeatingCallback<void(quic::QuicStreamId id, uint64_t bytes_received)>
+      push_data_callback_;
+
   base::WeakPtrFactory<QuicChromiumClientStream> weak_factory_{this};
 
   DISALLOW_COPY_AND_ASSIGN(QuicChromiumClientStream);
@@ -133,7 +133,10 @@ quic::WriteResult QuicChromiumPacketWriter::WritePacket(
     quic::PerPacketOptions* /*options*/) {
   DCHECK(!IsWriteBlocked());
   SetPacket(buffer, buf_len);
-  return WritePacketToSocketImpl();
+  quic::WriteResult result = WritePacketToSocketImpl();
+  if (result.status == quic::WRITE_STATUS_MSG_TOO_BIG && delegate_ != nullptr)
+    delegate_->OnMessageTooBig(buf_len);
+  return result;
 }
 
 void QuicChromiumPacketWriter::WritePacketToSocket(
@@ -155,6 +158,14 @@ quic::WriteResult QuicChromiumPacketWriter::WritePacketToSocketImpl() {
     return quic::WriteResult(quic::WRITE_STATUS_BLOCKED_DATA_BUFFERED,
                              ERR_IO_PENDING);
 
+  if (rv == ERR_MSG_TOO_BIG) {
+    // The socket does not fragment, so the packet exceeds the path MTU.
+    // Migrating would not help; report it to the connection, which drops
+    // lost MTU probes and keeps |packet_| reusable. The delegate is told by
+    // the caller, or by OnWriteComplete().
+    return quic::WriteResult(quic::WRITE_STATUS_MSG_TOO_BIG, rv);
+  }
+
   if (rv < 0 && rv != ERR_IO_PENDING && delegate_ != nullptr) {
     // If write error, then call delegate's HandleWriteError, which
     // may be able to migrate and rewrite packet on a new socket.
@@ -204,6 +215,14 @@ void QuicChromiumPacketWriter::OnWriteComplete(int rv) {
   if (delegate_ == nullptr)
     return;
 
+  if (rv == ERR_MSG_TOO_BIG) {
+    // As for synchronous writes, migrating would not help. The packet, which
+    // the connection already considers sent, is lost like any other, and the
+    // writer stays usable.
+    delegate_->OnMessageTooBig(packet_->size());
+    rv = OK;
+  }
+
   if (rv < 0) {
     if (MaybeRetryAfterWriteError(rv))
       return;
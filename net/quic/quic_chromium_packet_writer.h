@@ -63,6 +63,12 @@ class NET_EXPORT_PRIVATE QuicChromiumPacketWriter
 
     // Called when the writer is unblocked due to a write completion.
     virtual void OnWriteUnblocked() = 0;
+
+    // Called when a packet of |packet_size| bytes exceeded the path MTU. If
+    // the write was synchronous, the connection is told about it as well and
+    // drops the packet if it was an MTU probe. Otherwise the packet is lost
+    // and the writer is unblocked.
+    virtual void OnMessageTooBig(size_t packet_size) = 0;
   };
 
   QuicChromiumPacketWriter();
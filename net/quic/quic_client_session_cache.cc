@@ -115,6 +115,16 @@ void QuicClientSessionCache::ClearEarlyData(
   }
 }
 
+bool QuicClientSessionCache::CanResumeWithEarlyData(
+    const quic::QuicServerId& server_id) const {
+  auto iter = cache_.Peek(server_id);
+  if (iter == cache_.end())
+    return false;
+  SSL_SESSION* session = iter->second.PeekSession();
+  return IsValid(session, clock_->Now().ToTimeT()) &&
+         SSL_SESSION_early_data_capable(session);
+}
+
 void QuicClientSessionCache::FlushInvalidEntries() {
   time_t now = clock_->Now().ToTimeT();
   auto iter = cache_.begin();
@@ -181,7 +191,7 @@ bssl::UniquePtr<SSL_SESSION> QuicClientSessionCache::Entry::PopSession() {
   return session;
 }
 
-SSL_SESSION* QuicClientSessionCache::Entry::PeekSession() {
+SSL_SESSION* QuicClientSessionCache::Entry::PeekSession() const {
   return sessions[0].get();
 }
 
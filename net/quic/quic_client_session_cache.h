@@ -41,6 +41,10 @@ class NET_EXPORT_PRIVATE QuicClientSessionCache : public quic::SessionCache {
 
   void ClearEarlyData(const quic::QuicServerId& server_id) override;
 
+  // Returns true if Lookup() would return a session for |server_id| that
+  // allows early data. Unlike Lookup(), leaves the session in the cache.
+  bool CanResumeWithEarlyData(const quic::QuicServerId& server_id) const;
+
   void SetClockForTesting(base::Clock* clock) { clock_ = clock; }
 
   size_t size() const { return cache_.size(); }
@@ -63,7 +67,7 @@ class NET_EXPORT_PRIVATE QuicClientSessionCache : public quic::SessionCache {
     // Retrieves the latest session from the entry, meanwhile removing it.
     bssl::UniquePtr<SSL_SESSION> PopSession();
 
-    SSL_SESSION* PeekSession();
+    SSL_SESSION* PeekSession() const;
 
     bssl::UniquePtr<SSL_SESSION> sessions[2];
     std::unique_ptr<quic::TransportParameters> params;
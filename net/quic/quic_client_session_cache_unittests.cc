@@ -368,6 +368,32 @@ TEST_F(QuicClientSessionCacheTest, Expiration) {
   EXPECT_EQ(1u, cache.size());
 }
 
+TEST_F(QuicClientSessionCacheTest, CanResumeWithEarlyData) {
+  QuicClientSessionCache cache;
+  cache.SetClockForTesting(clock_.get());
+
+  auto params = MakeFakeTransportParams();
+  quic::QuicServerId id1("a.com", 443);
+  EXPECT_FALSE(cache.CanResumeWithEarlyData(id1));
+
+  cache.Insert(id1, MakeTestSession(), *params, nullptr);
+  EXPECT_TRUE(cache.CanResumeWithEarlyData(id1));
+  // Checking leaves the session for Lookup().
+  EXPECT_TRUE(cache.CanResumeWithEarlyData(id1));
+  EXPECT_NE(nullptr, cache.Lookup(id1, ssl_ctx_.get()));
+  EXPECT_FALSE(cache.CanResumeWithEarlyData(id1));
+
+  // Sessions that no longer allow early data can only be resumed with 1-RTT.
+  cache.Insert(id1, MakeTestSession(), *params, nullptr);
+  cache.ClearEarlyData(id1);
+  EXPECT_FALSE(cache.CanResumeWithEarlyData(id1));
+  EXPECT_NE(nullptr, cache.Lookup(id1, ssl_ctx_.get()));
+
+  cache.Insert(id1, MakeTestSession(), *params, nullptr);
+  clock_->Advance(kTimeout * 2);
+  EXPECT_FALSE(cache.CanResumeWithEarlyData(id1));
+}
+
 TEST_F(QuicClientSessionCacheTest, FlushOnMemoryNotifications) {
   base::test::TaskEnvironment task_environment;
   QuicClientSessionCache cache;
@@ -370,6 +370,9 @@ QuicConnectionLogger::QuicConnectionLogger(
       num_duplicate_packets_(0),
       num_blocked_frames_received_(0),
       num_blocked_frames_sent_(0),
+      num_ack_frames_sent_(0),
+      num_ecn_ack_frames_received_(0),
+      peer_ecn_ce_count_(0),
       connection_description_(connection_description),
       socket_performance_watcher_(std::move(socket_performance_watcher)) {}
 
@@ -388,6 +391,12 @@ QuicConnectionLogger::~QuicConnectionLogger() {
                           num_blocked_frames_received_);
   UMA_HISTOGRAM_COUNTS_1M("Net.QuicSession.BlockedFrames.Sent",
                           num_blocked_frames_sent_);
+  UMA_HISTOGRAM_BOOLEAN("Net.QuicSession.PeerReportedEcnCounts",
+                        num_ecn_ack_frames_received_ > 0);
+  if (num_ecn_ack_frames_received_ > 0) {
+    UMA_HISTOGRAM_COUNTS_1M("Net.QuicSession.PeerReportedEcnCePackets",
+                            peer_ecn_ce_count_);
+  }
 
   const quic::QuicConnectionStats& stats = session_->connection()->GetStats();
   UMA_HISTOGRAM_TIMES("Net.QuicSession.MinRTT",
@@ -409,6 +418,16 @@ QuicConnectionLogger::~QuicConnectionLogger() {
     }
   }
 
+  // Ack frequency matters for long transfers, where every ack costs CPU on
+  // both ends.
+  if (num_packets_received_ >= 1000) {
+    UMA_HISTOGRAM_CUSTOM_COUNTS(
+        "Net.QuicSession.AcksSentPerThousandPacketsReceived",
+        static_cast<base::HistogramBase::Sample>(num_ack_frames_sent_ * 1000 /
+                                                 num_packets_received_),
+        1, 1000, 50);
+  }
+
   RecordAggregatePacketLossRate();
 }
 
@@ -419,6 +438,7 @@ void QuicConnectionLogger::OnFrameAddedToPacket(const quic::QuicFrame& frame) {
     case quic::STREAM_FRAME:
       break;
     case quic::ACK_FRAME: {
+      ++num_ack_frames_sent_;
       break;
     }
     case quic::RST_STREAM_FRAME:
@@ -881,6 +901,11 @@ void QuicConnectionLogger::OnIncomingAck(
                    first_received_packet_number_] = true;
   }
 
+  if (frame.ecn_counters_populated) {
+    ++num_ecn_ack_frames_received_;
+    peer_ecn_ce_count_ = std::max(peer_ecn_ce_count_, frame.ecn_ce_count);
+  }
+
   if (!net_log_.IsCapturing())
     return;
   net_log_.AddEvent(NetLogEventType::QUIC_SESSION_ACK_FRAME_RECEIVED,
@@ -184,6 +184,12 @@ class NET_EXPORT_PRIVATE QuicConnectionLogger
   int num_blocked_frames_received_;
   // Count of the number of BLOCKED frames sent.
   int num_blocked_frames_sent_;
+  // Count of the number of ACK frames sent.
+  int num_ack_frames_sent_;
+  // Count of the number of ACK frames received carrying ECN counts.
+  int num_ecn_ack_frames_received_;
+  // Highest CE count reported by the peer.
+  quic::QuicPacketCount peer_ecn_ce_count_;
   // Vector of inital packets status' indexed by packet numbers, where
   // false means never received. We track 150 packets starting from
   // first_received_packet_number_.
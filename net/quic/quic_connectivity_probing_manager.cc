@@ -91,6 +91,8 @@ void QuicConnectivityProbingManager::OnWriteError(int error_code) {
 
 void QuicConnectivityProbingManager::OnWriteUnblocked() {}
 
+void QuicConnectivityProbingManager::OnMessageTooBig(size_t packet_size) {}
+
 void QuicConnectivityProbingManager::CancelProbing(
     NetworkChangeNotifier::NetworkHandle network,
     const quic::QuicSocketAddress& peer_address) {
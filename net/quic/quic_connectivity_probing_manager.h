@@ -60,6 +60,7 @@ class NET_EXPORT_PRIVATE QuicConnectivityProbingManager
                            last_packet) override;
   void OnWriteError(int error_code) override;
   void OnWriteUnblocked() override;
+  void OnMessageTooBig(size_t packet_size) override;
 
   // Starts probing |peer_address| on |network|.
   // |this| will take the ownership of |socket|, |writer| and |reader|.
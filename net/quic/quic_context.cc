@@ -54,9 +54,17 @@ quic::QuicConfig InitializeQuicConfig(const QuicParams& params) {
   config.SetConnectionOptionsToSend(params.connection_options);
   config.SetClientConnectionOptions(params.client_connection_options);
   config.set_max_undecryptable_packets(kMaxUndecryptablePackets);
-  config.SetInitialSessionFlowControlWindowToSend(
-      kQuicSessionMaxRecvWindowSize);
-  config.SetInitialStreamFlowControlWindowToSend(kQuicStreamMaxRecvWindowSize);
+  if (params.auto_tune_receive_windows) {
+    config.SetInitialSessionFlowControlWindowToSend(
+        kQuicAutoTuneInitialSessionRecvWindowSize);
+    config.SetInitialStreamFlowControlWindowToSend(
+        kQuicAutoTuneInitialStreamRecvWindowSize);
+  } else {
+    config.SetInitialSessionFlowControlWindowToSend(
+        kQuicSessionMaxRecvWindowSize);
+    config.SetInitialStreamFlowControlWindowToSend(
+        kQuicStreamMaxRecvWindowSize);
+  }
   config.SetBytesForConnectionIdToSend(0);
   return config;
 }
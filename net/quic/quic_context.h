@@ -50,6 +50,21 @@ const int64_t kMaxMigrationsToNonDefaultNetworkOnWriteError = 5;
 // degrading per network.
 const int64_t kMaxMigrationsToNonDefaultNetworkOnPathDegrading = 5;
 
+// Initial and maximum receive windows of sessions and streams when receive
+// window auto-tuning is enabled. Windows grow by doubling, so maximums are
+// powers of two times the initial windows.
+const int32_t kQuicAutoTuneInitialSessionRecvWindowSize = 1024 * 1024;
+const int32_t kQuicAutoTuneInitialStreamRecvWindowSize = 512 * 1024;
+const int32_t kQuicAutoTuneMaxSessionRecvWindowSize = 16 * 1024 * 1024;
+const int32_t kQuicAutoTuneMaxStreamRecvWindowSize = 8 * 1024 * 1024;
+
+// Default limit on how far receive windows of all sessions of a
+// QuicStreamFactory may grow beyond their initial sizes, in total.
+const size_t kQuicDefaultReceiveWindowMemoryBudget = 64 * 1024 * 1024;
+
+// Default limit on the bytes received on the unclaimed pushes of a session.
+const size_t kQuicDefaultMaxPushCacheBytes = 4 * 1024 * 1024;
+
 // QUIC's socket receive buffer size.
 // We should adaptively set this buffer size, but for now, we'll use a size
 // that seems large enough to receive data at line rate for most connections,
@@ -71,9 +86,26 @@ struct NET_EXPORT QuicParams {
   std::string user_agent_id;
   // Limit on the size of QUIC packets.
   size_t max_packet_length = quic::kDefaultMaxPacketSize;
+  // If true, client sessions probe for a larger path MTU once the handshake
+  // is confirmed, and again after migrating to a new path. Validated MTUs are
+  // cached per network and peer address.
+  bool enable_path_mtu_discovery = false;
   // Maximum number of server configs that are to be stored in
   // HttpServerProperties, instead of the disk cache.
   size_t max_server_configs_stored_in_properties = 0u;
+  // If non-zero, idle sessions are closed whenever the estimated memory used
+  // by all sessions exceeds this many bytes, and on memory pressure. Sessions
+  // that can be resumed with 0-RTT are closed first, then the least recently
+  // used ones. Also makes TLS handshakes cache session tickets, so that
+  // evicted sessions with tickets allowing early data resume with 0-RTT.
+  size_t session_memory_budget = 0u;
+  // If true, sessions advertise small initial receive windows and double
+  // session and stream windows when the reader consumes half a window within
+  // two round trips, instead of advertising large fixed windows.
+  bool auto_tune_receive_windows = false;
+  // Limit on the total growth of receive windows beyond their initial sizes,
+  // across all sessions, when |auto_tune_receive_windows| is true.
+  size_t receive_window_memory_budget = kQuicDefaultReceiveWindowMemoryBudget;
   // QUIC will be used for all connections in this set.
   std::set<HostPortPair> origins_to_force_quic_on;
   // Set of QUIC tags to send in the handshake's connection options.
@@ -85,6 +117,16 @@ struct NET_EXPORT QuicParams {
   bool enable_socket_recv_optimization = false;
   // Initial value of QuicSpdyClientSessionBase::max_allowed_push_id_.
   quic::QuicStreamId max_allowed_push_id = 0;
+  // Unclaimed pushes of a session are cancelled, oldest first, once more than
+  // this many bytes have been received on them. Zero means no limit.
+  size_t max_push_cache_bytes = kQuicDefaultMaxPushCacheBytes;
+  // Pushes unclaimed for longer than this are cancelled when more data is
+  // received on a push. Zero, the default, leaves unclaimed pushes to the push
+  // promise timeout of the QUIC library.
+  base::TimeDelta max_push_cache_age;
+  // If true, identical GET requests in flight on a session share one request
+  // stream, and the response is read once for all of them.
+  bool coalesce_identical_requests = false;
 
   // Active QUIC experiments
 
@@ -167,6 +209,9 @@ struct NET_EXPORT QuicParams {
   // The initial rtt that will be used in crypto handshake if no cached
   // smoothed rtt is present.
   base::TimeDelta initial_rtt_for_handshake;
+  // If true, sessions to servers with a cached large bandwidth-delay product
+  // ack once per quarter RTT, however many packets that is.
+  bool adaptive_ack_decimation = false;
 };
 
 // QuicContext contains QUIC-related variables that are shared across all of the
@@ -77,6 +77,10 @@ QuicHttpStream::QuicHttpStream(
       user_buffer_len_(0),
       session_error_(ERR_UNEXPECTED),
       found_promise_(false),
+      may_coalesce_(false),
+      coalesced_reader_id_(0),
+      is_coalescing_leader_(false),
+      reading_coalesced_response_(false),
       in_loop_(false) {}
 
 QuicHttpStream::~QuicHttpStream() {
@@ -165,6 +169,14 @@ int QuicHttpStream::InitializeStream(const HttpRequestInfo* request_info,
     return OK;
   }
 
+  // Whether an identical request is in flight is only known once the request
+  // headers are, so the stream is requested, if at all, by SendRequest().
+  if (quic_session()->GetRequestCoalescer() &&
+      QuicRequestCoalescer::IsEligible(*request_info)) {
+    may_coalesce_ = true;
+    return OK;
+  }
+
   next_state_ = STATE_REQUEST_STREAM;
   int rv = DoLoop(OK);
   if (rv == ERR_IO_PENDING)
@@ -203,6 +215,48 @@ int QuicHttpStream::DoHandlePromiseComplete(int rv) {
   return OK;
 }
 
+int QuicHttpStream::DoCoalesceRequest() {
+  QuicRequestCoalescer* coalescer = quic_session()->GetRequestCoalescer();
+  if (!coalescer) {
+    next_state_ = STATE_REQUEST_STREAM;
+    return OK;
+  }
+
+  std::string key = QuicRequestCoalescer::ComputeKey(request_headers_);
+  coalesced_response_ = coalescer->Join(key);
+  if (!coalesced_response_) {
+    // Send the request, and share its response with identical requests
+    // issued until the response headers arrive.
+    coalesced_response_ = coalescer->Start(key);
+    coalesced_reader_id_ = coalesced_response_->AddReader(priority_);
+    is_coalescing_leader_ = true;
+    next_state_ = STATE_REQUEST_STREAM;
+    return OK;
+  }
+
+  coalesced_reader_id_ = coalesced_response_->AddReader(priority_);
+  next_state_ = STATE_COALESCE_REQUEST_COMPLETE;
+  return coalesced_response_->WaitForHeaders(
+      coalesced_reader_id_,
+      base::BindOnce(&QuicHttpStream::OnIOComplete,
+                     weak_factory_.GetWeakPtr()));
+}
+
+int QuicHttpStream::DoCoalesceRequestComplete(int rv) {
+  DCHECK_NE(ERR_IO_PENDING, rv);
+  if (rv != OK) {
+    // The response is not shared, so send the request as usual.
+    coalesced_response_->RemoveReader(coalesced_reader_id_);
+    coalesced_response_ = nullptr;
+    next_state_ = STATE_REQUEST_STREAM;
+    return OK;
+  }
+
+  reading_coalesced_response_ = true;
+  next_state_ = STATE_OPEN;
+  return OK;
+}
+
 int QuicHttpStream::SendRequest(const HttpRequestHeaders& request_headers,
                                 HttpResponseInfo* response,
                                 CompletionOnceCallback callback) {
@@ -212,9 +266,11 @@ int QuicHttpStream::SendRequest(const HttpRequestHeaders& request_headers,
   CHECK(!callback.is_null());
   CHECK(response);
 
-  // In order to rendezvous with a push stream, the session still needs to be
-  // available. Otherwise the stream needs to be available.
-  if ((!found_promise_ && !stream_) || !quic_session()->IsConnected())
+  // In order to rendezvous with a push stream or to coalesce the request, the
+  // session still needs to be available. Otherwise the stream needs to be
+  // available.
+  if ((!found_promise_ && !may_coalesce_ && !stream_) ||
+      !quic_session()->IsConnected())
     return GetResponseStatus();
 
   // Store the serialized request headers.
@@ -260,7 +316,9 @@ int QuicHttpStream::SendRequest(const HttpRequestHeaders& request_headers,
 
   int rv;
 
-  if (!found_promise_) {
+  if (may_coalesce_) {
+    next_state_ = STATE_COALESCE_REQUEST;
+  } else if (!found_promise_) {
     next_state_ = STATE_SET_REQUEST_PRIORITY;
   } else if (!request_body_stream_) {
     next_state_ = STATE_HANDLE_PROMISE;
@@ -280,6 +338,13 @@ int QuicHttpStream::ReadResponseHeaders(CompletionOnceCallback callback) {
   CHECK(callback_.is_null());
   CHECK(!callback.is_null());
 
+  if (reading_coalesced_response_) {
+    if (response_headers_received_)
+      return OK;
+    // The headers were received by the leader, on behalf of this stream.
+    return ProcessResponseHeaders(coalesced_response_->headers());
+  }
+
   int rv = stream_->ReadInitialHeaders(
       &response_header_block_,
       base::BindOnce(&QuicHttpStream::OnReadResponseHeadersComplete,
@@ -319,6 +384,20 @@ int QuicHttpStream::ReadResponseBody(IOBuffer* buf,
   // anymore.
   request_info_ = nullptr;
 
+  if (reading_coalesced_response_) {
+    int rv = coalesced_response_->ReadBody(
+        coalesced_reader_id_, buf, buf_len,
+        base::BindOnce(&QuicHttpStream::OnReadBodyComplete,
+                       weak_factory_.GetWeakPtr()));
+    if (rv == ERR_IO_PENDING) {
+      callback_ = std::move(callback);
+      return ERR_IO_PENDING;
+    }
+    if (rv < 0)
+      return MapStreamError(rv);
+    return HandleReadComplete(rv);
+  }
+
   // If the stream is already closed, there is no body to read.
   if (stream_->IsDoneReading())
     return HandleReadComplete(OK);
@@ -342,6 +421,12 @@ int QuicHttpStream::ReadResponseBody(IOBuffer* buf,
 void QuicHttpStream::Close(bool /*not_reusable*/) {
   session_error_ = ERR_ABORTED;
   SaveResponseStatus();
+  if (coalesced_response_) {
+    if (is_coalescing_leader_ && !stream_)
+      closed_stream_received_bytes_ = coalesced_response_->NumBytesConsumed();
+    coalesced_response_->RemoveReader(coalesced_reader_id_);
+    coalesced_response_ = nullptr;
+  }
   // Note: the not_reusable flag has no meaning for QUIC streams.
   if (stream_)
     stream_->Reset(quic::QUIC_STREAM_CANCELLED);
@@ -349,6 +434,10 @@ void QuicHttpStream::Close(bool /*not_reusable*/) {
 }
 
 bool QuicHttpStream::IsResponseBodyComplete() const {
+  if (reading_coalesced_response_) {
+    return coalesced_response_ &&
+           coalesced_response_->IsDoneReading(coalesced_reader_id_);
+  }
   return next_state_ == STATE_OPEN && stream_->IsDoneReading();
 }
 
@@ -368,6 +457,10 @@ int64_t QuicHttpStream::GetTotalReceivedBytes() const {
     DCHECK_LE(stream_->NumBytesConsumed(), stream_->stream_bytes_read());
     // Only count the uniquely received bytes.
     total_received_bytes += stream_->NumBytesConsumed();
+  } else if (is_coalescing_leader_ && coalesced_response_) {
+    // The leader accounts for the shared stream. The other readers received
+    // nothing themselves.
+    total_received_bytes += coalesced_response_->NumBytesConsumed();
   } else {
     total_received_bytes += closed_stream_received_bytes_;
   }
@@ -494,6 +587,13 @@ int QuicHttpStream::DoLoop(int rv) {
       case STATE_HANDLE_PROMISE_COMPLETE:
         rv = DoHandlePromiseComplete(rv);
         break;
+      case STATE_COALESCE_REQUEST:
+        CHECK_EQ(OK, rv);
+        rv = DoCoalesceRequest();
+        break;
+      case STATE_COALESCE_REQUEST_COMPLETE:
+        rv = DoCoalesceRequestComplete(rv);
+        break;
       case STATE_REQUEST_STREAM:
         CHECK_EQ(OK, rv);
         rv = DoRequestStream();
@@ -583,9 +683,16 @@ int QuicHttpStream::DoSetRequestPriority() {
   DCHECK(stream_);
   DCHECK(response_info_);
 
-  spdy::SpdyPriority priority = ConvertRequestPriorityToQuicPriority(priority_);
-  spdy::SpdyStreamPrecedence precedence(priority);
-  stream_->SetPriority(precedence);
+  if (coalesced_response_) {
+    // The stream gets the priority of the most urgent of the identical
+    // requests which join this one.
+    coalesced_response_->SetLeaderStream(stream_.get());
+  } else {
+    spdy::SpdyPriority priority =
+        ConvertRequestPriorityToQuicPriority(priority_);
+    spdy::SpdyStreamPrecedence precedence(priority);
+    stream_->SetPriority(precedence);
+  }
   next_state_ = STATE_SEND_HEADERS;
   return OK;
 }
@@ -708,6 +815,22 @@ int QuicHttpStream::ProcessResponseHeaders(
   // take care of 0-RTT where request is sent before handshake is confirmed.
   connect_timing_ = quic_session()->GetConnectTiming();
 
+  if (coalesced_response_ && !reading_coalesced_response_) {
+    // Record what the stream sent and received so far, before the shared
+    // response takes it over.
+    ResetStream();
+    if (coalesced_response_->OnHeaders(headers, &stream_)) {
+      reading_coalesced_response_ = true;
+    } else {
+      coalesced_response_->RemoveReader(coalesced_reader_id_);
+      coalesced_response_ = nullptr;
+    }
+  }
+
+  // The shared response reads the trailers and the end of the stream.
+  if (reading_coalesced_response_)
+    return OK;
+
   base::ThreadTaskRunnerHandle::Get()->PostTask(
       FROM_HERE, base::BindOnce(&QuicHttpStream::ReadTrailingHeaders,
                                 weak_factory_.GetWeakPtr()));
@@ -730,6 +853,12 @@ void QuicHttpStream::OnReadBodyComplete(int rv) {
 }
 
 int QuicHttpStream::HandleReadComplete(int rv) {
+  if (reading_coalesced_response_) {
+    if (coalesced_response_->IsDoneReading(coalesced_reader_id_))
+      SetResponseStatus(OK);
+    return rv;
+  }
+
   if (stream_->IsDoneReading()) {
     stream_->OnFinRead();
     SetResponseStatus(OK);
@@ -23,6 +23,7 @@
 #include "net/log/net_log_with_source.h"
 #include "net/quic/quic_chromium_client_session.h"
 #include "net/quic/quic_chromium_client_stream.h"
+#include "net/quic/quic_request_coalescer.h"
 #include "net/spdy/multiplexed_http_stream.h"
 #include "net/third_party/quiche/src/quic/core/http/quic_client_push_promise_index.h"
 #include "net/third_party/quiche/src/quic/core/quic_packets.h"
@@ -77,6 +78,8 @@ class NET_EXPORT_PRIVATE QuicHttpStream : public MultiplexedHttpStream {
     STATE_NONE,
     STATE_HANDLE_PROMISE,
     STATE_HANDLE_PROMISE_COMPLETE,
+    STATE_COALESCE_REQUEST,
+    STATE_COALESCE_REQUEST_COMPLETE,
     STATE_REQUEST_STREAM,
     STATE_REQUEST_STREAM_COMPLETE,
     STATE_SET_REQUEST_PRIORITY,
@@ -95,6 +98,8 @@ class NET_EXPORT_PRIVATE QuicHttpStream : public MultiplexedHttpStream {
   int DoLoop(int rv);
   int DoHandlePromise();
   int DoHandlePromiseComplete(int rv);
+  int DoCoalesceRequest();
+  int DoCoalesceRequestComplete(int rv);
   int DoRequestStream();
   int DoRequestStreamComplete(int rv);
   int DoSetRequestPriority();
@@ -212,6 +217,20 @@ class NET_EXPORT_PRIVATE QuicHttpStream : public MultiplexedHttpStream {
 
   bool found_promise_;
 
+  // True if the request may share the response of an identical request in
+  // flight on the session, which is decided once the request headers are
+  // known.
+  bool may_coalesce_;
+  // The response shared by identical requests, and the id of this stream
+  // among its readers. Set while waiting for it, and while reading it.
+  scoped_refptr<QuicCoalescedResponse> coalesced_response_;
+  QuicCoalescedResponse::ReaderId coalesced_reader_id_;
+  // True if this stream sends the request whose response is shared.
+  bool is_coalescing_leader_;
+  // True once the response is read from |coalesced_response_| instead of
+  // |stream_|.
+  bool reading_coalesced_response_;
+
   // Set to true when DoLoop() is being executed, false otherwise.
   bool in_loop_;
 
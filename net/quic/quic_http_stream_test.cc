@@ -999,6 +999,196 @@ TEST_P(QuicHttpStreamTest, GetRequestLargeResponse) {
             stream_->GetTotalReceivedBytes());
 }
 
+TEST_P(QuicHttpStreamTest, CoalescedGetRequests) {
+  SetRequest("GET", "/", DEFAULT_PRIORITY);
+  size_t spdy_request_header_frame_length;
+  int packet_number = 1;
+  if (VersionUsesHttp3(version_.transport_version))
+    AddWrite(ConstructInitialSettingsPacket(packet_number++));
+  // The request is sent once.
+  AddWrite(InnerConstructRequestHeadersPacket(
+      packet_number++, GetNthClientInitiatedBidirectionalStreamId(0),
+      kIncludeVersion, kFin, DEFAULT_PRIORITY,
+      &spdy_request_header_frame_length));
+  AddWrite(ConstructClientAckPacket(packet_number++, 3, 1, 2));
+
+  Initialize();
+  session_->EnableRequestCoalescing();
+
+  request_.method = "GET";
+  request_.url = GURL("https://www.example.org/");
+
+  EXPECT_EQ(OK,
+            stream_->InitializeStream(&request_, true, DEFAULT_PRIORITY,
+                                      net_log_.bound(), callback_.callback()));
+  EXPECT_EQ(OK,
+            stream_->SendRequest(headers_, &response_, callback_.callback()));
+
+  // An identical request waits for the response of the first one.
+  TestCompletionCallback callback2;
+  HttpResponseInfo response2;
+  EXPECT_EQ(OK, promised_stream_->InitializeStream(
+                    &request_, true, DEFAULT_PRIORITY, net_log_.bound(),
+                    callback2.callback()));
+  EXPECT_THAT(
+      promised_stream_->SendRequest(headers_, &response2, callback2.callback()),
+      IsError(ERR_IO_PENDING));
+
+  // Ack the request.
+  ProcessPacket(ConstructServerAckPacket(1, 1, 1, 1));
+
+  EXPECT_THAT(stream_->ReadResponseHeaders(callback_.callback()),
+              IsError(ERR_IO_PENDING));
+
+  SetResponse("200 OK", string());
+  size_t spdy_response_header_frame_length;
+  ProcessPacket(ConstructResponseHeadersPacket(
+      2, !kFin, &spdy_response_header_frame_length));
+
+  EXPECT_THAT(callback_.WaitForResult(), IsOk());
+  EXPECT_THAT(callback2.WaitForResult(), IsOk());
+  EXPECT_THAT(promised_stream_->ReadResponseHeaders(callback2.callback()),
+              IsOk());
+  for (const HttpResponseInfo* response : {&response_, &response2}) {
+    ASSERT_TRUE(response->headers.get());
+    EXPECT_EQ(200, response->headers->response_code());
+    EXPECT_TRUE(
+        response->headers->HasHeaderValue("Content-Type", "text/plain"));
+  }
+
+  const char kResponseBody[] = "Hello world!";
+  std::string header = ConstructDataHeader(strlen(kResponseBody));
+  ProcessPacket(
+      ConstructServerDataPacket(3, false, kFin, header + kResponseBody));
+
+  // Both streams read the body.
+  for (QuicHttpStream* stream : {stream_.get(), promised_stream_.get()}) {
+    ASSERT_EQ(static_cast<int>(strlen(kResponseBody)),
+              stream->ReadResponseBody(read_buffer_.get(),
+                                       read_buffer_->size(),
+                                       callback_.callback()));
+    EXPECT_EQ(kResponseBody,
+              base::StringPiece(read_buffer_->data(), strlen(kResponseBody)));
+    EXPECT_EQ(0,
+              stream->ReadResponseBody(read_buffer_.get(), read_buffer_->size(),
+                                       callback_.callback()));
+    EXPECT_TRUE(stream->IsResponseBodyComplete());
+  }
+  EXPECT_TRUE(AtEof());
+
+  const QuicRequestCoalescer::Stats& stats =
+      session_->request_coalescer()->stats();
+  EXPECT_EQ(1u, stats.requests_coalesced);
+  EXPECT_EQ(strlen(kResponseBody), stats.bytes_saved);
+
+  // The first stream accounts for all bytes on the wire.
+  EXPECT_EQ(static_cast<int64_t>(spdy_request_header_frame_length),
+            stream_->GetTotalSentBytes());
+  EXPECT_EQ(static_cast<int64_t>(spdy_response_header_frame_length +
+                                 strlen(kResponseBody) + header.length()),
+            stream_->GetTotalReceivedBytes());
+  EXPECT_EQ(0, promised_stream_->GetTotalSentBytes());
+  EXPECT_EQ(0, promised_stream_->GetTotalReceivedBytes());
+}
+
+TEST_P(QuicHttpStreamTest, CoalescedGetRequestsWithStalledReader) {
+  SetRequest("GET", "/", DEFAULT_PRIORITY);
+  size_t spdy_request_header_frame_length;
+  int packet_number = 1;
+  if (VersionUsesHttp3(version_.transport_version))
+    AddWrite(ConstructInitialSettingsPacket(packet_number++));
+  AddWrite(InnerConstructRequestHeadersPacket(
+      packet_number++, GetNthClientInitiatedBidirectionalStreamId(0),
+      kIncludeVersion, kFin, DEFAULT_PRIORITY,
+      &spdy_request_header_frame_length));
+  AddWrite(ConstructClientAckPacket(packet_number++, 3, 1, 2));
+
+  Initialize();
+  session_->EnableRequestCoalescing();
+  // The shared response buffers no more than 5 bytes of the body.
+  session_->request_coalescer()->set_max_buffered_bytes_for_testing(5);
+
+  request_.method = "GET";
+  request_.url = GURL("https://www.example.org/");
+
+  EXPECT_EQ(OK,
+            stream_->InitializeStream(&request_, true, DEFAULT_PRIORITY,
+                                      net_log_.bound(), callback_.callback()));
+  EXPECT_EQ(OK,
+            stream_->SendRequest(headers_, &response_, callback_.callback()));
+  TestCompletionCallback callback2;
+  HttpResponseInfo response2;
+  EXPECT_EQ(OK, promised_stream_->InitializeStream(
+                    &request_, true, DEFAULT_PRIORITY, net_log_.bound(),
+                    callback2.callback()));
+  EXPECT_THAT(
+      promised_stream_->SendRequest(headers_, &response2, callback2.callback()),
+      IsError(ERR_IO_PENDING));
+
+  ProcessPacket(ConstructServerAckPacket(1, 1, 1, 1));
+  EXPECT_THAT(stream_->ReadResponseHeaders(callback_.callback()),
+              IsError(ERR_IO_PENDING));
+  SetResponse("200 OK", string());
+  size_t spdy_response_header_frame_length;
+  ProcessPacket(ConstructResponseHeadersPacket(
+      2, !kFin, &spdy_response_header_frame_length));
+  EXPECT_THAT(callback_.WaitForResult(), IsOk());
+  EXPECT_THAT(callback2.WaitForResult(), IsOk());
+  EXPECT_THAT(promised_stream_->ReadResponseHeaders(callback2.callback()),
+              IsOk());
+
+  const char kResponseBody[] = "Hello world!";
+  std::string header = ConstructDataHeader(strlen(kResponseBody));
+  ProcessPacket(
+      ConstructServerDataPacket(3, false, kFin, header + kResponseBody));
+
+  // The first stream reads ahead of the second one, which does not read,
+  // until the buffer is full.
+  EXPECT_EQ(5, stream_->ReadResponseBody(read_buffer_.get(),
+                                         read_buffer_->size(),
+                                         callback_.callback()));
+  EXPECT_EQ("Hello", base::StringPiece(read_buffer_->data(), 5));
+  EXPECT_THAT(stream_->ReadResponseBody(read_buffer_.get(),
+                                        read_buffer_->size(),
+                                        callback_.callback()),
+              IsError(ERR_IO_PENDING));
+  base::RunLoop().RunUntilIdle();
+  EXPECT_FALSE(callback_.have_result());
+
+  // Each time the second stream catches up, the first one reads on.
+  auto read_buffer2 = base::MakeRefCounted<IOBufferWithSize>(4096);
+  EXPECT_EQ(5, promised_stream_->ReadResponseBody(read_buffer2.get(),
+                                                  read_buffer2->size(),
+                                                  callback2.callback()));
+  EXPECT_EQ("Hello", base::StringPiece(read_buffer2->data(), 5));
+  EXPECT_EQ(5, callback_.WaitForResult());
+  EXPECT_EQ(" worl", base::StringPiece(read_buffer_->data(), 5));
+
+  EXPECT_THAT(stream_->ReadResponseBody(read_buffer_.get(),
+                                        read_buffer_->size(),
+                                        callback_.callback()),
+              IsError(ERR_IO_PENDING));
+  EXPECT_EQ(5, promised_stream_->ReadResponseBody(read_buffer2.get(),
+                                                  read_buffer2->size(),
+                                                  callback2.callback()));
+  EXPECT_EQ(" worl", base::StringPiece(read_buffer2->data(), 5));
+  EXPECT_EQ(2, callback_.WaitForResult());
+  EXPECT_EQ("d!", base::StringPiece(read_buffer_->data(), 2));
+
+  EXPECT_EQ(0, stream_->ReadResponseBody(read_buffer_.get(),
+                                         read_buffer_->size(),
+                                         callback_.callback()));
+  EXPECT_TRUE(stream_->IsResponseBodyComplete());
+  EXPECT_EQ(2, promised_stream_->ReadResponseBody(read_buffer2.get(),
+                                                  read_buffer2->size(),
+                                                  callback2.callback()));
+  EXPECT_EQ(0, promised_stream_->ReadResponseBody(read_buffer2.get(),
+                                                  read_buffer2->size(),
+                                                  callback2.callback()));
+  EXPECT_TRUE(promised_stream_->IsResponseBodyComplete());
+  EXPECT_TRUE(AtEof());
+}
+
 // Regression test for http://crbug.com/409101
 TEST_P(QuicHttpStreamTest, SessionClosedBeforeSendRequest) {
   SetRequest("GET", "/", DEFAULT_PRIORITY);
@@ -0,0 +1,54 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_path_mtu_cache.h"
+
+namespace net {
+
+QuicPathMtuCache::QuicPathMtuCache(size_t max_entries) : cache_(max_entries) {}
+
+QuicPathMtuCache::~QuicPathMtuCache() = default;
+
+quic::QuicByteCount QuicPathMtuCache::Lookup(
+    NetworkChangeNotifier::NetworkHandle network,
+    const IPEndPoint& peer_address) {
+  auto it = cache_.Get(PathKey(network, peer_address));
+  if (it == cache_.end())
+    return 0;
+  return it->second;
+}
+
+void QuicPathMtuCache::OnMtuValidated(
+    NetworkChangeNotifier::NetworkHandle network,
+    const IPEndPoint& peer_address,
+    quic::QuicByteCount mtu) {
+  cache_.Put(PathKey(network, peer_address), mtu);
+}
+
+void QuicPathMtuCache::OnPacketTooBig(
+    NetworkChangeNotifier::NetworkHandle network,
+    const IPEndPoint& peer_address,
+    quic::QuicByteCount size) {
+  auto it = cache_.Peek(PathKey(network, peer_address));
+  if (it != cache_.end() && it->second >= size)
+    cache_.Erase(it);
+}
+
+void QuicPathMtuCache::OnNetworkDisconnected(
+    NetworkChangeNotifier::NetworkHandle network) {
+  auto it = cache_.begin();
+  while (it != cache_.end()) {
+    if (it->first.first == network) {
+      it = cache_.Erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void QuicPathMtuCache::Clear() {
+  cache_.Clear();
+}
+
+}  // namespace net
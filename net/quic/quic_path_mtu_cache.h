@@ -0,0 +1,70 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_QUIC_PATH_MTU_CACHE_H_
+#define NET_QUIC_QUIC_PATH_MTU_CACHE_H_
+
+#include <stddef.h>
+
+#include <utility>
+
+#include "base/containers/mru_cache.h"
+#include "base/macros.h"
+#include "net/base/ip_endpoint.h"
+#include "net/base/net_export.h"
+#include "net/base/network_change_notifier.h"
+#include "net/third_party/quiche/src/quic/core/quic_types.h"
+
+namespace net {
+
+// Maximum number of <network, peer> paths whose MTU is remembered.
+const size_t kMaxPathMtuCacheEntries = 256;
+
+// Remembers the largest packet size validated by packetization-layer path MTU
+// discovery (RFC 8899) on a <network, peer address> path. Sessions to a known
+// path use the cached value as their probe target, so that the search
+// converges with a single probe; the value is always re-validated by probing
+// before it is used for regular packets.
+class NET_EXPORT_PRIVATE QuicPathMtuCache {
+ public:
+  explicit QuicPathMtuCache(size_t max_entries);
+  ~QuicPathMtuCache();
+
+  // Returns the cached MTU on the path to |peer_address| over |network|, or 0
+  // if the path is unknown.
+  quic::QuicByteCount Lookup(NetworkChangeNotifier::NetworkHandle network,
+                             const IPEndPoint& peer_address);
+
+  // Records that packets of |mtu| bytes have been acknowledged on the path to
+  // |peer_address| over |network|.
+  void OnMtuValidated(NetworkChangeNotifier::NetworkHandle network,
+                      const IPEndPoint& peer_address,
+                      quic::QuicByteCount mtu);
+
+  // Records that a packet of |size| bytes was too big for the path to
+  // |peer_address| over |network|. Forgets the cached MTU of the path if it is
+  // not below |size|, as the path has changed since it was validated.
+  void OnPacketTooBig(NetworkChangeNotifier::NetworkHandle network,
+                      const IPEndPoint& peer_address,
+                      quic::QuicByteCount size);
+
+  // Forgets every path over |network|, e.g. when the network disconnects.
+  void OnNetworkDisconnected(NetworkChangeNotifier::NetworkHandle network);
+
+  // Forgets every path.
+  void Clear();
+
+  size_t size() const { return cache_.size(); }
+
+ private:
+  using PathKey = std::pair<NetworkChangeNotifier::NetworkHandle, IPEndPoint>;
+
+  base::MRUCache<PathKey, quic::QuicByteCount> cache_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicPathMtuCache);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_PATH_MTU_CACHE_H_
@@ -0,0 +1,83 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_path_mtu_cache.h"
+
+#include "net/base/ip_address.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+const NetworkChangeNotifier::NetworkHandle kNetwork1 = 1;
+const NetworkChangeNotifier::NetworkHandle kNetwork2 = 2;
+
+class QuicPathMtuCacheTest : public ::testing::Test {
+ protected:
+  QuicPathMtuCacheTest()
+      : cache_(2),
+        peer1_(IPAddress(192, 0, 2, 1), 443),
+        peer2_(IPAddress(192, 0, 2, 2), 443) {}
+
+  QuicPathMtuCache cache_;
+  IPEndPoint peer1_;
+  IPEndPoint peer2_;
+};
+
+TEST_F(QuicPathMtuCacheTest, UnknownPath) {
+  EXPECT_EQ(0u, cache_.Lookup(kNetwork1, peer1_));
+}
+
+TEST_F(QuicPathMtuCacheTest, PerNetworkAndPeer) {
+  cache_.OnMtuValidated(kNetwork1, peer1_, 1450);
+  EXPECT_EQ(1450u, cache_.Lookup(kNetwork1, peer1_));
+  EXPECT_EQ(0u, cache_.Lookup(kNetwork2, peer1_));
+  EXPECT_EQ(0u, cache_.Lookup(kNetwork1, peer2_));
+
+  cache_.OnMtuValidated(kNetwork1, peer1_, 1300);
+  EXPECT_EQ(1300u, cache_.Lookup(kNetwork1, peer1_));
+}
+
+TEST_F(QuicPathMtuCacheTest, EvictsLeastRecentlyUsed) {
+  cache_.OnMtuValidated(kNetwork1, peer1_, 1450);
+  cache_.OnMtuValidated(kNetwork1, peer2_, 1450);
+  // Touch |peer1_| so that |peer2_| is evicted next.
+  EXPECT_EQ(1450u, cache_.Lookup(kNetwork1, peer1_));
+  cache_.OnMtuValidated(kNetwork2, peer1_, 1400);
+
+  EXPECT_EQ(2u, cache_.size());
+  EXPECT_EQ(1450u, cache_.Lookup(kNetwork1, peer1_));
+  EXPECT_EQ(0u, cache_.Lookup(kNetwork1, peer2_));
+  EXPECT_EQ(1400u, cache_.Lookup(kNetwork2, peer1_));
+}
+
+TEST_F(QuicPathMtuCacheTest, OnPacketTooBig) {
+  cache_.OnMtuValidated(kNetwork1, peer1_, 1400);
+  cache_.OnMtuValidated(kNetwork1, peer2_, 1450);
+
+  // Packets larger than the cached MTU say nothing about it.
+  cache_.OnPacketTooBig(kNetwork1, peer1_, 1450);
+  EXPECT_EQ(1400u, cache_.Lookup(kNetwork1, peer1_));
+
+  cache_.OnPacketTooBig(kNetwork1, peer1_, 1400);
+  EXPECT_EQ(0u, cache_.Lookup(kNetwork1, peer1_));
+  EXPECT_EQ(1450u, cache_.Lookup(kNetwork1, peer2_));
+}
+
+TEST_F(QuicPathMtuCacheTest, OnNetworkDisconnected) {
+  cache_.OnMtuValidated(kNetwork1, peer1_, 1450);
+  cache_.OnMtuValidated(kNetwork2, peer1_, 1400);
+
+  cache_.OnNetworkDisconnected(kNetwork1);
+  EXPECT_EQ(0u, cache_.Lookup(kNetwork1, peer1_));
+  EXPECT_EQ(1400u, cache_.Lookup(kNetwork2, peer1_));
+
+  cache_.Clear();
+  EXPECT_EQ(0u, cache_.size());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
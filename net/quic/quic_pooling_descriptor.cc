@@ -0,0 +1,139 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_pooling_descriptor.h"
+
+#include <algorithm>
+
+#include "base/strings/string_util.h"
+#include "net/base/host_port_pair.h"
+#include "net/base/ip_address.h"
+#include "net/cert/cert_verify_result.h"
+#include "net/cert/ct_verify_result.h"
+#include "net/cert/x509_certificate.h"
+#include "net/http/transport_security_state.h"
+#include "net/ssl/ssl_config_service.h"
+
+namespace net {
+
+namespace {
+
+// Number of hostnames whose name match result is kept per session.
+const size_t kMaxCachedNameMatches = 32;
+
+}  // namespace
+
+QuicPoolingDescriptor::QuicPoolingDescriptor(
+    const CertVerifyResult& cert_verify_result,
+    const ct::CTVerifyResult& ct_verify_result,
+    bool client_cert_sent)
+    : cert_(cert_verify_result.verified_cert),
+      has_cert_error_(IsCertStatusError(cert_verify_result.cert_status)),
+      is_issued_by_known_root_(cert_verify_result.is_issued_by_known_root),
+      client_cert_sent_(client_cert_sent),
+      public_key_hashes_(cert_verify_result.public_key_hashes),
+      scts_(ct_verify_result.scts),
+      ct_policy_compliance_(ct_verify_result.policy_compliance),
+      ct_compliant_(
+          ct_verify_result.policy_compliance ==
+              ct::CTPolicyCompliance::CT_POLICY_COMPLIES_VIA_SCTS ||
+          ct_verify_result.policy_compliance ==
+              ct::CTPolicyCompliance::CT_POLICY_BUILD_NOT_TIMELY),
+      name_matches_(kMaxCachedNameMatches) {
+  std::vector<std::string> ip_addresses;
+  if (cert_ && cert_->GetSubjectAltName(&dns_names_, &ip_addresses)) {
+    for (std::string& name : dns_names_)
+      name = base::ToLowerASCII(name);
+  }
+}
+
+QuicPoolingDescriptor::~QuicPoolingDescriptor() = default;
+
+bool QuicPoolingDescriptor::CanPool(
+    TransportSecurityState* transport_security_state,
+    const SSLConfigService& ssl_config_service,
+    const std::string& old_hostname,
+    const std::string& new_hostname,
+    const NetworkIsolationKey& network_isolation_key) const {
+  if (!cert_ || has_cert_error_)
+    return false;
+
+  if (client_cert_sent_ &&
+      !(ssl_config_service.CanShareConnectionWithClientCerts(old_hostname) &&
+        ssl_config_service.CanShareConnectionWithClientCerts(new_hostname))) {
+    return false;
+  }
+
+  if (!MatchesHostname(new_hostname))
+    return false;
+
+  // As in SpdySession::CanPool(), reports are disabled because these checks
+  // can fail in normal operation. The port is never used.
+  std::string pinning_failure_log;
+  if (transport_security_state->CheckPublicKeyPins(
+          HostPortPair(new_hostname, 0), is_issued_by_known_root_,
+          public_key_hashes_, /*served_certificate_chain=*/nullptr,
+          cert_.get(), TransportSecurityState::DISABLE_PIN_REPORTS,
+          &pinning_failure_log) ==
+      TransportSecurityState::PKPStatus::VIOLATED) {
+    return false;
+  }
+
+  if (ct_compliant_)
+    return true;
+  return transport_security_state->CheckCTRequirements(
+             HostPortPair(new_hostname, 0), is_issued_by_known_root_,
+             public_key_hashes_, cert_.get(),
+             /*served_certificate_chain=*/nullptr, scts_,
+             TransportSecurityState::DISABLE_EXPECT_CT_REPORTS,
+             ct_policy_compliance_, network_isolation_key) !=
+         TransportSecurityState::CT_REQUIREMENTS_NOT_MET;
+}
+
+bool QuicPoolingDescriptor::MayCoverHostname(
+    const std::string& hostname) const {
+  std::vector<std::string> names;
+  GetCoveringNames(hostname, &names);
+  if (names.empty())
+    return true;
+  for (const std::string& name : names) {
+    if (std::find(dns_names_.begin(), dns_names_.end(), name) !=
+        dns_names_.end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// static
+void QuicPoolingDescriptor::GetCoveringNames(const std::string& hostname,
+                                             std::vector<std::string>* names) {
+  IPAddress ip_address;
+  if (hostname.empty() || hostname[0] == '[' ||
+      ip_address.AssignFromIPLiteral(hostname)) {
+    return;
+  }
+  std::string name = base::ToLowerASCII(hostname);
+  // Certificates never carry the trailing dot of a fully qualified name.
+  if (name.back() == '.')
+    name.pop_back();
+  size_t dot = name.find('.');
+  if (dot != std::string::npos && dot > 0)
+    names->push_back("*" + name.substr(dot));
+  names->push_back(std::move(name));
+}
+
+bool QuicPoolingDescriptor::MatchesHostname(
+    const std::string& hostname) const {
+  if (!MayCoverHostname(hostname))
+    return false;
+  auto it = name_matches_.Get(hostname);
+  if (it != name_matches_.end())
+    return it->second;
+  bool matches = cert_->VerifyNameMatch(hostname);
+  name_matches_.Put(hostname, matches);
+  return matches;
+}
+
+}  // namespace net
@@ -0,0 +1,92 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_QUIC_POOLING_DESCRIPTOR_H_
+#define NET_QUIC_QUIC_POOLING_DESCRIPTOR_H_
+
+#include <string>
+#include <vector>
+
+#include "base/containers/mru_cache.h"
+#include "base/macros.h"
+#include "base/memory/scoped_refptr.h"
+#include "net/base/hash_value.h"
+#include "net/base/net_export.h"
+#include "net/cert/cert_status_flags.h"
+#include "net/cert/ct_policy_status.h"
+#include "net/cert/signed_certificate_timestamp_and_status.h"
+
+namespace net {
+
+class NetworkIsolationKey;
+class SSLConfigService;
+class TransportSecurityState;
+class X509Certificate;
+struct CertVerifyResult;
+
+namespace ct {
+struct CTVerifyResult;
+}  // namespace ct
+
+// What a QUIC session's certificate allows to pool onto it, extracted once
+// when the certificate is verified. Gives the same verdicts as
+// SpdySession::CanPool() on the session's SSLInfo, without building that
+// SSLInfo or parsing the certificate for every check:
+//  - certificate errors are folded into one flag;
+//  - dNSName SANs are indexed, so hostnames the certificate cannot cover are
+//    rejected without a name match, and name match results are cached;
+//  - CT policy compliance is evaluated once; a compliant certificate meets
+//    any CT requirement.
+// Pin and Expect-CT checks still consult TransportSecurityState on every
+// call, since its dynamic state can change while the session is alive.
+class NET_EXPORT_PRIVATE QuicPoolingDescriptor {
+ public:
+  QuicPoolingDescriptor(const CertVerifyResult& cert_verify_result,
+                        const ct::CTVerifyResult& ct_verify_result,
+                        bool client_cert_sent);
+  ~QuicPoolingDescriptor();
+
+  // Returns true if |new_hostname| may be pooled onto a session to
+  // |old_hostname| with this certificate.
+  bool CanPool(TransportSecurityState* transport_security_state,
+               const SSLConfigService& ssl_config_service,
+               const std::string& old_hostname,
+               const std::string& new_hostname,
+               const NetworkIsolationKey& network_isolation_key) const;
+
+  // Returns false if the certificate certainly does not cover |hostname|.
+  bool MayCoverHostname(const std::string& hostname) const;
+
+  // Lower-cased dNSName SANs of the certificate, possibly wildcards.
+  const std::vector<std::string>& dns_names() const { return dns_names_; }
+
+  // Appends to |names| the SAN values that can cover |hostname|: the
+  // hostname itself and the wildcard for its parent domain. Appends nothing
+  // for IP literals, which only IP address SANs cover.
+  static void GetCoveringNames(const std::string& hostname,
+                               std::vector<std::string>* names);
+
+ private:
+  bool MatchesHostname(const std::string& hostname) const;
+
+  const scoped_refptr<X509Certificate> cert_;
+  const bool has_cert_error_;
+  const bool is_issued_by_known_root_;
+  const bool client_cert_sent_;
+  const HashValueVector public_key_hashes_;
+  const SignedCertificateTimestampAndStatusList scts_;
+  const ct::CTPolicyCompliance ct_policy_compliance_;
+  // True if the certificate complies with the CT policy.
+  const bool ct_compliant_;
+  std::vector<std::string> dns_names_;
+
+  // Name match results by hostname.
+  mutable base::MRUCache<std::string, bool> name_matches_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicPoolingDescriptor);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_POOLING_DESCRIPTOR_H_
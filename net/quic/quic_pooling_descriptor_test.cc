@@ -0,0 +1,106 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_pooling_descriptor.h"
+
+#include "net/base/network_isolation_key.h"
+#include "net/cert/cert_verify_result.h"
+#include "net/cert/ct_verify_result.h"
+#include "net/http/transport_security_state.h"
+#include "net/ssl/ssl_config_service_defaults.h"
+#include "net/test/cert_test_util.h"
+#include "net/test/test_data_directory.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+class QuicPoolingDescriptorTest : public ::testing::Test {
+ protected:
+  QuicPoolingDescriptorTest() {
+    // Valid for www.example.org, mail.example.org and www.example.com.
+    cert_verify_result_.verified_cert =
+        ImportCertFromFile(GetTestCertsDirectory(), "spdy_pooling.pem");
+    cert_verify_result_.is_issued_by_known_root = true;
+    ct_verify_result_.policy_compliance =
+        ct::CTPolicyCompliance::CT_POLICY_COMPLIES_VIA_SCTS;
+  }
+
+  bool CanPool(const QuicPoolingDescriptor& descriptor,
+               const std::string& hostname) {
+    return descriptor.CanPool(&transport_security_state_, ssl_config_service_,
+                              "www.example.org", hostname,
+                              NetworkIsolationKey());
+  }
+
+  CertVerifyResult cert_verify_result_;
+  ct::CTVerifyResult ct_verify_result_;
+  TransportSecurityState transport_security_state_;
+  SSLConfigServiceDefaults ssl_config_service_;
+};
+
+TEST_F(QuicPoolingDescriptorTest, NameMatching) {
+  ASSERT_TRUE(cert_verify_result_.verified_cert);
+  QuicPoolingDescriptor descriptor(cert_verify_result_, ct_verify_result_,
+                                   /*client_cert_sent=*/false);
+  EXPECT_THAT(descriptor.dns_names(),
+              testing::IsSupersetOf(
+                  {"www.example.org", "mail.example.org", "www.example.com"}));
+
+  EXPECT_TRUE(CanPool(descriptor, "www.example.org"));
+  EXPECT_TRUE(CanPool(descriptor, "mail.example.org"));
+  EXPECT_TRUE(CanPool(descriptor, "www.example.com"));
+  EXPECT_TRUE(CanPool(descriptor, "MAIL.example.org"));
+  EXPECT_FALSE(CanPool(descriptor, "mail.google.com"));
+  EXPECT_FALSE(descriptor.MayCoverHostname("mail.google.com"));
+  // Checked again from the cache.
+  EXPECT_TRUE(CanPool(descriptor, "mail.example.org"));
+  EXPECT_FALSE(CanPool(descriptor, "mail.google.com"));
+}
+
+TEST_F(QuicPoolingDescriptorTest, CertError) {
+  cert_verify_result_.cert_status = CERT_STATUS_DATE_INVALID;
+  QuicPoolingDescriptor descriptor(cert_verify_result_, ct_verify_result_,
+                                   /*client_cert_sent=*/false);
+  EXPECT_FALSE(CanPool(descriptor, "www.example.org"));
+  EXPECT_FALSE(CanPool(descriptor, "mail.example.org"));
+}
+
+TEST_F(QuicPoolingDescriptorTest, NoCertificate) {
+  cert_verify_result_.verified_cert = nullptr;
+  QuicPoolingDescriptor descriptor(cert_verify_result_, ct_verify_result_,
+                                   /*client_cert_sent=*/false);
+  EXPECT_TRUE(descriptor.dns_names().empty());
+  EXPECT_FALSE(CanPool(descriptor, "www.example.org"));
+}
+
+TEST_F(QuicPoolingDescriptorTest, ClientCertSent) {
+  QuicPoolingDescriptor descriptor(cert_verify_result_, ct_verify_result_,
+                                   /*client_cert_sent=*/true);
+  // SSLConfigServiceDefaults never shares connections with client certs.
+  EXPECT_FALSE(CanPool(descriptor, "mail.example.org"));
+}
+
+TEST_F(QuicPoolingDescriptorTest, GetCoveringNames) {
+  std::vector<std::string> names;
+  QuicPoolingDescriptor::GetCoveringNames("Mail.Example.org.", &names);
+  EXPECT_THAT(names,
+              testing::ElementsAre("*.example.org", "mail.example.org"));
+
+  names.clear();
+  QuicPoolingDescriptor::GetCoveringNames("localhost", &names);
+  EXPECT_THAT(names, testing::ElementsAre("localhost"));
+
+  names.clear();
+  QuicPoolingDescriptor::GetCoveringNames("192.0.2.1", &names);
+  QuicPoolingDescriptor::GetCoveringNames("[2001:db8::1]", &names);
+  QuicPoolingDescriptor::GetCoveringNames("2001:db8::1", &names);
+  EXPECT_TRUE(names.empty());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
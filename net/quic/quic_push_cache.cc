@@ -0,0 +1,96 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_push_cache.h"
+
+#include "base/logging.h"
+
+namespace net {
+
+QuicPushCache::QuicPushCache(size_t max_bytes,
+                             base::TimeDelta max_age,
+                             size_t max_digest_entries)
+    : max_bytes_(max_bytes),
+      max_age_(max_age),
+      bytes_(0),
+      digest_(max_digest_entries) {}
+
+QuicPushCache::~QuicPushCache() = default;
+
+void QuicPushCache::SetLimits(size_t max_bytes, base::TimeDelta max_age) {
+  max_bytes_ = max_bytes;
+  max_age_ = max_age;
+}
+
+bool QuicPushCache::OnPushPromised(quic::QuicStreamId id,
+                                   const GURL& url,
+                                   base::TimeTicks now) {
+  ++stats_.promised;
+  if (digest_.Get(url.spec()) != digest_.end()) {
+    ++stats_.cancelled;
+    ++stats_.cancelled_by_digest;
+    return false;
+  }
+  DCHECK(!Contains(id));
+  Push& push = pushes_[id];
+  push.url = url;
+  push.promised_time = now;
+  return true;
+}
+
+void QuicPushCache::OnPushBytesReceived(quic::QuicStreamId id,
+                                        uint64_t bytes) {
+  auto it = pushes_.find(id);
+  if (it == pushes_.end())
+    return;
+  DCHECK_GE(bytes, it->second.bytes);
+  bytes_ += bytes - it->second.bytes;
+  it->second.bytes = bytes;
+}
+
+base::TimeDelta QuicPushCache::OnPushClaimed(quic::QuicStreamId id,
+                                             base::TimeTicks now) {
+  auto it = pushes_.find(id);
+  if (it == pushes_.end())
+    return base::TimeDelta();
+  const base::TimeDelta latency = now - it->second.promised_time;
+  ++stats_.claimed;
+  stats_.total_claim_latency += latency;
+  bytes_ -= it->second.bytes;
+  pushes_.erase(it);
+  return latency;
+}
+
+void QuicPushCache::OnPushCancelled(quic::QuicStreamId id) {
+  auto it = pushes_.find(id);
+  if (it == pushes_.end())
+    return;
+  ++stats_.cancelled;
+  stats_.wasted_bytes += it->second.bytes;
+  bytes_ -= it->second.bytes;
+  pushes_.erase(it);
+}
+
+std::vector<quic::QuicStreamId> QuicPushCache::GetPushesToCancel(
+    base::TimeTicks now) const {
+  std::vector<quic::QuicStreamId> ids;
+  uint64_t remaining_bytes = bytes_;
+  for (const auto& id_and_push : pushes_) {
+    const Push& push = id_and_push.second;
+    const bool too_old =
+        !max_age_.is_zero() && now - push.promised_time > max_age_;
+    const bool over_budget = max_bytes_ > 0 && remaining_bytes > max_bytes_;
+    if (!too_old && !over_budget)
+      break;
+    ids.push_back(id_and_push.first);
+    remaining_bytes -= push.bytes;
+  }
+  return ids;
+}
+
+void QuicPushCache::AddToDigest(const GURL& url) {
+  digest_.Put(url.spec(), true);
+}
+
+}  // namespace net
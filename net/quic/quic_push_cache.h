@@ -0,0 +1,120 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_QUIC_PUSH_CACHE_H_
+#define NET_QUIC_QUIC_PUSH_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/containers/mru_cache.h"
+#include "base/macros.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+#include "net/third_party/quiche/src/quic/core/quic_types.h"
+#include "url/gurl.h"
+
+namespace net {
+
+// Number of URLs a QuicPushCache remembers the client to have.
+const size_t kMaxPushCacheDigestEntries = 256;
+
+// Tracks the pushed responses of a session which no request has claimed yet,
+// and decides which of them to cancel. Unclaimed pushes are bounded both in
+// total bytes received and in age; the oldest ones are cancelled first.
+// Pushes of URLs the client is known to have, because the embedder cancelled
+// an earlier push of the same URL, are cancelled as soon as they are
+// promised, like a server would skip them given an HTTP cache digest.
+//
+// The cache only keeps accounts. Its owner resets the streams it is told to
+// cancel, and reports every push outcome so that hit rate, wasted bytes and
+// claim latency can be exported.
+class NET_EXPORT_PRIVATE QuicPushCache {
+ public:
+  struct Stats {
+    // Pushes promised, including those cancelled when promised.
+    uint32_t promised = 0;
+    // Pushes claimed by a request.
+    uint32_t claimed = 0;
+    // Pushes cancelled or timed out before being claimed.
+    uint32_t cancelled = 0;
+    // Pushes cancelled when promised because the client has the URL.
+    uint32_t cancelled_by_digest = 0;
+    // Bytes received on pushed streams which were never claimed.
+    uint64_t wasted_bytes = 0;
+    // Sum of the time between promise and claim of claimed pushes.
+    base::TimeDelta total_claim_latency;
+  };
+
+  // |max_bytes| and |max_age| of zero mean no limit.
+  QuicPushCache(size_t max_bytes,
+                base::TimeDelta max_age,
+                size_t max_digest_entries);
+  ~QuicPushCache();
+
+  void SetLimits(size_t max_bytes, base::TimeDelta max_age);
+
+  // Called when stream |id| is promised for |url|. Returns false if the client
+  // already has |url|, in which case the push is not tracked and should be
+  // cancelled.
+  bool OnPushPromised(quic::QuicStreamId id,
+                      const GURL& url,
+                      base::TimeTicks now);
+
+  // Updates the number of bytes received so far on unclaimed push |id|.
+  void OnPushBytesReceived(quic::QuicStreamId id, uint64_t bytes);
+
+  // Called when a request claims push |id|. Returns the time since the push
+  // was promised, or zero if |id| is unknown.
+  base::TimeDelta OnPushClaimed(quic::QuicStreamId id, base::TimeTicks now);
+
+  // Called when unclaimed push |id| is cancelled or times out. Its bytes are
+  // counted as wasted.
+  void OnPushCancelled(quic::QuicStreamId id);
+
+  // Returns the unclaimed pushes which have to be cancelled as of |now|:
+  // those older than the age limit, then the oldest remaining ones until the
+  // rest fit within the byte budget. Oldest first. The owner is expected to
+  // cancel them and call OnPushCancelled().
+  std::vector<quic::QuicStreamId> GetPushesToCancel(base::TimeTicks now) const;
+
+  // Records that the client has |url|, so that pushes of it are cancelled.
+  void AddToDigest(const GURL& url);
+
+  bool Contains(quic::QuicStreamId id) const {
+    return pushes_.find(id) != pushes_.end();
+  }
+  bool empty() const { return pushes_.empty(); }
+  size_t size() const { return pushes_.size(); }
+  // Bytes received on unclaimed pushes.
+  uint64_t bytes() const { return bytes_; }
+  const Stats& stats() const { return stats_; }
+
+ private:
+  struct Push {
+    GURL url;
+    base::TimeTicks promised_time;
+    uint64_t bytes = 0;
+  };
+
+  size_t max_bytes_;
+  base::TimeDelta max_age_;
+  // Unclaimed pushes. Servers promise streams in increasing ID order, so the
+  // map is sorted from oldest to newest.
+  std::map<quic::QuicStreamId, Push> pushes_;
+  uint64_t bytes_;
+  // Specs of the URLs the client has.
+  base::HashingMRUCache<std::string, bool> digest_;
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicPushCache);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_PUSH_CACHE_H_
@@ -0,0 +1,127 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_push_cache.h"
+
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+namespace net {
+namespace test {
+namespace {
+
+const size_t kMaxBytes = 1000;
+const base::TimeDelta kMaxAge = base::TimeDelta::FromSeconds(10);
+
+class QuicPushCacheTest : public ::testing::Test {
+ protected:
+  QuicPushCacheTest()
+      : cache_(kMaxBytes, kMaxAge, /*max_digest_entries=*/2),
+        now_(base::TimeTicks() + base::TimeDelta::FromSeconds(1)),
+        url1_("https://www.example.org/1.js"),
+        url2_("https://www.example.org/2.js"),
+        url3_("https://www.example.org/3.js") {}
+
+  QuicPushCache cache_;
+  base::TimeTicks now_;
+  const GURL url1_;
+  const GURL url2_;
+  const GURL url3_;
+};
+
+TEST_F(QuicPushCacheTest, ClaimedPush) {
+  ASSERT_TRUE(cache_.OnPushPromised(2, url1_, now_));
+  cache_.OnPushBytesReceived(2, 300);
+  cache_.OnPushBytesReceived(2, 500);
+  EXPECT_EQ(500u, cache_.bytes());
+
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(40),
+            cache_.OnPushClaimed(
+                2, now_ + base::TimeDelta::FromMilliseconds(40)));
+  EXPECT_TRUE(cache_.empty());
+  EXPECT_EQ(0u, cache_.bytes());
+  EXPECT_EQ(1u, cache_.stats().promised);
+  EXPECT_EQ(1u, cache_.stats().claimed);
+  EXPECT_EQ(0u, cache_.stats().cancelled);
+  EXPECT_EQ(0u, cache_.stats().wasted_bytes);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(40),
+            cache_.stats().total_claim_latency);
+
+  // Bytes received after the push is claimed are not tracked.
+  cache_.OnPushBytesReceived(2, 800);
+  EXPECT_EQ(0u, cache_.bytes());
+}
+
+TEST_F(QuicPushCacheTest, CancelledPushIsWasted) {
+  ASSERT_TRUE(cache_.OnPushPromised(2, url1_, now_));
+  cache_.OnPushBytesReceived(2, 400);
+  cache_.OnPushCancelled(2);
+  EXPECT_TRUE(cache_.empty());
+  EXPECT_EQ(1u, cache_.stats().cancelled);
+  EXPECT_EQ(400u, cache_.stats().wasted_bytes);
+
+  // Unknown pushes are ignored.
+  cache_.OnPushCancelled(2);
+  EXPECT_EQ(base::TimeDelta(), cache_.OnPushClaimed(2, now_));
+  EXPECT_EQ(1u, cache_.stats().cancelled);
+  EXPECT_EQ(0u, cache_.stats().claimed);
+}
+
+TEST_F(QuicPushCacheTest, CancelsOldestOverByteBudget) {
+  ASSERT_TRUE(cache_.OnPushPromised(2, url1_, now_));
+  ASSERT_TRUE(cache_.OnPushPromised(4, url2_, now_));
+  ASSERT_TRUE(cache_.OnPushPromised(6, url3_, now_));
+  cache_.OnPushBytesReceived(2, 400);
+  cache_.OnPushBytesReceived(4, 400);
+  EXPECT_THAT(cache_.GetPushesToCancel(now_), IsEmpty());
+
+  cache_.OnPushBytesReceived(6, 400);
+  EXPECT_THAT(cache_.GetPushesToCancel(now_), ElementsAre(2u));
+
+  cache_.OnPushBytesReceived(6, 1200);
+  EXPECT_THAT(cache_.GetPushesToCancel(now_), ElementsAre(2u, 4u, 6u));
+}
+
+TEST_F(QuicPushCacheTest, CancelsOverAgeLimit) {
+  ASSERT_TRUE(cache_.OnPushPromised(2, url1_, now_));
+  ASSERT_TRUE(cache_.OnPushPromised(
+      4, url2_, now_ + base::TimeDelta::FromSeconds(5)));
+  EXPECT_THAT(cache_.GetPushesToCancel(now_ + kMaxAge), IsEmpty());
+  const base::TimeTicks later =
+      now_ + kMaxAge + base::TimeDelta::FromSeconds(1);
+  EXPECT_THAT(cache_.GetPushesToCancel(later), ElementsAre(2u));
+
+  // No limits.
+  cache_.SetLimits(0, base::TimeDelta());
+  EXPECT_THAT(cache_.GetPushesToCancel(now_ + base::TimeDelta::FromDays(1)),
+              IsEmpty());
+}
+
+TEST_F(QuicPushCacheTest, Digest) {
+  cache_.AddToDigest(url1_);
+  EXPECT_FALSE(cache_.OnPushPromised(2, url1_, now_));
+  EXPECT_FALSE(cache_.Contains(2));
+  EXPECT_EQ(1u, cache_.stats().cancelled_by_digest);
+
+  // Claiming a push does not add its URL to the digest: the response may not
+  // be cacheable.
+  ASSERT_TRUE(cache_.OnPushPromised(4, url2_, now_));
+  cache_.OnPushClaimed(4, now_);
+  EXPECT_TRUE(cache_.OnPushPromised(6, url2_, now_));
+
+  // The digest is bounded.
+  cache_.AddToDigest(url2_);
+  cache_.AddToDigest(url3_);
+  EXPECT_TRUE(cache_.OnPushPromised(8, url1_, now_));
+  EXPECT_FALSE(cache_.OnPushPromised(10, url3_, now_));
+  EXPECT_EQ(2u, cache_.stats().cancelled);
+  EXPECT_EQ(5u, cache_.stats().promised);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
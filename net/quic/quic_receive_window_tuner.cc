@@ -0,0 +1,101 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_receive_window_tuner.h"
+
+#include "base/logging.h"
+
+namespace net {
+
+QuicReceiveWindowBudget::QuicReceiveWindowBudget(quic::QuicByteCount limit)
+    : limit_(limit), reserved_(0) {}
+
+QuicReceiveWindowBudget::~QuicReceiveWindowBudget() {
+  DCHECK_EQ(0u, reserved_);
+}
+
+bool QuicReceiveWindowBudget::CanReserve(quic::QuicByteCount bytes) const {
+  return bytes <= limit_ - reserved_;
+}
+
+void QuicReceiveWindowBudget::Reserve(quic::QuicByteCount bytes) {
+  reserved_ += bytes;
+}
+
+void QuicReceiveWindowBudget::Release(quic::QuicByteCount bytes) {
+  DCHECK_LE(bytes, reserved_);
+  reserved_ -= bytes;
+}
+
+QuicReceiveWindowTuner::QuicReceiveWindowTuner(
+    quic::QuicByteCount initial_window,
+    quic::QuicByteCount max_window,
+    QuicReceiveWindowBudget* budget)
+    : initial_window_(initial_window),
+      max_window_(max_window),
+      budget_(budget),
+      window_(initial_window),
+      epoch_start_bytes_consumed_(0),
+      epoch_start_time_(quic::QuicTime::Zero()),
+      num_increases_(0) {
+  DCHECK_LT(0u, initial_window);
+}
+
+QuicReceiveWindowTuner::~QuicReceiveWindowTuner() {
+  if (budget_)
+    budget_->Release(window_ - initial_window_);
+}
+
+quic::QuicByteCount QuicReceiveWindowTuner::OnBytesConsumed(
+    quic::QuicStreamOffset bytes_consumed,
+    quic::QuicTime now,
+    quic::QuicTime::Delta smoothed_rtt) {
+  if (!epoch_start_time_.IsInitialized()) {
+    epoch_start_bytes_consumed_ = bytes_consumed;
+    epoch_start_time_ = now;
+    return 0;
+  }
+  if (bytes_consumed - epoch_start_bytes_consumed_ < window_ / 2)
+    return 0;
+
+  const bool limited_by_window =
+      !smoothed_rtt.IsZero() && now - epoch_start_time_ < 2 * smoothed_rtt;
+  epoch_start_bytes_consumed_ = bytes_consumed;
+  epoch_start_time_ = now;
+  if (!limited_by_window || window_ > max_window_ / 2)
+    return 0;
+  if (budget_ && !budget_->CanReserve(window_))
+    return 0;
+  return 2 * window_;
+}
+
+void QuicReceiveWindowTuner::OnWindowGrown(quic::QuicByteCount window) {
+  if (window <= window_)
+    return;
+  if (budget_)
+    budget_->Reserve(window - window_);
+  window_ = window;
+  ++num_increases_;
+}
+
+bool QuicReceiveWindowTuner::MaybeGrowWindow(
+    quic::QuicFlowController* flow_controller,
+    quic::QuicTime now,
+    quic::QuicTime::Delta smoothed_rtt) {
+  quic::QuicByteCount window =
+      OnBytesConsumed(flow_controller->bytes_consumed(), now, smoothed_rtt);
+  if (window == 0)
+    return false;
+  const quic::QuicStreamOffset offset =
+      flow_controller->receive_window_offset();
+  flow_controller->EnsureWindowAtLeast(window);
+  if (flow_controller->receive_window_offset() == offset)
+    return false;
+  // Growing the window advertises a full window past the consumed bytes.
+  OnWindowGrown(flow_controller->receive_window_offset() -
+                flow_controller->bytes_consumed());
+  return true;
+}
+
+}  // namespace net
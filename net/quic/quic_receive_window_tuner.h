@@ -0,0 +1,93 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_QUIC_RECEIVE_WINDOW_TUNER_H_
+#define NET_QUIC_QUIC_RECEIVE_WINDOW_TUNER_H_
+
+#include "base/macros.h"
+#include "net/base/net_export.h"
+#include "net/third_party/quiche/src/quic/core/quic_flow_controller.h"
+#include "net/third_party/quiche/src/quic/core/quic_packets.h"
+#include "net/third_party/quiche/src/quic/core/quic_time.h"
+
+namespace net {
+
+// Memory that receive windows may grow into, shared by the sessions of a
+// QuicStreamFactory. Only growth beyond the initial windows is accounted, as
+// initial windows are what every session advertises regardless of tuning.
+class NET_EXPORT_PRIVATE QuicReceiveWindowBudget {
+ public:
+  explicit QuicReceiveWindowBudget(quic::QuicByteCount limit);
+  ~QuicReceiveWindowBudget();
+
+  // Returns true if reserving |bytes| would keep the total within the limit.
+  bool CanReserve(quic::QuicByteCount bytes) const;
+  void Reserve(quic::QuicByteCount bytes);
+  void Release(quic::QuicByteCount bytes);
+
+  quic::QuicByteCount limit() const { return limit_; }
+  quic::QuicByteCount reserved() const { return reserved_; }
+
+ private:
+  const quic::QuicByteCount limit_;
+  quic::QuicByteCount reserved_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicReceiveWindowBudget);
+};
+
+// Decides when the receive window of a session or stream should grow, in the
+// manner of TCP receive buffer auto-tuning: if the reader consumes half a
+// window in less than two round trips, the window was limiting throughput
+// and is doubled. Windows only grow by doubling, because that is what
+// quic::QuicFlowController::EnsureWindowAtLeast() does, and the flow
+// controller may still decline to grow, so only growth it reports is charged
+// to the budget.
+class NET_EXPORT_PRIVATE QuicReceiveWindowTuner {
+ public:
+  // |budget| may be null, in which case only |max_window| bounds growth.
+  QuicReceiveWindowTuner(quic::QuicByteCount initial_window,
+                         quic::QuicByteCount max_window,
+                         QuicReceiveWindowBudget* budget);
+  // Returns the growth of the window to |budget|.
+  ~QuicReceiveWindowTuner();
+
+  // Called with the total number of bytes consumed by the reader. Returns the
+  // window size to ask the flow controller for if the window should grow, or
+  // 0. Nothing is charged to the budget until OnWindowGrown().
+  quic::QuicByteCount OnBytesConsumed(quic::QuicStreamOffset bytes_consumed,
+                                      quic::QuicTime now,
+                                      quic::QuicTime::Delta smoothed_rtt);
+
+  // Called with the window the flow controller has after being asked to
+  // grow. Charges the growth, if any, to the budget.
+  void OnWindowGrown(quic::QuicByteCount window);
+
+  // Calls OnBytesConsumed() with the bytes consumed from |flow_controller|,
+  // grows its window if needed and calls OnWindowGrown(). Returns true if the
+  // window grew.
+  bool MaybeGrowWindow(quic::QuicFlowController* flow_controller,
+                       quic::QuicTime now,
+                       quic::QuicTime::Delta smoothed_rtt);
+
+  quic::QuicByteCount window() const { return window_; }
+  quic::QuicByteCount initial_window() const { return initial_window_; }
+  int num_increases() const { return num_increases_; }
+
+ private:
+  const quic::QuicByteCount initial_window_;
+  const quic::QuicByteCount max_window_;
+  QuicReceiveWindowBudget* const budget_;
+  quic::QuicByteCount window_;
+  // Start of the current measurement, which ends once half a window has been
+  // consumed.
+  quic::QuicStreamOffset epoch_start_bytes_consumed_;
+  quic::QuicTime epoch_start_time_;
+  int num_increases_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicReceiveWindowTuner);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_RECEIVE_WINDOW_TUNER_H_
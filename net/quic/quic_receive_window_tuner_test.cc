@@ -0,0 +1,111 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_receive_window_tuner.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+const quic::QuicByteCount kInitialWindow = 64 * 1024;
+const quic::QuicTime::Delta kRtt = quic::QuicTime::Delta::FromMilliseconds(50);
+
+class QuicReceiveWindowTunerTest : public ::testing::Test {
+ protected:
+  QuicReceiveWindowTunerTest() : now_(quic::QuicTime::Zero()) {
+    now_ = now_ + quic::QuicTime::Delta::FromSeconds(1);
+  }
+
+  quic::QuicTime now_;
+};
+
+TEST_F(QuicReceiveWindowTunerTest, GrowsWhenConsumedWithinTwoRtts) {
+  QuicReceiveWindowTuner tuner(kInitialWindow, 4 * kInitialWindow, nullptr);
+  EXPECT_EQ(0u, tuner.OnBytesConsumed(0, now_, kRtt));
+
+  // Less than half a window consumed.
+  now_ = now_ + kRtt;
+  EXPECT_EQ(0u, tuner.OnBytesConsumed(kInitialWindow / 4, now_, kRtt));
+
+  // Half a window within two round trips. The window only changes once the
+  // flow controller grows it.
+  EXPECT_EQ(2 * kInitialWindow,
+            tuner.OnBytesConsumed(kInitialWindow / 2, now_, kRtt));
+  EXPECT_EQ(kInitialWindow, tuner.window());
+  tuner.OnWindowGrown(2 * kInitialWindow);
+  EXPECT_EQ(2 * kInitialWindow, tuner.window());
+  EXPECT_EQ(1, tuner.num_increases());
+
+  now_ = now_ + kRtt;
+  EXPECT_EQ(4 * kInitialWindow,
+            tuner.OnBytesConsumed(3 * kInitialWindow / 2, now_, kRtt));
+  tuner.OnWindowGrown(4 * kInitialWindow);
+
+  // The maximum window is reached.
+  now_ = now_ + kRtt;
+  EXPECT_EQ(0u, tuner.OnBytesConsumed(4 * kInitialWindow, now_, kRtt));
+  EXPECT_EQ(4 * kInitialWindow, tuner.window());
+  EXPECT_EQ(2, tuner.num_increases());
+}
+
+TEST_F(QuicReceiveWindowTunerTest, SlowReaderDoesNotGrow) {
+  QuicReceiveWindowTuner tuner(kInitialWindow, 4 * kInitialWindow, nullptr);
+  EXPECT_EQ(0u, tuner.OnBytesConsumed(0, now_, kRtt));
+  now_ = now_ + 2 * kRtt;
+  EXPECT_EQ(0u, tuner.OnBytesConsumed(kInitialWindow / 2, now_, kRtt));
+
+  // Without an RTT estimate, the window never grows.
+  now_ = now_ + quic::QuicTime::Delta::FromMilliseconds(1);
+  EXPECT_EQ(0u, tuner.OnBytesConsumed(kInitialWindow, now_,
+                                      quic::QuicTime::Delta::Zero()));
+  EXPECT_EQ(kInitialWindow, tuner.window());
+  EXPECT_EQ(0, tuner.num_increases());
+}
+
+TEST_F(QuicReceiveWindowTunerTest, SharedBudget) {
+  QuicReceiveWindowBudget budget(3 * kInitialWindow);
+  {
+    QuicReceiveWindowTuner tuner1(kInitialWindow, 8 * kInitialWindow,
+                                  &budget);
+    QuicReceiveWindowTuner tuner2(kInitialWindow, 8 * kInitialWindow,
+                                  &budget);
+    tuner1.OnBytesConsumed(0, now_, kRtt);
+    tuner2.OnBytesConsumed(0, now_, kRtt);
+
+    EXPECT_EQ(2 * kInitialWindow,
+              tuner1.OnBytesConsumed(kInitialWindow / 2, now_, kRtt));
+    EXPECT_EQ(0u, budget.reserved());
+    tuner1.OnWindowGrown(2 * kInitialWindow);
+    EXPECT_EQ(kInitialWindow, budget.reserved());
+    EXPECT_EQ(2 * kInitialWindow,
+              tuner2.OnBytesConsumed(kInitialWindow / 2, now_, kRtt));
+    tuner2.OnWindowGrown(2 * kInitialWindow);
+    EXPECT_EQ(2 * kInitialWindow, budget.reserved());
+
+    // Growing either window again would need two more initial windows.
+    EXPECT_EQ(0u, tuner1.OnBytesConsumed(3 * kInitialWindow / 2, now_, kRtt));
+    EXPECT_EQ(2 * kInitialWindow, tuner1.window());
+  }
+  EXPECT_EQ(0u, budget.reserved());
+}
+
+TEST_F(QuicReceiveWindowTunerTest, DeclinedGrowthIsNotCharged) {
+  QuicReceiveWindowBudget budget(8 * kInitialWindow);
+  QuicReceiveWindowTuner tuner(kInitialWindow, 8 * kInitialWindow, &budget);
+  tuner.OnBytesConsumed(0, now_, kRtt);
+  EXPECT_EQ(2 * kInitialWindow,
+            tuner.OnBytesConsumed(kInitialWindow / 2, now_, kRtt));
+
+  // The flow controller kept its window.
+  tuner.OnWindowGrown(kInitialWindow);
+  EXPECT_EQ(kInitialWindow, tuner.window());
+  EXPECT_EQ(0, tuner.num_increases());
+  EXPECT_EQ(0u, budget.reserved());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
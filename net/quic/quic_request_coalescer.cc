@@ -0,0 +1,477 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_request_coalescer.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "net/base/load_flags.h"
+#include "net/base/net_errors.h"
+#include "net/http/http_request_info.h"
+#include "net/quic/quic_http_utils.h"
+#include "net/third_party/quiche/src/spdy/core/spdy_protocol.h"
+
+namespace net {
+
+namespace {
+
+// Separators of the values of a header, which may have been sent as several
+// headers of the same name.
+const base::StringPiece kValueSeparators(",\0", 2);
+
+// Returns true if header |name| of |headers| has the directive |directive|.
+bool HasDirective(const spdy::SpdyHeaderBlock& headers,
+                  base::StringPiece name,
+                  base::StringPiece directive) {
+  auto it = headers.find(name);
+  if (it == headers.end())
+    return false;
+  for (base::StringPiece value :
+       base::SplitStringPiece(it->second, kValueSeparators,
+                              base::TRIM_WHITESPACE,
+                              base::SPLIT_WANT_NONEMPTY)) {
+    // Arguments like the field names of "private" make no difference.
+    value = base::TrimWhitespaceASCII(value.substr(0, value.find('=')),
+                                      base::TRIM_TRAILING);
+    if (base::EqualsCaseInsensitiveASCII(value, directive))
+      return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+// static
+const uint64_t QuicRequestCoalescer::kMaxBufferedBytes = 512 * 1024;
+
+QuicRequestCoalescer::QuicRequestCoalescer()
+    : max_buffered_bytes_(kMaxBufferedBytes) {}
+
+QuicRequestCoalescer::~QuicRequestCoalescer() = default;
+
+// static
+bool QuicRequestCoalescer::IsEligible(const HttpRequestInfo& request_info) {
+  return request_info.method == "GET" && !request_info.upload_data_stream &&
+         !(request_info.load_flags & (LOAD_DISABLE_CACHE | LOAD_BYPASS_CACHE));
+}
+
+// static
+std::string QuicRequestCoalescer::ComputeKey(
+    const spdy::SpdyHeaderBlock& request_headers) {
+  std::vector<std::pair<base::StringPiece, base::StringPiece>> headers;
+  headers.reserve(request_headers.size());
+  for (const auto& header : request_headers)
+    headers.emplace_back(header.first, header.second);
+  std::sort(headers.begin(), headers.end());
+
+  // Neither names nor values contain newlines, and names contain no NUL.
+  std::string key;
+  for (const auto& header : headers) {
+    key.append(header.first.data(), header.first.size());
+    key.push_back('\0');
+    key.append(header.second.data(), header.second.size());
+    key.push_back('\n');
+  }
+  return key;
+}
+
+scoped_refptr<QuicCoalescedResponse> QuicRequestCoalescer::Join(
+    const std::string& key) {
+  auto it = joinable_.find(key);
+  if (it == joinable_.end())
+    return nullptr;
+  return it->second;
+}
+
+scoped_refptr<QuicCoalescedResponse> QuicRequestCoalescer::Start(
+    const std::string& key) {
+  DCHECK(!joinable_.count(key));
+  auto response = base::MakeRefCounted<QuicCoalescedResponse>(
+      weak_factory_.GetWeakPtr(), key, max_buffered_bytes_);
+  joinable_[key] = response.get();
+  return response;
+}
+
+void QuicRequestCoalescer::Remove(const std::string& key) {
+  joinable_.erase(key);
+}
+
+QuicCoalescedResponse::Reader::Reader() = default;
+
+QuicCoalescedResponse::Reader::~Reader() = default;
+
+QuicCoalescedResponse::QuicCoalescedResponse(
+    base::WeakPtr<QuicRequestCoalescer> coalescer,
+    const std::string& key,
+    uint64_t max_buffered_bytes)
+    : coalescer_(std::move(coalescer)),
+      key_(key),
+      max_buffered_bytes_(max_buffered_bytes),
+      state_(STATE_WAITING_FOR_HEADERS),
+      next_reader_id_(0),
+      leader_(0),
+      leader_stream_(nullptr),
+      read_in_flight_(false),
+      read_blocked_(false),
+      end_offset_(0),
+      done_(false),
+      status_(OK) {}
+
+QuicCoalescedResponse::~QuicCoalescedResponse() {
+  if (state_ == STATE_WAITING_FOR_HEADERS && coalescer_)
+    coalescer_->Remove(key_);
+  if (stream_ && !done_)
+    stream_->Reset(quic::QUIC_STREAM_CANCELLED);
+}
+
+QuicCoalescedResponse::ReaderId QuicCoalescedResponse::AddReader(
+    RequestPriority priority) {
+  DCHECK_EQ(STATE_WAITING_FOR_HEADERS, state_);
+  ReaderId reader = next_reader_id_++;
+  readers_[reader].priority = priority;
+  UpdateStreamPriority();
+  return reader;
+}
+
+void QuicCoalescedResponse::SetLeaderStream(
+    QuicChromiumClientStream::Handle* stream) {
+  DCHECK_EQ(STATE_WAITING_FOR_HEADERS, state_);
+  leader_stream_ = stream;
+  UpdateStreamPriority();
+}
+
+RequestPriority QuicCoalescedResponse::priority() const {
+  RequestPriority priority = MINIMUM_PRIORITY;
+  for (const auto& id_and_reader : readers_)
+    priority = std::max(priority, id_and_reader.second.priority);
+  return priority;
+}
+
+void QuicCoalescedResponse::RemoveReader(ReaderId reader) {
+  readers_.erase(reader);
+  switch (state_) {
+    case STATE_WAITING_FOR_HEADERS:
+      if (reader == leader_) {
+        leader_stream_ = nullptr;
+        StopSharing();
+      }
+      return;
+    case STATE_SHARED:
+      TrimChunks();
+      if (readers_.empty() && !done_) {
+        Finish(ERR_ABORTED);
+        stream_->Reset(quic::QUIC_STREAM_CANCELLED);
+        return;
+      }
+      UpdateStreamPriority();
+      return;
+    case STATE_NOT_SHARED:
+      return;
+  }
+}
+
+int QuicCoalescedResponse::WaitForHeaders(ReaderId reader,
+                                          CompletionOnceCallback callback) {
+  DCHECK_NE(leader_, reader);
+  switch (state_) {
+    case STATE_WAITING_FOR_HEADERS:
+      readers_[reader].callback = std::move(callback);
+      return ERR_IO_PENDING;
+    case STATE_SHARED:
+      return OK;
+    case STATE_NOT_SHARED:
+      return ERR_ABORTED;
+  }
+  NOTREACHED();
+  return ERR_UNEXPECTED;
+}
+
+bool QuicCoalescedResponse::OnHeaders(
+    const spdy::SpdyHeaderBlock& headers,
+    std::unique_ptr<QuicChromiumClientStream::Handle>* stream) {
+  DCHECK_EQ(STATE_WAITING_FOR_HEADERS, state_);
+  leader_stream_ = nullptr;
+  if (readers_.size() < 2 || !IsShareable(headers)) {
+    StopSharing();
+    return false;
+  }
+  DCHECK(*stream);
+
+  if (coalescer_) {
+    coalescer_->Remove(key_);
+    coalescer_->stats_.requests_coalesced +=
+        static_cast<uint32_t>(readers_.size() - 1);
+  }
+  state_ = STATE_SHARED;
+  headers_ = headers.Clone();
+  stream_ = std::move(*stream);
+  UpdateStreamPriority();
+
+  PostHeadersCallbacks(OK);
+
+  if (stream_->IsDoneReading()) {
+    Finish(OK);
+  } else {
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE, base::BindOnce(&QuicCoalescedResponse::ReadTrailingHeaders,
+                                  weak_factory_.GetWeakPtr()));
+  }
+  return true;
+}
+
+int QuicCoalescedResponse::ReadBody(ReaderId reader_id,
+                                    IOBuffer* buf,
+                                    int buf_len,
+                                    CompletionOnceCallback callback) {
+  DCHECK_EQ(STATE_SHARED, state_);
+  DCHECK_GT(buf_len, 0);
+  auto it = readers_.find(reader_id);
+  DCHECK(it != readers_.end());
+  Reader* reader = &it->second;
+  DCHECK(!reader->callback);
+
+  if (reader->offset == end_offset_ && !done_) {
+    // A pending read of the stream means that the other readers are waiting
+    // for the same bytes.
+    int rv = MaybeReadStream(buf_len);
+    if (rv == ERR_IO_PENDING) {
+      reader->callback = std::move(callback);
+      reader->buf = buf;
+      reader->buf_len = buf_len;
+      return ERR_IO_PENDING;
+    }
+    OnStreamData(rv);
+  }
+  return CopyBody(reader_id, reader, buf, buf_len);
+}
+
+bool QuicCoalescedResponse::IsDoneReading(ReaderId reader) const {
+  auto it = readers_.find(reader);
+  return it != readers_.end() && done_ && status_ == OK &&
+         it->second.offset == end_offset_;
+}
+
+int64_t QuicCoalescedResponse::NumBytesConsumed() const {
+  return stream_ ? stream_->NumBytesConsumed() : 0;
+}
+
+// static
+bool QuicCoalescedResponse::IsShareable(const spdy::SpdyHeaderBlock& headers) {
+  return headers.find("set-cookie") == headers.end() &&
+         !HasDirective(headers, "vary", "*") &&
+         !HasDirective(headers, "cache-control", "no-store") &&
+         !HasDirective(headers, "cache-control", "private");
+}
+
+void QuicCoalescedResponse::StopSharing() {
+  if (state_ != STATE_WAITING_FOR_HEADERS)
+    return;
+  state_ = STATE_NOT_SHARED;
+  if (coalescer_)
+    coalescer_->Remove(key_);
+  PostHeadersCallbacks(ERR_ABORTED);
+}
+
+void QuicCoalescedResponse::PostHeadersCallbacks(int rv) {
+  // The leader is in the middle of reading its headers or of closing, so the
+  // other readers are called back asynchronously.
+  for (const auto& id_and_reader : readers_) {
+    if (!id_and_reader.second.callback)
+      continue;
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE, base::BindOnce(&QuicCoalescedResponse::RunHeadersCallback,
+                                  weak_factory_.GetWeakPtr(),
+                                  id_and_reader.first, rv));
+  }
+}
+
+void QuicCoalescedResponse::RunHeadersCallback(ReaderId reader, int rv) {
+  auto it = readers_.find(reader);
+  if (it == readers_.end() || !it->second.callback)
+    return;
+  std::move(it->second.callback).Run(rv);
+}
+
+void QuicCoalescedResponse::UpdateStreamPriority() {
+  QuicChromiumClientStream::Handle* stream =
+      stream_ ? stream_.get() : leader_stream_;
+  if (!stream || readers_.empty())
+    return;
+  stream->SetPriority(spdy::SpdyStreamPrecedence(
+      ConvertRequestPriorityToQuicPriority(priority())));
+}
+
+int QuicCoalescedResponse::MaybeReadStream(int buf_len) {
+  if (read_in_flight_)
+    return ERR_IO_PENDING;
+  // A reader which stalls must not make the response buffer the whole body,
+  // so the readers ahead of it wait for it to catch up.
+  uint64_t buffered = BufferedBytes();
+  if (buffered >= max_buffered_bytes_) {
+    read_blocked_ = true;
+    return ERR_IO_PENDING;
+  }
+  return ReadStream(static_cast<int>(
+      std::min<uint64_t>(buf_len, max_buffered_bytes_ - buffered)));
+}
+
+int QuicCoalescedResponse::ReadStream(int buf_len) {
+  DCHECK(!read_in_flight_);
+  read_buf_ = base::MakeRefCounted<IOBuffer>(buf_len);
+  int rv = stream_->ReadBody(
+      read_buf_.get(), buf_len,
+      base::BindOnce(&QuicCoalescedResponse::OnReadStreamComplete,
+                     base::Unretained(this)));
+  read_in_flight_ = rv == ERR_IO_PENDING;
+  return rv;
+}
+
+void QuicCoalescedResponse::ResumeReading() {
+  if (done_)
+    return;
+  // The pending readers all wait at the end of the buffered body.
+  int buf_len = 0;
+  for (const auto& id_and_reader : readers_) {
+    if (id_and_reader.second.buf)
+      buf_len = std::max(buf_len, id_and_reader.second.buf_len);
+  }
+  if (buf_len == 0)
+    return;
+  int rv = MaybeReadStream(buf_len);
+  if (rv == ERR_IO_PENDING)
+    return;
+  // Readers may release the last reference to the response when called back.
+  scoped_refptr<QuicCoalescedResponse> protect(this);
+  OnStreamData(rv);
+  CompletePendingReads();
+}
+
+void QuicCoalescedResponse::OnReadStreamComplete(int rv) {
+  read_in_flight_ = false;
+  if (done_)
+    return;
+  // Readers may release the last reference to the response when called back.
+  scoped_refptr<QuicCoalescedResponse> protect(this);
+  OnStreamData(rv);
+  CompletePendingReads();
+}
+
+void QuicCoalescedResponse::OnStreamData(int rv) {
+  if (rv > 0) {
+    chunks_.push_back({end_offset_, std::move(read_buf_), rv});
+    end_offset_ += rv;
+  }
+  read_buf_ = nullptr;
+  if (rv < 0) {
+    Finish(rv);
+  } else if (rv == 0 || stream_->IsDoneReading()) {
+    Finish(OK);
+  }
+}
+
+void QuicCoalescedResponse::ReadTrailingHeaders() {
+  if (done_)
+    return;
+  int rv = stream_->ReadTrailingHeaders(
+      &trailing_headers_,
+      base::BindOnce(&QuicCoalescedResponse::OnReadTrailingHeadersComplete,
+                     base::Unretained(this)));
+  if (rv != ERR_IO_PENDING)
+    OnReadTrailingHeadersComplete(rv);
+}
+
+void QuicCoalescedResponse::OnReadTrailingHeadersComplete(int rv) {
+  // Trailers are ignored, like QuicHttpStream does, but they may be what
+  // ends the stream.
+  if (done_ || (rv >= 0 && !stream_->IsDoneReading()))
+    return;
+  scoped_refptr<QuicCoalescedResponse> protect(this);
+  Finish(rv < 0 ? rv : OK);
+  CompletePendingReads();
+}
+
+void QuicCoalescedResponse::Finish(int rv) {
+  DCHECK(!done_);
+  done_ = true;
+  status_ = rv;
+  if (rv == OK)
+    stream_->OnFinRead();
+}
+
+void QuicCoalescedResponse::CompletePendingReads() {
+  // Every pending reader waits for the bytes just read, or for the end of the
+  // body. Complete all of them before running any callback, which may remove
+  // readers.
+  std::vector<std::pair<CompletionOnceCallback, int>> completions;
+  for (auto& id_and_reader : readers_) {
+    Reader* reader = &id_and_reader.second;
+    // Readers may still wait for their headers callback.
+    if (!reader->callback || !reader->buf)
+      continue;
+    scoped_refptr<IOBuffer> buf = std::move(reader->buf);
+    int rv = CopyBody(id_and_reader.first, reader, buf.get(), reader->buf_len);
+    reader->buf_len = 0;
+    completions.emplace_back(std::move(reader->callback), rv);
+  }
+  TrimChunks();
+  for (auto& completion : completions)
+    std::move(completion.first).Run(completion.second);
+}
+
+int QuicCoalescedResponse::CopyBody(ReaderId reader_id,
+                                    Reader* reader,
+                                    IOBuffer* buf,
+                                    int buf_len) {
+  if (reader->offset == end_offset_) {
+    DCHECK(done_);
+    return status_;
+  }
+
+  auto chunk = chunks_.begin();
+  while (reader->offset >= chunk->offset + chunk->size)
+    ++chunk;
+  size_t start = reader->offset - chunk->offset;
+  int size = std::min(buf_len, chunk->size - static_cast<int>(start));
+  memcpy(buf->data(), chunk->data->data() + start, size);
+  reader->offset += size;
+
+  if (reader_id != leader_ && coalescer_)
+    coalescer_->stats_.bytes_saved += size;
+  TrimChunks();
+  return size;
+}
+
+void QuicCoalescedResponse::TrimChunks() {
+  uint64_t min_offset = end_offset_;
+  for (const auto& id_and_reader : readers_)
+    min_offset = std::min(min_offset, id_and_reader.second.offset);
+  while (!chunks_.empty() &&
+         chunks_.front().offset + chunks_.front().size <= min_offset) {
+    chunks_.pop_front();
+  }
+  // The readers which waited for room are called back asynchronously, as the
+  // reader which made it is in the middle of a read or of leaving.
+  if (read_blocked_ && BufferedBytes() < max_buffered_bytes_) {
+    read_blocked_ = false;
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE, base::BindOnce(&QuicCoalescedResponse::ResumeReading,
+                                  weak_factory_.GetWeakPtr()));
+  }
+}
+
+uint64_t QuicCoalescedResponse::BufferedBytes() const {
+  return chunks_.empty() ? 0 : end_offset_ - chunks_.front().offset;
+}
+
+}  // namespace net
@@ -0,0 +1,260 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_QUIC_REQUEST_COALESCER_H_
+#define NET_QUIC_QUIC_REQUEST_COALESCER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/completion_once_callback.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_export.h"
+#include "net/base/request_priority.h"
+#include "net/quic/quic_chromium_client_stream.h"
+#include "net/third_party/quiche/src/spdy/core/spdy_header_block.h"
+
+namespace net {
+
+struct HttpRequestInfo;
+class QuicCoalescedResponse;
+
+// Collapses identical GET requests in flight on one session into a single
+// request stream. The first request of a kind leads: it sends the request and,
+// once its response headers arrive, shares the response with the requests
+// which joined it in the meantime. The join window closes with the response
+// headers; later requests start a new request of their own.
+//
+// Requests are identical if all their request headers are, which includes the
+// URL and whatever headers the response may vary on. Responses which must not
+// be shared, e.g. because they set cookies, are read by the leader alone and
+// the requests which joined it are sent on their own streams.
+class NET_EXPORT_PRIVATE QuicRequestCoalescer {
+ public:
+  struct Stats {
+    // Requests which read the response of another request instead of sending
+    // their own.
+    uint32_t requests_coalesced = 0;
+    // Response body bytes delivered to those requests, which were downloaded
+    // once instead of once per request.
+    uint64_t bytes_saved = 0;
+  };
+
+  // Body bytes a shared response buffers for its slowest reader before it
+  // stops reading the stream.
+  static const uint64_t kMaxBufferedBytes;
+
+  QuicRequestCoalescer();
+  ~QuicRequestCoalescer();
+
+  // Returns true if |request_info| may share its response with identical
+  // requests: a GET without a body which is allowed to use cached data.
+  static bool IsEligible(const HttpRequestInfo& request_info);
+
+  // Returns the key under which requests with |request_headers| coalesce.
+  static std::string ComputeKey(const spdy::SpdyHeaderBlock& request_headers);
+
+  // Returns the response of the request in flight for |key| whose response
+  // headers have not arrived yet, or null if there is none.
+  scoped_refptr<QuicCoalescedResponse> Join(const std::string& key);
+
+  // Registers a new request in flight for |key|. Must not be called while a
+  // request for |key| can be joined.
+  scoped_refptr<QuicCoalescedResponse> Start(const std::string& key);
+
+  const Stats& stats() const { return stats_; }
+
+  void set_max_buffered_bytes_for_testing(uint64_t max_buffered_bytes) {
+    max_buffered_bytes_ = max_buffered_bytes;
+  }
+
+ private:
+  friend class QuicCoalescedResponse;
+
+  // Closes the join window of |key|.
+  void Remove(const std::string& key);
+
+  // Requests in flight which can be joined, by key. Responses remove
+  // themselves before they are destroyed.
+  std::map<std::string, QuicCoalescedResponse*> joinable_;
+
+  uint64_t max_buffered_bytes_;
+  Stats stats_;
+
+  base::WeakPtrFactory<QuicRequestCoalescer> weak_factory_{this};
+
+  DISALLOW_COPY_AND_ASSIGN(QuicRequestCoalescer);
+};
+
+// The response of a request read by several readers: the leading request,
+// which owns the request stream until the response headers arrive, and the
+// requests which joined it. Once shared, the response owns the stream and
+// reads the body from it as fast as its fastest reader, but no further than
+// max_buffered_bytes ahead of its slowest one. Body chunks are refcounted
+// buffers, released once the slowest reader has consumed them. The stream
+// has the priority of the most urgent reader.
+class NET_EXPORT_PRIVATE QuicCoalescedResponse
+    : public base::RefCounted<QuicCoalescedResponse> {
+ public:
+  using ReaderId = int;
+
+  QuicCoalescedResponse(base::WeakPtr<QuicRequestCoalescer> coalescer,
+                        const std::string& key,
+                        uint64_t max_buffered_bytes);
+
+  // Adds a reader of |priority|. The first reader added leads.
+  ReaderId AddReader(RequestPriority priority);
+
+  // Called by the leader once it has its request stream, which the response
+  // raises to the priority of the readers joining it until the response
+  // headers arrive. |stream| must outlive the leader's reader, or its call to
+  // OnHeaders().
+  void SetLeaderStream(QuicChromiumClientStream::Handle* stream);
+
+  // The priority of the most urgent reader.
+  RequestPriority priority() const;
+
+  // Removes |reader|, whose callbacks will not be run. If the leader leaves
+  // before the response headers arrive, the other readers are told to send
+  // their own requests. If the last reader leaves before the end of the
+  // body, the stream is reset.
+  void RemoveReader(ReaderId reader);
+
+  // Waits for the leader to share its response headers. Returns OK once they
+  // are shared, ERR_IO_PENDING and runs |callback| later, or an error if the
+  // response will not be shared, in which case |reader| must send its own
+  // request.
+  int WaitForHeaders(ReaderId reader, CompletionOnceCallback callback);
+
+  // Called by the leader with its response |headers|. Returns true if the
+  // response is shared, in which case the response takes |stream| over and
+  // the leader reads the body like the other readers. Otherwise the other
+  // readers are told to send their own requests.
+  bool OnHeaders(const spdy::SpdyHeaderBlock& headers,
+                 std::unique_ptr<QuicChromiumClientStream::Handle>* stream);
+
+  // The shared response headers.
+  const spdy::SpdyHeaderBlock& headers() const { return headers_; }
+
+  // Reads up to |buf_len| bytes of the body for |reader|. Returns the number
+  // of bytes read, 0 at the end of the body, a net error, or ERR_IO_PENDING
+  // in which case |callback| is run with the result later.
+  int ReadBody(ReaderId reader,
+               IOBuffer* buf,
+               int buf_len,
+               CompletionOnceCallback callback);
+
+  // Returns true if |reader| has read the whole body.
+  bool IsDoneReading(ReaderId reader) const;
+
+  // Bytes consumed from the stream, for the leader's received bytes.
+  int64_t NumBytesConsumed() const;
+
+ private:
+  friend class base::RefCounted<QuicCoalescedResponse>;
+
+  enum State {
+    STATE_WAITING_FOR_HEADERS,
+    STATE_SHARED,
+    STATE_NOT_SHARED,
+  };
+
+  struct Reader {
+    Reader();
+    ~Reader();
+
+    RequestPriority priority = DEFAULT_PRIORITY;
+    // Offset of the next body byte to read.
+    uint64_t offset = 0;
+    // Pending WaitForHeaders() or ReadBody().
+    CompletionOnceCallback callback;
+    scoped_refptr<IOBuffer> buf;
+    int buf_len = 0;
+  };
+
+  struct Chunk {
+    uint64_t offset;
+    scoped_refptr<IOBuffer> data;
+    int size;
+  };
+
+  ~QuicCoalescedResponse();
+
+  // Returns true if |headers| allow the response to be shared.
+  static bool IsShareable(const spdy::SpdyHeaderBlock& headers);
+
+  // Tells the readers waiting for headers that the response is not shared.
+  void StopSharing();
+  // Runs the callbacks of the readers waiting for headers with |rv|.
+  void PostHeadersCallbacks(int rv);
+  void RunHeadersCallback(ReaderId reader, int rv);
+
+  // Gives the stream the priority of the most urgent reader.
+  void UpdateStreamPriority();
+
+  // Reads the next chunk of the body, of up to |buf_len| bytes, from the
+  // stream unless a read is in flight or the buffer is full, in which case it
+  // returns ERR_IO_PENDING.
+  int MaybeReadStream(int buf_len);
+  int ReadStream(int buf_len);
+  // Reads on for the pending readers once the buffer has room again.
+  void ResumeReading();
+  void OnReadStreamComplete(int rv);
+  void OnStreamData(int rv);
+  void ReadTrailingHeaders();
+  void OnReadTrailingHeadersComplete(int rv);
+  void Finish(int rv);
+  // Completes the pending reads of all readers.
+  void CompletePendingReads();
+
+  // Copies buffered body to |reader| and returns the number of bytes copied,
+  // or the final status if it read the whole body.
+  int CopyBody(ReaderId reader_id, Reader* reader, IOBuffer* buf, int buf_len);
+  // Releases the chunks which all readers have consumed.
+  void TrimChunks();
+  // Bytes of the chunks not yet consumed by all readers.
+  uint64_t BufferedBytes() const;
+
+  base::WeakPtr<QuicRequestCoalescer> coalescer_;
+  const std::string key_;
+  const uint64_t max_buffered_bytes_;
+  State state_;
+
+  std::map<ReaderId, Reader> readers_;
+  ReaderId next_reader_id_;
+  ReaderId leader_;
+
+  spdy::SpdyHeaderBlock headers_;
+  spdy::SpdyHeaderBlock trailing_headers_;
+  // The leader's stream, until the response headers arrive. Not owned.
+  QuicChromiumClientStream::Handle* leader_stream_;
+  std::unique_ptr<QuicChromiumClientStream::Handle> stream_;
+  scoped_refptr<IOBuffer> read_buf_;
+  bool read_in_flight_;
+  // Set while readers wait for the slowest reader to make room in the buffer.
+  bool read_blocked_;
+
+  std::deque<Chunk> chunks_;
+  // Offset just past the last body byte read from the stream.
+  uint64_t end_offset_;
+  // Set once the stream is done, with the final status of the body.
+  bool done_;
+  int status_;
+
+  base::WeakPtrFactory<QuicCoalescedResponse> weak_factory_{this};
+
+  DISALLOW_COPY_AND_ASSIGN(QuicCoalescedResponse);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_REQUEST_COALESCER_H_
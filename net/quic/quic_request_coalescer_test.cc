@@ -0,0 +1,179 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_request_coalescer.h"
+
+#include "base/strings/string_number_conversions.h"
+#include "net/base/load_flags.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/http/http_request_info.h"
+#include "net/test/test_with_task_environment.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+spdy::SpdyHeaderBlock RequestHeaders(const std::string& path) {
+  spdy::SpdyHeaderBlock headers;
+  headers[":method"] = "GET";
+  headers[":scheme"] = "https";
+  headers[":authority"] = "www.example.org";
+  headers[":path"] = path;
+  headers["accept-encoding"] = "gzip";
+  return headers;
+}
+
+spdy::SpdyHeaderBlock ResponseHeaders() {
+  spdy::SpdyHeaderBlock headers;
+  headers[":status"] = "200";
+  headers["cache-control"] = "max-age=60";
+  return headers;
+}
+
+class QuicRequestCoalescerTest : public TestWithTaskEnvironment {
+ protected:
+  // Checks that a response with |headers| is not shared, and that the
+  // request which joined it is told to send its own request.
+  void ExpectNotShared(const spdy::SpdyHeaderBlock& headers) {
+    const std::string key = QuicRequestCoalescer::ComputeKey(
+        RequestHeaders("/" + base::NumberToString(next_path_++)));
+    scoped_refptr<QuicCoalescedResponse> response = coalescer_.Start(key);
+    QuicCoalescedResponse::ReaderId leader =
+        response->AddReader(DEFAULT_PRIORITY);
+    QuicCoalescedResponse::ReaderId follower =
+        response->AddReader(DEFAULT_PRIORITY);
+    TestCompletionCallback callback;
+    EXPECT_EQ(ERR_IO_PENDING,
+              response->WaitForHeaders(follower, callback.callback()));
+    // A shared response would take the stream over.
+    std::unique_ptr<QuicChromiumClientStream::Handle> stream;
+    EXPECT_FALSE(response->OnHeaders(headers, &stream));
+    EXPECT_EQ(ERR_ABORTED, callback.WaitForResult());
+    response->RemoveReader(follower);
+    response->RemoveReader(leader);
+  }
+
+  QuicRequestCoalescer coalescer_;
+  int next_path_ = 0;
+};
+
+TEST_F(QuicRequestCoalescerTest, ComputeKey) {
+  spdy::SpdyHeaderBlock reordered;
+  reordered["accept-encoding"] = "gzip";
+  reordered[":path"] = "/a";
+  reordered[":authority"] = "www.example.org";
+  reordered[":scheme"] = "https";
+  reordered[":method"] = "GET";
+  EXPECT_EQ(QuicRequestCoalescer::ComputeKey(RequestHeaders("/a")),
+            QuicRequestCoalescer::ComputeKey(reordered));
+
+  EXPECT_NE(QuicRequestCoalescer::ComputeKey(RequestHeaders("/a")),
+            QuicRequestCoalescer::ComputeKey(RequestHeaders("/b")));
+
+  // Any header the response may vary on makes a difference.
+  reordered["accept-encoding"] = "br";
+  EXPECT_NE(QuicRequestCoalescer::ComputeKey(RequestHeaders("/a")),
+            QuicRequestCoalescer::ComputeKey(reordered));
+}
+
+TEST_F(QuicRequestCoalescerTest, IsEligible) {
+  HttpRequestInfo request;
+  request.method = "GET";
+  request.url = GURL("https://www.example.org/");
+  EXPECT_TRUE(QuicRequestCoalescer::IsEligible(request));
+
+  request.load_flags = LOAD_DISABLE_CACHE;
+  EXPECT_FALSE(QuicRequestCoalescer::IsEligible(request));
+  request.load_flags = LOAD_BYPASS_CACHE;
+  EXPECT_FALSE(QuicRequestCoalescer::IsEligible(request));
+
+  request.load_flags = 0;
+  request.method = "POST";
+  EXPECT_FALSE(QuicRequestCoalescer::IsEligible(request));
+}
+
+TEST_F(QuicRequestCoalescerTest, JoinUntilHeaders) {
+  const std::string key = QuicRequestCoalescer::ComputeKey(RequestHeaders("/"));
+  EXPECT_FALSE(coalescer_.Join(key));
+
+  scoped_refptr<QuicCoalescedResponse> response = coalescer_.Start(key);
+  QuicCoalescedResponse::ReaderId leader =
+      response->AddReader(DEFAULT_PRIORITY);
+  EXPECT_EQ(response, coalescer_.Join(key));
+
+  // The leader has no followers, so its response is not shared, and the
+  // join window is closed.
+  std::unique_ptr<QuicChromiumClientStream::Handle> stream;
+  EXPECT_FALSE(response->OnHeaders(ResponseHeaders(), &stream));
+  EXPECT_FALSE(coalescer_.Join(key));
+  response->RemoveReader(leader);
+  EXPECT_EQ(0u, coalescer_.stats().requests_coalesced);
+}
+
+TEST_F(QuicRequestCoalescerTest, LeaderLeavesBeforeHeaders) {
+  const std::string key = QuicRequestCoalescer::ComputeKey(RequestHeaders("/"));
+  scoped_refptr<QuicCoalescedResponse> response = coalescer_.Start(key);
+  QuicCoalescedResponse::ReaderId leader =
+      response->AddReader(DEFAULT_PRIORITY);
+
+  scoped_refptr<QuicCoalescedResponse> joined = coalescer_.Join(key);
+  ASSERT_EQ(response, joined);
+  QuicCoalescedResponse::ReaderId follower =
+      joined->AddReader(DEFAULT_PRIORITY);
+  TestCompletionCallback callback;
+  EXPECT_EQ(ERR_IO_PENDING,
+            joined->WaitForHeaders(follower, callback.callback()));
+
+  // The follower is told to send its own request, and later requests start
+  // afresh.
+  response->RemoveReader(leader);
+  response = nullptr;
+  EXPECT_FALSE(coalescer_.Join(key));
+  EXPECT_FALSE(callback.have_result());
+  EXPECT_EQ(ERR_ABORTED, callback.WaitForResult());
+  EXPECT_EQ(ERR_ABORTED,
+            joined->WaitForHeaders(follower, callback.callback()));
+  joined->RemoveReader(follower);
+  EXPECT_EQ(0u, coalescer_.stats().requests_coalesced);
+}
+
+TEST_F(QuicRequestCoalescerTest, PriorityOfMostUrgentReader) {
+  const std::string key = QuicRequestCoalescer::ComputeKey(RequestHeaders("/"));
+  scoped_refptr<QuicCoalescedResponse> response = coalescer_.Start(key);
+  QuicCoalescedResponse::ReaderId leader = response->AddReader(LOW);
+  EXPECT_EQ(LOW, response->priority());
+
+  QuicCoalescedResponse::ReaderId follower = response->AddReader(HIGHEST);
+  EXPECT_EQ(HIGHEST, response->priority());
+  response->RemoveReader(follower);
+  EXPECT_EQ(LOW, response->priority());
+  response->RemoveReader(leader);
+}
+
+TEST_F(QuicRequestCoalescerTest, PrivateResponsesAreNotShared) {
+  spdy::SpdyHeaderBlock headers = ResponseHeaders();
+  headers["set-cookie"] = "id=1";
+  ExpectNotShared(headers);
+
+  headers = ResponseHeaders();
+  headers["cache-control"] = "max-age=60, Private=\"x-user\"";
+  ExpectNotShared(headers);
+
+  headers = ResponseHeaders();
+  headers["cache-control"] = "no-store";
+  ExpectNotShared(headers);
+
+  headers = ResponseHeaders();
+  headers["vary"] = "*";
+  ExpectNotShared(headers);
+
+  EXPECT_EQ(0u, coalescer_.stats().requests_coalesced);
+  EXPECT_EQ(0u, coalescer_.stats().bytes_saved);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -50,6 +50,22 @@ QuicSessionKey::QuicSessionKey(const quic::QuicServerId& server_id,
 
 QuicSessionKey::QuicSessionKey(const QuicSessionKey& other) = default;
 
+// static
+QuicSessionKey QuicSessionKey::CreateWithPartitioning(
+    const quic::QuicServerId& server_id,
+    const SocketTag& socket_tag,
+    const NetworkIsolationKey& network_isolation_key,
+    bool disable_secure_dns,
+    bool partition_by_network_isolation_key) {
+  QuicSessionKey key;
+  key.server_id_ = server_id;
+  key.socket_tag_ = socket_tag;
+  if (partition_by_network_isolation_key)
+    key.network_isolation_key_ = network_isolation_key;
+  key.disable_secure_dns_ = disable_secure_dns;
+  return key;
+}
+
 bool QuicSessionKey::operator<(const QuicSessionKey& other) const {
   return std::tie(server_id_, socket_tag_, network_isolation_key_,
                   disable_secure_dns_) <
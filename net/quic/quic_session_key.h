@@ -36,6 +36,17 @@ class QUIC_EXPORT_PRIVATE QuicSessionKey {
   QuicSessionKey(const QuicSessionKey& other);
   ~QuicSessionKey() = default;
 
+  // Like the constructors above, but whether |network_isolation_key| is kept
+  // is decided by |partition_by_network_isolation_key| rather than by
+  // querying features::kPartitionConnectionsByNetworkIsolationKey, so that
+  // callers creating many keys can look the feature up once.
+  static QuicSessionKey CreateWithPartitioning(
+      const quic::QuicServerId& server_id,
+      const SocketTag& socket_tag,
+      const NetworkIsolationKey& network_isolation_key,
+      bool disable_secure_dns,
+      bool partition_by_network_isolation_key);
+
   // Needed to be an element of std::set.
   bool operator<(const QuicSessionKey& other) const;
   bool operator==(const QuicSessionKey& other) const;
@@ -0,0 +1,102 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_session_key_interner.h"
+
+#include <functional>
+#include <string>
+
+#include "base/hash/hash.h"
+#include "base/logging.h"
+#include "base/optional.h"
+#include "base/trace_event/memory_usage_estimator.h"
+#include "net/base/network_isolation_key.h"
+#include "url/origin.h"
+
+namespace net {
+
+namespace {
+
+// Combines |hash| with |origin|. Opaque origins only hash as such; their
+// nonces are compared by NetworkIsolationKey::operator==().
+size_t HashOrigin(size_t hash, const base::Optional<url::Origin>& origin) {
+  if (!origin || origin->opaque())
+    return base::HashInts(hash, static_cast<size_t>(origin.has_value()));
+  hash = base::HashInts(hash, std::hash<std::string>()(origin->scheme()));
+  hash = base::HashInts(hash, std::hash<std::string>()(origin->host()));
+  return base::HashInts(hash, static_cast<size_t>(origin->port()));
+}
+
+}  // namespace
+
+QuicSessionKeyInterner::QuicSessionKeyInterner()
+    : next_id_(kInvalidQuicSessionKeyId + 1) {}
+
+QuicSessionKeyInterner::~QuicSessionKeyInterner() = default;
+
+QuicSessionKeyId QuicSessionKeyInterner::Find(const QuicSessionKey& key) const {
+  auto it = keys_.find(key);
+  if (it == keys_.end())
+    return kInvalidQuicSessionKeyId;
+  return it->second.id;
+}
+
+QuicSessionKeyId QuicSessionKeyInterner::Intern(const QuicSessionKey& key) {
+  auto result = keys_.emplace(key, Entry{next_id_, 0});
+  Entry& entry = result.first->second;
+  if (result.second) {
+    ids_.emplace(next_id_, result.first);
+    ++next_id_;
+    // IDs are never reused, so running out would take four billion keys.
+    CHECK_NE(kInvalidQuicSessionKeyId, next_id_);
+  }
+  ++entry.ref_count;
+  return entry.id;
+}
+
+void QuicSessionKeyInterner::Release(QuicSessionKeyId id) {
+  auto it = ids_.find(id);
+  DCHECK(it != ids_.end());
+  if (it == ids_.end())
+    return;
+  Entry& entry = it->second->second;
+  DCHECK_LT(0u, entry.ref_count);
+  if (--entry.ref_count > 0)
+    return;
+  keys_.erase(it->second);
+  ids_.erase(it);
+}
+
+const QuicSessionKey& QuicSessionKeyInterner::GetKey(
+    QuicSessionKeyId id) const {
+  auto it = ids_.find(id);
+  CHECK(it != ids_.end());
+  return it->second->first;
+}
+
+size_t QuicSessionKeyInterner::EstimateMemoryUsage() const {
+  return base::trace_event::EstimateMemoryUsage(keys_) +
+         base::trace_event::EstimateMemoryUsage(ids_);
+}
+
+size_t QuicSessionKeyInterner::KeyHash::operator()(
+    const QuicSessionKey& key) const {
+  // SocketTag does not expose its fields, so equal hashes are resolved by
+  // QuicSessionKey::operator==(). Hashes the strings in place, since keys are
+  // hashed on every lookup.
+  const quic::QuicServerId& server_id = key.server_id();
+  size_t hash = std::hash<std::string>()(server_id.host());
+  hash = base::HashInts(hash, (static_cast<size_t>(server_id.port()) << 2) |
+                                  (server_id.privacy_mode_enabled() << 1) |
+                                  key.disable_secure_dns());
+  const NetworkIsolationKey& network_isolation_key =
+      key.network_isolation_key();
+  if (!network_isolation_key.IsEmpty()) {
+    hash = HashOrigin(hash, network_isolation_key.GetTopFrameOrigin());
+    hash = HashOrigin(hash, network_isolation_key.GetFrameOrigin());
+  }
+  return hash;
+}
+
+}  // namespace net
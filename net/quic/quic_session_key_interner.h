@@ -0,0 +1,79 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_QUIC_SESSION_KEY_INTERNER_H_
+#define NET_QUIC_QUIC_SESSION_KEY_INTERNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_map>
+
+#include "base/macros.h"
+#include "net/base/net_export.h"
+#include "net/quic/quic_session_key.h"
+
+namespace net {
+
+// Compact identifier of a QuicSessionKey interned by a QuicSessionKeyInterner.
+// Two keys interned by the same interner have the same ID if and only if they
+// are equal, so maps keyed by ID compare integers instead of host names,
+// socket tags and NetworkIsolationKeys.
+using QuicSessionKeyId = uint32_t;
+
+// Never returned by QuicSessionKeyInterner::Intern().
+const QuicSessionKeyId kInvalidQuicSessionKeyId = 0;
+
+// Maps QuicSessionKeys to QuicSessionKeyIds. Each key is hashed once when it
+// is resolved; the hash is kept with the interned key so that the table can
+// grow without hashing keys again. Interned keys are reference counted, and a
+// key is forgotten, and its ID never reused, once its last reference is
+// released.
+class NET_EXPORT_PRIVATE QuicSessionKeyInterner {
+ public:
+  // Hashes the fields of a QuicSessionKey other than its SocketTag.
+  struct KeyHash {
+    size_t operator()(const QuicSessionKey& key) const;
+  };
+
+  QuicSessionKeyInterner();
+  ~QuicSessionKeyInterner();
+
+  // Returns the ID of |key|, or kInvalidQuicSessionKeyId if it is not
+  // interned. Does not add a reference.
+  QuicSessionKeyId Find(const QuicSessionKey& key) const;
+
+  // Returns the ID of |key|, interning it if needed, and adds a reference to
+  // it.
+  QuicSessionKeyId Intern(const QuicSessionKey& key);
+
+  // Releases a reference added by Intern().
+  void Release(QuicSessionKeyId id);
+
+  // Returns the key interned as |id|, which must be interned.
+  const QuicSessionKey& GetKey(QuicSessionKeyId id) const;
+
+  size_t size() const { return ids_.size(); }
+
+  size_t EstimateMemoryUsage() const;
+
+ private:
+  struct Entry {
+    QuicSessionKeyId id;
+    size_t ref_count;
+  };
+
+  using KeyMap = std::unordered_map<QuicSessionKey, Entry, KeyHash>;
+
+  KeyMap keys_;
+  // Interned keys by ID. Points into |keys_|, whose nodes are stable.
+  std::unordered_map<QuicSessionKeyId, KeyMap::iterator> ids_;
+  QuicSessionKeyId next_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicSessionKeyInterner);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_SESSION_KEY_INTERNER_H_
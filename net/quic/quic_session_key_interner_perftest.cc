@@ -0,0 +1,131 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares QuicStreamFactory-style maps keyed by full QuicSessionKeys with
+// maps keyed by QuicSessionKeyIds, following the calls the factory makes for
+// a request while thousands of sessions are live.
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/timer/elapsed_timer.h"
+#include "net/base/network_isolation_key.h"
+#include "net/quic/quic_session_key_interner.h"
+#include "net/socket/socket_tag.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+#include "url/gurl.h"
+#include "url/origin.h"
+
+namespace net {
+namespace test {
+namespace {
+
+const size_t kNumSessions[] = {100, 1000, 10000};
+const int kNumRequests = 200000;
+// Every fourth request has no session yet and waits on a job.
+const int kJobInterval = 4;
+
+const char kMetricPrefix[] = "QuicSessionKey.";
+const char kMetricKeyLookupTime[] = "key_lookup_time";
+const char kMetricIdLookupTime[] = "id_lookup_time";
+
+perf_test::PerfResultReporter SetUpReporter(const std::string& story) {
+  perf_test::PerfResultReporter reporter(kMetricPrefix, story);
+  reporter.RegisterImportantMetric(kMetricKeyLookupTime, "ns");
+  reporter.RegisterImportantMetric(kMetricIdLookupTime, "ns");
+  return reporter;
+}
+
+// Hosts share a long suffix and NetworkIsolationKeys are populated, as with
+// connection partitioning enabled, so that comparisons of full keys are not
+// decided by the first characters of the host.
+std::vector<QuicSessionKey> CreateKeys(size_t num_keys) {
+  std::vector<QuicSessionKey> keys;
+  for (size_t i = 0; i < num_keys; ++i) {
+    const url::Origin origin = url::Origin::Create(
+        GURL(base::StringPrintf("https://site%zu.example.test/", i % 50)));
+    keys.push_back(QuicSessionKey::CreateWithPartitioning(
+        quic::QuicServerId(
+            base::StringPrintf("cdn.static.example.org.%zu", i), 443,
+            /*privacy_mode_enabled=*/false),
+        SocketTag(), NetworkIsolationKey(origin, origin),
+        /*disable_secure_dns=*/false,
+        /*partition_by_network_isolation_key=*/true));
+  }
+  return keys;
+}
+
+// Requests for live sessions look up |active_sessions_| once. Requests
+// without one look up |active_sessions_| and |active_jobs_|, start a job,
+// change their priority and complete, as in QuicStreamFactory::Create(),
+// SetRequestPriority() and OnJobComplete().
+TEST(QuicSessionKeyInternerPerfTest, Request) {
+  for (size_t num_sessions : kNumSessions) {
+    const std::vector<QuicSessionKey> keys = CreateKeys(num_sessions);
+    const std::vector<QuicSessionKey> new_keys = CreateKeys(2 * num_sessions);
+    size_t found = 0;
+
+    std::map<QuicSessionKey, size_t> key_sessions;
+    std::map<QuicSessionKey, size_t> key_jobs;
+    for (size_t i = 0; i < keys.size(); ++i)
+      key_sessions[keys[i]] = i;
+    base::ElapsedTimer key_timer;
+    for (int i = 0; i < kNumRequests; ++i) {
+      if (i % kJobInterval != 0) {
+        found += key_sessions.count(keys[i % keys.size()]);
+        continue;
+      }
+      // Keys past the first |num_sessions| have no session.
+      const QuicSessionKey& key =
+          new_keys[num_sessions + (i / kJobInterval) % num_sessions];
+      found += key_sessions.count(key) + key_jobs.count(key);
+      key_jobs[key] = i;
+      found += key_jobs.count(key);
+      key_jobs.erase(key);
+    }
+    base::TimeDelta key_time = key_timer.Elapsed();
+
+    QuicSessionKeyInterner interner;
+    std::map<QuicSessionKeyId, size_t> id_sessions;
+    std::map<QuicSessionKeyId, size_t> id_jobs;
+    for (size_t i = 0; i < keys.size(); ++i)
+      id_sessions[interner.Intern(keys[i])] = i;
+    base::ElapsedTimer id_timer;
+    for (int i = 0; i < kNumRequests; ++i) {
+      if (i % kJobInterval != 0) {
+        found += id_sessions.count(interner.Find(keys[i % keys.size()]));
+        continue;
+      }
+      const QuicSessionKey& key =
+          new_keys[num_sessions + (i / kJobInterval) % num_sessions];
+      QuicSessionKeyId id = interner.Find(key);
+      found += id_sessions.count(id) + id_jobs.count(id);
+      // The job and its requests keep the ID from here on.
+      id = interner.Intern(key);
+      id_jobs[id] = i;
+      found += id_jobs.count(id);
+      id_jobs.erase(id);
+      interner.Release(id);
+    }
+    base::TimeDelta id_time = id_timer.Elapsed();
+    // Each request finds its session, or its job once started.
+    EXPECT_EQ(2u * kNumRequests, found);
+    EXPECT_EQ(keys.size(), interner.size());
+
+    perf_test::PerfResultReporter reporter =
+        SetUpReporter("sessions_" + base::NumberToString(num_sessions));
+    reporter.AddResult(kMetricKeyLookupTime,
+                       key_time.InMicrosecondsF() * 1000 / kNumRequests);
+    reporter.AddResult(kMetricIdLookupTime,
+                       id_time.InMicrosecondsF() * 1000 / kNumRequests);
+  }
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -0,0 +1,140 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_session_key_interner.h"
+
+#include "net/base/network_isolation_key.h"
+#include "net/socket/socket_tag.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "url/gurl.h"
+#include "url/origin.h"
+
+namespace net {
+namespace test {
+namespace {
+
+QuicSessionKey CreateKey(const std::string& host,
+                         const NetworkIsolationKey& network_isolation_key =
+                             NetworkIsolationKey()) {
+  return QuicSessionKey::CreateWithPartitioning(
+      quic::QuicServerId(host, 443, /*privacy_mode_enabled=*/false),
+      SocketTag(), network_isolation_key, /*disable_secure_dns=*/false,
+      /*partition_by_network_isolation_key=*/true);
+}
+
+TEST(QuicSessionKeyInternerTest, EqualKeysShareId) {
+  QuicSessionKeyInterner interner;
+  const QuicSessionKey key1 = CreateKey("www.example.org");
+  const QuicSessionKey key2 = CreateKey("mail.example.org");
+
+  EXPECT_EQ(kInvalidQuicSessionKeyId, interner.Find(key1));
+  QuicSessionKeyId id1 = interner.Intern(key1);
+  EXPECT_NE(kInvalidQuicSessionKeyId, id1);
+  EXPECT_EQ(id1, interner.Intern(key1));
+  EXPECT_EQ(id1, interner.Find(key1));
+  EXPECT_EQ(key1, interner.GetKey(id1));
+
+  QuicSessionKeyId id2 = interner.Intern(key2);
+  EXPECT_NE(id1, id2);
+  EXPECT_EQ(key2, interner.GetKey(id2));
+  EXPECT_EQ(2u, interner.size());
+}
+
+TEST(QuicSessionKeyInternerTest, KeyFields) {
+  QuicSessionKeyInterner interner;
+  const url::Origin origin = url::Origin::Create(GURL("https://foo.test/"));
+  const NetworkIsolationKey network_isolation_key(origin, origin);
+  const QuicSessionKey key = CreateKey("www.example.org");
+  QuicSessionKeyId id = interner.Intern(key);
+
+  EXPECT_NE(id, interner.Intern(
+                    CreateKey("www.example.org", network_isolation_key)));
+  EXPECT_NE(id, interner.Intern(QuicSessionKey(
+                    quic::QuicServerId("www.example.org", 443,
+                                       /*privacy_mode_enabled=*/true),
+                    SocketTag(), NetworkIsolationKey(),
+                    /*disable_secure_dns=*/false)));
+  EXPECT_NE(id, interner.Intern(QuicSessionKey(
+                    quic::QuicServerId("www.example.org", 444,
+                                       /*privacy_mode_enabled=*/false),
+                    SocketTag(), NetworkIsolationKey(),
+                    /*disable_secure_dns=*/false)));
+  EXPECT_NE(id, interner.Intern(QuicSessionKey(
+                    key.server_id(), SocketTag(), NetworkIsolationKey(),
+                    /*disable_secure_dns=*/true)));
+  EXPECT_EQ(5u, interner.size());
+}
+
+TEST(QuicSessionKeyInternerTest, Release) {
+  QuicSessionKeyInterner interner;
+  const QuicSessionKey key = CreateKey("www.example.org");
+  QuicSessionKeyId id = interner.Intern(key);
+  EXPECT_EQ(id, interner.Intern(key));
+
+  interner.Release(id);
+  EXPECT_EQ(id, interner.Find(key));
+  interner.Release(id);
+  EXPECT_EQ(kInvalidQuicSessionKeyId, interner.Find(key));
+  EXPECT_EQ(0u, interner.size());
+
+  // IDs are not reused.
+  EXPECT_NE(id, interner.Intern(key));
+}
+
+TEST(QuicSessionKeyInternerTest, NetworkIsolationKeyHash) {
+  QuicSessionKeyInterner interner;
+  const url::Origin origin1 = url::Origin::Create(GURL("https://foo.test/"));
+  const url::Origin origin2 = url::Origin::Create(GURL("https://bar.test/"));
+  QuicSessionKeyId id = interner.Intern(
+      CreateKey("www.example.org", NetworkIsolationKey(origin1, origin1)));
+
+  // Equal keys built from separate origins share an ID.
+  EXPECT_EQ(id, interner.Find(CreateKey(
+                    "www.example.org",
+                    NetworkIsolationKey(
+                        url::Origin::Create(GURL("https://foo.test/")),
+                        url::Origin::Create(GURL("https://foo.test/"))))));
+  EXPECT_NE(id, interner.Intern(CreateKey(
+                    "www.example.org", NetworkIsolationKey(origin2, origin1))));
+  EXPECT_NE(id, interner.Intern(CreateKey(
+                    "www.example.org", NetworkIsolationKey(origin1, origin2))));
+
+  // Opaque origins hash alike, but are only equal to themselves.
+  const url::Origin opaque1;
+  const url::Origin opaque2;
+  QuicSessionKeyId opaque_id = interner.Intern(
+      CreateKey("www.example.org", NetworkIsolationKey(opaque1, opaque1)));
+  EXPECT_NE(opaque_id, interner.Intern(CreateKey(
+                           "www.example.org",
+                           NetworkIsolationKey(opaque2, opaque2))));
+  EXPECT_EQ(opaque_id, interner.Find(CreateKey(
+                           "www.example.org",
+                           NetworkIsolationKey(opaque1, opaque1))));
+}
+
+TEST(QuicSessionKeyTest, CreateWithPartitioning) {
+  const url::Origin origin = url::Origin::Create(GURL("https://foo.test/"));
+  const NetworkIsolationKey network_isolation_key(origin, origin);
+  const quic::QuicServerId server_id("www.example.org", 443,
+                                     /*privacy_mode_enabled=*/false);
+
+  QuicSessionKey key = QuicSessionKey::CreateWithPartitioning(
+      server_id, SocketTag(), network_isolation_key,
+      /*disable_secure_dns=*/true,
+      /*partition_by_network_isolation_key=*/true);
+  EXPECT_EQ(server_id, key.server_id());
+  EXPECT_EQ(network_isolation_key, key.network_isolation_key());
+  EXPECT_TRUE(key.disable_secure_dns());
+
+  key = QuicSessionKey::CreateWithPartitioning(
+      server_id, SocketTag(), network_isolation_key,
+      /*disable_secure_dns=*/false,
+      /*partition_by_network_isolation_key=*/false);
+  EXPECT_EQ(NetworkIsolationKey(), key.network_isolation_key());
+  EXPECT_FALSE(key.disable_secure_dns());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
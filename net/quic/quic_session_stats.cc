@@ -0,0 +1,202 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_session_stats.h"
+
+#include <type_traits>
+
+#include "base/big_endian.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+
+namespace net {
+
+namespace {
+
+static_assert(std::is_trivially_copyable<QuicSessionStats>::value,
+              "QuicSessionStats must be cheap to copy");
+
+const uint8_t kSerializationVersion = 4;
+
+enum Flags : uint8_t {
+  kConnected = 1 << 0,
+  kHandshakeConfirmed = 1 << 1,
+  kGoingAway = 1 << 2,
+};
+
+// Escapes a tag value of the line protocol.
+void AppendTagValue(base::StringPiece value, std::string* output) {
+  for (char c : value) {
+    if (c == ',' || c == '=' || c == ' ')
+      output->push_back('\\');
+    output->push_back(c);
+  }
+}
+
+// Appends the name of a field, preceded by a separator unless it is the first
+// field of the line.
+void AppendFieldName(const char* name, std::string* output) {
+  if (output->back() != ' ')
+    output->push_back(',');
+  output->append(name);
+  output->push_back('=');
+}
+
+void AppendField(const char* name, uint64_t value, std::string* output) {
+  AppendFieldName(name, output);
+  output->append(base::NumberToString(value));
+  output->push_back('i');
+}
+
+void AppendField(const char* name, int64_t value, std::string* output) {
+  AppendFieldName(name, output);
+  output->append(base::NumberToString(value));
+  output->push_back('i');
+}
+
+void AppendField(const char* name, bool value, std::string* output) {
+  AppendFieldName(name, output);
+  output->push_back(value ? 't' : 'f');
+}
+
+}  // namespace
+
+void SerializeQuicSessionStats(const QuicSessionStats& stats,
+                               std::string* output) {
+  size_t offset = output->size();
+  output->resize(offset + kQuicSessionStatsSerializedSize);
+  base::BigEndianWriter writer(&(*output)[offset],
+                               kQuicSessionStatsSerializedSize);
+  uint8_t flags = (stats.connected ? kConnected : 0) |
+                  (stats.handshake_confirmed ? kHandshakeConfirmed : 0) |
+                  (stats.going_away ? kGoingAway : 0);
+  bool success =
+      writer.WriteU8(kSerializationVersion) &&
+      writer.WriteU64(static_cast<uint64_t>(stats.smoothed_rtt_us)) &&
+      writer.WriteU64(static_cast<uint64_t>(stats.min_rtt_us)) &&
+      writer.WriteU64(static_cast<uint64_t>(stats.latest_rtt_us)) &&
+      writer.WriteU64(stats.congestion_window) &&
+      writer.WriteU64(stats.bytes_in_flight) &&
+      writer.WriteU64(stats.packets_sent) &&
+      writer.WriteU64(stats.packets_received) &&
+      writer.WriteU64(stats.packets_lost) &&
+      writer.WriteU64(stats.packets_retransmitted) &&
+      writer.WriteU64(stats.bytes_sent) &&
+      writer.WriteU64(stats.bytes_received) &&
+      writer.WriteU64(stats.bytes_retransmitted) &&
+      writer.WriteU32(stats.open_streams) &&
+      writer.WriteU32(stats.total_streams) &&
+      writer.WriteU32(stats.migrations) &&
+      writer.WriteU32(stats.migration_failures) &&
+      writer.WriteU64(stats.receive_window) &&
+      writer.WriteU32(stats.receive_window_increases) &&
+      writer.WriteU32(stats.stream_receive_window_increases) &&
+      writer.WriteU32(stats.pushes_promised) &&
+      writer.WriteU32(stats.pushes_claimed) &&
+      writer.WriteU32(stats.pushes_cancelled) &&
+      writer.WriteU64(stats.push_wasted_bytes) &&
+      writer.WriteU64(static_cast<uint64_t>(stats.push_claim_latency_us)) &&
+      writer.WriteU32(stats.requests_coalesced) &&
+      writer.WriteU64(stats.coalesced_bytes_saved) &&
+      writer.WriteU8(flags);
+  DCHECK(success);
+  DCHECK_EQ(0u, writer.remaining());
+}
+
+bool ParseQuicSessionStats(base::StringPiece input, QuicSessionStats* stats) {
+  if (input.size() != kQuicSessionStatsSerializedSize)
+    return false;
+  base::BigEndianReader reader(input.data(), input.size());
+  uint8_t version;
+  if (!reader.ReadU8(&version) || version != kSerializationVersion)
+    return false;
+  uint64_t smoothed_rtt_us;
+  uint64_t min_rtt_us;
+  uint64_t latest_rtt_us;
+  uint64_t push_claim_latency_us;
+  uint8_t flags;
+  if (!reader.ReadU64(&smoothed_rtt_us) || !reader.ReadU64(&min_rtt_us) ||
+      !reader.ReadU64(&latest_rtt_us) ||
+      !reader.ReadU64(&stats->congestion_window) ||
+      !reader.ReadU64(&stats->bytes_in_flight) ||
+      !reader.ReadU64(&stats->packets_sent) ||
+      !reader.ReadU64(&stats->packets_received) ||
+      !reader.ReadU64(&stats->packets_lost) ||
+      !reader.ReadU64(&stats->packets_retransmitted) ||
+      !reader.ReadU64(&stats->bytes_sent) ||
+      !reader.ReadU64(&stats->bytes_received) ||
+      !reader.ReadU64(&stats->bytes_retransmitted) ||
+      !reader.ReadU32(&stats->open_streams) ||
+      !reader.ReadU32(&stats->total_streams) ||
+      !reader.ReadU32(&stats->migrations) ||
+      !reader.ReadU32(&stats->migration_failures) ||
+      !reader.ReadU64(&stats->receive_window) ||
+      !reader.ReadU32(&stats->receive_window_increases) ||
+      !reader.ReadU32(&stats->stream_receive_window_increases) ||
+      !reader.ReadU32(&stats->pushes_promised) ||
+      !reader.ReadU32(&stats->pushes_claimed) ||
+      !reader.ReadU32(&stats->pushes_cancelled) ||
+      !reader.ReadU64(&stats->push_wasted_bytes) ||
+      !reader.ReadU64(&push_claim_latency_us) ||
+      !reader.ReadU32(&stats->requests_coalesced) ||
+      !reader.ReadU64(&stats->coalesced_bytes_saved) ||
+      !reader.ReadU8(&flags)) {
+    return false;
+  }
+  stats->smoothed_rtt_us = static_cast<int64_t>(smoothed_rtt_us);
+  stats->min_rtt_us = static_cast<int64_t>(min_rtt_us);
+  stats->latest_rtt_us = static_cast<int64_t>(latest_rtt_us);
+  stats->push_claim_latency_us = static_cast<int64_t>(push_claim_latency_us);
+  stats->connected = flags & kConnected;
+  stats->handshake_confirmed = flags & kHandshakeConfirmed;
+  stats->going_away = flags & kGoingAway;
+  return true;
+}
+
+void AppendQuicSessionStatsLine(const QuicSessionStats& stats,
+                                base::StringPiece host,
+                                uint16_t port,
+                                std::string* output) {
+  output->append("quic_session,host=");
+  AppendTagValue(host, output);
+  output->append(",port=");
+  output->append(base::NumberToString(port));
+  output->push_back(' ');
+  AppendField("smoothed_rtt_us", stats.smoothed_rtt_us, output);
+  AppendField("min_rtt_us", stats.min_rtt_us, output);
+  AppendField("latest_rtt_us", stats.latest_rtt_us, output);
+  AppendField("congestion_window", stats.congestion_window, output);
+  AppendField("bytes_in_flight", stats.bytes_in_flight, output);
+  AppendField("packets_sent", stats.packets_sent, output);
+  AppendField("packets_received", stats.packets_received, output);
+  AppendField("packets_lost", stats.packets_lost, output);
+  AppendField("packets_retransmitted", stats.packets_retransmitted, output);
+  AppendField("bytes_sent", stats.bytes_sent, output);
+  AppendField("bytes_received", stats.bytes_received, output);
+  AppendField("bytes_retransmitted", stats.bytes_retransmitted, output);
+  AppendField("open_streams", uint64_t{stats.open_streams}, output);
+  AppendField("total_streams", uint64_t{stats.total_streams}, output);
+  AppendField("migrations", uint64_t{stats.migrations}, output);
+  AppendField("migration_failures", uint64_t{stats.migration_failures},
+              output);
+  AppendField("receive_window", stats.receive_window, output);
+  AppendField("receive_window_increases",
+              uint64_t{stats.receive_window_increases}, output);
+  AppendField("stream_receive_window_increases",
+              uint64_t{stats.stream_receive_window_increases}, output);
+  AppendField("pushes_promised", uint64_t{stats.pushes_promised}, output);
+  AppendField("pushes_claimed", uint64_t{stats.pushes_claimed}, output);
+  AppendField("pushes_cancelled", uint64_t{stats.pushes_cancelled}, output);
+  AppendField("push_wasted_bytes", stats.push_wasted_bytes, output);
+  AppendField("push_claim_latency_us", stats.push_claim_latency_us, output);
+  AppendField("requests_coalesced", uint64_t{stats.requests_coalesced},
+              output);
+  AppendField("coalesced_bytes_saved", stats.coalesced_bytes_saved, output);
+  AppendField("connected", stats.connected, output);
+  AppendField("handshake_confirmed", stats.handshake_confirmed, output);
+  AppendField("going_away", stats.going_away, output);
+  output->push_back('\n');
+}
+
+}  // namespace net
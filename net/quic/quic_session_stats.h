@@ -0,0 +1,99 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_QUIC_SESSION_STATS_H_
+#define NET_QUIC_QUIC_SESSION_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "base/strings/string_piece.h"
+#include "net/base/net_export.h"
+
+namespace net {
+
+// Size of a QuicSessionStats record written by SerializeQuicSessionStats().
+const size_t kQuicSessionStatsSerializedSize = 170;
+
+// Snapshot of the state of a QuicChromiumClientSession, for monitoring. Unlike
+// QuicChromiumClientSession::GetInfoAsValue(), taking a snapshot allocates
+// nothing, so it can be polled for thousands of sessions.
+struct NET_EXPORT_PRIVATE QuicSessionStats {
+  // RTT estimates, in microseconds.
+  int64_t smoothed_rtt_us = 0;
+  int64_t min_rtt_us = 0;
+  int64_t latest_rtt_us = 0;
+
+  // Congestion controller state, in bytes.
+  uint64_t congestion_window = 0;
+  uint64_t bytes_in_flight = 0;
+
+  // Counters over the lifetime of the connection.
+  uint64_t packets_sent = 0;
+  uint64_t packets_received = 0;
+  uint64_t packets_lost = 0;
+  uint64_t packets_retransmitted = 0;
+  uint64_t bytes_sent = 0;
+  uint64_t bytes_received = 0;
+  uint64_t bytes_retransmitted = 0;
+
+  // Request streams currently open, and created over the session lifetime.
+  uint32_t open_streams = 0;
+  uint32_t total_streams = 0;
+
+  // Connection and port migrations which moved the session to a new path,
+  // and attempts which did not.
+  uint32_t migrations = 0;
+  uint32_t migration_failures = 0;
+
+  // Current receive window of the session, and how many times the receive
+  // windows of the session and of its streams were grown by auto-tuning.
+  uint64_t receive_window = 0;
+  uint32_t receive_window_increases = 0;
+  uint32_t stream_receive_window_increases = 0;
+
+  // Server pushes promised, claimed by a request, and cancelled or timed out
+  // unclaimed; the push hit rate is |pushes_claimed| / |pushes_promised|.
+  // Also the bytes received on unclaimed pushes, and the total time between
+  // promise and claim of claimed pushes, in microseconds.
+  uint32_t pushes_promised = 0;
+  uint32_t pushes_claimed = 0;
+  uint32_t pushes_cancelled = 0;
+  uint64_t push_wasted_bytes = 0;
+  int64_t push_claim_latency_us = 0;
+
+  // Requests which shared the response of an identical request instead of
+  // sending their own, and the response body bytes they read without
+  // downloading them again.
+  uint32_t requests_coalesced = 0;
+  uint64_t coalesced_bytes_saved = 0;
+
+  bool connected = false;
+  bool handshake_confirmed = false;
+  bool going_away = false;
+};
+
+// Writes |stats| to |output| as a fixed-size, big-endian record of
+// kQuicSessionStatsSerializedSize bytes, starting with a format version.
+NET_EXPORT_PRIVATE void SerializeQuicSessionStats(const QuicSessionStats& stats,
+                                                  std::string* output);
+
+// Reads a record written by SerializeQuicSessionStats(). Returns false if
+// |input| is not a complete record of a known version.
+NET_EXPORT_PRIVATE bool ParseQuicSessionStats(base::StringPiece input,
+                                              QuicSessionStats* stats);
+
+// Appends |stats| to |output| as one line of InfluxDB line protocol, with the
+// measurement "quic_session" and |host| and |port| as tags.
+NET_EXPORT_PRIVATE void AppendQuicSessionStatsLine(
+    const QuicSessionStats& stats,
+    base::StringPiece host,
+    uint16_t port,
+    std::string* output);
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_SESSION_STATS_H_
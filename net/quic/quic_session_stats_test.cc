@@ -0,0 +1,131 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_session_stats.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+QuicSessionStats CreateStats() {
+  QuicSessionStats stats;
+  stats.smoothed_rtt_us = 25000;
+  stats.min_rtt_us = 20000;
+  stats.latest_rtt_us = 31000;
+  stats.congestion_window = 14720;
+  stats.bytes_in_flight = 2400;
+  stats.packets_sent = 100;
+  stats.packets_received = 90;
+  stats.packets_lost = 3;
+  stats.packets_retransmitted = 4;
+  stats.bytes_sent = 120000;
+  stats.bytes_received = 1ull << 40;
+  stats.bytes_retransmitted = 4800;
+  stats.open_streams = 2;
+  stats.total_streams = 7;
+  stats.migrations = 1;
+  stats.migration_failures = 5;
+  stats.receive_window = 2 * 1024 * 1024;
+  stats.receive_window_increases = 1;
+  stats.stream_receive_window_increases = 3;
+  stats.pushes_promised = 4;
+  stats.pushes_claimed = 3;
+  stats.pushes_cancelled = 1;
+  stats.push_wasted_bytes = 1350;
+  stats.push_claim_latency_us = 90000;
+  stats.requests_coalesced = 6;
+  stats.coalesced_bytes_saved = 65536;
+  stats.connected = true;
+  stats.handshake_confirmed = true;
+  stats.going_away = false;
+  return stats;
+}
+
+TEST(QuicSessionStatsTest, SerializeAndParse) {
+  const QuicSessionStats stats = CreateStats();
+  std::string output("prefix");
+  SerializeQuicSessionStats(stats, &output);
+  ASSERT_EQ(6 + kQuicSessionStatsSerializedSize, output.size());
+  EXPECT_EQ("prefix", output.substr(0, 6));
+
+  QuicSessionStats parsed;
+  ASSERT_TRUE(
+      ParseQuicSessionStats(base::StringPiece(output).substr(6), &parsed));
+  EXPECT_EQ(stats.smoothed_rtt_us, parsed.smoothed_rtt_us);
+  EXPECT_EQ(stats.min_rtt_us, parsed.min_rtt_us);
+  EXPECT_EQ(stats.latest_rtt_us, parsed.latest_rtt_us);
+  EXPECT_EQ(stats.congestion_window, parsed.congestion_window);
+  EXPECT_EQ(stats.bytes_in_flight, parsed.bytes_in_flight);
+  EXPECT_EQ(stats.packets_sent, parsed.packets_sent);
+  EXPECT_EQ(stats.packets_received, parsed.packets_received);
+  EXPECT_EQ(stats.packets_lost, parsed.packets_lost);
+  EXPECT_EQ(stats.packets_retransmitted, parsed.packets_retransmitted);
+  EXPECT_EQ(stats.bytes_sent, parsed.bytes_sent);
+  EXPECT_EQ(stats.bytes_received, parsed.bytes_received);
+  EXPECT_EQ(stats.bytes_retransmitted, parsed.bytes_retransmitted);
+  EXPECT_EQ(stats.open_streams, parsed.open_streams);
+  EXPECT_EQ(stats.total_streams, parsed.total_streams);
+  EXPECT_EQ(stats.migrations, parsed.migrations);
+  EXPECT_EQ(stats.migration_failures, parsed.migration_failures);
+  EXPECT_EQ(stats.receive_window, parsed.receive_window);
+  EXPECT_EQ(stats.receive_window_increases, parsed.receive_window_increases);
+  EXPECT_EQ(stats.stream_receive_window_increases,
+            parsed.stream_receive_window_increases);
+  EXPECT_EQ(stats.pushes_promised, parsed.pushes_promised);
+  EXPECT_EQ(stats.pushes_claimed, parsed.pushes_claimed);
+  EXPECT_EQ(stats.pushes_cancelled, parsed.pushes_cancelled);
+  EXPECT_EQ(stats.push_wasted_bytes, parsed.push_wasted_bytes);
+  EXPECT_EQ(stats.push_claim_latency_us, parsed.push_claim_latency_us);
+  EXPECT_EQ(stats.requests_coalesced, parsed.requests_coalesced);
+  EXPECT_EQ(stats.coalesced_bytes_saved, parsed.coalesced_bytes_saved);
+  EXPECT_TRUE(parsed.connected);
+  EXPECT_TRUE(parsed.handshake_confirmed);
+  EXPECT_FALSE(parsed.going_away);
+}
+
+TEST(QuicSessionStatsTest, ParseInvalid) {
+  std::string output;
+  SerializeQuicSessionStats(CreateStats(), &output);
+  QuicSessionStats parsed;
+
+  EXPECT_FALSE(ParseQuicSessionStats(
+      base::StringPiece(output).substr(0, output.size() - 1), &parsed));
+  EXPECT_FALSE(ParseQuicSessionStats(output + '\0', &parsed));
+
+  // Unknown version.
+  output[0] = 1;
+  EXPECT_FALSE(ParseQuicSessionStats(output, &parsed));
+}
+
+TEST(QuicSessionStatsTest, LineProtocol) {
+  std::string output;
+  AppendQuicSessionStatsLine(CreateStats(), "www.example.org", 443, &output);
+  EXPECT_EQ(
+      "quic_session,host=www.example.org,port=443 smoothed_rtt_us=25000i,"
+      "min_rtt_us=20000i,latest_rtt_us=31000i,congestion_window=14720i,"
+      "bytes_in_flight=2400i,packets_sent=100i,packets_received=90i,"
+      "packets_lost=3i,packets_retransmitted=4i,bytes_sent=120000i,"
+      "bytes_received=1099511627776i,bytes_retransmitted=4800i,"
+      "open_streams=2i,total_streams=7i,migrations=1i,"
+      "migration_failures=5i,receive_window=2097152i,"
+      "receive_window_increases=1i,stream_receive_window_increases=3i,"
+      "pushes_promised=4i,pushes_claimed=3i,pushes_cancelled=1i,"
+      "push_wasted_bytes=1350i,push_claim_latency_us=90000i,"
+      "requests_coalesced=6i,coalesced_bytes_saved=65536i,connected=t,"
+      "handshake_confirmed=t,going_away=f\n",
+      output);
+
+  // Lines are appended, and tag values are escaped.
+  AppendQuicSessionStatsLine(QuicSessionStats(), "a b,c=d", 80, &output);
+  EXPECT_EQ(0u, output.find("quic_session,host=www.example.org"));
+  EXPECT_NE(std::string::npos,
+            output.find("\nquic_session,host=a\\ b\\,c\\=d,port=80 "
+                        "smoothed_rtt_us=0i,"));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
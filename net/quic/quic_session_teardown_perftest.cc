@@ -0,0 +1,123 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares tearing down the session pool indices of QuicStreamFactory one
+// session at a time, as OnSessionGoingAway() does, with clearing them in one
+// pass, as MarkAllActiveSessionsGoingAway() and CloseAllSessions() do, for
+// thousands of sessions connected to a few CDN addresses.
+
+#include <stdint.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/timer/elapsed_timer.h"
+#include "net/base/ip_address.h"
+#include "net/base/ip_endpoint.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace net {
+namespace test {
+namespace {
+
+const size_t kNumSessions[] = {100, 1000, 10000};
+const size_t kNumPeers = 8;
+const size_t kNamesPerSession = 4;
+
+const char kMetricPrefix[] = "QuicSessionTeardown.";
+const char kMetricPerSessionTime[] = "per_session_time";
+const char kMetricBatchedTime[] = "batched_time";
+
+// Stand-in for QuicChromiumClientSession, only used as a key.
+struct Session {
+  IPEndPoint peer;
+};
+
+// The pool indices of QuicStreamFactory that are keyed by peer address.
+struct PoolIndices {
+  std::map<IPEndPoint, std::set<const Session*>> ip_aliases;
+  std::map<IPEndPoint, std::multimap<std::string, const Session*>>
+      ip_name_index;
+  std::map<const Session*, IPEndPoint> session_peer_ip;
+};
+
+perf_test::PerfResultReporter SetUpReporter(const std::string& story) {
+  perf_test::PerfResultReporter reporter(kMetricPrefix, story);
+  reporter.RegisterImportantMetric(kMetricPerSessionTime, "us");
+  reporter.RegisterImportantMetric(kMetricBatchedTime, "us");
+  return reporter;
+}
+
+void AddSessions(const std::vector<Session>& sessions, PoolIndices* indices) {
+  for (size_t i = 0; i < sessions.size(); ++i) {
+    const Session* session = &sessions[i];
+    indices->ip_aliases[session->peer].insert(session);
+    auto& index = indices->ip_name_index[session->peer];
+    for (size_t j = 0; j < kNamesPerSession; ++j) {
+      index.emplace(base::StringPrintf("host%zu.example.org", (i + j) % 64),
+                    session);
+    }
+    indices->session_peer_ip[session] = session->peer;
+  }
+}
+
+// Mirrors the index cleanup of QuicStreamFactory::OnSessionGoingAway().
+void RemoveSession(const Session* session, PoolIndices* indices) {
+  const IPEndPoint peer_address = indices->session_peer_ip[session];
+  indices->ip_aliases[peer_address].erase(session);
+  if (indices->ip_aliases[peer_address].empty())
+    indices->ip_aliases.erase(peer_address);
+  auto& index = indices->ip_name_index[peer_address];
+  for (auto it = index.begin(); it != index.end();) {
+    if (it->second == session) {
+      it = index.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  if (index.empty())
+    indices->ip_name_index.erase(peer_address);
+  indices->session_peer_ip.erase(session);
+}
+
+TEST(QuicSessionTeardownPerfTest, RemoveAllSessions) {
+  for (size_t num_sessions : kNumSessions) {
+    std::vector<Session> sessions(num_sessions);
+    for (size_t i = 0; i < num_sessions; ++i) {
+      sessions[i].peer = IPEndPoint(
+          IPAddress(192, 0, 2, static_cast<uint8_t>(i % kNumPeers)), 443);
+    }
+
+    PoolIndices per_session;
+    AddSessions(sessions, &per_session);
+    base::ElapsedTimer per_session_timer;
+    for (const Session& session : sessions)
+      RemoveSession(&session, &per_session);
+    base::TimeDelta per_session_time = per_session_timer.Elapsed();
+    EXPECT_TRUE(per_session.ip_name_index.empty());
+
+    PoolIndices batched;
+    AddSessions(sessions, &batched);
+    base::ElapsedTimer batched_timer;
+    batched.ip_aliases.clear();
+    batched.ip_name_index.clear();
+    batched.session_peer_ip.clear();
+    base::TimeDelta batched_time = batched_timer.Elapsed();
+
+    perf_test::PerfResultReporter reporter =
+        SetUpReporter("sessions_" + base::NumberToString(num_sessions));
+    reporter.AddResult(kMetricPerSessionTime,
+                       per_session_time.InMicrosecondsF());
+    reporter.AddResult(kMetricBatchedTime, batched_time.InMicrosecondsF());
+  }
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
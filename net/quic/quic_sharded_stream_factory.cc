@@ -0,0 +1,201 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_sharded_stream_factory.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "net/quic/quic_session_key_interner.h"
+
+namespace net {
+
+// A QuicStreamFactory, its dependencies, and the thread they run on.
+// Everything but thread() and task_runner() runs on that thread.
+class QuicShardedStreamFactory::Shard {
+ public:
+  Shard(QuicShardedStreamFactory* owner, size_t index)
+      : owner_(owner),
+        index_(index),
+        thread_("QuicStreamFactoryShard" + base::NumberToString(index)) {}
+
+  ~Shard() { DCHECK(!context_); }
+
+  base::Thread* thread() { return &thread_; }
+
+  // Set once the thread is started, so that it can be read from any thread
+  // afterwards, unlike base::Thread::task_runner().
+  const scoped_refptr<base::SingleThreadTaskRunner>& task_runner() const {
+    return task_runner_;
+  }
+  void set_task_runner(scoped_refptr<base::SingleThreadTaskRunner> runner) {
+    task_runner_ = std::move(runner);
+  }
+
+  void Start(base::WaitableEvent* started) {
+    context_ = owner_->shard_context_factory_.Run(index_);
+    context_->factory()->set_session_availability_callback(
+        base::BindRepeating(
+            &QuicShardedStreamFactory::OnSessionAvailabilityChanged,
+            base::Unretained(owner_), index_));
+    started->Signal();
+  }
+
+  void Stop() {
+    if (!context_)
+      return;
+    // Sessions closed as the factory is destroyed need not be reported.
+    context_->factory()->set_session_availability_callback(
+        QuicStreamFactory::SessionAvailabilityCallback());
+    context_.reset();
+  }
+
+  void RunWithFactory(FactoryCallback callback) {
+    if (context_)
+      std::move(callback).Run(context_->factory());
+  }
+
+ private:
+  QuicShardedStreamFactory* const owner_;
+  const size_t index_;
+  base::Thread thread_;
+  scoped_refptr<base::SingleThreadTaskRunner> task_runner_;
+  std::unique_ptr<ShardContext> context_;
+
+  DISALLOW_COPY_AND_ASSIGN(Shard);
+};
+
+QuicShardedStreamFactory::QuicShardedStreamFactory(
+    size_t num_shards,
+    ShardContextFactory shard_context_factory)
+    : shard_context_factory_(std::move(shard_context_factory)) {
+  DCHECK_GT(num_shards, 0u);
+  DCHECK_LE(num_shards, kQuicMaxStreamFactoryShards);
+  for (size_t i = 0; i < num_shards; ++i)
+    shards_.push_back(std::make_unique<Shard>(this, i));
+}
+
+QuicShardedStreamFactory::~QuicShardedStreamFactory() {
+  // Contexts are destroyed on their threads before any thread stops, so
+  // that tasks posted to a shard in the meantime find no factory rather than
+  // a dangling one.
+  for (const auto& shard : shards_) {
+    if (shard->thread()->IsRunning()) {
+      shard->thread()->task_runner()->PostTask(
+          FROM_HERE,
+          base::BindOnce(&Shard::Stop, base::Unretained(shard.get())));
+    }
+  }
+  for (const auto& shard : shards_)
+    shard->thread()->Stop();
+}
+
+bool QuicShardedStreamFactory::Start() {
+  for (const auto& shard : shards_) {
+    base::Thread::Options options;
+    options.message_pump_type = base::MessagePumpType::IO;
+    if (!shard->thread()->StartWithOptions(options))
+      return false;
+    shard->set_task_runner(shard->thread()->task_runner());
+
+    base::WaitableEvent started;
+    shard->task_runner()->PostTask(
+        FROM_HERE, base::BindOnce(&Shard::Start, base::Unretained(shard.get()),
+                                  &started));
+    started.Wait();
+  }
+  return true;
+}
+
+size_t QuicShardedStreamFactory::GetShardForRequest(
+    const QuicSessionKey& session_key,
+    const HostPortPair& destination) const {
+  {
+    base::AutoLock lock(lock_);
+    auto session_it = session_shards_.find(session_key);
+    if (session_it != session_shards_.end())
+      return session_it->second.back();
+
+    auto destination_it = destination_shards_.find(destination);
+    if (destination_it != destination_shards_.end()) {
+      // The shard with the most sessions to |destination| is the likeliest
+      // to have one the request can be pooled to.
+      size_t best_shard = 0;
+      size_t best_count = 0;
+      for (const auto& shard_and_count : destination_it->second) {
+        if (shard_and_count.second > best_count) {
+          best_shard = shard_and_count.first;
+          best_count = shard_and_count.second;
+        }
+      }
+      DCHECK_GT(best_count, 0u);
+      return best_shard;
+    }
+  }
+  return QuicSessionKeyInterner::KeyHash()(session_key) % shards_.size();
+}
+
+bool QuicShardedStreamFactory::HasAvailableSession(
+    const QuicSessionKey& session_key) const {
+  base::AutoLock lock(lock_);
+  return session_shards_.find(session_key) != session_shards_.end();
+}
+
+bool QuicShardedStreamFactory::PostToShard(size_t shard_index,
+                                           FactoryCallback callback) {
+  DCHECK_LT(shard_index, shards_.size());
+  Shard* shard = shards_[shard_index].get();
+  if (!shard->task_runner())
+    return false;
+  return shard->task_runner()->PostTask(
+      FROM_HERE, base::BindOnce(&Shard::RunWithFactory, base::Unretained(shard),
+                                std::move(callback)));
+}
+
+scoped_refptr<base::SingleThreadTaskRunner>
+QuicShardedStreamFactory::GetShardTaskRunner(size_t shard_index) const {
+  DCHECK_LT(shard_index, shards_.size());
+  return shards_[shard_index]->task_runner();
+}
+
+void QuicShardedStreamFactory::OnSessionAvailabilityChanged(
+    size_t shard_index,
+    const QuicStreamFactory::QuicSessionAliasKey& key,
+    bool available) {
+  base::AutoLock lock(lock_);
+  if (available) {
+    session_shards_[key.session_key()].push_back(shard_index);
+    ++destination_shards_[key.destination()][shard_index];
+    return;
+  }
+
+  // Another shard may still have a session for the key.
+  auto session_it = session_shards_.find(key.session_key());
+  DCHECK(session_it != session_shards_.end());
+  std::vector<size_t>& shards = session_it->second;
+  auto shard_it = std::find(shards.begin(), shards.end(), shard_index);
+  DCHECK(shard_it != shards.end());
+  shards.erase(shard_it);
+  if (shards.empty())
+    session_shards_.erase(session_it);
+
+  auto destination_it = destination_shards_.find(key.destination());
+  DCHECK(destination_it != destination_shards_.end());
+  std::map<size_t, size_t>& shard_counts = destination_it->second;
+  auto count_it = shard_counts.find(shard_index);
+  DCHECK(count_it != shard_counts.end());
+  if (--count_it->second == 0) {
+    shard_counts.erase(count_it);
+    if (shard_counts.empty())
+      destination_shards_.erase(destination_it);
+  }
+}
+
+}  // namespace net
@@ -0,0 +1,126 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_QUIC_SHARDED_STREAM_FACTORY_H_
+#define NET_QUIC_QUIC_SHARDED_STREAM_FACTORY_H_
+
+#include <stddef.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/scoped_refptr.h"
+#include "base/single_thread_task_runner.h"
+#include "base/synchronization/lock.h"
+#include "net/base/host_port_pair.h"
+#include "net/base/net_export.h"
+#include "net/quic/quic_session_key.h"
+#include "net/quic/quic_stream_factory.h"
+
+namespace net {
+
+namespace test {
+class QuicShardedStreamFactoryPeer;
+}  // namespace test
+
+// Upper bound on the number of shards of a QuicShardedStreamFactory.
+const size_t kQuicMaxStreamFactoryShards = 64;
+
+// Spreads QUIC sessions over several network threads. Each shard is a
+// QuicStreamFactory, along with everything it depends on, created and used
+// only on the shard's own IO thread. Since a QuicStreamFactory creates its
+// connection helper, alarm factory and socket readers on the thread it runs
+// on, shards share no QUIC state, and each can keep a core busy.
+//
+// Requests are routed to a shard by GetShardForRequest(), which may be called
+// from any thread, and then issued on that shard through PostToShard().
+// Requests go to a shard which already has a session they can use, or
+// failing that, to one picked by hashing the session key. Sessions are only
+// ever pooled within a shard.
+class NET_EXPORT_PRIVATE QuicShardedStreamFactory {
+ public:
+  // The QuicStreamFactory of a shard, and whatever it depends on (host
+  // resolver, cert verifier, QuicContext and so on). Created and destroyed on
+  // the shard's thread.
+  class ShardContext {
+   public:
+    virtual ~ShardContext() {}
+
+    virtual QuicStreamFactory* factory() = 0;
+  };
+
+  // Creates the context of shard |shard_index|. Run on the shard's thread.
+  using ShardContextFactory =
+      base::RepeatingCallback<std::unique_ptr<ShardContext>(
+          size_t shard_index)>;
+
+  // Runs on a shard's thread, with the shard's factory.
+  using FactoryCallback = base::OnceCallback<void(QuicStreamFactory* factory)>;
+
+  QuicShardedStreamFactory(size_t num_shards,
+                           ShardContextFactory shard_context_factory);
+  // Destroys each shard's context on its thread, then stops the threads.
+  ~QuicShardedStreamFactory();
+
+  // Starts the thread of every shard and creates its context. Returns once
+  // all shards are ready, or false if a thread could not be started.
+  bool Start();
+
+  size_t num_shards() const { return shards_.size(); }
+
+  // Returns the shard requests for |session_key| to |destination| should be
+  // issued on. Thread-safe.
+  size_t GetShardForRequest(const QuicSessionKey& session_key,
+                            const HostPortPair& destination) const;
+
+  // Returns true if a shard has a session that can be used by requests for
+  // |session_key|. Thread-safe.
+  bool HasAvailableSession(const QuicSessionKey& session_key) const;
+
+  // Runs |callback| on the thread of shard |shard_index|. |callback| is
+  // dropped if the shard is stopped before it runs. Thread-safe.
+  bool PostToShard(size_t shard_index, FactoryCallback callback);
+
+  // Returns the task runner of shard |shard_index|'s thread, or null if the
+  // shard is not running. Thread-safe.
+  scoped_refptr<base::SingleThreadTaskRunner> GetShardTaskRunner(
+      size_t shard_index) const;
+
+ private:
+  friend class test::QuicShardedStreamFactoryPeer;
+  class Shard;
+
+  // Called on the thread of shard |shard_index| when a session for |key|
+  // becomes available, or stops being available.
+  void OnSessionAvailabilityChanged(
+      size_t shard_index,
+      const QuicStreamFactory::QuicSessionAliasKey& key,
+      bool available);
+
+  ShardContextFactory shard_context_factory_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // Guards the members below, which are written from shard threads and read
+  // from any thread.
+  mutable base::Lock lock_;
+
+  // The shards with a session available for each session key, least recent
+  // first. Requests go to the most recent one.
+  std::map<QuicSessionKey, std::vector<size_t>> session_shards_;
+
+  // For each destination, the number of session keys with a session
+  // available on each shard. Requests to the same destination are likely to
+  // resolve to the same server, so they are kept on a shard where IP-based
+  // pooling may let them share a session.
+  std::map<HostPortPair, std::map<size_t, size_t>> destination_shards_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicShardedStreamFactory);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_SHARDED_STREAM_FACTORY_H_
@@ -0,0 +1,219 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_sharded_stream_factory.h"
+
+#include <set>
+#include <string>
+
+#include "base/bind.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
+#include "net/base/network_isolation_key.h"
+#include "net/base/privacy_mode.h"
+#include "net/cert/ct_policy_enforcer.h"
+#include "net/cert/do_nothing_ct_verifier.h"
+#include "net/cert/mock_cert_verifier.h"
+#include "net/dns/mock_host_resolver.h"
+#include "net/http/http_server_properties.h"
+#include "net/http/transport_security_state.h"
+#include "net/quic/mock_crypto_client_stream_factory.h"
+#include "net/quic/quic_context.h"
+#include "net/socket/socket_tag.h"
+#include "net/socket/socket_test_util.h"
+#include "net/ssl/ssl_config_service_defaults.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+
+class QuicShardedStreamFactoryPeer {
+ public:
+  static void SetSessionAvailable(QuicShardedStreamFactory* factory,
+                                  size_t shard_index,
+                                  const HostPortPair& destination,
+                                  const QuicSessionKey& session_key,
+                                  bool available) {
+    factory->OnSessionAvailabilityChanged(
+        shard_index,
+        QuicStreamFactory::QuicSessionAliasKey(destination, session_key),
+        available);
+  }
+};
+
+namespace {
+
+const size_t kNumShards = 4;
+
+// A QuicStreamFactory with mock dependencies.
+class TestShardContext : public QuicShardedStreamFactory::ShardContext {
+ public:
+  TestShardContext()
+      : factory_(/*net_log=*/nullptr,
+                 &host_resolver_,
+                 &ssl_config_service_,
+                 &socket_factory_,
+                 &http_server_properties_,
+                 &cert_verifier_,
+                 &ct_policy_enforcer_,
+                 &transport_security_state_,
+                 &ct_verifier_,
+                 /*socket_performance_watcher_factory=*/nullptr,
+                 &crypto_client_stream_factory_,
+                 &quic_context_) {}
+
+  QuicStreamFactory* factory() override { return &factory_; }
+
+ private:
+  MockHostResolver host_resolver_;
+  SSLConfigServiceDefaults ssl_config_service_;
+  MockClientSocketFactory socket_factory_;
+  HttpServerProperties http_server_properties_;
+  MockCertVerifier cert_verifier_;
+  DefaultCTPolicyEnforcer ct_policy_enforcer_;
+  TransportSecurityState transport_security_state_;
+  DoNothingCTVerifier ct_verifier_;
+  MockCryptoClientStreamFactory crypto_client_stream_factory_;
+  QuicContext quic_context_;
+  QuicStreamFactory factory_;
+};
+
+std::unique_ptr<QuicShardedStreamFactory::ShardContext> CreateShardContext(
+    size_t shard_index) {
+  return std::make_unique<TestShardContext>();
+}
+
+QuicSessionKey CreateSessionKey(const std::string& host) {
+  return QuicSessionKey(host, 443, PRIVACY_MODE_DISABLED, SocketTag(),
+                        NetworkIsolationKey(), /*disable_secure_dns=*/false);
+}
+
+class QuicShardedStreamFactoryTest : public ::testing::Test {
+ protected:
+  QuicShardedStreamFactoryTest()
+      : factory_(kNumShards, base::BindRepeating(&CreateShardContext)) {}
+
+  // Runs a task on shard |shard_index| and waits for it, returning the
+  // shard's factory and the thread the task ran on.
+  void RunOnShard(size_t shard_index,
+                  QuicStreamFactory** shard_factory,
+                  base::PlatformThreadId* thread_id) {
+    base::WaitableEvent done;
+    ASSERT_TRUE(factory_.PostToShard(
+        shard_index,
+        base::BindOnce(
+            [](QuicStreamFactory** shard_factory,
+               base::PlatformThreadId* thread_id, base::WaitableEvent* done,
+               QuicStreamFactory* factory) {
+              *shard_factory = factory;
+              *thread_id = base::PlatformThread::CurrentId();
+              done->Signal();
+            },
+            shard_factory, thread_id, &done)));
+    done.Wait();
+  }
+
+  QuicShardedStreamFactory factory_;
+};
+
+TEST_F(QuicShardedStreamFactoryTest, ShardsRunOnTheirOwnThreads) {
+  EXPECT_FALSE(factory_.GetShardTaskRunner(0));
+  ASSERT_TRUE(factory_.Start());
+  EXPECT_EQ(kNumShards, factory_.num_shards());
+
+  std::set<QuicStreamFactory*> shard_factories;
+  std::set<base::PlatformThreadId> thread_ids;
+  for (size_t i = 0; i < kNumShards; ++i) {
+    EXPECT_TRUE(factory_.GetShardTaskRunner(i));
+    QuicStreamFactory* shard_factory = nullptr;
+    base::PlatformThreadId thread_id = base::kInvalidThreadId;
+    RunOnShard(i, &shard_factory, &thread_id);
+    ASSERT_TRUE(shard_factory);
+    EXPECT_NE(base::PlatformThread::CurrentId(), thread_id);
+    shard_factories.insert(shard_factory);
+    thread_ids.insert(thread_id);
+  }
+  EXPECT_EQ(kNumShards, shard_factories.size());
+  EXPECT_EQ(kNumShards, thread_ids.size());
+}
+
+TEST_F(QuicShardedStreamFactoryTest, SpreadsSessionKeys) {
+  ASSERT_TRUE(factory_.Start());
+  std::set<size_t> shards;
+  for (int i = 0; i < 64; ++i) {
+    const QuicSessionKey session_key =
+        CreateSessionKey("www" + base::NumberToString(i) + ".example.org");
+    const HostPortPair destination(session_key.server_id().host(), 443);
+    const size_t shard = factory_.GetShardForRequest(session_key, destination);
+    ASSERT_LT(shard, kNumShards);
+    // Routing is stable.
+    EXPECT_EQ(shard, factory_.GetShardForRequest(session_key, destination));
+    shards.insert(shard);
+  }
+  EXPECT_LT(1u, shards.size());
+}
+
+TEST_F(QuicShardedStreamFactoryTest, RoutesToShardWithAvailableSession) {
+  ASSERT_TRUE(factory_.Start());
+  const QuicSessionKey session_key = CreateSessionKey("www.example.org");
+  const QuicSessionKey other_session_key =
+      CreateSessionKey("mail.example.org");
+  const HostPortPair destination("cdn.example.org", 443);
+  const size_t hashed_shard =
+      factory_.GetShardForRequest(session_key, destination);
+  const size_t session_shard = (hashed_shard + 1) % kNumShards;
+  EXPECT_FALSE(factory_.HasAvailableSession(session_key));
+
+  QuicShardedStreamFactoryPeer::SetSessionAvailable(
+      &factory_, session_shard, destination, session_key, true);
+  EXPECT_TRUE(factory_.HasAvailableSession(session_key));
+  EXPECT_EQ(session_shard,
+            factory_.GetShardForRequest(session_key, destination));
+  // Requests for other origins served by the same destination go to the same
+  // shard, where they may be pooled.
+  EXPECT_FALSE(factory_.HasAvailableSession(other_session_key));
+  EXPECT_EQ(session_shard,
+            factory_.GetShardForRequest(other_session_key, destination));
+
+  QuicShardedStreamFactoryPeer::SetSessionAvailable(
+      &factory_, session_shard, destination, session_key, false);
+  EXPECT_FALSE(factory_.HasAvailableSession(session_key));
+  EXPECT_EQ(hashed_shard,
+            factory_.GetShardForRequest(session_key, destination));
+}
+
+TEST_F(QuicShardedStreamFactoryTest, SessionOnTwoShards) {
+  ASSERT_TRUE(factory_.Start());
+  const QuicSessionKey session_key = CreateSessionKey("www.example.org");
+  const HostPortPair destination("www.example.org", 443);
+  const size_t hashed_shard =
+      factory_.GetShardForRequest(session_key, destination);
+  const size_t first_shard = (hashed_shard + 1) % kNumShards;
+  const size_t second_shard = (hashed_shard + 2) % kNumShards;
+
+  QuicShardedStreamFactoryPeer::SetSessionAvailable(
+      &factory_, first_shard, destination, session_key, true);
+  QuicShardedStreamFactoryPeer::SetSessionAvailable(
+      &factory_, second_shard, destination, session_key, true);
+  EXPECT_EQ(second_shard,
+            factory_.GetShardForRequest(session_key, destination));
+
+  // The session of the other shard remains available.
+  QuicShardedStreamFactoryPeer::SetSessionAvailable(
+      &factory_, second_shard, destination, session_key, false);
+  EXPECT_TRUE(factory_.HasAvailableSession(session_key));
+  EXPECT_EQ(first_shard,
+            factory_.GetShardForRequest(session_key, destination));
+
+  QuicShardedStreamFactoryPeer::SetSessionAvailable(
+      &factory_, first_shard, destination, session_key, false);
+  EXPECT_FALSE(factory_.HasAvailableSession(session_key));
+  EXPECT_EQ(hashed_shard,
+            factory_.GetShardForRequest(session_key, destination));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -15,6 +15,7 @@
 #include "base/metrics/field_trial.h"
 #include "base/metrics/histogram_functions.h"
 #include "base/metrics/histogram_macros.h"
+#include "base/metrics/sparse_histogram.h"
 #include "base/single_thread_task_runner.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/string_util.h"
@@ -41,13 +42,16 @@
 #include "net/quic/address_utils.h"
 #include "net/quic/crypto/proof_verifier_chromium.h"
 #include "net/quic/properties_based_quic_server_info.h"
+#include "net/quic/quic_ack_frequency_policy.h"
 #include "net/quic/quic_chromium_alarm_factory.h"
 #include "net/quic/quic_chromium_connection_helper.h"
 #include "net/quic/quic_chromium_packet_reader.h"
 #include "net/quic/quic_chromium_packet_writer.h"
+#include "net/quic/quic_client_session_cache.h"
 #include "net/quic/quic_context.h"
 #include "net/quic/quic_crypto_client_stream_factory.h"
 #include "net/quic/quic_http_stream.h"
+#include "net/quic/quic_pooling_descriptor.h"
 #include "net/quic/quic_server_info.h"
 #include "net/socket/client_socket_factory.h"
 #include "net/socket/next_proto.h"
@@ -300,10 +304,13 @@ class QuicStreamFactory::CertVerifierJob {
 // into an MRU cache.
 class QuicStreamFactory::QuicCryptoClientConfigOwner {
  public:
+  // |session_cache| may be null, in which case TLS handshakes cannot resume
+  // sessions.
   QuicCryptoClientConfigOwner(
       std::unique_ptr<quic::ProofVerifier> proof_verifier,
+      std::unique_ptr<QuicClientSessionCache> session_cache,
       QuicStreamFactory* quic_stream_factory)
-      : config_(std::move(proof_verifier)),
+      : config_(std::move(proof_verifier), std::move(session_cache)),
         quic_stream_factory_(quic_stream_factory) {
     DCHECK(quic_stream_factory_);
   }
@@ -312,6 +319,12 @@ class QuicStreamFactory::QuicCryptoClientConfigOwner {
 
   quic::QuicCryptoClientConfig* config() { return &config_; }
 
+  // Caches the TLS sessions of |config_|, which only QUIC crypto handshakes
+  // keep in its cached states. May be null.
+  QuicClientSessionCache* session_cache() {
+    return static_cast<QuicClientSessionCache*>(config_.session_cache());
+  }
+
   int num_refs() const { return num_refs_; }
 
   QuicStreamFactory* quic_stream_factory() { return quic_stream_factory_; }
@@ -409,6 +422,13 @@ class QuicStreamFactory::Job {
 
   const QuicSessionAliasKey& key() const { return key_; }
 
+  // The interned ID of key().session_key(), set by the factory before any
+  // request is added.
+  QuicSessionKeyId session_key_id() const { return session_key_id_; }
+  void set_session_key_id(QuicSessionKeyId session_key_id) {
+    session_key_id_ = session_key_id;
+  }
+
   const NetLogWithSource& net_log() const { return net_log_; }
 
   base::WeakPtr<Job> GetWeakPtr() { return weak_factory_.GetWeakPtr(); }
@@ -420,6 +440,7 @@ class QuicStreamFactory::Job {
 
   void AddRequest(QuicStreamRequest* request) {
     stream_requests_.insert(request);
+    request->set_session_key_id(session_key_id_);
     if (!host_resolution_finished_) {
       request->ExpectOnHostResolution();
     }
@@ -524,6 +545,7 @@ class QuicStreamFactory::Job {
   quic::ParsedQuicVersion quic_version_;
   HostResolver* host_resolver_;
   const QuicSessionAliasKey key_;
+  QuicSessionKeyId session_key_id_;
   const std::unique_ptr<CryptoClientConfigHandle> client_config_handle_;
   RequestPriority priority_;
   const int cert_verify_flags_;
@@ -569,6 +591,7 @@ QuicStreamFactory::Job::Job(
       quic_version_(quic_version),
       host_resolver_(host_resolver),
       key_(key),
+      session_key_id_(kInvalidQuicSessionKeyId),
       client_config_handle_(std::move(client_config_handle)),
       priority_(priority),
       cert_verify_flags_(cert_verify_flags),
@@ -1015,7 +1038,9 @@ int QuicStreamFactory::Job::DoConfirmConnection(int rv) {
 }
 
 QuicStreamRequest::QuicStreamRequest(QuicStreamFactory* factory)
-    : factory_(factory), expect_on_host_resolution_(false) {}
+    : factory_(factory),
+      session_key_id_(kInvalidQuicSessionKeyId),
+      expect_on_host_resolution_(false) {}
 
 QuicStreamRequest::~QuicStreamRequest() {
   if (factory_ && !callback_.is_null())
@@ -1045,9 +1070,12 @@ int QuicStreamRequest::Request(
   net_error_details_ = net_error_details;
   failed_on_default_network_callback_ =
       std::move(failed_on_default_network_callback);
-  session_key_ =
-      QuicSessionKey(HostPortPair::FromURL(url), privacy_mode, socket_tag,
-                     network_isolation_key, disable_secure_dns);
+  const HostPortPair host_port_pair = HostPortPair::FromURL(url);
+  session_key_ = QuicSessionKey::CreateWithPartitioning(
+      quic::QuicServerId(host_port_pair.host(), host_port_pair.port(),
+                         privacy_mode == PRIVACY_MODE_ENABLED),
+      socket_tag, network_isolation_key, disable_secure_dns,
+      factory_->partition_connections_by_network_isolation_key());
 
   int rv = factory_->Create(session_key_, destination, quic_version, priority,
                             cert_verify_flags, url, net_log, this);
@@ -1171,6 +1199,7 @@ QuicStreamFactory::QuicStreamFactory(
       params_(*quic_context->params()),
       clock_skew_detector_(base::TimeTicks::Now(), base::Time::Now()),
       socket_performance_watcher_factory_(socket_performance_watcher_factory),
+      next_session_use_(0),
       recent_crypto_config_map_(kMaxRecentCryptoConfigs),
       config_(InitializeQuicConfig(*quic_context->params())),
       ping_timeout_(quic::QuicTime::Delta::FromSeconds(quic::kPingTimeoutSecs)),
@@ -1185,16 +1214,29 @@ QuicStreamFactory::QuicStreamFactory(
       default_network_(NetworkChangeNotifier::kInvalidNetworkHandle),
       need_to_check_persisted_supports_quic_(true),
       prefer_aes_gcm_recorded_(false),
+      path_mtu_cache_(kMaxPathMtuCacheEntries),
       num_push_streams_created_(0),
       tick_clock_(nullptr),
       task_runner_(nullptr),
       ssl_config_service_(ssl_config_service),
       use_network_isolation_key_for_crypto_configs_(
           base::FeatureList::IsEnabled(
-              features::kPartitionHttpServerPropertiesByNetworkIsolationKey)) {
+              features::kPartitionHttpServerPropertiesByNetworkIsolationKey)),
+      partition_connections_by_network_isolation_key_(
+          base::FeatureList::IsEnabled(
+              features::kPartitionConnectionsByNetworkIsolationKey)) {
   DCHECK(transport_security_state_);
   DCHECK(http_server_properties_);
   InitializeMigrationOptions();
+  if (params_.auto_tune_receive_windows) {
+    receive_window_budget_ = std::make_unique<QuicReceiveWindowBudget>(
+        params_.receive_window_memory_budget);
+  }
+  if (params_.session_memory_budget > 0) {
+    memory_pressure_listener_ =
+        std::make_unique<base::MemoryPressureListener>(base::BindRepeating(
+            &QuicStreamFactory::OnMemoryPressure, base::Unretained(this)));
+  }
 }
 
 QuicStreamFactory::~QuicStreamFactory() {
@@ -1229,7 +1271,7 @@ bool QuicStreamFactory::CanUseExistingSession(const QuicSessionKey& session_key,
   if (active_sessions_.empty())
     return false;
 
-  if (base::Contains(active_sessions_, session_key))
+  if (base::Contains(active_sessions_, session_key_interner_.Find(session_key)))
     return true;
 
   for (const auto& key_value : active_sessions_) {
@@ -1270,6 +1312,7 @@ int QuicStreamFactory::Create(const QuicSessionKey& session_key,
     DCHECK(session);
     if (session->server_id().privacy_mode_enabled() ==
         session_key.server_id().privacy_mode_enabled()) {
+      MarkSessionUsed(session);
       request->SetSession(session->CreateHandle(destination));
       ++num_push_streams_created_;
       return OK;
@@ -1280,19 +1323,25 @@ int QuicStreamFactory::Create(const QuicSessionKey& session_key,
     promised->Cancel();
   }
 
+  // Keys of active sessions and jobs are interned, so an unknown key has
+  // neither.
+  const QuicSessionKeyId session_key_id =
+      session_key_interner_.Find(session_key);
+
   // Use active session for |session_key| if such exists.
   // TODO(rtenneti): crbug.com/498823 - delete active_sessions_.empty() checks.
   if (!active_sessions_.empty()) {
-    auto it = active_sessions_.find(session_key);
+    auto it = active_sessions_.find(session_key_id);
     if (it != active_sessions_.end()) {
       QuicChromiumClientSession* session = it->second;
+      MarkSessionUsed(session);
       request->SetSession(session->CreateHandle(destination));
       return OK;
     }
   }
 
   // Associate with active job to |session_key| if such exists.
-  auto it = active_jobs_.find(session_key);
+  auto it = active_jobs_.find(session_key_id);
   if (it != active_jobs_.end()) {
     const NetLogWithSource& job_net_log = it->second->net_log();
     job_net_log.AddEventReferencingSource(
@@ -1317,6 +1366,7 @@ int QuicStreamFactory::Create(const QuicSessionKey& session_key,
                            session_key.socket_tag(),
                            session_key.network_isolation_key(),
                            session_key.disable_secure_dns())) {
+        MarkSessionUsed(session);
         request->SetSession(session->CreateHandle(destination));
         return OK;
       }
@@ -1347,8 +1397,11 @@ int QuicStreamFactory::Create(const QuicSessionKey& session_key,
   int rv = job->Run(base::BindOnce(&QuicStreamFactory::OnJobComplete,
                                    base::Unretained(this), job.get()));
   if (rv == ERR_IO_PENDING) {
+    const QuicSessionKeyId job_key_id =
+        session_key_interner_.Intern(session_key);
+    job->set_session_key_id(job_key_id);
     job->AddRequest(request);
-    active_jobs_[session_key] = std::move(job);
+    active_jobs_[job_key_id] = std::move(job);
     return rv;
   }
   if (rv == OK) {
@@ -1356,29 +1409,34 @@ int QuicStreamFactory::Create(const QuicSessionKey& session_key,
     // related changes.
     if (active_sessions_.empty())
       return ERR_QUIC_PROTOCOL_ERROR;
-    auto it = active_sessions_.find(session_key);
+    auto it = active_sessions_.find(session_key_interner_.Find(session_key));
     DCHECK(it != active_sessions_.end());
     if (it == active_sessions_.end())
       return ERR_QUIC_PROTOCOL_ERROR;
     QuicChromiumClientSession* session = it->second;
+    MarkSessionUsed(session);
     request->SetSession(session->CreateHandle(destination));
   }
   return rv;
 }
 
 void QuicStreamFactory::OnSessionGoingAway(QuicChromiumClientSession* session) {
-  const AliasSet& aliases = session_aliases_[session];
+  const AliasIdMap& aliases = session_aliases_[session];
   for (auto it = aliases.begin(); it != aliases.end(); ++it) {
-    const QuicSessionKey& session_key = it->session_key();
-    DCHECK(active_sessions_.count(session_key));
-    DCHECK_EQ(session, active_sessions_[session_key]);
+    const QuicSessionAliasKey& alias = it->first;
+    const QuicSessionKeyId session_key_id = it->second;
+    DCHECK(active_sessions_.count(session_key_id));
+    DCHECK_EQ(session, active_sessions_[session_key_id]);
     // Track sessions which have recently gone away so that we can disable
     // port suggestions.
     if (session->goaway_received())
-      gone_away_aliases_.insert(*it);
+      gone_away_aliases_.insert(alias);
 
-    active_sessions_.erase(session_key);
-    ProcessGoingAwaySession(session, session_key.server_id(), true);
+    active_sessions_.erase(session_key_id);
+    session_key_interner_.Release(session_key_id);
+    ProcessGoingAwaySession(session, alias.server_id(), true);
+    if (session_availability_callback_)
+      session_availability_callback_.Run(alias, /*available=*/false);
   }
   ProcessGoingAwaySession(session, all_sessions_[session].server_id(), false);
   if (!aliases.empty()) {
@@ -1387,6 +1445,15 @@ void QuicStreamFactory::OnSessionGoingAway(QuicChromiumClientSession* session) {
     ip_aliases_[peer_address].erase(session);
     if (ip_aliases_[peer_address].empty())
       ip_aliases_.erase(peer_address);
+    auto index_it = ip_name_index_.find(peer_address);
+    DCHECK(index_it != ip_name_index_.end());
+    for (SessionNameIndex::iterator entry :
+         session_name_index_entries_[session]) {
+      index_it->second.erase(entry);
+    }
+    if (index_it->second.empty())
+      ip_name_index_.erase(index_it);
+    session_name_index_entries_.erase(session);
     session_peer_ip_.erase(session);
   }
   session_aliases_.erase(session);
@@ -1395,11 +1462,15 @@ void QuicStreamFactory::OnSessionGoingAway(QuicChromiumClientSession* session) {
 void QuicStreamFactory::OnSessionClosed(QuicChromiumClientSession* session) {
   DCHECK_EQ(0u, session->GetNumActiveStreams());
   OnSessionGoingAway(session);
+  session_last_used_.erase(session);
 
-  for (const auto& iter : active_jobs_) {
-    if (iter.first == session->quic_session_key()) {
-      iter.second->OnSessionClosed(session);
-    }
+  // Only a job still connecting holds on to |session|, so there is no key to
+  // look up once all jobs are done.
+  if (!active_jobs_.empty()) {
+    auto job_iter = active_jobs_.find(
+        session_key_interner_.Find(session->quic_session_key()));
+    if (job_iter != active_jobs_.end())
+      job_iter->second->OnSessionClosed(session);
   }
   delete session;
   all_sessions_.erase(session);
@@ -1413,14 +1484,14 @@ void QuicStreamFactory::OnBlackholeAfterHandshakeConfirmed(
 }
 
 void QuicStreamFactory::CancelRequest(QuicStreamRequest* request) {
-  auto job_iter = active_jobs_.find(request->session_key());
+  auto job_iter = active_jobs_.find(request->session_key_id());
   CHECK(job_iter != active_jobs_.end());
   job_iter->second->RemoveRequest(request);
 }
 
 void QuicStreamFactory::SetRequestPriority(QuicStreamRequest* request,
                                            RequestPriority priority) {
-  auto job_iter = active_jobs_.find(request->session_key());
+  auto job_iter = active_jobs_.find(request->session_key_id());
   if (job_iter == active_jobs_.end())
     return;
   job_iter->second->SetPriority(priority);
@@ -1429,21 +1500,26 @@ void QuicStreamFactory::SetRequestPriority(QuicStreamRequest* request,
 void QuicStreamFactory::CloseAllSessions(int error,
                                          quic::QuicErrorCode quic_error) {
   base::UmaHistogramSparse("Net.QuicSession.CloseAllSessionsError", -error);
-  while (!active_sessions_.empty()) {
-    size_t initial_size = active_sessions_.size();
-    active_sessions_.begin()->second->CloseSessionOnError(
-        error, quic_error,
-        quic::ConnectionCloseBehavior::SEND_CONNECTION_CLOSE_PACKET);
-    DCHECK_NE(initial_size, active_sessions_.size());
-  }
+  // Takes all sessions out of the pool in one pass, so that each session
+  // finds nothing left to unregister when it notifies the factory that it
+  // closed.
+  RemoveAllActiveSessions();
+  int num_closed = 0;
   while (!all_sessions_.empty()) {
     size_t initial_size = all_sessions_.size();
-    all_sessions_.begin()->first->CloseSessionOnError(
+    all_sessions_.begin()->first->CloseSessionOnErrorInBatch(
         error, quic_error,
         quic::ConnectionCloseBehavior::SEND_CONNECTION_CLOSE_PACKET);
+    ++num_closed;
     DCHECK_NE(initial_size, all_sessions_.size());
   }
   DCHECK(all_sessions_.empty());
+  if (num_closed > 0) {
+    base::SparseHistogram::FactoryGet(
+        "Net.QuicSession.CloseSessionOnError",
+        base::HistogramBase::kUmaTargetedHistogramFlag)
+        ->AddCount(-error, num_closed);
+  }
 }
 
 std::unique_ptr<base::Value> QuicStreamFactory::QuicStreamFactoryInfoToValue()
@@ -1451,16 +1527,17 @@ std::unique_ptr<base::Value> QuicStreamFactory::QuicStreamFactoryInfoToValue()
   std::unique_ptr<base::ListValue> list(new base::ListValue());
 
   for (auto it = active_sessions_.begin(); it != active_sessions_.end(); ++it) {
-    const quic::QuicServerId& server_id = it->first.server_id();
+    const quic::QuicServerId& server_id =
+        session_key_interner_.GetKey(it->first).server_id();
     QuicChromiumClientSession* session = it->second;
-    const AliasSet& aliases = session_aliases_.find(session)->second;
+    const AliasIdMap& aliases = session_aliases_.find(session)->second;
     // Only add a session to the list once.
-    if (server_id == aliases.begin()->server_id()) {
+    if (server_id == aliases.begin()->first.server_id()) {
       std::set<HostPortPair> hosts;
       for (auto alias_it = aliases.begin(); alias_it != aliases.end();
            ++alias_it) {
-        hosts.insert(HostPortPair(alias_it->server_id().host(),
-                                  alias_it->server_id().port()));
+        hosts.insert(HostPortPair(alias_it->first.server_id().host(),
+                                  alias_it->first.server_id().port()));
       }
       list->Append(session->GetInfoAsValue(hosts));
     }
@@ -1468,6 +1545,22 @@ std::unique_ptr<base::Value> QuicStreamFactory::QuicStreamFactoryInfoToValue()
   return std::move(list);
 }
 
+void QuicStreamFactory::ForEachSessionStats(
+    const SessionStatsCallback& callback) {
+  QuicSessionStats stats;
+  for (const auto& session_and_key : all_sessions_) {
+    session_and_key.first->GetStatsSnapshot(&stats);
+    callback.Run(session_and_key.second.session_key(), stats);
+  }
+}
+
+size_t QuicStreamFactory::EstimateSessionMemoryUsage() const {
+  size_t memory_usage = 0;
+  for (const auto& session_and_key : all_sessions_)
+    memory_usage += session_and_key.first->EstimateMemoryUsage();
+  return memory_usage;
+}
+
 void QuicStreamFactory::ClearCachedStatesInCryptoConfig(
     const base::RepeatingCallback<bool(const GURL&)>& origin_filter) {
   ServerIdOriginFilter filter(origin_filter);
@@ -1571,6 +1664,7 @@ void QuicStreamFactory::OnIPAddressChanged() {
     return;
 
   set_is_quic_known_to_work_on_current_network(false);
+  path_mtu_cache_.Clear();
   if (params_.close_sessions_on_ip_change) {
     CloseAllSessions(ERR_NETWORK_CHANGED, quic::QUIC_IP_ADDRESS_CHANGED);
   } else {
@@ -1608,6 +1702,7 @@ void QuicStreamFactory::OnNetworkDisconnected(NetworkHandle network) {
         NetLogEventType::QUIC_CONNECTION_MIGRATION_PLATFORM_NOTIFICATION,
         "signal", "OnNetworkDisconnected");
   }
+  path_mtu_cache_.OnNetworkDisconnected(network);
   // Broadcast network disconnected to all sessions.
   // If migration is not turned on, session will not migrate but collect data.
   auto it = all_sessions_.begin();
@@ -1656,6 +1751,36 @@ void QuicStreamFactory::OnNetworkMadeDefault(NetworkHandle network) {
   set_is_quic_known_to_work_on_current_network(false);
 }
 
+quic::QuicByteCount QuicStreamFactory::GetPathMtuDiscoveryTarget(
+    NetworkHandle network,
+    const IPEndPoint& peer_address) {
+  if (!params_.enable_path_mtu_discovery)
+    return 0;
+  quic::QuicByteCount cached_mtu =
+      path_mtu_cache_.Lookup(network, peer_address);
+  // Probing straight for a previously validated size converges with a single
+  // probe; if that probe is lost the session stays at its base packet size.
+  if (cached_mtu > 0)
+    return cached_mtu;
+  return quic::kMtuDiscoveryTargetPacketSizeHigh;
+}
+
+void QuicStreamFactory::OnPathMtuValidated(NetworkHandle network,
+                                           const IPEndPoint& peer_address,
+                                           quic::QuicByteCount mtu) {
+  if (!params_.enable_path_mtu_discovery)
+    return;
+  path_mtu_cache_.OnMtuValidated(network, peer_address, mtu);
+}
+
+void QuicStreamFactory::OnPathMtuExceeded(NetworkHandle network,
+                                          const IPEndPoint& peer_address,
+                                          quic::QuicByteCount size) {
+  if (!params_.enable_path_mtu_discovery)
+    return;
+  path_mtu_cache_.OnPacketTooBig(network, peer_address, size);
+}
+
 void QuicStreamFactory::OnCertDBChanged() {
   // We should flush the sessions if we removed trust from a
   // cert, because a previously trusted server may have become
@@ -1727,11 +1852,14 @@ void QuicStreamFactory::DumpMemoryStats(
   base::trace_event::MemoryAllocatorDump* factory_dump =
       pmd->CreateAllocatorDump(parent_absolute_name + "/quic_stream_factory");
   size_t memory_estimate =
+      session_key_interner_.EstimateMemoryUsage() +
       base::trace_event::EstimateMemoryUsage(all_sessions_) +
       base::trace_event::EstimateMemoryUsage(active_sessions_) +
       base::trace_event::EstimateMemoryUsage(session_aliases_) +
       base::trace_event::EstimateMemoryUsage(ip_aliases_) +
+      base::trace_event::EstimateMemoryUsage(ip_name_index_) +
       base::trace_event::EstimateMemoryUsage(session_peer_ip_) +
+      base::trace_event::EstimateMemoryUsage(session_name_index_entries_) +
       base::trace_event::EstimateMemoryUsage(gone_away_aliases_) +
       base::trace_event::EstimateMemoryUsage(active_jobs_) +
       base::trace_event::EstimateMemoryUsage(active_cert_verifier_jobs_);
@@ -1757,31 +1885,60 @@ bool QuicStreamFactory::HasMatchingIpSession(const QuicSessionAliasKey& key,
     if (!base::Contains(ip_aliases_, address))
       continue;
 
-    const SessionSet& sessions = ip_aliases_[address];
-    for (QuicChromiumClientSession* session : sessions) {
+    for (QuicChromiumClientSession* session :
+         GetPoolingCandidates(address, server_id.host())) {
       if (!session->CanPool(server_id.host(), key.session_key().privacy_mode(),
                             key.session_key().socket_tag(),
                             key.session_key().network_isolation_key(),
                             key.session_key().disable_secure_dns())) {
         continue;
       }
-      active_sessions_[key.session_key()] = session;
-      session_aliases_[session].insert(key);
+      AddAlias(key, session);
       return true;
     }
   }
   return false;
 }
 
+std::vector<QuicChromiumClientSession*> QuicStreamFactory::GetPoolingCandidates(
+    const IPEndPoint& address,
+    const std::string& hostname) {
+  std::vector<std::string> names;
+  QuicPoolingDescriptor::GetCoveringNames(hostname, &names);
+  if (names.empty()) {
+    // IP literals are only covered by IP address SANs, which are not indexed.
+    const SessionSet& sessions = ip_aliases_[address];
+    return std::vector<QuicChromiumClientSession*>(sessions.begin(),
+                                                   sessions.end());
+  }
+  names.push_back(std::string());
+
+  std::vector<QuicChromiumClientSession*> candidates;
+  auto index_it = ip_name_index_.find(address);
+  if (index_it == ip_name_index_.end())
+    return candidates;
+  const SessionNameIndex& index = index_it->second;
+  for (const std::string& name : names) {
+    auto range = index.equal_range(name);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (!base::Contains(candidates, it->second))
+        candidates.push_back(it->second);
+    }
+  }
+  return candidates;
+}
+
 void QuicStreamFactory::OnJobComplete(Job* job, int rv) {
-  auto iter = active_jobs_.find(job->key().session_key());
+  const QuicSessionKeyId session_key_id = job->session_key_id();
+  auto iter = active_jobs_.find(session_key_id);
   DCHECK(iter != active_jobs_.end());
   if (rv == OK) {
     set_is_quic_known_to_work_on_current_network(true);
 
-    auto session_it = active_sessions_.find(job->key().session_key());
+    auto session_it = active_sessions_.find(session_key_id);
     CHECK(session_it != active_sessions_.end());
     QuicChromiumClientSession* session = session_it->second;
+    MarkSessionUsed(session);
     for (auto* request : iter->second->stream_requests()) {
       // Do not notify |request| yet.
       request->SetSession(session->CreateHandle(job->key().destination()));
@@ -1798,6 +1955,7 @@ void QuicStreamFactory::OnJobComplete(Job* job, int rv) {
     request->OnRequestComplete(rv);
   }
   active_jobs_.erase(iter);
+  session_key_interner_.Release(session_key_id);
 }
 
 void QuicStreamFactory::OnCertVerifyJobComplete(CertVerifierJob* job, int rv) {
@@ -1809,11 +1967,12 @@ bool QuicStreamFactory::HasActiveSession(
   // TODO(rtenneti): crbug.com/498823 - delete active_sessions_.empty() check.
   if (active_sessions_.empty())
     return false;
-  return base::Contains(active_sessions_, session_key);
+  return base::Contains(active_sessions_,
+                        session_key_interner_.Find(session_key));
 }
 
 bool QuicStreamFactory::HasActiveJob(const QuicSessionKey& session_key) const {
-  return base::Contains(active_jobs_, session_key);
+  return base::Contains(active_jobs_, session_key_interner_.Find(session_key));
 }
 
 bool QuicStreamFactory::HasActiveCertVerifierJob(
@@ -1892,6 +2051,10 @@ int QuicStreamFactory::CreateSession(
   quic::QuicConfig config = config_;
   ConfigureInitialRttEstimate(
       server_id, key.session_key().network_isolation_key(), &config);
+  if (params_.adaptive_ack_decimation) {
+    ConfigureAckDecimation(server_id, key.session_key().network_isolation_key(),
+                           &config);
+  }
   // QUIC versions that use the IETF invariant header all have NSTP
   // enabled by default, so we only need to add it for those that don't.
   if (!quic_version.HasIetfInvariantHeader() &&
@@ -1939,6 +2102,12 @@ int QuicStreamFactory::CreateSession(
 
   all_sessions_[*session] = key;  // owning pointer
   writer->set_delegate(*session);
+  if (receive_window_budget_)
+    (*session)->EnableReceiveWindowAutoTuning(receive_window_budget_.get());
+  (*session)->push_cache()->SetLimits(params_.max_push_cache_bytes,
+                                      params_.max_push_cache_age);
+  if (params_.coalesce_identical_requests)
+    (*session)->EnableRequestCoalescing();
 
   (*session)->Initialize();
   bool closed_during_initialize = !base::Contains(all_sessions_, *session) ||
@@ -1957,21 +2126,155 @@ void QuicStreamFactory::ActivateSession(const QuicSessionAliasKey& key,
                                         QuicChromiumClientSession* session) {
   DCHECK(!HasActiveSession(key.session_key()));
   UMA_HISTOGRAM_COUNTS_1M("Net.QuicActiveSessions", active_sessions_.size());
-  active_sessions_[key.session_key()] = session;
-  session_aliases_[session].insert(key);
   const IPEndPoint peer_address =
       ToIPEndPoint(session->connection()->peer_address());
   DCHECK(!base::Contains(ip_aliases_[peer_address], session));
   ip_aliases_[peer_address].insert(session);
+  SessionNameIndex& index = ip_name_index_[peer_address];
+  std::vector<SessionNameIndex::iterator>& entries =
+      session_name_index_entries_[session];
+  DCHECK(entries.empty());
+  const QuicPoolingDescriptor* descriptor = session->pooling_descriptor();
+  if (descriptor) {
+    for (const std::string& name : descriptor->dns_names())
+      entries.push_back(index.emplace(name, session));
+  } else {
+    entries.push_back(index.emplace(std::string(), session));
+  }
   DCHECK(!base::Contains(session_peer_ip_, session));
   session_peer_ip_[session] = peer_address;
+  AddAlias(key, session);
+
+  if (params_.session_memory_budget > 0 &&
+      EstimateSessionMemoryUsage() > params_.session_memory_budget) {
+    EvictIdleSessions(params_.session_memory_budget, session);
+  }
+}
+
+void QuicStreamFactory::AddAlias(const QuicSessionAliasKey& key,
+                                 QuicChromiumClientSession* session) {
+  DCHECK(!HasActiveSession(key.session_key()));
+  const QuicSessionKeyId session_key_id =
+      session_key_interner_.Intern(key.session_key());
+  active_sessions_[session_key_id] = session;
+  session_aliases_[session][key] = session_key_id;
+  MarkSessionUsed(session);
+  if (session_availability_callback_)
+    session_availability_callback_.Run(key, /*available=*/true);
+}
+
+void QuicStreamFactory::MarkSessionUsed(QuicChromiumClientSession* session) {
+  session_last_used_[session] = ++next_session_use_;
+}
+
+void QuicStreamFactory::EvictIdleSessions(
+    size_t target_memory_usage,
+    const QuicChromiumClientSession* session_to_keep) {
+  size_t memory_usage = EstimateSessionMemoryUsage();
+  if (memory_usage <= target_memory_usage)
+    return;
+
+  // Sessions going away are not in |session_aliases_|, and close on their
+  // own once their streams are done.
+  struct Candidate {
+    bool resumable;
+    uint64_t last_used;
+    QuicChromiumClientSession* session;
+  };
+  std::vector<Candidate> candidates;
+  for (const auto& session_and_aliases : session_aliases_) {
+    QuicChromiumClientSession* session = session_and_aliases.first;
+    if (session == session_to_keep || !session->IsIdle())
+      continue;
+    candidates.push_back({IsSessionResumable(session),
+                          session_last_used_[session], session});
+  }
+  // Resumable sessions first, then least recently used.
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate& a, const Candidate& b) {
+              return std::tie(b.resumable, a.last_used) <
+                     std::tie(a.resumable, b.last_used);
+            });
+
+  for (const Candidate& candidate : candidates) {
+    if (memory_usage <= target_memory_usage)
+      break;
+    memory_usage -= std::min(memory_usage,
+                             candidate.session->EstimateMemoryUsage());
+    // Deletes |candidate.session|.
+    candidate.session->CloseSessionOnError(
+        ERR_INSUFFICIENT_RESOURCES, quic::QUIC_CONNECTION_CANCELLED,
+        quic::ConnectionCloseBehavior::SEND_CONNECTION_CLOSE_PACKET);
+  }
+}
+
+bool QuicStreamFactory::IsSessionResumable(
+    const QuicChromiumClientSession* session) {
+  const QuicSessionKey& session_key = session->quic_session_key();
+  if (session->GetQuicVersion().handshake_protocol != quic::PROTOCOL_TLS1_3) {
+    return !CryptoConfigCacheIsEmpty(session_key.server_id(),
+                                     session_key.network_isolation_key());
+  }
+  QuicCryptoClientConfigOwner* owner =
+      FindCryptoConfigOwner(session_key.network_isolation_key());
+  return owner && owner->session_cache() &&
+         owner->session_cache()->CanResumeWithEarlyData(
+             session_key.server_id());
+}
+
+void QuicStreamFactory::OnMemoryPressure(
+    base::MemoryPressureListener::MemoryPressureLevel memory_pressure_level) {
+  switch (memory_pressure_level) {
+    case base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_NONE:
+      break;
+    case base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_MODERATE:
+      EvictIdleSessions(params_.session_memory_budget / 2, nullptr);
+      break;
+    case base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_CRITICAL:
+      EvictIdleSessions(0, nullptr);
+      break;
+  }
 }
 
 void QuicStreamFactory::MarkAllActiveSessionsGoingAway() {
-  while (!active_sessions_.empty()) {
-    QuicChromiumClientSession* session = active_sessions_.begin()->second;
-    OnSessionGoingAway(session);
+  for (QuicChromiumClientSession* session : RemoveAllActiveSessions())
+    ProcessGoingAwaySession(session, all_sessions_[session].server_id(), false);
+}
+
+std::vector<QuicChromiumClientSession*>
+QuicStreamFactory::RemoveAllActiveSessions() {
+  // Does what OnSessionGoingAway() does for each alias, but clears the IP
+  // indices at once rather than searching the name index of each session's
+  // peer, which is quadratic when many sessions share a peer.
+  std::vector<QuicChromiumClientSession*> sessions;
+  sessions.reserve(session_aliases_.size());
+  size_t num_aliases = 0;
+  for (const auto& session_and_aliases : session_aliases_) {
+    QuicChromiumClientSession* session = session_and_aliases.first;
+    for (const auto& alias_and_id : session_and_aliases.second) {
+      const QuicSessionAliasKey& alias = alias_and_id.first;
+      const QuicSessionKeyId session_key_id = alias_and_id.second;
+      DCHECK(active_sessions_.count(session_key_id));
+      if (session->goaway_received())
+        gone_away_aliases_.insert(alias);
+      session_key_interner_.Release(session_key_id);
+      ProcessGoingAwaySession(session, alias.server_id(), true);
+      // Every alias, including those pooled by IP, was reported as available
+      // by AddAlias().
+      if (session_availability_callback_)
+        session_availability_callback_.Run(alias, /*available=*/false);
+    }
+    num_aliases += session_and_aliases.second.size();
+    sessions.push_back(session);
   }
+  DCHECK_EQ(num_aliases, active_sessions_.size());
+  active_sessions_.clear();
+  session_aliases_.clear();
+  ip_aliases_.clear();
+  ip_name_index_.clear();
+  session_peer_ip_.clear();
+  session_name_index_entries_.clear();
+  return sessions;
 }
 
 void QuicStreamFactory::ConfigureInitialRttEstimate(
@@ -2010,6 +2313,30 @@ void QuicStreamFactory::ConfigureInitialRttEstimate(
   SetInitialRttEstimate(base::TimeDelta(), INITIAL_RTT_DEFAULT, config);
 }
 
+void QuicStreamFactory::ConfigureAckDecimation(
+    const quic::QuicServerId& server_id,
+    const NetworkIsolationKey& network_isolation_key,
+    quic::QuicConfig* config) {
+  url::SchemeHostPort server("https", server_id.host(), server_id.port());
+  const ServerNetworkStats* stats =
+      http_server_properties_->GetServerNetworkStats(server,
+                                                     network_isolation_key);
+  if (stats == nullptr)
+    return;
+  quic::QuicTag option = SelectAckDecimationConnectionOption(
+      stats->srtt, stats->bandwidth_estimate, params_.max_packet_length);
+  UMA_HISTOGRAM_BOOLEAN("Net.QuicSession.AdaptiveAckDecimationEnabled",
+                        option != 0);
+  if (option == 0 ||
+      config->HasClientSentConnectionOption(option,
+                                            quic::Perspective::IS_CLIENT)) {
+    return;
+  }
+  quic::QuicTagVector connection_options = config->SendConnectionOptions();
+  connection_options.push_back(option);
+  config->SetConnectionOptionsToSend(connection_options);
+}
+
 int64_t QuicStreamFactory::GetServerNetworkStatsSmoothedRttInMicroseconds(
     const quic::QuicServerId& server_id,
     const NetworkIsolationKey& network_isolation_key) const {
@@ -2271,6 +2598,11 @@ QuicStreamFactory::CreateCryptoConfigHandle(
               cert_transparency_verifier_,
               HostsFromOrigins(params_.origins_to_force_quic_on),
               actual_network_isolation_key),
+          // Sessions are only cached along with the memory budget, so that
+          // evicted TLS sessions can be resumed with 0-RTT.
+          params_.session_memory_budget > 0
+              ? std::make_unique<QuicClientSessionCache>()
+              : nullptr,
           this);
 
   quic::QuicCryptoClientConfig* crypto_config = crypto_config_owner->config();
@@ -2322,22 +2654,34 @@ quic::QuicAsyncStatus QuicStreamFactory::StartCertVerifyJobForTesting(
 bool QuicStreamFactory::CryptoConfigCacheIsEmptyForTesting(
     const quic::QuicServerId& server_id,
     const NetworkIsolationKey& network_isolation_key) {
-  quic::QuicCryptoClientConfig::CachedState* cached = nullptr;
+  return CryptoConfigCacheIsEmpty(server_id, network_isolation_key);
+}
+
+bool QuicStreamFactory::CryptoConfigCacheIsEmpty(
+    const quic::QuicServerId& server_id,
+    const NetworkIsolationKey& network_isolation_key) {
+  QuicCryptoClientConfigOwner* owner =
+      FindCryptoConfigOwner(network_isolation_key);
+  if (!owner)
+    return true;
+  return owner->config()->LookupOrCreate(server_id)->IsEmpty();
+}
+
+QuicStreamFactory::QuicCryptoClientConfigOwner*
+QuicStreamFactory::FindCryptoConfigOwner(
+    const NetworkIsolationKey& network_isolation_key) {
   NetworkIsolationKey actual_network_isolation_key =
       use_network_isolation_key_for_crypto_configs_ ? network_isolation_key
                                                     : NetworkIsolationKey();
   auto map_iterator =
       active_crypto_config_map_.find(actual_network_isolation_key);
-  if (map_iterator != active_crypto_config_map_.end()) {
-    cached = map_iterator->second->config()->LookupOrCreate(server_id);
-  } else {
-    auto mru_iterator =
-        recent_crypto_config_map_.Peek(actual_network_isolation_key);
-    if (mru_iterator != recent_crypto_config_map_.end()) {
-      cached = mru_iterator->second->config()->LookupOrCreate(server_id);
-    }
-  }
-  return !cached || cached->IsEmpty();
+  if (map_iterator != active_crypto_config_map_.end())
+    return map_iterator->second.get();
+  auto mru_iterator =
+      recent_crypto_config_map_.Peek(actual_network_isolation_key);
+  if (mru_iterator != recent_crypto_config_map_.end())
+    return mru_iterator->second.get();
+  return nullptr;
 }
 
 }  // namespace net
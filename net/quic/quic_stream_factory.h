@@ -13,12 +13,14 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/containers/mru_cache.h"
 #include "base/gtest_prod_util.h"
 #include "base/logging.h"
 #include "base/macros.h"
+#include "base/memory/memory_pressure_listener.h"
 #include "base/memory/weak_ptr.h"
 #include "base/time/tick_clock.h"
 #include "base/time/time.h"
@@ -37,7 +39,9 @@
 #include "net/quic/quic_clock_skew_detector.h"
 #include "net/quic/quic_context.h"
 #include "net/quic/quic_crypto_client_config_handle.h"
+#include "net/quic/quic_path_mtu_cache.h"
 #include "net/quic/quic_session_key.h"
+#include "net/quic/quic_session_key_interner.h"
 #include "net/socket/client_socket_pool.h"
 #include "net/ssl/ssl_config_service.h"
 #include "net/third_party/quiche/src/common/platform/api/quiche_string_piece.h"
@@ -170,11 +174,19 @@ class NET_EXPORT_PRIVATE QuicStreamRequest {
 
   const QuicSessionKey& session_key() const { return session_key_; }
 
+  // The interned ID of session_key() while the request waits on a job of the
+  // factory, so that the factory finds the job without hashing the key again.
+  QuicSessionKeyId session_key_id() const { return session_key_id_; }
+  void set_session_key_id(QuicSessionKeyId session_key_id) {
+    session_key_id_ = session_key_id;
+  }
+
   const NetLogWithSource& net_log() const { return net_log_; }
 
  private:
   QuicStreamFactory* factory_;
   QuicSessionKey session_key_;
+  QuicSessionKeyId session_key_id_;
   NetLogWithSource net_log_;
   CompletionOnceCallback callback_;
   CompletionOnceCallback failed_on_default_network_callback_;
@@ -284,6 +296,31 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
 
   std::unique_ptr<base::Value> QuicStreamFactoryInfoToValue() const;
 
+  // Passes a stats snapshot of every session, including sessions which are
+  // going away, to |callback|, along with the key the session was created
+  // for. |callback| must not close sessions. Intended for monitoring, as
+  // unlike QuicStreamFactoryInfoToValue(), nothing is allocated per session.
+  using SessionStatsCallback =
+      base::RepeatingCallback<void(const QuicSessionKey& session_key,
+                                   const QuicSessionStats& stats)>;
+  void ForEachSessionStats(const SessionStatsCallback& callback);
+
+  // Returns the estimated memory used by all sessions, in bytes.
+  size_t EstimateSessionMemoryUsage() const;
+
+  // Called with |available| true whenever a session becomes usable by new
+  // requests for |key|, and with |available| false when it stops being
+  // usable, i.e. when it goes away or closes. Lets a front end that spreads
+  // requests over several factories send requests to the factory that
+  // already holds a session for them.
+  using SessionAvailabilityCallback =
+      base::RepeatingCallback<void(const QuicSessionAliasKey& key,
+                                   bool available)>;
+  void set_session_availability_callback(
+      SessionAvailabilityCallback callback) {
+    session_availability_callback_ = std::move(callback);
+  }
+
   // Delete cached state objects in |crypto_config_|. If |origin_filter| is not
   // null, only objects on matching origins will be deleted.
   void ClearCachedStatesInCryptoConfig(
@@ -337,6 +374,12 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
 
   bool allow_server_migration() const { return params_.allow_server_migration; }
 
+  // Whether QuicSessionKeys keep their NetworkIsolationKey. Queried once, at
+  // construction, from features::kPartitionConnectionsByNetworkIsolationKey.
+  bool partition_connections_by_network_isolation_key() const {
+    return partition_connections_by_network_isolation_key_;
+  }
+
   void set_is_quic_known_to_work_on_current_network(
       bool is_quic_known_to_work_on_current_network);
 
@@ -355,6 +398,25 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
     return default_network_;
   }
 
+  // Returns the packet size that path MTU discovery should probe for on the
+  // path to |peer_address| over |network|, or 0 if path MTU discovery is
+  // disabled.
+  quic::QuicByteCount GetPathMtuDiscoveryTarget(
+      NetworkChangeNotifier::NetworkHandle network,
+      const IPEndPoint& peer_address);
+
+  // Called by a session when path MTU discovery has validated packets of
+  // |mtu| bytes on the path to |peer_address| over |network|.
+  void OnPathMtuValidated(NetworkChangeNotifier::NetworkHandle network,
+                          const IPEndPoint& peer_address,
+                          quic::QuicByteCount mtu);
+
+  // Called by a session when a packet of |size| bytes exceeded the MTU of the
+  // path to |peer_address| over |network|.
+  void OnPathMtuExceeded(NetworkChangeNotifier::NetworkHandle network,
+                         const IPEndPoint& peer_address,
+                         quic::QuicByteCount size);
+
   // Dumps memory allocation stats. |parent_dump_absolute_name| is the name
   // used by the parent MemoryAllocatorDump in the memory dump hierarchy.
   void DumpMemoryStats(base::trace_event::ProcessMemoryDump* pmd,
@@ -367,15 +429,24 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
   class CryptoClientConfigHandle;
   friend class test::QuicStreamFactoryPeer;
 
-  typedef std::map<QuicSessionKey, QuicChromiumClientSession*> SessionMap;
+  typedef std::map<QuicSessionKeyId, QuicChromiumClientSession*> SessionMap;
   typedef std::map<QuicChromiumClientSession*, QuicSessionAliasKey>
       SessionIdMap;
   typedef std::set<QuicSessionAliasKey> AliasSet;
-  typedef std::map<QuicChromiumClientSession*, AliasSet> SessionAliasMap;
+  // Aliases of a session, with the interned IDs of their session keys.
+  typedef std::map<QuicSessionAliasKey, QuicSessionKeyId> AliasIdMap;
+  typedef std::map<QuicChromiumClientSession*, AliasIdMap> SessionAliasMap;
   typedef std::set<QuicChromiumClientSession*> SessionSet;
   typedef std::map<IPEndPoint, SessionSet> IPAliasMap;
+  typedef std::multimap<std::string, QuicChromiumClientSession*>
+      SessionNameIndex;
+  typedef std::map<IPEndPoint, SessionNameIndex> IPNameIndexMap;
   typedef std::map<QuicChromiumClientSession*, IPEndPoint> SessionPeerIPMap;
-  typedef std::map<QuicSessionKey, std::unique_ptr<Job>> JobMap;
+  typedef std::map<QuicChromiumClientSession*,
+                   std::vector<SessionNameIndex::iterator>>
+      SessionNameIndexEntryMap;
+  typedef std::map<QuicChromiumClientSession*, uint64_t> SessionLastUsedMap;
+  typedef std::map<QuicSessionKeyId, std::unique_ptr<Job>> JobMap;
   typedef std::map<quic::QuicServerId, std::unique_ptr<CertVerifierJob>>
       CertVerifierJobMap;
   using QuicCryptoClientConfigMap =
@@ -384,6 +455,11 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
 
   bool HasMatchingIpSession(const QuicSessionAliasKey& key,
                             const AddressList& address_list);
+  // Returns the sessions connected to |address| whose certificate may cover
+  // |hostname|.
+  std::vector<QuicChromiumClientSession*> GetPoolingCandidates(
+      const IPEndPoint& address,
+      const std::string& hostname);
   void OnJobComplete(Job* job, int rv);
   void OnCertVerifyJobComplete(CertVerifierJob* job, int rv);
   bool HasActiveSession(const QuicSessionKey& session_key) const;
@@ -401,13 +477,27 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
                     NetworkChangeNotifier::NetworkHandle* network);
   void ActivateSession(const QuicSessionAliasKey& key,
                        QuicChromiumClientSession* session);
+  // Makes |session| the active session for |key| and reports |key| as
+  // available. Used both for new sessions and for sessions pooled by IP.
+  void AddAlias(const QuicSessionAliasKey& key,
+                QuicChromiumClientSession* session);
   void MarkAllActiveSessionsGoingAway();
+  // Removes every session from the pool in one pass, as OnSessionGoingAway()
+  // does for one session except for the processing of the session as no
+  // longer active. Returns the sessions removed.
+  std::vector<QuicChromiumClientSession*> RemoveAllActiveSessions();
 
   void ConfigureInitialRttEstimate(
       const quic::QuicServerId& server_id,
       const NetworkIsolationKey& network_isolation_key,
       quic::QuicConfig* config);
 
+  // Adds a connection option selecting the ack decimation mode to |config|,
+  // based on the ServerNetworkStats cached for |server_id|.
+  void ConfigureAckDecimation(const quic::QuicServerId& server_id,
+                              const NetworkIsolationKey& network_isolation_key,
+                              quic::QuicConfig* config);
+
   // Returns |srtt| in micro seconds from ServerNetworkStats. Returns 0 if there
   // is no |http_server_properties_| or if |http_server_properties_| doesn't
   // have ServerNetworkStats for the given |server_id|.
@@ -462,6 +552,36 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
                                const quic::QuicServerId& server_id,
                                bool was_session_active);
 
+  // Records that a request was handed |session|, for picking the least
+  // recently used session to evict.
+  void MarkSessionUsed(QuicChromiumClientSession* session);
+
+  // Closes idle active sessions, other than |session_to_keep|, until the
+  // estimated memory used by all sessions is at most |target_memory_usage|
+  // bytes. Sessions that can be resumed with 0-RTT go first, and within each
+  // group, the least recently used ones.
+  void EvictIdleSessions(size_t target_memory_usage,
+                         const QuicChromiumClientSession* session_to_keep);
+
+  // Returns true if a new connection to the server of |session| could be
+  // established with 0-RTT: from the cached server config for QUIC crypto
+  // handshakes, or a cached TLS session that allows early data for TLS
+  // handshakes.
+  bool IsSessionResumable(const QuicChromiumClientSession* session);
+
+  void OnMemoryPressure(
+      base::MemoryPressureListener::MemoryPressureLevel memory_pressure_level);
+
+  bool CryptoConfigCacheIsEmpty(
+      const quic::QuicServerId& server_id,
+      const NetworkIsolationKey& network_isolation_key);
+
+  // Returns the QuicCryptoClientConfigOwner used for |network_isolation_key|
+  // in |active_crypto_config_map_| or |recent_crypto_config_map_|, without
+  // promoting it, or null if there is none.
+  QuicCryptoClientConfigOwner* FindCryptoConfigOwner(
+      const NetworkIsolationKey& network_isolation_key);
+
   // Creates a CreateCryptoConfigHandle for the specified NetworkIsolationKey.
   // If there's already a corresponding entry in |active_crypto_config_map_|,
   // reuses it. If there's a corresponding entry in |recent_crypto_config_map_|,
@@ -521,6 +641,17 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
   // The alarm factory used for all connections.
   std::unique_ptr<quic::QuicAlarmFactory> alarm_factory_;
 
+  // Interns the keys of |active_sessions_| and |active_jobs_|, each of which
+  // holds a reference to the keys it uses. Requests resolve their key once,
+  // and the maps then compare IDs rather than full keys. Jobs, the requests
+  // waiting on them and |session_aliases_| keep the IDs they were given, so
+  // later calls do not hash keys again.
+  QuicSessionKeyInterner session_key_interner_;
+
+  // Shared by the receive window tuners of all sessions. Only set if
+  // |params_.auto_tune_receive_windows| is true.
+  std::unique_ptr<QuicReceiveWindowBudget> receive_window_budget_;
+
   // Contains owning pointers to all sessions that currently exist.
   SessionIdMap all_sessions_;
   // Contains non-owning pointers to currently active session
@@ -530,8 +661,18 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
   SessionAliasMap session_aliases_;
   // Map from IP address to sessions which are connected to this address.
   IPAliasMap ip_aliases_;
+  // Map from IP address to the sessions in |ip_aliases_|, indexed by the
+  // dNSName SANs of their certificates. Sessions whose certificate was not
+  // verified yet when they were activated are under the empty name.
+  IPNameIndexMap ip_name_index_;
   // Map from session to its original peer IP address.
   SessionPeerIPMap session_peer_ip_;
+  // Map from session to its entries in |ip_name_index_|.
+  SessionNameIndexEntryMap session_name_index_entries_;
+  // Map from session to the value of |next_session_use_| when a request was
+  // last handed the session.
+  SessionLastUsedMap session_last_used_;
+  uint64_t next_session_use_;
 
   // Origins which have gone away recently.
   AliasSet gone_away_aliases_;
@@ -582,6 +723,10 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
 
   NetworkConnection network_connection_;
 
+  // MTUs validated by path MTU discovery, keyed by network and peer address.
+  // Only used if |params_.enable_path_mtu_discovery| is true.
+  QuicPathMtuCache path_mtu_cache_;
+
   int num_push_streams_created_;
 
   quic::QuicClientPushPromiseIndex push_promise_index_;
@@ -602,6 +747,13 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
   // corresponding NIK.
   const bool use_network_isolation_key_for_crypto_configs_;
 
+  const bool partition_connections_by_network_isolation_key_;
+
+  // Only set if |params_.session_memory_budget| is non-zero.
+  std::unique_ptr<base::MemoryPressureListener> memory_pressure_listener_;
+
+  SessionAvailabilityCallback session_availability_callback_;
+
   base::WeakPtrFactory<QuicStreamFactory> weak_factory_{this};
 
   DISALLOW_COPY_AND_ASSIGN(QuicStreamFactory);
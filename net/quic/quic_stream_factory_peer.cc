@@ -77,7 +77,8 @@ QuicChromiumClientSession* QuicStreamFactoryPeer::GetActiveSession(
   QuicSessionKey session_key(server_id, SocketTag(), network_isolation_key,
                              false /* disable_secure_dns */);
   DCHECK(factory->HasActiveSession(session_key));
-  return factory->active_sessions_[session_key];
+  return factory->active_sessions_[factory->session_key_interner_.Find(
+      session_key)];
 }
 
 bool QuicStreamFactoryPeer::HasLiveSession(
@@ -107,6 +108,13 @@ bool QuicStreamFactoryPeer::IsLiveSession(QuicStreamFactory* factory,
   return false;
 }
 
+std::vector<QuicChromiumClientSession*>
+QuicStreamFactoryPeer::GetPoolingCandidates(QuicStreamFactory* factory,
+                                            const IPEndPoint& address,
+                                            const std::string& hostname) {
+  return factory->GetPoolingCandidates(address, hostname);
+}
+
 void QuicStreamFactoryPeer::SetTaskRunner(
     QuicStreamFactory* factory,
     base::SequencedTaskRunner* task_runner) {
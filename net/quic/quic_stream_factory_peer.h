@@ -9,11 +9,14 @@
 #include <stdint.h>
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "base/macros.h"
 #include "base/sequenced_task_runner.h"
 #include "base/time/tick_clock.h"
 #include "net/base/host_port_pair.h"
+#include "net/base/ip_endpoint.h"
 #include "net/base/network_isolation_key.h"
 #include "net/base/privacy_mode.h"
 #include "net/third_party/quiche/src/quic/core/quic_packets.h"
@@ -71,6 +74,13 @@ class QuicStreamFactoryPeer {
   static bool IsLiveSession(QuicStreamFactory* factory,
                             QuicChromiumClientSession* session);
 
+  // Returns the sessions to |address| that the factory would consider
+  // pooling |hostname| onto.
+  static std::vector<QuicChromiumClientSession*> GetPoolingCandidates(
+      QuicStreamFactory* factory,
+      const IPEndPoint& address,
+      const std::string& hostname);
+
   static void SetTickClock(QuicStreamFactory* factory,
                            const base::TickClock* tick_clock);
 
@@ -6,11 +6,13 @@
 
 #include <memory>
 #include <ostream>
+#include <set>
 #include <utility>
 
 #include "base/bind.h"
 #include "base/callback.h"
 #include "base/macros.h"
+#include "base/memory/memory_pressure_listener.h"
 #include "base/run_loop.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/string_util.h"
@@ -1007,6 +1009,212 @@ TEST_P(QuicStreamFactoryTest, Create) {
   EXPECT_TRUE(socket_data.AllWriteDataConsumed());
 }
 
+TEST_P(QuicStreamFactoryTest, ForEachSessionStats) {
+  Initialize();
+  ProofVerifyDetailsChromium verify_details = DefaultProofVerifyDetails();
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+
+  MockQuicData socket_data(version_);
+  socket_data.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  if (VersionUsesHttp3(version_.transport_version))
+    socket_data.AddWrite(SYNCHRONOUS, ConstructInitialSettingsPacket());
+  socket_data.AddSocketDataToFactory(socket_factory_.get());
+
+  std::vector<std::pair<QuicSessionKey, QuicSessionStats>> snapshots;
+  QuicStreamFactory::SessionStatsCallback callback = base::BindRepeating(
+      [](std::vector<std::pair<QuicSessionKey, QuicSessionStats>>* snapshots,
+         const QuicSessionKey& session_key, const QuicSessionStats& stats) {
+        snapshots->emplace_back(session_key, stats);
+      },
+      &snapshots);
+  factory_->ForEachSessionStats(callback);
+  EXPECT_TRUE(snapshots.empty());
+
+  QuicStreamRequest request(factory_.get());
+  EXPECT_EQ(
+      ERR_IO_PENDING,
+      request.Request(
+          host_port_pair_, version_, privacy_mode_, DEFAULT_PRIORITY,
+          SocketTag(), NetworkIsolationKey(), false /* disable_secure_dns */,
+          /*cert_verify_flags=*/0, url_, net_log_, &net_error_details_,
+          failed_on_default_network_callback_, callback_.callback()));
+  EXPECT_THAT(callback_.WaitForResult(), IsOk());
+  std::unique_ptr<HttpStream> stream = CreateStream(&request);
+  EXPECT_TRUE(stream.get());
+
+  factory_->ForEachSessionStats(callback);
+  ASSERT_EQ(1u, snapshots.size());
+  EXPECT_EQ(host_port_pair_.host(), snapshots[0].first.host());
+  const QuicSessionStats& stats = snapshots[0].second;
+  EXPECT_TRUE(stats.connected);
+  EXPECT_TRUE(stats.handshake_confirmed);
+  EXPECT_FALSE(stats.going_away);
+  EXPECT_LT(0u, stats.congestion_window);
+  EXPECT_EQ(0u, stats.migrations);
+
+  stream.reset();
+  EXPECT_TRUE(socket_data.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data.AllWriteDataConsumed());
+}
+
+// Verifies that an MTU probe which the socket rejects as too big is dropped
+// without closing the connection, and that it invalidates the MTU cached for
+// the path.
+TEST_P(QuicStreamFactoryTest, MtuProbeTooBig) {
+  quic_params_->enable_path_mtu_discovery = true;
+  Initialize();
+  ProofVerifyDetailsChromium verify_details = DefaultProofVerifyDetails();
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+
+  MockQuicData socket_data(version_);
+  socket_data.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  if (VersionUsesHttp3(version_.transport_version))
+    socket_data.AddWrite(SYNCHRONOUS, ConstructInitialSettingsPacket());
+  socket_data.AddWrite(SYNCHRONOUS, ERR_MSG_TOO_BIG);
+  socket_data.AddSocketDataToFactory(socket_factory_.get());
+
+  QuicStreamRequest request(factory_.get());
+  EXPECT_EQ(
+      ERR_IO_PENDING,
+      request.Request(
+          host_port_pair_, version_, privacy_mode_, DEFAULT_PRIORITY,
+          SocketTag(), NetworkIsolationKey(), false /* disable_secure_dns */,
+          /*cert_verify_flags=*/0, url_, net_log_, &net_error_details_,
+          failed_on_default_network_callback_, callback_.callback()));
+  EXPECT_THAT(callback_.WaitForResult(), IsOk());
+  std::unique_ptr<HttpStream> stream = CreateStream(&request);
+  EXPECT_TRUE(stream.get());
+
+  QuicChromiumClientSession* session = GetActiveSession(host_port_pair_);
+  const NetworkChangeNotifier::NetworkHandle network =
+      session->GetDefaultSocket()->GetBoundNetwork();
+  IPEndPoint peer_address;
+  session->GetDefaultSocket()->GetPeerAddress(&peer_address);
+
+  // A previous session validated a size the path no longer carries.
+  const quic::QuicByteCount kStaleMtu = 1400;
+  factory_->OnPathMtuValidated(network, peer_address, kStaleMtu);
+  EXPECT_EQ(kStaleMtu,
+            factory_->GetPathMtuDiscoveryTarget(network, peer_address));
+
+  const quic::QuicByteCount max_packet_length =
+      session->connection()->max_packet_length();
+  ASSERT_LT(max_packet_length, kStaleMtu);
+  session->connection()->SendMtuDiscoveryPacket(kStaleMtu);
+
+  // The probe is dropped; the connection carries on with its packet size.
+  EXPECT_TRUE(session->connection()->connected());
+  EXPECT_TRUE(HasActiveSession(host_port_pair_));
+  EXPECT_EQ(max_packet_length, session->connection()->max_packet_length());
+  // Later sessions on the path no longer probe straight for the stale size.
+  EXPECT_EQ(quic::kMtuDiscoveryTargetPacketSizeHigh,
+            factory_->GetPathMtuDiscoveryTarget(network, peer_address));
+
+  stream.reset();
+  EXPECT_TRUE(socket_data.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data.AllWriteDataConsumed());
+}
+
+// Verifies that an MTU probe which the socket asynchronously rejects as too
+// big neither closes nor migrates the connection, and that it invalidates the
+// MTU cached for the path.
+TEST_P(QuicStreamFactoryTest, MtuProbeTooBigAsync) {
+  quic_params_->enable_path_mtu_discovery = true;
+  Initialize();
+  ProofVerifyDetailsChromium verify_details = DefaultProofVerifyDetails();
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+
+  MockQuicData socket_data(version_);
+  socket_data.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  if (VersionUsesHttp3(version_.transport_version))
+    socket_data.AddWrite(SYNCHRONOUS, ConstructInitialSettingsPacket());
+  socket_data.AddWrite(ASYNC, ERR_MSG_TOO_BIG);
+  socket_data.AddSocketDataToFactory(socket_factory_.get());
+
+  QuicStreamRequest request(factory_.get());
+  EXPECT_EQ(
+      ERR_IO_PENDING,
+      request.Request(
+          host_port_pair_, version_, privacy_mode_, DEFAULT_PRIORITY,
+          SocketTag(), NetworkIsolationKey(), false /* disable_secure_dns */,
+          /*cert_verify_flags=*/0, url_, net_log_, &net_error_details_,
+          failed_on_default_network_callback_, callback_.callback()));
+  EXPECT_THAT(callback_.WaitForResult(), IsOk());
+  std::unique_ptr<HttpStream> stream = CreateStream(&request);
+  EXPECT_TRUE(stream.get());
+
+  QuicChromiumClientSession* session = GetActiveSession(host_port_pair_);
+  const NetworkChangeNotifier::NetworkHandle network =
+      session->GetDefaultSocket()->GetBoundNetwork();
+  IPEndPoint peer_address;
+  session->GetDefaultSocket()->GetPeerAddress(&peer_address);
+
+  const quic::QuicByteCount kStaleMtu = 1400;
+  factory_->OnPathMtuValidated(network, peer_address, kStaleMtu);
+  const quic::QuicByteCount max_packet_length =
+      session->connection()->max_packet_length();
+  ASSERT_LT(max_packet_length, kStaleMtu);
+  session->connection()->SendMtuDiscoveryPacket(kStaleMtu);
+  // The write completes with the error.
+  base::RunLoop().RunUntilIdle();
+
+  EXPECT_TRUE(session->connection()->connected());
+  EXPECT_FALSE(session->connection()->writer()->IsWriteBlocked());
+  EXPECT_TRUE(HasActiveSession(host_port_pair_));
+  // No new socket was created to migrate to.
+  EXPECT_EQ(1u, socket_factory_->udp_client_socket_ports().size());
+  EXPECT_EQ(max_packet_length, session->connection()->max_packet_length());
+  EXPECT_EQ(quic::kMtuDiscoveryTargetPacketSizeHigh,
+            factory_->GetPathMtuDiscoveryTarget(network, peer_address));
+
+  stream.reset();
+  EXPECT_TRUE(socket_data.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data.AllWriteDataConsumed());
+}
+
+TEST_P(QuicStreamFactoryTest, SessionAvailabilityCallback) {
+  Initialize();
+  ProofVerifyDetailsChromium verify_details = DefaultProofVerifyDetails();
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+
+  MockQuicData socket_data(version_);
+  socket_data.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  if (VersionUsesHttp3(version_.transport_version))
+    socket_data.AddWrite(SYNCHRONOUS, ConstructInitialSettingsPacket());
+  socket_data.AddSocketDataToFactory(socket_factory_.get());
+
+  std::vector<std::pair<QuicStreamFactory::QuicSessionAliasKey, bool>> events;
+  factory_->set_session_availability_callback(base::BindRepeating(
+      [](std::vector<std::pair<QuicStreamFactory::QuicSessionAliasKey, bool>>*
+             events,
+         const QuicStreamFactory::QuicSessionAliasKey& key, bool available) {
+        events->emplace_back(key, available);
+      },
+      &events));
+
+  QuicStreamRequest request(factory_.get());
+  EXPECT_EQ(
+      ERR_IO_PENDING,
+      request.Request(
+          host_port_pair_, version_, privacy_mode_, DEFAULT_PRIORITY,
+          SocketTag(), NetworkIsolationKey(), false /* disable_secure_dns */,
+          /*cert_verify_flags=*/0, url_, net_log_, &net_error_details_,
+          failed_on_default_network_callback_, callback_.callback()));
+  EXPECT_THAT(callback_.WaitForResult(), IsOk());
+  ASSERT_EQ(1u, events.size());
+  EXPECT_EQ(host_port_pair_, events[0].first.destination());
+  EXPECT_EQ(host_port_pair_.host(), events[0].first.session_key().host());
+  EXPECT_TRUE(events[0].second);
+
+  factory_->OnSessionGoingAway(GetActiveSession(host_port_pair_));
+  ASSERT_EQ(2u, events.size());
+  EXPECT_EQ(events[0].first, events[1].first);
+  EXPECT_FALSE(events[1].second);
+
+  EXPECT_TRUE(socket_data.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data.AllWriteDataConsumed());
+}
+
 TEST_P(QuicStreamFactoryTest, CreateZeroRtt) {
   if (version_.UsesTls() && version_.HasIetfQuicFrames()) {
     // 0-rtt is not supported in IETF QUIC yet.
@@ -1231,6 +1439,51 @@ TEST_P(QuicStreamFactoryTest, CachedInitialRtt) {
   EXPECT_EQ(10000u, session->config()->GetInitialRoundTripTimeUsToSend());
 }
 
+// Test that sessions to servers with a cached large bandwidth-delay product
+// ask for unlimited ack decimation.
+TEST_P(QuicStreamFactoryTest, CachedBandwidthDelayProductDecimatesAcks) {
+  ServerNetworkStats stats;
+  // 100 Mbps * 20 ms is about 180 packets.
+  stats.srtt = base::TimeDelta::FromMilliseconds(20);
+  stats.bandwidth_estimate = quic::QuicBandwidth::FromKBitsPerSecond(100000);
+  http_server_properties_->SetServerNetworkStats(url::SchemeHostPort(url_),
+                                                 NetworkIsolationKey(), stats);
+  quic_params_->adaptive_ack_decimation = true;
+
+  Initialize();
+  ProofVerifyDetailsChromium verify_details = DefaultProofVerifyDetails();
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+
+  MockQuicData socket_data(version_);
+  socket_data.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  if (VersionUsesHttp3(version_.transport_version))
+    socket_data.AddWrite(SYNCHRONOUS, ConstructInitialSettingsPacket());
+  socket_data.AddSocketDataToFactory(socket_factory_.get());
+
+  QuicStreamRequest request(factory_.get());
+  EXPECT_EQ(
+      ERR_IO_PENDING,
+      request.Request(
+          host_port_pair_, version_, privacy_mode_, DEFAULT_PRIORITY,
+          SocketTag(), NetworkIsolationKey(), false /* disable_secure_dns */,
+          /*cert_verify_flags=*/0, url_, net_log_, &net_error_details_,
+          failed_on_default_network_callback_, callback_.callback()));
+
+  EXPECT_THAT(callback_.WaitForResult(), IsOk());
+  std::unique_ptr<HttpStream> stream = CreateStream(&request);
+  EXPECT_TRUE(stream.get());
+
+  QuicChromiumClientSession* session = GetActiveSession(host_port_pair_);
+  EXPECT_TRUE(session->config()->HasClientSentConnectionOption(
+      quic::kAKDU, quic::Perspective::IS_CLIENT));
+  EXPECT_FALSE(session->config()->HasClientSentConnectionOption(
+      quic::kAKD3, quic::Perspective::IS_CLIENT));
+  // The factory's own config is left alone.
+  EXPECT_FALSE(QuicStreamFactoryPeer::GetConfig(factory_.get())
+                   ->HasClientSentConnectionOption(
+                       quic::kAKDU, quic::Perspective::IS_CLIENT));
+}
+
 // Test that QUIC sessions use the cached RTT from HttpServerProperties for the
 // correct NetworkIsolationKey.
 TEST_P(QuicStreamFactoryTest, CachedInitialRttWithNetworkIsolationKey) {
@@ -1627,6 +1880,212 @@ TEST_P(QuicStreamFactoryTest, Pooling) {
   EXPECT_TRUE(socket_data.AllWriteDataConsumed());
 }
 
+// A host pooled onto an existing session by IP is reported as available, and
+// as unavailable again when the session goes away.
+TEST_P(QuicStreamFactoryTest, PoolingReportsSessionAvailability) {
+  Initialize();
+  ProofVerifyDetailsChromium verify_details = DefaultProofVerifyDetails();
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+
+  MockQuicData socket_data(version_);
+  socket_data.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  if (VersionUsesHttp3(version_.transport_version))
+    socket_data.AddWrite(SYNCHRONOUS, ConstructInitialSettingsPacket());
+  socket_data.AddSocketDataToFactory(socket_factory_.get());
+
+  HostPortPair server2(kServer2HostName, kDefaultServerPort);
+  host_resolver_->set_synchronous_mode(true);
+  host_resolver_->rules()->AddIPLiteralRule(host_port_pair_.host(),
+                                            "192.168.0.1", "");
+  host_resolver_->rules()->AddIPLiteralRule(server2.host(), "192.168.0.1", "");
+
+  std::vector<std::pair<QuicStreamFactory::QuicSessionAliasKey, bool>> events;
+  factory_->set_session_availability_callback(base::BindRepeating(
+      [](std::vector<std::pair<QuicStreamFactory::QuicSessionAliasKey, bool>>*
+             events,
+         const QuicStreamFactory::QuicSessionAliasKey& key, bool available) {
+        events->emplace_back(key, available);
+      },
+      &events));
+
+  QuicStreamRequest request(factory_.get());
+  EXPECT_EQ(
+      OK,
+      request.Request(
+          host_port_pair_, version_, privacy_mode_, DEFAULT_PRIORITY,
+          SocketTag(), NetworkIsolationKey(), false /* disable_secure_dns */,
+          /*cert_verify_flags=*/0, url_, net_log_, &net_error_details_,
+          failed_on_default_network_callback_, callback_.callback()));
+  std::unique_ptr<HttpStream> stream = CreateStream(&request);
+  EXPECT_TRUE(stream.get());
+  ASSERT_EQ(1u, events.size());
+
+  TestCompletionCallback callback;
+  QuicStreamRequest request2(factory_.get());
+  EXPECT_EQ(OK,
+            request2.Request(
+                server2, version_, privacy_mode_, DEFAULT_PRIORITY, SocketTag(),
+                NetworkIsolationKey(), false /* disable_secure_dns */,
+                /*cert_verify_flags=*/0, url2_, net_log_, &net_error_details_,
+                failed_on_default_network_callback_, callback.callback()));
+  std::unique_ptr<HttpStream> stream2 = CreateStream(&request2);
+  EXPECT_TRUE(stream2.get());
+
+  QuicChromiumClientSession* session = GetActiveSession(host_port_pair_);
+  EXPECT_EQ(session, GetActiveSession(server2));
+  ASSERT_EQ(2u, events.size());
+  EXPECT_EQ(server2, events[1].first.destination());
+  EXPECT_EQ(server2.host(), events[1].first.session_key().host());
+  EXPECT_TRUE(events[1].second);
+
+  factory_->OnSessionGoingAway(session);
+  ASSERT_EQ(4u, events.size());
+  EXPECT_FALSE(events[2].second);
+  EXPECT_FALSE(events[3].second);
+  EXPECT_TRUE((events[2].first == events[0].first &&
+               events[3].first == events[1].first) ||
+              (events[2].first == events[1].first &&
+               events[3].first == events[0].first));
+
+  EXPECT_TRUE(socket_data.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data.AllWriteDataConsumed());
+}
+
+// Marking all sessions going away removes every alias of a pooled session.
+TEST_P(QuicStreamFactoryTest, PooledSessionGoesAwayWithAllAliases) {
+  Initialize();
+  ProofVerifyDetailsChromium verify_details = DefaultProofVerifyDetails();
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+
+  MockQuicData socket_data(version_);
+  socket_data.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  if (VersionUsesHttp3(version_.transport_version))
+    socket_data.AddWrite(SYNCHRONOUS, ConstructInitialSettingsPacket());
+  socket_data.AddSocketDataToFactory(socket_factory_.get());
+
+  HostPortPair server2(kServer2HostName, kDefaultServerPort);
+  host_resolver_->set_synchronous_mode(true);
+  host_resolver_->rules()->AddIPLiteralRule(host_port_pair_.host(),
+                                            "192.168.0.1", "");
+  host_resolver_->rules()->AddIPLiteralRule(server2.host(), "192.168.0.1", "");
+
+  std::vector<std::pair<QuicStreamFactory::QuicSessionAliasKey, bool>> events;
+  factory_->set_session_availability_callback(base::BindRepeating(
+      [](std::vector<std::pair<QuicStreamFactory::QuicSessionAliasKey, bool>>*
+             events,
+         const QuicStreamFactory::QuicSessionAliasKey& key, bool available) {
+        events->emplace_back(key, available);
+      },
+      &events));
+
+  QuicStreamRequest request(factory_.get());
+  EXPECT_EQ(
+      OK,
+      request.Request(
+          host_port_pair_, version_, privacy_mode_, DEFAULT_PRIORITY,
+          SocketTag(), NetworkIsolationKey(), false /* disable_secure_dns */,
+          /*cert_verify_flags=*/0, url_, net_log_, &net_error_details_,
+          failed_on_default_network_callback_, callback_.callback()));
+  std::unique_ptr<HttpStream> stream = CreateStream(&request);
+  EXPECT_TRUE(stream.get());
+
+  TestCompletionCallback callback;
+  QuicStreamRequest request2(factory_.get());
+  EXPECT_EQ(OK,
+            request2.Request(
+                server2, version_, privacy_mode_, DEFAULT_PRIORITY, SocketTag(),
+                NetworkIsolationKey(), false /* disable_secure_dns */,
+                /*cert_verify_flags=*/0, url2_, net_log_, &net_error_details_,
+                failed_on_default_network_callback_, callback.callback()));
+  std::unique_ptr<HttpStream> stream2 = CreateStream(&request2);
+  EXPECT_TRUE(stream2.get());
+
+  QuicChromiumClientSession* session = GetActiveSession(host_port_pair_);
+  EXPECT_EQ(session, GetActiveSession(server2));
+  // Both hosts, including the one pooled by IP, are reported as available.
+  ASSERT_EQ(2u, events.size());
+  EXPECT_TRUE(events[0].second);
+  EXPECT_TRUE(events[1].second);
+  EXPECT_EQ(host_port_pair_, events[0].first.destination());
+  EXPECT_EQ(server2, events[1].first.destination());
+
+  // Each of them is reported as unavailable exactly once.
+  factory_->OnCertDBChanged();
+  EXPECT_FALSE(HasActiveSession(host_port_pair_));
+  EXPECT_FALSE(HasActiveSession(server2));
+  EXPECT_TRUE(QuicStreamFactoryPeer::IsLiveSession(factory_.get(), session));
+  ASSERT_EQ(4u, events.size());
+  EXPECT_FALSE(events[2].second);
+  EXPECT_FALSE(events[3].second);
+  std::set<QuicStreamFactory::QuicSessionAliasKey> available = {
+      events[0].first, events[1].first};
+  std::set<QuicStreamFactory::QuicSessionAliasKey> unavailable = {
+      events[2].first, events[3].first};
+  EXPECT_EQ(available, unavailable);
+
+  // Sessions no longer in the pool are not reported again.
+  factory_->OnCertDBChanged();
+  EXPECT_EQ(4u, events.size());
+
+  EXPECT_TRUE(socket_data.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data.AllWriteDataConsumed());
+}
+
+// Sessions are pooling candidates for the names their certificate covers, and
+// stop being candidates when they go away.
+TEST_P(QuicStreamFactoryTest, PoolingCandidatesIndexedByCertificateName) {
+  Initialize();
+  ProofVerifyDetailsChromium verify_details = DefaultProofVerifyDetails();
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+
+  MockQuicData socket_data(version_);
+  socket_data.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  if (VersionUsesHttp3(version_.transport_version))
+    socket_data.AddWrite(SYNCHRONOUS, ConstructInitialSettingsPacket());
+  socket_data.AddSocketDataToFactory(socket_factory_.get());
+
+  host_resolver_->set_synchronous_mode(true);
+  host_resolver_->rules()->AddIPLiteralRule(host_port_pair_.host(),
+                                            "192.168.0.1", "");
+
+  QuicStreamRequest request(factory_.get());
+  EXPECT_EQ(
+      OK,
+      request.Request(
+          host_port_pair_, version_, privacy_mode_, DEFAULT_PRIORITY,
+          SocketTag(), NetworkIsolationKey(), false /* disable_secure_dns */,
+          /*cert_verify_flags=*/0, url_, net_log_, &net_error_details_,
+          failed_on_default_network_callback_, callback_.callback()));
+  std::unique_ptr<HttpStream> stream = CreateStream(&request);
+  EXPECT_TRUE(stream.get());
+
+  QuicChromiumClientSession* session = GetActiveSession(host_port_pair_);
+  ASSERT_TRUE(session->pooling_descriptor());
+  const IPEndPoint address(IPAddress(192, 168, 0, 1), kDefaultServerPort);
+  std::vector<QuicChromiumClientSession*> candidates =
+      QuicStreamFactoryPeer::GetPoolingCandidates(factory_.get(), address,
+                                                  kServer2HostName);
+  ASSERT_EQ(1u, candidates.size());
+  EXPECT_EQ(session, candidates[0]);
+  // The certificate is only valid for *.example.org.
+  EXPECT_TRUE(QuicStreamFactoryPeer::GetPoolingCandidates(
+                  factory_.get(), address, "www.example.com")
+                  .empty());
+  EXPECT_TRUE(QuicStreamFactoryPeer::GetPoolingCandidates(
+                  factory_.get(), IPEndPoint(kCachedIPAddress,
+                                             kDefaultServerPort),
+                  kServer2HostName)
+                  .empty());
+
+  factory_->OnSessionGoingAway(session);
+  EXPECT_TRUE(QuicStreamFactoryPeer::GetPoolingCandidates(
+                  factory_.get(), address, kServer2HostName)
+                  .empty());
+
+  EXPECT_TRUE(socket_data.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data.AllWriteDataConsumed());
+}
+
 TEST_P(QuicStreamFactoryTest, PoolingWithServerMigration) {
   // Set up session to migrate.
   host_resolver_->rules()->AddIPLiteralRule(host_port_pair_.host(),
@@ -1746,6 +2205,222 @@ TEST_P(QuicStreamFactoryTest, NoPoolingAfterGoAway) {
   EXPECT_TRUE(socket_data2.AllWriteDataConsumed());
 }
 
+// An idle session is closed when a new session takes the sessions over the
+// memory budget.
+TEST_P(QuicStreamFactoryTest, EvictIdleSessionOverMemoryBudget) {
+  quic_params_->session_memory_budget = 1;
+  Initialize();
+  ProofVerifyDetailsChromium verify_details = DefaultProofVerifyDetails();
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+
+  MockQuicData socket_data1(version_);
+  socket_data1.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  int packet_num = 1;
+  if (VersionUsesHttp3(version_.transport_version)) {
+    socket_data1.AddWrite(SYNCHRONOUS,
+                          ConstructInitialSettingsPacket(packet_num++));
+  }
+  socket_data1.AddWrite(
+      SYNCHRONOUS,
+      client_maker_.MakeConnectionClosePacket(
+          packet_num++, true, quic::QUIC_CONNECTION_CANCELLED, "net error"));
+  socket_data1.AddSocketDataToFactory(socket_factory_.get());
+  client_maker_.Reset();
+  MockQuicData socket_data2(version_);
+  socket_data2.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  if (VersionUsesHttp3(version_.transport_version))
+    socket_data2.AddWrite(SYNCHRONOUS, ConstructInitialSettingsPacket());
+  socket_data2.AddSocketDataToFactory(socket_factory_.get());
+
+  HostPortPair server2(kServer2HostName, kDefaultServerPort);
+  host_resolver_->set_synchronous_mode(true);
+  host_resolver_->rules()->AddIPLiteralRule(host_port_pair_.host(),
+                                            "192.168.0.1", "");
+  host_resolver_->rules()->AddIPLiteralRule(server2.host(), "192.168.0.2", "");
+
+  QuicStreamRequest request(factory_.get());
+  EXPECT_EQ(
+      OK,
+      request.Request(
+          host_port_pair_, version_, privacy_mode_, DEFAULT_PRIORITY,
+          SocketTag(), NetworkIsolationKey(), false /* disable_secure_dns */,
+          /*cert_verify_flags=*/0, url_, net_log_, &net_error_details_,
+          failed_on_default_network_callback_, callback_.callback()));
+  // The session has no open stream until the HttpStream is initialized.
+  std::unique_ptr<HttpStream> stream = CreateStream(&request);
+  EXPECT_TRUE(stream.get());
+  EXPECT_TRUE(HasActiveSession(host_port_pair_));
+  EXPECT_LT(0u, factory_->EstimateSessionMemoryUsage());
+  // Releases the last handle to the session, which leaves it idle.
+  stream.reset();
+
+  TestCompletionCallback callback;
+  QuicStreamRequest request2(factory_.get());
+  EXPECT_EQ(OK,
+            request2.Request(
+                server2, version_, privacy_mode_, DEFAULT_PRIORITY, SocketTag(),
+                NetworkIsolationKey(), false /* disable_secure_dns */,
+                /*cert_verify_flags=*/0, url2_, net_log_, &net_error_details_,
+                failed_on_default_network_callback_, callback.callback()));
+  std::unique_ptr<HttpStream> stream2 = CreateStream(&request2);
+  EXPECT_TRUE(stream2.get());
+
+  EXPECT_FALSE(HasActiveSession(host_port_pair_));
+  EXPECT_TRUE(HasActiveSession(server2));
+
+  EXPECT_TRUE(socket_data1.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data1.AllWriteDataConsumed());
+  EXPECT_TRUE(socket_data2.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data2.AllWriteDataConsumed());
+}
+
+// A session is not evicted while a request holds a handle to it, even if it
+// has no open stream.
+TEST_P(QuicStreamFactoryTest, DoNotEvictSessionWithHandle) {
+  quic_params_->session_memory_budget = 1;
+  Initialize();
+  ProofVerifyDetailsChromium verify_details = DefaultProofVerifyDetails();
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+
+  MockQuicData socket_data1(version_);
+  socket_data1.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  if (VersionUsesHttp3(version_.transport_version))
+    socket_data1.AddWrite(SYNCHRONOUS, ConstructInitialSettingsPacket());
+  socket_data1.AddSocketDataToFactory(socket_factory_.get());
+  client_maker_.Reset();
+  MockQuicData socket_data2(version_);
+  socket_data2.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  if (VersionUsesHttp3(version_.transport_version))
+    socket_data2.AddWrite(SYNCHRONOUS, ConstructInitialSettingsPacket());
+  socket_data2.AddSocketDataToFactory(socket_factory_.get());
+
+  HostPortPair server2(kServer2HostName, kDefaultServerPort);
+  host_resolver_->set_synchronous_mode(true);
+  host_resolver_->rules()->AddIPLiteralRule(host_port_pair_.host(),
+                                            "192.168.0.1", "");
+  host_resolver_->rules()->AddIPLiteralRule(server2.host(), "192.168.0.2", "");
+
+  QuicStreamRequest request(factory_.get());
+  EXPECT_EQ(
+      OK,
+      request.Request(
+          host_port_pair_, version_, privacy_mode_, DEFAULT_PRIORITY,
+          SocketTag(), NetworkIsolationKey(), false /* disable_secure_dns */,
+          /*cert_verify_flags=*/0, url_, net_log_, &net_error_details_,
+          failed_on_default_network_callback_, callback_.callback()));
+  std::unique_ptr<HttpStream> stream = CreateStream(&request);
+  EXPECT_TRUE(stream.get());
+
+  TestCompletionCallback callback;
+  QuicStreamRequest request2(factory_.get());
+  EXPECT_EQ(OK,
+            request2.Request(
+                server2, version_, privacy_mode_, DEFAULT_PRIORITY, SocketTag(),
+                NetworkIsolationKey(), false /* disable_secure_dns */,
+                /*cert_verify_flags=*/0, url2_, net_log_, &net_error_details_,
+                failed_on_default_network_callback_, callback.callback()));
+  std::unique_ptr<HttpStream> stream2 = CreateStream(&request2);
+  EXPECT_TRUE(stream2.get());
+
+  EXPECT_TRUE(HasActiveSession(host_port_pair_));
+  EXPECT_TRUE(HasActiveSession(server2));
+
+  EXPECT_TRUE(socket_data1.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data1.AllWriteDataConsumed());
+  EXPECT_TRUE(socket_data2.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data2.AllWriteDataConsumed());
+}
+
+TEST_P(QuicStreamFactoryTest, EvictIdleSessionsOnMemoryPressure) {
+  quic_params_->session_memory_budget = 1 << 30;
+  Initialize();
+  ProofVerifyDetailsChromium verify_details = DefaultProofVerifyDetails();
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+
+  MockQuicData socket_data(version_);
+  socket_data.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  int packet_num = 1;
+  if (VersionUsesHttp3(version_.transport_version)) {
+    socket_data.AddWrite(SYNCHRONOUS,
+                         ConstructInitialSettingsPacket(packet_num++));
+  }
+  socket_data.AddWrite(
+      SYNCHRONOUS,
+      client_maker_.MakeConnectionClosePacket(
+          packet_num++, true, quic::QUIC_CONNECTION_CANCELLED, "net error"));
+  socket_data.AddSocketDataToFactory(socket_factory_.get());
+
+  QuicStreamRequest request(factory_.get());
+  EXPECT_EQ(
+      ERR_IO_PENDING,
+      request.Request(
+          host_port_pair_, version_, privacy_mode_, DEFAULT_PRIORITY,
+          SocketTag(), NetworkIsolationKey(), false /* disable_secure_dns */,
+          /*cert_verify_flags=*/0, url_, net_log_, &net_error_details_,
+          failed_on_default_network_callback_, callback_.callback()));
+  EXPECT_THAT(callback_.WaitForResult(), IsOk());
+  std::unique_ptr<HttpStream> stream = CreateStream(&request);
+  EXPECT_TRUE(stream.get());
+
+  // Moderate pressure halves the budget, which still fits the session.
+  base::MemoryPressureListener::NotifyMemoryPressure(
+      base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_MODERATE);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_TRUE(HasActiveSession(host_port_pair_));
+
+  // |stream| holds a handle to the session.
+  base::MemoryPressureListener::NotifyMemoryPressure(
+      base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_CRITICAL);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_TRUE(HasActiveSession(host_port_pair_));
+
+  stream.reset();
+  base::MemoryPressureListener::NotifyMemoryPressure(
+      base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_CRITICAL);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_FALSE(HasActiveSession(host_port_pair_));
+  EXPECT_EQ(0u, factory_->EstimateSessionMemoryUsage());
+
+  EXPECT_TRUE(socket_data.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data.AllWriteDataConsumed());
+}
+
+// Without a memory budget, the factory does not react to memory pressure.
+TEST_P(QuicStreamFactoryTest, NoEvictionWithoutMemoryBudget) {
+  Initialize();
+  ProofVerifyDetailsChromium verify_details = DefaultProofVerifyDetails();
+  crypto_client_stream_factory_.AddProofVerifyDetails(&verify_details);
+
+  MockQuicData socket_data(version_);
+  socket_data.AddRead(SYNCHRONOUS, ERR_IO_PENDING);
+  if (VersionUsesHttp3(version_.transport_version))
+    socket_data.AddWrite(SYNCHRONOUS, ConstructInitialSettingsPacket());
+  socket_data.AddSocketDataToFactory(socket_factory_.get());
+
+  QuicStreamRequest request(factory_.get());
+  EXPECT_EQ(
+      ERR_IO_PENDING,
+      request.Request(
+          host_port_pair_, version_, privacy_mode_, DEFAULT_PRIORITY,
+          SocketTag(), NetworkIsolationKey(), false /* disable_secure_dns */,
+          /*cert_verify_flags=*/0, url_, net_log_, &net_error_details_,
+          failed_on_default_network_callback_, callback_.callback()));
+  EXPECT_THAT(callback_.WaitForResult(), IsOk());
+  std::unique_ptr<HttpStream> stream = CreateStream(&request);
+  EXPECT_TRUE(stream.get());
+  stream.reset();
+
+  base::MemoryPressureListener::NotifyMemoryPressure(
+      base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_CRITICAL);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_TRUE(HasActiveSession(host_port_pair_));
+
+  EXPECT_TRUE(socket_data.AllReadDataConsumed());
+  EXPECT_TRUE(socket_data.AllWriteDataConsumed());
+}
+
 TEST_P(QuicStreamFactoryTest, HttpsPooling) {
   Initialize();
 
@@ -3356,6 +4031,12 @@ TEST_P(QuicStreamFactoryTest, OnNetworkMadeDefaultConnectionMigrationDisabled) {
   EXPECT_FALSE(HasActiveSession(host_port_pair_));
   EXPECT_EQ(1u, session->GetNumActiveStreams());
 
+  // A migration the config disables is not a failed migration.
+  QuicSessionStats stats;
+  session->GetStatsSnapshot(&stats);
+  EXPECT_EQ(0u, stats.migrations);
+  EXPECT_EQ(0u, stats.migration_failures);
+
   stream.reset();
 
   EXPECT_TRUE(socket_data.AllReadDataConsumed());
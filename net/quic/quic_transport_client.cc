@@ -409,6 +409,8 @@ void QuicTransportClient::OnWriteUnblocked() {
   connection_->OnCanWrite();
 }
 
+void QuicTransportClient::OnMessageTooBig(size_t /*packet_size*/) {}
+
 void QuicTransportClient::OnConnectionClosed(
     quic::QuicConnectionId /*server_connection_id*/,
     quic::QuicErrorCode error,
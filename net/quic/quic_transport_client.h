@@ -135,6 +135,7 @@ class NET_EXPORT QuicTransportClient
                            last_packet) override;
   void OnWriteError(int error_code) override;
   void OnWriteUnblocked() override;
+  void OnMessageTooBig(size_t packet_size) override;
 
   // QuicSession::Visitor methods.
   void OnConnectionClosed(quic::QuicConnectionId server_connection_id,
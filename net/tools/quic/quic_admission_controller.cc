@@ -0,0 +1,155 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_admission_controller.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/hash/hash.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/core/quic_clock.h"
+
+namespace net {
+
+namespace {
+
+const size_t kMaxHashInputSize = sizeof(uint64_t) + IPAddress::kIPv6AddressSize;
+
+uint32_t HashPrefix(uint64_t seed, const IPAddress& prefix) {
+  uint8_t input[kMaxHashInputSize];
+  memcpy(input, &seed, sizeof(seed));
+  memcpy(input + sizeof(seed), prefix.bytes().data(), prefix.size());
+  return base::PersistentHash(input, sizeof(seed) + prefix.size());
+}
+
+}  // namespace
+
+QuicAdmissionController::QuicAdmissionController(const Params& params,
+                                                 const quic::QuicClock* clock)
+    : params_(params),
+      clock_(clock),
+      hash_seed_(quic::QuicRandom::GetInstance()->RandUint64()),
+      cells_(params.sketch_depth * params.sketch_width,
+             Cell{static_cast<float>(params.burst), 0}),
+      num_accepted_(0),
+      num_rejected_(0) {
+  DCHECK_GT(params_.sketch_depth, 0u);
+  DCHECK_GT(params_.sketch_width, 0u);
+  const int64_t now_us = (clock_->ApproximateNow() - quic::QuicTime::Zero())
+                             .ToMicroseconds();
+  for (Cell& cell : cells_)
+    cell.last_refill_us = now_us;
+}
+
+QuicAdmissionController::~QuicAdmissionController() = default;
+
+bool QuicAdmissionController::ShouldAccept(const IPAddress& address) {
+  const IPAddress prefix = GetPrefix(address);
+  const int64_t now_us = (clock_->ApproximateNow() - quic::QuicTime::Zero())
+                             .ToMicroseconds();
+  // Double hashing gives each row an independent column.
+  const uint32_t h1 = HashPrefix(hash_seed_, prefix);
+  const uint32_t h2 = HashPrefix(hash_seed_ + 1, prefix) | 1;
+
+  float tokens = 0;
+  for (size_t row = 0; row < params_.sketch_depth; ++row) {
+    size_t column = (h1 + row * h2) % params_.sketch_width;
+    tokens = std::max(tokens, RefillCell(row, column, now_us)->tokens);
+  }
+
+  if (tokens >= 1) {
+    for (size_t row = 0; row < params_.sketch_depth; ++row) {
+      Cell& cell = cells_[row * params_.sketch_width +
+                          (h1 + row * h2) % params_.sketch_width];
+      cell.tokens = std::max(0.0f, cell.tokens - 1);
+    }
+    ++num_accepted_;
+    return true;
+  }
+
+  ++num_rejected_;
+  RecordRejection(prefix);
+  return false;
+}
+
+base::Value QuicAdmissionController::TopTalkersToValue() const {
+  std::vector<TopTalker> top_talkers = top_talkers_;
+  std::sort(top_talkers.begin(), top_talkers.end(),
+            [](const TopTalker& a, const TopTalker& b) {
+              return a.num_rejected > b.num_rejected;
+            });
+  base::Value list(base::Value::Type::LIST);
+  for (const TopTalker& talker : top_talkers) {
+    base::Value dict(base::Value::Type::DICTIONARY);
+    size_t prefix_length = talker.prefix.IsIPv4() ? params_.ipv4_prefix_length
+                                                  : params_.ipv6_prefix_length;
+    dict.SetStringKey("prefix", talker.prefix.ToString() + "/" +
+                                    base::NumberToString(prefix_length));
+    // base::Value has no 64-bit integers.
+    dict.SetStringKey("rejected_chlos",
+                      base::NumberToString(talker.num_rejected));
+    list.Append(std::move(dict));
+  }
+  return list;
+}
+
+IPAddress QuicAdmissionController::GetPrefix(const IPAddress& address) const {
+  IPAddress v4_or_v6 = address.IsIPv4MappedIPv6()
+                           ? ConvertIPv4MappedIPv6ToIPv4(address)
+                           : address;
+  size_t prefix_length = v4_or_v6.IsIPv4() ? params_.ipv4_prefix_length
+                                           : params_.ipv6_prefix_length;
+  std::vector<uint8_t> bytes(v4_or_v6.bytes().begin(), v4_or_v6.bytes().end());
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    if (prefix_length >= 8 * (i + 1))
+      continue;
+    size_t kept_bits = prefix_length > 8 * i ? prefix_length - 8 * i : 0;
+    bytes[i] &= static_cast<uint8_t>(0xff00 >> kept_bits);
+  }
+  return IPAddress(bytes.data(), bytes.size());
+}
+
+QuicAdmissionController::Cell* QuicAdmissionController::RefillCell(
+    size_t row,
+    size_t column,
+    int64_t now_us) {
+  Cell* cell = &cells_[row * params_.sketch_width + column];
+  if (now_us > cell->last_refill_us) {
+    double refill =
+        (now_us - cell->last_refill_us) * params_.chlos_per_second / 1e6;
+    cell->tokens = static_cast<float>(
+        std::min(params_.burst, static_cast<double>(cell->tokens) + refill));
+    cell->last_refill_us = now_us;
+  }
+  return cell;
+}
+
+void QuicAdmissionController::RecordRejection(const IPAddress& prefix) {
+  // Space-saving heavy hitters: a new prefix replaces the least rejected one
+  // and inherits its count, which bounds the error of every count.
+  for (TopTalker& talker : top_talkers_) {
+    if (talker.prefix == prefix) {
+      ++talker.num_rejected;
+      return;
+    }
+  }
+  if (top_talkers_.size() < params_.max_top_talkers) {
+    top_talkers_.push_back({prefix, 1});
+    return;
+  }
+  if (top_talkers_.empty())
+    return;
+  auto least = std::min_element(top_talkers_.begin(), top_talkers_.end(),
+                                [](const TopTalker& a, const TopTalker& b) {
+                                  return a.num_rejected < b.num_rejected;
+                                });
+  least->prefix = prefix;
+  ++least->num_rejected;
+}
+
+}  // namespace net
@@ -0,0 +1,94 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_ADMISSION_CONTROLLER_H_
+#define NET_TOOLS_QUIC_QUIC_ADMISSION_CONTROLLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/values.h"
+#include "net/base/ip_address.h"
+
+namespace quic {
+class QuicClock;
+}  // namespace quic
+namespace net {
+
+// Limits the rate of client hellos a server handles per source prefix, so
+// that a few abusive prefixes cannot consume the server's handshake CPU.
+//
+// Each prefix has a token bucket refilled at |chlos_per_second|. Buckets live
+// in a count-min sketch of fixed size: a prefix maps to one cell in each row,
+// and its tokens are those of its fullest cell, so hash collisions can only
+// make a prefix look less loaded than it is.
+//
+// Only clients whose address has been validated before a session exists,
+// like those QuicAdmissionDispatcher sent a RETRY, may bypass the limit. QUIC
+// crypto source address tokens are only validated later in the handshake, so
+// an unchecked token would let any client bypass it.
+class QuicAdmissionController {
+ public:
+  struct Params {
+    double chlos_per_second = 100;
+    double burst = 200;
+    size_t ipv4_prefix_length = 24;
+    size_t ipv6_prefix_length = 48;
+    size_t sketch_depth = 4;
+    size_t sketch_width = 4096;
+    // Number of prefixes reported by TopTalkersToValue().
+    size_t max_top_talkers = 16;
+  };
+
+  QuicAdmissionController(const Params& params, const quic::QuicClock* clock);
+  ~QuicAdmissionController();
+
+  // Returns true if a client hello from |address| should be processed.
+  bool ShouldAccept(const IPAddress& address);
+
+  // Returns the prefixes with the most rejected client hellos, most first.
+  // Counts are approximate once more prefixes than |max_top_talkers| have
+  // been rejected.
+  base::Value TopTalkersToValue() const;
+
+  uint64_t num_accepted() const { return num_accepted_; }
+  uint64_t num_rejected() const { return num_rejected_; }
+
+ private:
+  struct Cell {
+    float tokens;
+    int64_t last_refill_us;
+  };
+
+  struct TopTalker {
+    IPAddress prefix;
+    uint64_t num_rejected;
+  };
+
+  IPAddress GetPrefix(const IPAddress& address) const;
+  // Refills |cell| up to |now_us| and returns it.
+  Cell* RefillCell(size_t row, size_t column, int64_t now_us);
+  void RecordRejection(const IPAddress& prefix);
+
+  const Params params_;
+  const quic::QuicClock* clock_;  // Not owned.
+  // Randomizes the sketch columns so that attackers cannot choose prefixes
+  // that collide with a victim's.
+  const uint64_t hash_seed_;
+  std::vector<Cell> cells_;
+  std::vector<TopTalker> top_talkers_;
+
+  uint64_t num_accepted_;
+  uint64_t num_rejected_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicAdmissionController);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_ADMISSION_CONTROLLER_H_
@@ -0,0 +1,97 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_admission_controller.h"
+
+#include "net/third_party/quiche/src/quic/test_tools/mock_clock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+class QuicAdmissionControllerTest : public ::testing::Test {
+ protected:
+  QuicAdmissionControllerTest() {
+    params_.chlos_per_second = 10;
+    params_.burst = 5;
+    params_.max_top_talkers = 2;
+    controller_ = std::make_unique<QuicAdmissionController>(params_, &clock_);
+  }
+
+  // Returns the number of client hellos from |address| accepted out of
+  // |count|.
+  int Send(const IPAddress& address, int count) {
+    int accepted = 0;
+    for (int i = 0; i < count; ++i) {
+      if (controller_->ShouldAccept(address))
+        ++accepted;
+    }
+    return accepted;
+  }
+
+  quic::MockClock clock_;
+  QuicAdmissionController::Params params_;
+  std::unique_ptr<QuicAdmissionController> controller_;
+};
+
+TEST_F(QuicAdmissionControllerTest, LimitsBurst) {
+  EXPECT_EQ(5, Send(IPAddress(192, 0, 2, 1), 8));
+  EXPECT_EQ(5u, controller_->num_accepted());
+  EXPECT_EQ(3u, controller_->num_rejected());
+}
+
+TEST_F(QuicAdmissionControllerTest, Refills) {
+  EXPECT_EQ(5, Send(IPAddress(192, 0, 2, 1), 5));
+  EXPECT_EQ(0, Send(IPAddress(192, 0, 2, 1), 1));
+
+  // 10 per second.
+  clock_.AdvanceTime(quic::QuicTime::Delta::FromMilliseconds(200));
+  EXPECT_EQ(2, Send(IPAddress(192, 0, 2, 1), 5));
+
+  // Never more than the burst.
+  clock_.AdvanceTime(quic::QuicTime::Delta::FromSeconds(60));
+  EXPECT_EQ(5, Send(IPAddress(192, 0, 2, 1), 10));
+}
+
+TEST_F(QuicAdmissionControllerTest, SharesBudgetWithinPrefix) {
+  EXPECT_EQ(3, Send(IPAddress(192, 0, 2, 1), 3));
+  EXPECT_EQ(2, Send(IPAddress(192, 0, 2, 200), 3));
+  // Other prefixes are unaffected.
+  EXPECT_EQ(5, Send(IPAddress(192, 0, 3, 1), 5));
+  // IPv4-mapped addresses share the IPv4 prefix.
+  EXPECT_EQ(0, Send(ConvertIPv4ToIPv4MappedIPv6(IPAddress(192, 0, 2, 7)), 1));
+}
+
+TEST_F(QuicAdmissionControllerTest, Ipv6Prefix) {
+  IPAddress address1;
+  IPAddress address2;
+  IPAddress address3;
+  ASSERT_TRUE(address1.AssignFromIPLiteral("2001:db8:1::1"));
+  ASSERT_TRUE(address2.AssignFromIPLiteral("2001:db8:1:ffff::2"));
+  ASSERT_TRUE(address3.AssignFromIPLiteral("2001:db8:2::1"));
+  EXPECT_EQ(5, Send(address1, 5));
+  EXPECT_EQ(0, Send(address2, 1));
+  EXPECT_EQ(5, Send(address3, 5));
+}
+
+TEST_F(QuicAdmissionControllerTest, TopTalkers) {
+  Send(IPAddress(192, 0, 2, 1), 5 + 3);
+  Send(IPAddress(198, 51, 100, 1), 5 + 7);
+  Send(IPAddress(203, 0, 113, 1), 5 + 1);
+
+  base::Value top_talkers = controller_->TopTalkersToValue();
+  ASSERT_TRUE(top_talkers.is_list());
+  const auto& list = top_talkers.GetList();
+  ASSERT_EQ(2u, list.size());
+  EXPECT_EQ("198.51.100.0/24", *list[0].FindStringKey("prefix"));
+  EXPECT_EQ("7", *list[0].FindStringKey("rejected_chlos"));
+  // 203.0.113.0/24 replaced 192.0.2.0/24, inheriting its count.
+  EXPECT_EQ("203.0.113.0/24", *list[1].FindStringKey("prefix"));
+  EXPECT_EQ("4", *list[1].FindStringKey("rejected_chlos"));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -0,0 +1,343 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_admission_dispatcher.h"
+
+#include <utility>
+
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "crypto/hmac.h"
+#include "crypto/secure_util.h"
+#include "net/quic/address_utils.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/core/quic_clock.h"
+#include "net/third_party/quiche/src/quic/core/quic_connection.h"
+#include "net/third_party/quiche/src/quic/core/quic_data_reader.h"
+#include "net/third_party/quiche/src/quic/core/quic_data_writer.h"
+#include "net/third_party/quiche/src/quic/core/quic_framer.h"
+#include "net/third_party/quiche/src/quic/core/quic_time_wait_list_manager.h"
+#include "net/third_party/quiche/src/quic/tools/quic_simple_server_session.h"
+#include "third_party/boringssl/src/include/openssl/aead.h"
+
+namespace net {
+
+namespace {
+
+const size_t kTokenKeySize = 32;
+const size_t kTokenMacSize = 16;
+// Bounds the connections remembered between admission and session creation.
+const size_t kMaxAdmittedConnections = 1024;
+
+// Key and nonce of the RETRY integrity tag of IETF drafts 25 to 28, which are
+// also used by T050.
+const uint8_t kRetryIntegrityKey[] = {0x4d, 0x32, 0xec, 0xdb, 0x2a, 0x21,
+                                      0x33, 0xc8, 0x41, 0xe4, 0x04, 0x3d,
+                                      0xf2, 0x7d, 0x44, 0x30};
+const uint8_t kRetryIntegrityNonce[] = {0x4d, 0x16, 0x11, 0xd0, 0x55, 0x13,
+                                        0xa5, 0x52, 0xc5, 0x87, 0xd5, 0x75};
+const size_t kRetryIntegrityTagSize = 16;
+
+// Long header form and fixed bits, and the RETRY packet type.
+const uint8_t kRetryFirstByte = 0x80 | 0x40 | (0x03 << 4);
+
+}  // namespace
+
+const quic::QuicTime::Delta QuicRetryTokenMinter::kLifetime =
+    quic::QuicTime::Delta::FromSeconds(10);
+
+QuicRetryTokenMinter::QuicRetryTokenMinter(const quic::QuicClock* clock,
+                                           quic::QuicRandom* random)
+    : clock_(clock), key_(kTokenKeySize, '\0') {
+  random->RandBytes(base::data(key_), key_.size());
+}
+
+QuicRetryTokenMinter::~QuicRetryTokenMinter() = default;
+
+std::string QuicRetryTokenMinter::Mint(
+    const quic::QuicIpAddress& client_address,
+    quic::QuicConnectionId original_connection_id,
+    quic::QuicConnectionId retry_connection_id) const {
+  char buffer[sizeof(uint64_t) + 1 +
+              quic::kQuicMaxConnectionIdAllVersionsLength];
+  quic::QuicDataWriter writer(sizeof(buffer), buffer);
+  const int64_t issue_time_us =
+      (clock_->ApproximateNow() - quic::QuicTime::Zero()).ToMicroseconds();
+  if (!writer.WriteUInt64(issue_time_us) ||
+      !writer.WriteLengthPrefixedConnectionId(original_connection_id)) {
+    return std::string();
+  }
+  std::string token(buffer, writer.length());
+  token += Sign(client_address, retry_connection_id, token);
+  return token;
+}
+
+bool QuicRetryTokenMinter::Validate(
+    quiche::QuicheStringPiece token,
+    const quic::QuicIpAddress& client_address,
+    quic::QuicConnectionId retry_connection_id,
+    quic::QuicConnectionId* original_connection_id) const {
+  if (token.size() <= kTokenMacSize)
+    return false;
+  quiche::QuicheStringPiece contents =
+      token.substr(0, token.size() - kTokenMacSize);
+  std::string mac = Sign(client_address, retry_connection_id, contents);
+  if (mac.size() != kTokenMacSize ||
+      !crypto::SecureMemEqual(mac.data(), token.data() + contents.size(),
+                              kTokenMacSize)) {
+    return false;
+  }
+
+  quic::QuicDataReader reader(contents.data(), contents.size());
+  uint64_t issue_time_us;
+  quic::QuicConnectionId connection_id;
+  if (!reader.ReadUInt64(&issue_time_us) ||
+      !reader.ReadLengthPrefixedConnectionId(&connection_id) ||
+      !reader.IsDoneReading()) {
+    return false;
+  }
+  const quic::QuicTime issue_time =
+      quic::QuicTime::Zero() +
+      quic::QuicTime::Delta::FromMicroseconds(issue_time_us);
+  const quic::QuicTime now = clock_->ApproximateNow();
+  if (issue_time > now || now - issue_time > kLifetime)
+    return false;
+  *original_connection_id = connection_id;
+  return true;
+}
+
+std::string QuicRetryTokenMinter::Sign(
+    const quic::QuicIpAddress& client_address,
+    quic::QuicConnectionId retry_connection_id,
+    quiche::QuicheStringPiece contents) const {
+  crypto::HMAC hmac(crypto::HMAC::SHA256);
+  unsigned char mac[kTokenMacSize];
+  std::string data = client_address.ToPackedString();
+  data.push_back(static_cast<char>(retry_connection_id.length()));
+  data.append(retry_connection_id.data(), retry_connection_id.length());
+  data.append(contents.data(), contents.size());
+  if (!hmac.Init(key_) || !hmac.Sign(data, mac, sizeof(mac)))
+    return std::string();
+  return std::string(reinterpret_cast<const char*>(mac), sizeof(mac));
+}
+
+std::unique_ptr<quic::QuicEncryptedPacket> BuildQuicRetryPacket(
+    const quic::ParsedQuicVersion& version,
+    quic::QuicConnectionId original_connection_id,
+    quic::QuicConnectionId client_connection_id,
+    quic::QuicConnectionId retry_connection_id,
+    quiche::QuicheStringPiece token,
+    quic::QuicRandom* random) {
+  DCHECK_EQ(quic::PROTOCOL_TLS1_3, version.handshake_protocol);
+  std::unique_ptr<char[]> buffer(new char[quic::kMaxOutgoingPacketSize]);
+  quic::QuicDataWriter writer(quic::kMaxOutgoingPacketSize, buffer.get());
+  // The low four bits of the first byte are unused and randomized.
+  if (!writer.WriteUInt8(kRetryFirstByte | (random->RandUint64() & 0x0f)) ||
+      !writer.WriteUInt32(quic::CreateQuicVersionLabel(version)) ||
+      !writer.WriteLengthPrefixedConnectionId(client_connection_id) ||
+      !writer.WriteLengthPrefixedConnectionId(retry_connection_id) ||
+      !writer.WriteBytes(token.data(), token.size())) {
+    return nullptr;
+  }
+
+  // The integrity tag authenticates the packet and the client's original
+  // destination connection ID, so that only someone who saw the Initial can
+  // make the client retry.
+  std::string pseudo_packet(
+      1, static_cast<char>(original_connection_id.length()));
+  pseudo_packet.append(original_connection_id.data(),
+                       original_connection_id.length());
+  pseudo_packet.append(buffer.get(), writer.length());
+  bssl::ScopedEVP_AEAD_CTX ctx;
+  uint8_t tag[kRetryIntegrityTagSize];
+  size_t tag_length;
+  if (!EVP_AEAD_CTX_init(ctx.get(), EVP_aead_aes_128_gcm(), kRetryIntegrityKey,
+                         sizeof(kRetryIntegrityKey), sizeof(tag), nullptr) ||
+      !EVP_AEAD_CTX_seal(
+          ctx.get(), tag, &tag_length, sizeof(tag), kRetryIntegrityNonce,
+          sizeof(kRetryIntegrityNonce), nullptr, 0,
+          reinterpret_cast<const uint8_t*>(pseudo_packet.data()),
+          pseudo_packet.size()) ||
+      !writer.WriteBytes(tag, tag_length)) {
+    return nullptr;
+  }
+  const size_t length = writer.length();
+  return std::make_unique<quic::QuicEncryptedPacket>(buffer.release(), length,
+                                                     /*owns_buffer=*/true);
+}
+
+QuicAdmissionDispatcher::QuicAdmissionDispatcher(
+    const quic::QuicConfig* config,
+    const quic::QuicCryptoServerConfig* crypto_config,
+    quic::QuicVersionManager* version_manager,
+    std::unique_ptr<quic::QuicConnectionHelperInterface> helper,
+    std::unique_ptr<quic::QuicCryptoServerStreamBase::Helper> session_helper,
+    std::unique_ptr<quic::QuicAlarmFactory> alarm_factory,
+    quic::QuicSimpleServerBackend* quic_simple_server_backend,
+    uint8_t expected_server_connection_id_length,
+    bool compact_time_wait_list,
+    QuicAdmissionController* admission_controller)
+    : QuicCompactTimeWaitDispatcher(config,
+                                    crypto_config,
+                                    version_manager,
+                                    std::move(helper),
+                                    std::move(session_helper),
+                                    std::move(alarm_factory),
+                                    quic_simple_server_backend,
+                                    expected_server_connection_id_length,
+                                    compact_time_wait_list),
+      admission_controller_(admission_controller),
+      token_minter_(this->helper()->GetClock(),
+                    this->helper()->GetRandomGenerator()),
+      admitted_connections_(kMaxAdmittedConnections),
+      num_retries_sent_(0),
+      num_retries_validated_(0),
+      num_dropped_(0) {}
+
+QuicAdmissionDispatcher::~QuicAdmissionDispatcher() = default;
+
+bool QuicAdmissionDispatcher::OnFailedToDispatchPacket(
+    const quic::ReceivedPacketInfo& packet_info) {
+  if (QuicCompactTimeWaitDispatcher::OnFailedToDispatchPacket(packet_info))
+    return true;
+  if (!admission_controller_ || !packet_info.version_flag)
+    return false;
+  // Only packets that may open a connection are admitted. The dispatcher
+  // drops or buffers the others without creating a session.
+  if (packet_info.form == quic::IETF_QUIC_LONG_HEADER_PACKET &&
+      packet_info.long_packet_type != quic::INITIAL) {
+    return false;
+  }
+  // Unsupported versions are answered with version negotiation, and closed
+  // connections from the time-wait list.
+  if (!base::Contains(GetSupportedVersions(), packet_info.version) ||
+      time_wait_list_manager()->IsConnectionIdInTimeWait(
+          packet_info.destination_connection_id)) {
+    return false;
+  }
+  return MaybeRejectNewConnection(packet_info);
+}
+
+std::unique_ptr<quic::QuicSession> QuicAdmissionDispatcher::CreateQuicSession(
+    quic::QuicConnectionId connection_id,
+    const quic::QuicSocketAddress& client_address,
+    quiche::QuicheStringPiece alpn,
+    const quic::ParsedQuicVersion& version) {
+  // The session takes ownership of |connection|.
+  quic::QuicConnection* connection = new quic::QuicConnection(
+      connection_id, client_address, helper(), alarm_factory(), writer(),
+      /*owns_writer=*/false, quic::Perspective::IS_SERVER,
+      quic::ParsedQuicVersionVector{version});
+  auto session = std::make_unique<quic::QuicSimpleServerSession>(
+      TakeSessionConfig(connection_id, version), GetSupportedVersions(),
+      connection, this, session_helper(), crypto_config(),
+      compressed_certs_cache(), server_backend());
+  session->Initialize();
+  return session;
+}
+
+quic::QuicConfig QuicAdmissionDispatcher::TakeSessionConfig(
+    quic::QuicConnectionId connection_id,
+    const quic::ParsedQuicVersion& version) {
+  quic::QuicConfig session_config = config();
+  auto it = admitted_connections_.Peek(connection_id);
+  if (it == admitted_connections_.end())
+    return session_config;
+  if (!it->second.IsEmpty()) {
+    // Clients that were sent a RETRY check that the server saw their
+    // original Initial, and, from draft 28 on, chose the RETRY's connection
+    // ID.
+    session_config.SetOriginalConnectionIdToSend(it->second);
+    if (version.AuthenticatesHandshakeConnectionIds())
+      session_config.SetRetrySourceConnectionIdToSend(connection_id);
+  }
+  admitted_connections_.Erase(it);
+  return session_config;
+}
+
+bool QuicAdmissionDispatcher::MaybeRejectNewConnection(
+    const quic::ReceivedPacketInfo& packet_info) {
+  const quic::QuicConnectionId& connection_id =
+      packet_info.destination_connection_id;
+  // Later packets of a client hello that spans several packets were admitted
+  // with the first.
+  if (admitted_connections_.Peek(connection_id) != admitted_connections_.end())
+    return false;
+
+  quic::QuicConnectionId original_connection_id;
+  if (HasValidRetryToken(packet_info, &original_connection_id)) {
+    ++num_retries_validated_;
+    admitted_connections_.Put(connection_id, original_connection_id);
+    return false;
+  }
+  if (admission_controller_->ShouldAccept(
+          ToIPAddress(packet_info.peer_address.host()))) {
+    admitted_connections_.Put(connection_id, quic::EmptyQuicConnectionId());
+    return false;
+  }
+  if (packet_info.version.handshake_protocol == quic::PROTOCOL_TLS1_3) {
+    SendRetry(packet_info);
+    return true;
+  }
+  ++num_dropped_;
+  return true;
+}
+
+bool QuicAdmissionDispatcher::HasValidRetryToken(
+    const quic::ReceivedPacketInfo& packet_info,
+    quic::QuicConnectionId* original_connection_id) {
+  if (packet_info.version.handshake_protocol != quic::PROTOCOL_TLS1_3)
+    return false;
+  // The dispatcher does not keep the token, so the header is parsed again.
+  // Long headers carry the length of their connection IDs, so the expected
+  // length does not matter.
+  quic::PacketHeaderFormat format;
+  quic::QuicLongHeaderType long_packet_type;
+  bool version_present;
+  bool has_length_prefix;
+  quic::QuicVersionLabel version_label;
+  quic::ParsedQuicVersion version = quic::UnsupportedQuicVersion();
+  quic::QuicConnectionId destination_connection_id;
+  quic::QuicConnectionId source_connection_id;
+  bool retry_token_present = false;
+  quiche::QuicheStringPiece retry_token;
+  std::string detailed_error;
+  if (quic::QuicFramer::ParsePublicHeaderDispatcher(
+          packet_info.packet, quic::kQuicDefaultConnectionIdLength, &format,
+          &long_packet_type, &version_present, &has_length_prefix,
+          &version_label, &version, &destination_connection_id,
+          &source_connection_id, &retry_token_present, &retry_token,
+          &detailed_error) != quic::QUIC_NO_ERROR ||
+      !retry_token_present) {
+    return false;
+  }
+  return token_minter_.Validate(retry_token, packet_info.peer_address.host(),
+                                destination_connection_id,
+                                original_connection_id);
+}
+
+void QuicAdmissionDispatcher::SendRetry(
+    const quic::ReceivedPacketInfo& packet_info) {
+  const quic::QuicConnectionId retry_connection_id =
+      GenerateNewServerConnectionId(packet_info.version,
+                                    packet_info.destination_connection_id);
+  std::unique_ptr<quic::QuicEncryptedPacket> packet = BuildQuicRetryPacket(
+      packet_info.version, packet_info.destination_connection_id,
+      packet_info.source_connection_id, retry_connection_id,
+      token_minter_.Mint(packet_info.peer_address.host(),
+                         packet_info.destination_connection_id,
+                         retry_connection_id),
+      helper()->GetRandomGenerator());
+  if (!packet) {
+    ++num_dropped_;
+    return;
+  }
+  // A RETRY is smaller than the padded Initial it answers, so it cannot be
+  // used for amplification.
+  time_wait_list_manager()->SendPacket(packet_info.self_address,
+                                       packet_info.peer_address, *packet);
+  ++num_retries_sent_;
+}
+
+}  // namespace net
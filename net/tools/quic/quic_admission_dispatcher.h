@@ -0,0 +1,158 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_ADMISSION_DISPATCHER_H_
+#define NET_TOOLS_QUIC_QUIC_ADMISSION_DISPATCHER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "base/containers/mru_cache.h"
+#include "base/macros.h"
+#include "net/third_party/quiche/src/common/platform/api/quiche_string_piece.h"
+#include "net/third_party/quiche/src/quic/core/quic_config.h"
+#include "net/third_party/quiche/src/quic/core/quic_connection_id.h"
+#include "net/third_party/quiche/src/quic/core/quic_packets.h"
+#include "net/third_party/quiche/src/quic/core/quic_versions.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_socket_address.h"
+#include "net/tools/quic/quic_admission_controller.h"
+#include "net/tools/quic/quic_compact_time_wait_list.h"
+
+namespace quic {
+class QuicClock;
+class QuicRandom;
+}  // namespace quic
+namespace net {
+
+// Mints and validates the address validation tokens a server sends in IETF
+// RETRY packets. A token is bound to the client's IP address and to the
+// connection ID the server chose in the RETRY, carries the client's original
+// destination connection ID, and expires after kLifetime. Tokens are
+// authenticated with a random key, so they are only valid for the process
+// that minted them.
+class QuicRetryTokenMinter {
+ public:
+  static const quic::QuicTime::Delta kLifetime;
+
+  QuicRetryTokenMinter(const quic::QuicClock* clock, quic::QuicRandom* random);
+  ~QuicRetryTokenMinter();
+
+  std::string Mint(const quic::QuicIpAddress& client_address,
+                   quic::QuicConnectionId original_connection_id,
+                   quic::QuicConnectionId retry_connection_id) const;
+
+  // Returns true if |token| was minted for |client_address| and
+  // |retry_connection_id| less than kLifetime ago, and sets
+  // |original_connection_id|.
+  bool Validate(quiche::QuicheStringPiece token,
+                const quic::QuicIpAddress& client_address,
+                quic::QuicConnectionId retry_connection_id,
+                quic::QuicConnectionId* original_connection_id) const;
+
+ private:
+  // Returns the truncated MAC of |client_address|, |retry_connection_id| and
+  // the token |contents|.
+  std::string Sign(const quic::QuicIpAddress& client_address,
+                   quic::QuicConnectionId retry_connection_id,
+                   quiche::QuicheStringPiece contents) const;
+
+  const quic::QuicClock* clock_;  // Not owned.
+  std::string key_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicRetryTokenMinter);
+};
+
+// Returns a RETRY packet of |version|, which must use TLS, that answers an
+// Initial sent from |client_connection_id| to |original_connection_id| and
+// asks the client to retry to |retry_connection_id| with |token|. Returns
+// nullptr on failure.
+std::unique_ptr<quic::QuicEncryptedPacket> BuildQuicRetryPacket(
+    const quic::ParsedQuicVersion& version,
+    quic::QuicConnectionId original_connection_id,
+    quic::QuicConnectionId client_connection_id,
+    quic::QuicConnectionId retry_connection_id,
+    quiche::QuicheStringPiece token,
+    quic::QuicRandom* random);
+
+// A dispatcher that rate limits new connections per source prefix with a
+// QuicAdmissionController before any session is created for them, whatever
+// their handshake protocol.
+//
+// An IETF Initial from a prefix that is over budget is answered with a RETRY,
+// and the Initial the client sends back with the RETRY's token is admitted
+// without being charged: the client has proven it owns its address, so it is
+// not spoofing someone else's budget away. QUIC crypto has no stateless retry
+// in this QUIC version, so over-budget Google QUIC client hellos are dropped;
+// clients retransmit them once the prefix's budget refills.
+//
+// Subclasses that create their own sessions must build them with
+// TakeSessionConfig(), so that clients sent a RETRY can authenticate it.
+class QuicAdmissionDispatcher : public QuicCompactTimeWaitDispatcher {
+ public:
+  // |admission_controller|, which may be null to admit every connection,
+  // must outlive the dispatcher.
+  QuicAdmissionDispatcher(
+      const quic::QuicConfig* config,
+      const quic::QuicCryptoServerConfig* crypto_config,
+      quic::QuicVersionManager* version_manager,
+      std::unique_ptr<quic::QuicConnectionHelperInterface> helper,
+      std::unique_ptr<quic::QuicCryptoServerStreamBase::Helper> session_helper,
+      std::unique_ptr<quic::QuicAlarmFactory> alarm_factory,
+      quic::QuicSimpleServerBackend* quic_simple_server_backend,
+      uint8_t expected_server_connection_id_length,
+      bool compact_time_wait_list,
+      QuicAdmissionController* admission_controller);
+  ~QuicAdmissionDispatcher() override;
+
+  uint64_t num_retries_sent() const { return num_retries_sent_; }
+  uint64_t num_retries_validated() const { return num_retries_validated_; }
+  uint64_t num_dropped() const { return num_dropped_; }
+
+ protected:
+  // quic::QuicSimpleDispatcher methods:
+  bool OnFailedToDispatchPacket(
+      const quic::ReceivedPacketInfo& packet_info) override;
+  std::unique_ptr<quic::QuicSession> CreateQuicSession(
+      quic::QuicConnectionId connection_id,
+      const quic::QuicSocketAddress& client_address,
+      quiche::QuicheStringPiece alpn,
+      const quic::ParsedQuicVersion& version) override;
+
+  // Returns the config of a new session for |connection_id|: config(), plus
+  // the connection IDs the client checks if it was sent a RETRY.
+  quic::QuicConfig TakeSessionConfig(quic::QuicConnectionId connection_id,
+                                     const quic::ParsedQuicVersion& version);
+
+ private:
+  // Returns true if the packet, which opens a new connection, was dropped
+  // or answered with a RETRY.
+  bool MaybeRejectNewConnection(const quic::ReceivedPacketInfo& packet_info);
+  // Returns true if the packet's header carries a retry token minted for the
+  // packet's sender and destination connection ID, and sets
+  // |original_connection_id|.
+  bool HasValidRetryToken(const quic::ReceivedPacketInfo& packet_info,
+                          quic::QuicConnectionId* original_connection_id);
+  void SendRetry(const quic::ReceivedPacketInfo& packet_info);
+
+  QuicAdmissionController* admission_controller_;  // Not owned.
+  QuicRetryTokenMinter token_minter_;
+  // Connections admitted until their session is created, with the original
+  // destination connection ID of those admitted with a retry token, or an
+  // empty one. Bounded, as clients may never complete their client hello.
+  base::MRUCache<quic::QuicConnectionId, quic::QuicConnectionId>
+      admitted_connections_;
+
+  uint64_t num_retries_sent_;
+  uint64_t num_retries_validated_;
+  uint64_t num_dropped_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicAdmissionDispatcher);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_ADMISSION_DISPATCHER_H_
@@ -0,0 +1,238 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_admission_dispatcher.h"
+
+#include <memory>
+#include <string>
+
+#include "net/third_party/quiche/src/quic/core/crypto/crypto_utils.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_crypto_server_config.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/core/quic_version_manager.h"
+#include "net/third_party/quiche/src/quic/test_tools/crypto_test_utils.h"
+#include "net/third_party/quiche/src/quic/test_tools/mock_clock.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_dispatcher_peer.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_test_utils.h"
+#include "net/third_party/quiche/src/quic/tools/quic_memory_cache_backend.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using testing::_;
+using testing::Invoke;
+
+namespace net {
+namespace test {
+namespace {
+
+const size_t kRetryIntegrityTagSize = 16;
+
+class QuicRetryTokenMinterTest : public ::testing::Test {
+ protected:
+  QuicRetryTokenMinterTest()
+      : minter_(&clock_, quic::QuicRandom::GetInstance()),
+        client_address_(quic::QuicIpAddress::Loopback4()),
+        original_connection_id_(quic::test::TestConnectionId(1)),
+        retry_connection_id_(quic::test::TestConnectionId(2)) {
+    clock_.AdvanceTime(quic::QuicTime::Delta::FromSeconds(1));
+  }
+
+  bool Validate(const std::string& token,
+                const quic::QuicIpAddress& client_address,
+                quic::QuicConnectionId retry_connection_id) {
+    quic::QuicConnectionId original_connection_id;
+    if (!minter_.Validate(token, client_address, retry_connection_id,
+                          &original_connection_id)) {
+      return false;
+    }
+    EXPECT_EQ(original_connection_id_, original_connection_id);
+    return true;
+  }
+
+  quic::MockClock clock_;
+  QuicRetryTokenMinter minter_;
+  const quic::QuicIpAddress client_address_;
+  const quic::QuicConnectionId original_connection_id_;
+  const quic::QuicConnectionId retry_connection_id_;
+};
+
+TEST_F(QuicRetryTokenMinterTest, ValidatesOwnTokens) {
+  std::string token = minter_.Mint(client_address_, original_connection_id_,
+                                   retry_connection_id_);
+  EXPECT_TRUE(Validate(token, client_address_, retry_connection_id_));
+}
+
+TEST_F(QuicRetryTokenMinterTest, RejectsOtherClients) {
+  std::string token = minter_.Mint(client_address_, original_connection_id_,
+                                   retry_connection_id_);
+  EXPECT_FALSE(
+      Validate(token, quic::QuicIpAddress::Loopback6(), retry_connection_id_));
+  EXPECT_FALSE(
+      Validate(token, client_address_, quic::test::TestConnectionId(3)));
+}
+
+TEST_F(QuicRetryTokenMinterTest, RejectsTamperedTokens) {
+  std::string token = minter_.Mint(client_address_, original_connection_id_,
+                                   retry_connection_id_);
+  for (size_t i = 0; i < token.size(); ++i) {
+    std::string tampered = token;
+    tampered[i] ^= 0x01;
+    EXPECT_FALSE(Validate(tampered, client_address_, retry_connection_id_));
+  }
+  EXPECT_FALSE(Validate(token.substr(1), client_address_,
+                        retry_connection_id_));
+  EXPECT_FALSE(Validate(std::string(), client_address_,
+                        retry_connection_id_));
+
+  QuicRetryTokenMinter other_minter(&clock_, quic::QuicRandom::GetInstance());
+  quic::QuicConnectionId original_connection_id;
+  EXPECT_FALSE(other_minter.Validate(token, client_address_,
+                                     retry_connection_id_,
+                                     &original_connection_id));
+}
+
+TEST_F(QuicRetryTokenMinterTest, RejectsExpiredTokens) {
+  std::string token = minter_.Mint(client_address_, original_connection_id_,
+                                   retry_connection_id_);
+  clock_.AdvanceTime(QuicRetryTokenMinter::kLifetime);
+  EXPECT_TRUE(Validate(token, client_address_, retry_connection_id_));
+  clock_.AdvanceTime(quic::QuicTime::Delta::FromMilliseconds(1));
+  EXPECT_FALSE(Validate(token, client_address_, retry_connection_id_));
+}
+
+class QuicAdmissionDispatcherTest : public ::testing::Test {
+ protected:
+  QuicAdmissionDispatcherTest()
+      : crypto_config_(quic::QuicCryptoServerConfig::TESTING,
+                       quic::QuicRandom::GetInstance(),
+                       quic::test::crypto_test_utils::ProofSourceForTesting(),
+                       quic::KeyExchangeSource::Default()),
+        version_manager_(quic::AllSupportedVersions()),
+        helper_(new quic::test::MockQuicConnectionHelper),
+        admission_controller_(AdmitOne(), helper_->GetClock()),
+        dispatcher_(&config_,
+                    &crypto_config_,
+                    &version_manager_,
+                    std::unique_ptr<quic::QuicConnectionHelperInterface>(
+                        helper_),
+                    std::make_unique<testing::NiceMock<
+                        quic::test::MockQuicCryptoServerStreamHelper>>(),
+                    std::make_unique<quic::test::MockAlarmFactory>(),
+                    &backend_,
+                    quic::kQuicDefaultConnectionIdLength,
+                    /*compact_time_wait_list=*/false,
+                    &admission_controller_),
+        writer_(new testing::NiceMock<quic::test::MockPacketWriter>),
+        self_address_(quic::QuicIpAddress::Loopback4(), 443),
+        peer_address_(quic::QuicIpAddress::Loopback4(), 12345) {
+    quic::QuicEnableVersion(quic::ParsedQuicVersion::Q050());
+    quic::QuicEnableVersion(quic::ParsedQuicVersion::Draft27());
+    // Takes ownership of |writer_|.
+    dispatcher_.InitializeWithWriter(writer_);
+    helper_->AdvanceTime(quic::QuicTime::Delta::FromSeconds(1));
+  }
+
+  // Admits a single connection per prefix, ever.
+  static QuicAdmissionController::Params AdmitOne() {
+    QuicAdmissionController::Params params;
+    params.chlos_per_second = 0;
+    params.burst = 1;
+    return params;
+  }
+
+  void ProcessInitial(const quic::ParsedQuicVersion& version,
+                      quic::QuicConnectionId connection_id) {
+    quic::ParsedQuicVersionVector versions = {version};
+    std::unique_ptr<quic::QuicEncryptedPacket> packet(
+        quic::test::ConstructEncryptedPacket(
+            connection_id, quic::test::TestConnectionId(100),
+            /*version_flag=*/true, /*reset_flag=*/false, /*packet_number=*/1,
+            "data", /*full_padding=*/true, quic::CONNECTION_ID_PRESENT,
+            quic::CONNECTION_ID_PRESENT, quic::PACKET_4BYTE_PACKET_NUMBER,
+            &versions));
+    std::unique_ptr<quic::QuicReceivedPacket> received(
+        quic::test::ConstructReceivedPacket(*packet,
+                                            helper_->GetClock()->Now()));
+    dispatcher_.ProcessPacket(self_address_, peer_address_, *received);
+  }
+
+  bool HasBufferedPackets(quic::QuicConnectionId connection_id) {
+    return quic::test::QuicDispatcherPeer::GetBufferedPackets(&dispatcher_)
+        ->HasBufferedPackets(connection_id);
+  }
+
+  quic::QuicConfig config_;
+  quic::QuicCryptoServerConfig crypto_config_;
+  quic::QuicVersionManager version_manager_;
+  quic::QuicMemoryCacheBackend backend_;
+  quic::test::MockQuicConnectionHelper* helper_;  // Owned by |dispatcher_|.
+  QuicAdmissionController admission_controller_;
+  QuicAdmissionDispatcher dispatcher_;
+  quic::test::MockPacketWriter* writer_;  // Owned by |dispatcher_|.
+  quic::QuicSocketAddress self_address_;
+  quic::QuicSocketAddress peer_address_;
+};
+
+TEST_F(QuicAdmissionDispatcherTest, AdmitsAllPacketsOfAdmittedConnections) {
+  quic::QuicConnectionId connection_id = quic::test::TestConnectionId(1);
+  EXPECT_CALL(*writer_, WritePacket(_, _, _, _, _)).Times(0);
+  // The packets are not full client hellos, so they are buffered until the
+  // rest of the client hello arrives.
+  ProcessInitial(quic::ParsedQuicVersion::Draft27(), connection_id);
+  EXPECT_TRUE(HasBufferedPackets(connection_id));
+  ProcessInitial(quic::ParsedQuicVersion::Draft27(), connection_id);
+  EXPECT_EQ(1u, admission_controller_.num_accepted());
+  EXPECT_EQ(0u, admission_controller_.num_rejected());
+}
+
+TEST_F(QuicAdmissionDispatcherTest, DropsGoogleQuicClientHellosOverBudget) {
+  ProcessInitial(quic::ParsedQuicVersion::Q050(),
+                 quic::test::TestConnectionId(1));
+
+  quic::QuicConnectionId connection_id = quic::test::TestConnectionId(2);
+  EXPECT_CALL(*writer_, WritePacket(_, _, _, _, _)).Times(0);
+  ProcessInitial(quic::ParsedQuicVersion::Q050(), connection_id);
+  EXPECT_FALSE(HasBufferedPackets(connection_id));
+  EXPECT_EQ(0u, dispatcher_.NumSessions());
+  EXPECT_EQ(1u, admission_controller_.num_rejected());
+  EXPECT_EQ(1u, dispatcher_.num_dropped());
+  EXPECT_EQ(0u, dispatcher_.num_retries_sent());
+}
+
+TEST_F(QuicAdmissionDispatcherTest, RetriesIetfInitialsOverBudget) {
+  const quic::ParsedQuicVersion version = quic::ParsedQuicVersion::Draft27();
+  ProcessInitial(version, quic::test::TestConnectionId(1));
+
+  quic::QuicConnectionId connection_id = quic::test::TestConnectionId(2);
+  std::string retry;
+  EXPECT_CALL(*writer_, WritePacket(_, _, _, _, _))
+      .WillOnce(Invoke([&retry](const char* buffer, size_t buf_len,
+                                const quic::QuicIpAddress& self_address,
+                                const quic::QuicSocketAddress& peer_address,
+                                quic::PerPacketOptions* options) {
+        retry.assign(buffer, buf_len);
+        return quic::WriteResult(quic::WRITE_STATUS_OK, buf_len);
+      }));
+  ProcessInitial(version, connection_id);
+  EXPECT_FALSE(HasBufferedPackets(connection_id));
+  EXPECT_EQ(0u, dispatcher_.NumSessions());
+  EXPECT_EQ(1u, admission_controller_.num_rejected());
+  EXPECT_EQ(1u, dispatcher_.num_retries_sent());
+  EXPECT_EQ(0u, dispatcher_.num_dropped());
+
+  // The RETRY is smaller than the Initial, and clients accept it.
+  ASSERT_GT(retry.size(), kRetryIntegrityTagSize);
+  EXPECT_LT(retry.size(), quic::kMaxOutgoingPacketSize);
+  EXPECT_EQ(0xf0, static_cast<uint8_t>(retry[0]) & 0xf0);
+  const size_t tag_offset = retry.size() - kRetryIntegrityTagSize;
+  EXPECT_TRUE(quic::CryptoUtils::ValidateRetryIntegrityTag(
+      version, connection_id,
+      quiche::QuicheStringPiece(retry.data(), tag_offset),
+      quiche::QuicheStringPiece(retry.data() + tag_offset,
+                                kRetryIntegrityTagSize)));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
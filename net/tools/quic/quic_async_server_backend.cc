@@ -0,0 +1,209 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_async_server_backend.h"
+
+#include <algorithm>
+#include <list>
+#include <utility>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/metrics/histogram_functions.h"
+#include "base/synchronization/atomic_flag.h"
+#include "base/synchronization/lock.h"
+#include "base/task/thread_pool.h"
+#include "base/threading/sequenced_task_runner_handle.h"
+
+namespace net {
+
+// A request, shared by the QUIC thread and the worker running its handler.
+class QuicAsyncServerBackend::Request
+    : public base::RefCountedThreadSafe<Request> {
+ public:
+  Request(quic::QuicSimpleServerBackend::RequestHandler* request_handler,
+          const spdy::SpdyHeaderBlock& request_headers,
+          const std::string& request_body)
+      : request_handler_(request_handler),
+        request_headers_(request_headers.Clone()),
+        request_body_(request_body),
+        enqueue_time_(base::TimeTicks::Now()),
+        delivered_(false) {}
+
+  quic::QuicSimpleServerBackend::RequestHandler* request_handler() const {
+    return request_handler_;
+  }
+  const spdy::SpdyHeaderBlock& request_headers() const {
+    return request_headers_;
+  }
+  const std::string& request_body() const { return request_body_; }
+
+  // Set on the QUIC thread, read on workers.
+  base::AtomicFlag* cancelled() { return &cancelled_; }
+
+  // Written by the worker before the request is handed back, then only
+  // accessed on the QUIC thread.
+  void set_response(std::unique_ptr<quic::QuicBackendResponse> response) {
+    response_ = std::move(response);
+  }
+  const quic::QuicBackendResponse* response() const { return response_.get(); }
+  void set_start_time(base::TimeTicks start_time) { start_time_ = start_time; }
+  base::TimeDelta queue_delay() const { return start_time_ - enqueue_time_; }
+
+  // QUIC thread only.
+  bool delivered() const { return delivered_; }
+  void set_delivered() { delivered_ = true; }
+
+ private:
+  friend class base::RefCountedThreadSafe<Request>;
+  ~Request() = default;
+
+  quic::QuicSimpleServerBackend::RequestHandler* const request_handler_;
+  const spdy::SpdyHeaderBlock request_headers_;
+  const std::string request_body_;
+  const base::TimeTicks enqueue_time_;
+  base::TimeTicks start_time_;
+  base::AtomicFlag cancelled_;
+  std::unique_ptr<quic::QuicBackendResponse> response_;
+  bool delivered_;
+
+  DISALLOW_COPY_AND_ASSIGN(Request);
+};
+
+// Collects completed requests from workers. Posts one delivery task to the
+// QUIC thread whenever the queue becomes non-empty.
+class QuicAsyncServerBackend::CompletionQueue
+    : public base::RefCountedThreadSafe<CompletionQueue> {
+ public:
+  CompletionQueue(scoped_refptr<base::SequencedTaskRunner> quic_task_runner,
+                  base::RepeatingClosure deliver_callback)
+      : quic_task_runner_(std::move(quic_task_runner)),
+        deliver_callback_(std::move(deliver_callback)) {}
+
+  void Add(scoped_refptr<Request> request) {
+    bool was_empty;
+    {
+      base::AutoLock lock(lock_);
+      was_empty = completed_.empty();
+      completed_.push_back(std::move(request));
+    }
+    if (was_empty)
+      quic_task_runner_->PostTask(FROM_HERE, deliver_callback_);
+  }
+
+  std::vector<scoped_refptr<Request>> TakeAll() {
+    std::vector<scoped_refptr<Request>> completed;
+    base::AutoLock lock(lock_);
+    completed.swap(completed_);
+    return completed;
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<CompletionQueue>;
+  ~CompletionQueue() = default;
+
+  scoped_refptr<base::SequencedTaskRunner> quic_task_runner_;
+  base::RepeatingClosure deliver_callback_;
+  base::Lock lock_;
+  std::vector<scoped_refptr<Request>> completed_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompletionQueue);
+};
+
+QuicAsyncServerBackend::QuicAsyncServerBackend(const std::string& name,
+                                               Handler handler)
+    : QuicAsyncServerBackend(
+          name,
+          std::move(handler),
+          base::ThreadPool::CreateTaskRunner(
+              {base::TaskPriority::USER_BLOCKING,
+               base::TaskShutdownBehavior::SKIP_ON_SHUTDOWN})) {}
+
+QuicAsyncServerBackend::QuicAsyncServerBackend(
+    const std::string& name,
+    Handler handler,
+    scoped_refptr<base::TaskRunner> worker_task_runner)
+    : name_(name),
+      handler_(std::move(handler)),
+      worker_task_runner_(std::move(worker_task_runner)) {
+  completion_queue_ = base::MakeRefCounted<CompletionQueue>(
+      base::SequencedTaskRunnerHandle::Get(),
+      base::BindRepeating(&QuicAsyncServerBackend::DeliverCompletedRequests,
+                          weak_factory_.GetWeakPtr()));
+}
+
+QuicAsyncServerBackend::~QuicAsyncServerBackend() {
+  for (auto& entry : requests_)
+    entry.second->cancelled()->Set();
+}
+
+bool QuicAsyncServerBackend::InitializeBackend(
+    const std::string& backend_url) {
+  return true;
+}
+
+bool QuicAsyncServerBackend::IsBackendInitialized() const {
+  return true;
+}
+
+void QuicAsyncServerBackend::FetchResponseFromBackend(
+    const spdy::SpdyHeaderBlock& request_headers,
+    const std::string& request_body,
+    quic::QuicSimpleServerBackend::RequestHandler* request_handler) {
+  auto request = base::MakeRefCounted<Request>(request_handler,
+                                               request_headers, request_body);
+  requests_[request_handler] = request;
+  worker_task_runner_->PostTask(
+      FROM_HERE, base::BindOnce(&QuicAsyncServerBackend::RunHandler, handler_,
+                                std::move(request), completion_queue_));
+}
+
+void QuicAsyncServerBackend::CloseBackendResponseStream(
+    quic::QuicSimpleServerBackend::RequestHandler* request_handler) {
+  auto it = requests_.find(request_handler);
+  if (it == requests_.end())
+    return;
+  if (!it->second->delivered()) {
+    it->second->cancelled()->Set();
+    ++stats_.requests_cancelled;
+  }
+  requests_.erase(it);
+}
+
+// static
+void QuicAsyncServerBackend::RunHandler(
+    const Handler& handler,
+    scoped_refptr<Request> request,
+    scoped_refptr<CompletionQueue> completion_queue) {
+  if (request->cancelled()->IsSet())
+    return;
+  request->set_start_time(base::TimeTicks::Now());
+  request->set_response(
+      handler.Run(request->request_headers(), request->request_body()));
+  completion_queue->Add(std::move(request));
+}
+
+void QuicAsyncServerBackend::DeliverCompletedRequests() {
+  for (const scoped_refptr<Request>& request : completion_queue_->TakeAll()) {
+    if (request->cancelled()->IsSet())
+      continue;
+    request->set_delivered();
+
+    base::TimeDelta queue_delay = request->queue_delay();
+    ++stats_.requests_completed;
+    stats_.total_queue_delay += queue_delay;
+    stats_.max_queue_delay = std::max(stats_.max_queue_delay, queue_delay);
+    base::UmaHistogramTimes(
+        "Net.QuicSimpleServer.AsyncBackendQueueDelay." + name_, queue_delay);
+
+    // May close the stream, which releases the request's entry in
+    // |requests_|; |request| keeps the response alive until this returns.
+    request->request_handler()->OnResponseBackendComplete(
+        request->response(),
+        std::list<quic::QuicBackendResponse::ServerPushInfo>());
+  }
+}
+
+}  // namespace net
@@ -0,0 +1,101 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_ASYNC_SERVER_BACKEND_H_
+#define NET_TOOLS_QUIC_QUIC_ASYNC_SERVER_BACKEND_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/sequenced_task_runner.h"
+#include "base/task_runner.h"
+#include "base/time/time.h"
+#include "net/third_party/quiche/src/quic/tools/quic_backend_response.h"
+#include "net/third_party/quiche/src/quic/tools/quic_simple_server_backend.h"
+#include "net/third_party/quiche/src/spdy/core/spdy_header_block.h"
+
+namespace net {
+
+// Runs a CPU-heavy request handler, e.g. one rendering templates or
+// compressing bodies, on the thread pool instead of the QUIC thread, so that
+// slow responses do not stall the dispatcher's event loop.
+//
+// Completed responses are handed back to the QUIC thread in batches: a single
+// task delivers every response completed since the previous one. Requests
+// whose stream is closed before their response is delivered are cancelled;
+// their handler is not run if it has not started yet.
+class QuicAsyncServerBackend : public quic::QuicSimpleServerBackend {
+ public:
+  // Builds the response to a request. Runs on a thread pool worker, so it
+  // must be thread-safe. Returning nullptr results in a 404 response, as for
+  // a request missing from a cache.
+  using Handler =
+      base::RepeatingCallback<std::unique_ptr<quic::QuicBackendResponse>(
+          const spdy::SpdyHeaderBlock& request_headers,
+          const std::string& request_body)>;
+
+  struct Stats {
+    size_t requests_completed = 0;
+    size_t requests_cancelled = 0;
+    // Time requests spent waiting for a worker.
+    base::TimeDelta total_queue_delay;
+    base::TimeDelta max_queue_delay;
+  };
+
+  // |name| identifies the handler in the exported queue delay histogram,
+  // Net.QuicSimpleServer.AsyncBackendQueueDelay.<name>.
+  QuicAsyncServerBackend(const std::string& name, Handler handler);
+  // As above, running |handler| on |worker_task_runner|.
+  QuicAsyncServerBackend(const std::string& name,
+                         Handler handler,
+                         scoped_refptr<base::TaskRunner> worker_task_runner);
+  ~QuicAsyncServerBackend() override;
+
+  const Stats& stats() const { return stats_; }
+
+  // quic::QuicSimpleServerBackend implementation.
+  bool InitializeBackend(const std::string& backend_url) override;
+  bool IsBackendInitialized() const override;
+  void FetchResponseFromBackend(
+      const spdy::SpdyHeaderBlock& request_headers,
+      const std::string& request_body,
+      quic::QuicSimpleServerBackend::RequestHandler* request_handler) override;
+  void CloseBackendResponseStream(
+      quic::QuicSimpleServerBackend::RequestHandler* request_handler) override;
+
+ private:
+  class Request;
+  class CompletionQueue;
+
+  static void RunHandler(const Handler& handler,
+                         scoped_refptr<Request> request,
+                         scoped_refptr<CompletionQueue> completion_queue);
+  void DeliverCompletedRequests();
+
+  const std::string name_;
+  const Handler handler_;
+  scoped_refptr<base::TaskRunner> worker_task_runner_;
+  scoped_refptr<CompletionQueue> completion_queue_;
+  // Requests whose stream is open, including delivered ones, which own the
+  // response the stream is sending.
+  std::unordered_map<quic::QuicSimpleServerBackend::RequestHandler*,
+                     scoped_refptr<Request>>
+      requests_;
+  Stats stats_;
+
+  base::WeakPtrFactory<QuicAsyncServerBackend> weak_factory_{this};
+
+  DISALLOW_COPY_AND_ASSIGN(QuicAsyncServerBackend);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_ASYNC_SERVER_BACKEND_H_
@@ -0,0 +1,149 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_async_server_backend.h"
+
+#include "base/barrier_closure.h"
+#include "base/bind.h"
+#include "base/callback_helpers.h"
+#include "base/run_loop.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "net/test/test_with_task_environment.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_test_utils.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+class TestRequestHandler
+    : public quic::QuicSimpleServerBackend::RequestHandler {
+ public:
+  explicit TestRequestHandler(base::OnceClosure on_complete)
+      : on_complete_(std::move(on_complete)) {}
+
+  quic::QuicConnectionId connection_id() const override {
+    return quic::test::TestConnectionId(123);
+  }
+  quic::QuicStreamId stream_id() const override { return 5; }
+  std::string peer_host() const override { return "127.0.0.1"; }
+
+  void OnResponseBackendComplete(
+      const quic::QuicBackendResponse* response,
+      std::list<quic::QuicBackendResponse::ServerPushInfo> resources) override {
+    ASSERT_TRUE(response);
+    body_ = std::string(response->body());
+    std::move(on_complete_).Run();
+  }
+
+  const std::string& body() const { return body_; }
+
+ private:
+  base::OnceClosure on_complete_;
+  std::string body_;
+};
+
+// Responds with the request's path, after waiting for |unblock| if set.
+std::unique_ptr<quic::QuicBackendResponse> EchoPath(
+    base::WaitableEvent* unblock,
+    const spdy::SpdyHeaderBlock& request_headers,
+    const std::string& request_body) {
+  if (unblock)
+    unblock->Wait();
+  auto response = std::make_unique<quic::QuicBackendResponse>();
+  response->set_body(request_headers.find(":path")->second);
+  return response;
+}
+
+spdy::SpdyHeaderBlock RequestHeaders(const std::string& path) {
+  spdy::SpdyHeaderBlock headers;
+  headers[":method"] = "GET";
+  headers[":path"] = path;
+  return headers;
+}
+
+class QuicAsyncServerBackendTest : public TestWithTaskEnvironment {
+ protected:
+  QuicAsyncServerBackendTest()
+      : worker_("QuicAsyncServerBackendWorker"),
+        unblock_(base::WaitableEvent::ResetPolicy::MANUAL,
+                 base::WaitableEvent::InitialState::NOT_SIGNALED) {
+    CHECK(worker_.Start());
+  }
+
+  ~QuicAsyncServerBackendTest() override {
+    unblock_.Signal();
+    worker_.Stop();
+  }
+
+  std::unique_ptr<QuicAsyncServerBackend> CreateBackend(bool blocking) {
+    return std::make_unique<QuicAsyncServerBackend>(
+        "Echo",
+        base::BindRepeating(&EchoPath, blocking ? &unblock_ : nullptr),
+        worker_.task_runner());
+  }
+
+  base::Thread worker_;
+  base::WaitableEvent unblock_;
+};
+
+TEST_F(QuicAsyncServerBackendTest, DeliversResponses) {
+  auto backend = CreateBackend(/*blocking=*/false);
+  base::RunLoop run_loop;
+  auto barrier = base::BarrierClosure(2, run_loop.QuitClosure());
+  TestRequestHandler handler1(barrier);
+  TestRequestHandler handler2(barrier);
+  backend->FetchResponseFromBackend(RequestHeaders("/a"), "", &handler1);
+  backend->FetchResponseFromBackend(RequestHeaders("/b"), "", &handler2);
+  run_loop.Run();
+
+  EXPECT_EQ("/a", handler1.body());
+  EXPECT_EQ("/b", handler2.body());
+  EXPECT_EQ(2u, backend->stats().requests_completed);
+  EXPECT_GE(backend->stats().max_queue_delay, base::TimeDelta());
+  backend->CloseBackendResponseStream(&handler1);
+  backend->CloseBackendResponseStream(&handler2);
+  EXPECT_EQ(0u, backend->stats().requests_cancelled);
+}
+
+TEST_F(QuicAsyncServerBackendTest, CancelBeforeHandlerRuns) {
+  auto backend = CreateBackend(/*blocking=*/true);
+  base::RunLoop run_loop;
+  TestRequestHandler blocked(base::DoNothing());
+  TestRequestHandler cancelled(base::DoNothing());
+  TestRequestHandler completed(run_loop.QuitClosure());
+
+  // |blocked| occupies the only worker while |cancelled| is closed.
+  backend->FetchResponseFromBackend(RequestHeaders("/blocked"), "", &blocked);
+  backend->FetchResponseFromBackend(RequestHeaders("/cancelled"), "",
+                                    &cancelled);
+  backend->CloseBackendResponseStream(&blocked);
+  backend->CloseBackendResponseStream(&cancelled);
+  backend->FetchResponseFromBackend(RequestHeaders("/completed"), "",
+                                    &completed);
+  unblock_.Signal();
+  run_loop.Run();
+
+  EXPECT_EQ("", blocked.body());
+  EXPECT_EQ("", cancelled.body());
+  EXPECT_EQ("/completed", completed.body());
+  EXPECT_EQ(2u, backend->stats().requests_cancelled);
+  EXPECT_EQ(1u, backend->stats().requests_completed);
+}
+
+TEST_F(QuicAsyncServerBackendTest, DestroyedWithRequestsInFlight) {
+  auto backend = CreateBackend(/*blocking=*/true);
+  TestRequestHandler handler(base::DoNothing());
+  backend->FetchResponseFromBackend(RequestHeaders("/a"), "", &handler);
+  backend.reset();
+  unblock_.Signal();
+  worker_.FlushForTesting();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ("", handler.body());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -0,0 +1,171 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_body_digester.h"
+
+#include <stdint.h>
+
+#include <utility>
+
+#include "base/base64.h"
+#include "base/big_endian.h"
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "crypto/secure_hash.h"
+#include "third_party/crc32c/src/include/crc32c/crc32c.h"
+
+namespace net {
+
+const char kQuicBodyDigestHeader[] = "x-quic-body-digest";
+
+namespace {
+
+const char kSha256[] = "sha-256";
+const char kCrc32c[] = "crc32c";
+
+// BoringSSL picks the fastest SHA-256 implementation the CPU supports.
+class Sha256BodyDigester : public QuicBodyDigester {
+ public:
+  Sha256BodyDigester()
+      : hash_(crypto::SecureHash::Create(crypto::SecureHash::SHA256)) {}
+
+  const char* algorithm() const override { return kSha256; }
+
+  void Update(base::StringPiece data) override {
+    hash_->Update(data.data(), data.size());
+  }
+
+  std::string Finish() override {
+    std::string digest(hash_->GetHashLength(), '\0');
+    hash_->Finish(&digest[0], digest.size());
+    return digest;
+  }
+
+ private:
+  std::unique_ptr<crypto::SecureHash> hash_;
+
+  DISALLOW_COPY_AND_ASSIGN(Sha256BodyDigester);
+};
+
+// The crc32c library uses the SSE4.2 or ARMv8 CRC32C instructions when the
+// CPU has them.
+class Crc32cBodyDigester : public QuicBodyDigester {
+ public:
+  Crc32cBodyDigester() : crc_(0) {}
+
+  const char* algorithm() const override { return kCrc32c; }
+
+  void Update(base::StringPiece data) override {
+    crc_ = crc32c::Extend(crc_, reinterpret_cast<const uint8_t*>(data.data()),
+                          data.size());
+  }
+
+  // Big-endian, as RFC 9530 specifies.
+  std::string Finish() override {
+    std::string digest(sizeof(crc_), '\0');
+    base::WriteBigEndian(&digest[0], crc_);
+    return digest;
+  }
+
+ private:
+  uint32_t crc_;
+
+  DISALLOW_COPY_AND_ASSIGN(Crc32cBodyDigester);
+};
+
+std::vector<std::unique_ptr<QuicBodyDigester>> CreateDigesters(
+    const std::vector<std::string>& algorithms) {
+  std::vector<std::unique_ptr<QuicBodyDigester>> digesters;
+  for (const std::string& algorithm : algorithms) {
+    std::unique_ptr<QuicBodyDigester> digester =
+        CreateQuicBodyDigester(algorithm);
+    DCHECK(digester) << algorithm;
+    digesters.push_back(std::move(digester));
+  }
+  return digesters;
+}
+
+}  // namespace
+
+std::unique_ptr<QuicBodyDigester> CreateQuicBodyDigester(
+    base::StringPiece algorithm) {
+  if (algorithm == kSha256)
+    return std::make_unique<Sha256BodyDigester>();
+  if (algorithm == kCrc32c)
+    return std::make_unique<Crc32cBodyDigester>();
+  return nullptr;
+}
+
+QuicBodyDigesterFactory CreateQuicBodyDigesterFactory(
+    const std::vector<std::string>& algorithms) {
+  return base::BindRepeating(&CreateDigesters, algorithms);
+}
+
+QuicBodyDigestSet::QuicBodyDigestSet(
+    std::vector<std::unique_ptr<QuicBodyDigester>> digesters)
+    : digesters_(std::move(digesters)) {}
+
+QuicBodyDigestSet::~QuicBodyDigestSet() = default;
+
+void QuicBodyDigestSet::Update(base::StringPiece data) {
+  if (data.empty())
+    return;
+  for (const auto& digester : digesters_)
+    digester->Update(data);
+}
+
+std::map<std::string, std::string> QuicBodyDigestSet::Finish() {
+  std::map<std::string, std::string> digests;
+  for (const auto& digester : digesters_)
+    digests[digester->algorithm()] = digester->Finish();
+  return digests;
+}
+
+std::string FormatQuicContentDigest(
+    const std::map<std::string, std::string>& digests) {
+  std::string value;
+  for (const auto& algorithm_and_digest : digests) {
+    if (!value.empty())
+      value.append(", ");
+    std::string encoded;
+    base::Base64Encode(algorithm_and_digest.second, &encoded);
+    value.append(algorithm_and_digest.first);
+    value.append("=:");
+    value.append(encoded);
+    value.push_back(':');
+  }
+  return value;
+}
+
+bool ParseQuicContentDigest(base::StringPiece value,
+                            std::map<std::string, std::string>* digests) {
+  digests->clear();
+  for (base::StringPiece member :
+       base::SplitStringPiece(value, ",", base::TRIM_WHITESPACE,
+                              base::SPLIT_WANT_NONEMPTY)) {
+    // Parameters of dictionary members carry no meaning here.
+    member = member.substr(0, member.find(';'));
+    size_t equals = member.find('=');
+    if (equals == base::StringPiece::npos)
+      return false;
+    base::StringPiece algorithm =
+        base::TrimWhitespaceASCII(member.substr(0, equals), base::TRIM_ALL);
+    base::StringPiece item =
+        base::TrimWhitespaceASCII(member.substr(equals + 1), base::TRIM_ALL);
+    // Byte sequences are base64 between colons.
+    if (algorithm.empty() || item.size() < 2 || item.front() != ':' ||
+        item.back() != ':') {
+      return false;
+    }
+    std::string digest;
+    if (!base::Base64Decode(item.substr(1, item.size() - 2), &digest))
+      return false;
+    (*digests)[base::ToLowerASCII(algorithm)] = std::move(digest);
+  }
+  return true;
+}
+
+}  // namespace net
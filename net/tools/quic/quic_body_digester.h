@@ -0,0 +1,86 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_BODY_DIGESTER_H_
+#define NET_TOOLS_QUIC_QUIC_BODY_DIGESTER_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/strings/string_piece.h"
+
+namespace net {
+
+// Request header a server sets to the digests of the request body it
+// computed, in the format of a Content-Digest header (RFC 9530), so that
+// backends receive them along with the request. Any value sent by the client
+// is replaced.
+extern const char kQuicBodyDigestHeader[];
+
+// Computes a digest of a body fed to it in chunks as they arrive, so that the
+// body is never read a second time.
+class QuicBodyDigester {
+ public:
+  virtual ~QuicBodyDigester() {}
+
+  // Algorithm name as registered for the Content-Digest header, e.g.
+  // "sha-256".
+  virtual const char* algorithm() const = 0;
+
+  virtual void Update(base::StringPiece data) = 0;
+
+  // Returns the digest of all data passed to Update(). Must be called once.
+  virtual std::string Finish() = 0;
+};
+
+// Creates a digester for |algorithm|, "sha-256" or "crc32c", or returns null
+// for other algorithms. SHA-256 uses the SHA extensions or vector units of
+// the CPU when it has them, and CRC32C its CRC32 instructions.
+std::unique_ptr<QuicBodyDigester> CreateQuicBodyDigester(
+    base::StringPiece algorithm);
+
+// Creates the digesters fed with each request body.
+using QuicBodyDigesterFactory =
+    base::RepeatingCallback<std::vector<std::unique_ptr<QuicBodyDigester>>()>;
+
+// Returns a factory of digesters for each of |algorithms|, which must all be
+// supported by CreateQuicBodyDigester().
+QuicBodyDigesterFactory CreateQuicBodyDigesterFactory(
+    const std::vector<std::string>& algorithms);
+
+// Feeds a body to several digesters at once.
+class QuicBodyDigestSet {
+ public:
+  explicit QuicBodyDigestSet(
+      std::vector<std::unique_ptr<QuicBodyDigester>> digesters);
+  ~QuicBodyDigestSet();
+
+  void Update(base::StringPiece data);
+
+  // Returns the digest of each algorithm. Must be called once.
+  std::map<std::string, std::string> Finish();
+
+ private:
+  std::vector<std::unique_ptr<QuicBodyDigester>> digesters_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicBodyDigestSet);
+};
+
+// Formats |digests| as the value of a Content-Digest header, e.g.
+// "sha-256=:base64:".
+std::string FormatQuicContentDigest(
+    const std::map<std::string, std::string>& digests);
+
+// Parses the value of a Content-Digest header into |digests|, keyed by
+// algorithm. Returns false if the value is malformed.
+bool ParseQuicContentDigest(base::StringPiece value,
+                            std::map<std::string, std::string>* digests);
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_BODY_DIGESTER_H_
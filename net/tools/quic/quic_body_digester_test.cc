@@ -0,0 +1,84 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_body_digester.h"
+
+#include "base/strings/string_number_conversions.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+std::string HexDigest(base::StringPiece algorithm, base::StringPiece data) {
+  std::unique_ptr<QuicBodyDigester> digester =
+      CreateQuicBodyDigester(algorithm);
+  EXPECT_TRUE(digester);
+  EXPECT_EQ(algorithm, digester->algorithm());
+  digester->Update(data);
+  const std::string digest = digester->Finish();
+  return base::HexEncode(digest.data(), digest.size());
+}
+
+TEST(QuicBodyDigesterTest, KnownAnswers) {
+  EXPECT_EQ("BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD",
+            HexDigest("sha-256", "abc"));
+  EXPECT_EQ("E3069283", HexDigest("crc32c", "123456789"));
+  EXPECT_FALSE(CreateQuicBodyDigester("md5"));
+}
+
+TEST(QuicBodyDigesterTest, ChunksMatchWholeBody) {
+  const std::string body(100000, 'x');
+  for (const char* algorithm : {"sha-256", "crc32c"}) {
+    std::unique_ptr<QuicBodyDigester> whole =
+        CreateQuicBodyDigester(algorithm);
+    whole->Update(body);
+    std::unique_ptr<QuicBodyDigester> chunked =
+        CreateQuicBodyDigester(algorithm);
+    for (size_t offset = 0; offset < body.size(); offset += 1337)
+      chunked->Update(base::StringPiece(body).substr(offset, 1337));
+    EXPECT_EQ(whole->Finish(), chunked->Finish()) << algorithm;
+  }
+}
+
+TEST(QuicBodyDigesterTest, DigestSet) {
+  QuicBodyDigestSet digests(
+      CreateQuicBodyDigesterFactory({"sha-256", "crc32c"}).Run());
+  digests.Update("");
+  std::map<std::string, std::string> result = digests.Finish();
+  ASSERT_EQ(2u, result.size());
+  EXPECT_EQ(32u, result["sha-256"].size());
+  EXPECT_EQ(std::string(4, '\0'), result["crc32c"]);
+  EXPECT_EQ("crc32c=:AAAAAA==:, "
+            "sha-256=:47DEQpj8HBSa+/TImW+5JCeuQeRkm5NMpJWZG3hSuFU=:",
+            FormatQuicContentDigest(result));
+}
+
+TEST(QuicBodyDigesterTest, ParseContentDigest) {
+  std::map<std::string, std::string> digests;
+  ASSERT_TRUE(ParseQuicContentDigest(
+      "SHA-256=:47DEQpj8HBSa+/TImW+5JCeuQeRkm5NMpJWZG3hSuFU=:;p=1, "
+      "crc32c=:AAAAAA==:",
+      &digests));
+  ASSERT_EQ(2u, digests.size());
+  EXPECT_EQ(32u, digests["sha-256"].size());
+  EXPECT_EQ(std::string(4, '\0'), digests["crc32c"]);
+
+  // Round trip.
+  std::map<std::string, std::string> parsed;
+  ASSERT_TRUE(ParseQuicContentDigest(FormatQuicContentDigest(digests),
+                                     &parsed));
+  EXPECT_EQ(digests, parsed);
+
+  EXPECT_TRUE(ParseQuicContentDigest("", &digests));
+  EXPECT_TRUE(digests.empty());
+  EXPECT_FALSE(ParseQuicContentDigest("sha-256", &digests));
+  EXPECT_FALSE(ParseQuicContentDigest("sha-256=abc", &digests));
+  EXPECT_FALSE(ParseQuicContentDigest("sha-256=:!!:", &digests));
+  EXPECT_FALSE(ParseQuicContentDigest("=:AAAAAA==:", &digests));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -0,0 +1,334 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_compact_time_wait_list.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "base/logging.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_flags.h"
+
+namespace net {
+
+namespace {
+
+const size_t kInitialSlots = 16;
+const size_t kNumTimeWaitSlices = 8;
+
+// The low bit of a slot records whether the peer uses IETF QUIC, the next 15
+// bits count the packets received for the connection ID, and the high 48
+// bits are the fingerprint identifying it.
+const uint64_t kIetfQuicBit = 1;
+const int kPacketCountShift = 1;
+const uint64_t kPacketCountMask = UINT64_C(0x7fff) << kPacketCountShift;
+const int kFingerprintShift = 16;
+const uint64_t kFingerprintMask = ~UINT64_C(0) << kFingerprintShift;
+
+}  // namespace
+
+// static
+const uint32_t QuicCompactTimeWaitList::kMaxPacketCount =
+    static_cast<uint32_t>(kPacketCountMask >> kPacketCountShift);
+
+QuicCompactTimeWaitList::Slice::Slice() = default;
+
+QuicCompactTimeWaitList::Slice::Slice(Slice&& other) = default;
+
+QuicCompactTimeWaitList::Slice::~Slice() = default;
+
+QuicCompactTimeWaitList::QuicCompactTimeWaitList(
+    quic::QuicTime::Delta time_wait_period,
+    size_t max_entries,
+    size_t num_slices)
+    : slice_width_(quic::QuicTime::Delta::FromMicroseconds(
+          time_wait_period.ToMicroseconds() / (num_slices - 1))),
+      max_entries_(max_entries),
+      salt_(quic::QuicRandom::GetInstance()->RandUint64()),
+      current_(0),
+      current_start_(quic::QuicTime::Zero()),
+      size_(0),
+      num_evicted_early_(0) {
+  // A slice must wrap around after a full period, not before.
+  DCHECK_GE(num_slices, 2u);
+  DCHECK_GT(slice_width_.ToMicroseconds(), 0);
+  slices_.resize(num_slices);
+}
+
+QuicCompactTimeWaitList::~QuicCompactTimeWaitList() = default;
+
+void QuicCompactTimeWaitList::Add(quic::QuicConnectionId connection_id,
+                                  bool ietf_quic,
+                                  quic::QuicTime now) {
+  bool unused;
+  if (Contains(connection_id, now, &unused))
+    return;
+
+  if (size_ >= max_entries_) {
+    // Drop the oldest non-empty slice, which may be the current one.
+    for (size_t i = 1; i <= slices_.size(); ++i) {
+      Slice* slice = &slices_[(current_ + i) % slices_.size()];
+      if (slice->size > 0) {
+        num_evicted_early_ += slice->size;
+        Clear(slice);
+        break;
+      }
+    }
+  }
+
+  Insert(&slices_[current_],
+         Fingerprint(connection_id) | (ietf_quic ? kIetfQuicBit : 0));
+  ++size_;
+}
+
+bool QuicCompactTimeWaitList::Contains(quic::QuicConnectionId connection_id,
+                                       quic::QuicTime now,
+                                       bool* ietf_quic) {
+  uint64_t* slot = Find(connection_id, now);
+  if (!slot)
+    return false;
+  *ietf_quic = (*slot & kIetfQuicBit) != 0;
+  return true;
+}
+
+bool QuicCompactTimeWaitList::OnPacketReceived(
+    quic::QuicConnectionId connection_id,
+    quic::QuicTime now,
+    bool* ietf_quic,
+    uint32_t* num_packets) {
+  uint64_t* slot = Find(connection_id, now);
+  if (!slot)
+    return false;
+  *ietf_quic = (*slot & kIetfQuicBit) != 0;
+  uint32_t count = (*slot & kPacketCountMask) >> kPacketCountShift;
+  if (count < kMaxPacketCount) {
+    ++count;
+    *slot = (*slot & ~kPacketCountMask) |
+            (static_cast<uint64_t>(count) << kPacketCountShift);
+  }
+  *num_packets = count;
+  return true;
+}
+
+uint64_t* QuicCompactTimeWaitList::Find(quic::QuicConnectionId connection_id,
+                                        quic::QuicTime now) {
+  Expire(now);
+  if (size_ == 0)
+    return nullptr;
+  uint64_t key = Fingerprint(connection_id);
+  for (Slice& slice : slices_) {
+    if (slice.size == 0)
+      continue;
+    uint64_t* slot = FindSlot(&slice, key);
+    if (*slot != 0)
+      return slot;
+  }
+  return nullptr;
+}
+
+size_t QuicCompactTimeWaitList::EstimateMemoryUsage() const {
+  size_t bytes = sizeof(*this) + slices_.capacity() * sizeof(Slice);
+  for (const Slice& slice : slices_)
+    bytes += slice.slots.capacity() * sizeof(uint64_t);
+  return bytes;
+}
+
+uint64_t QuicCompactTimeWaitList::Fingerprint(
+    quic::QuicConnectionId connection_id) const {
+  // FNV-1a, keyed by starting from the salted offset basis.
+  const uint64_t kPrime = UINT64_C(1099511628211);
+  uint64_t hash = UINT64_C(14695981039346656037) ^ salt_;
+  const uint8_t* data =
+      reinterpret_cast<const uint8_t*>(connection_id.data());
+  for (size_t i = 0; i < connection_id.length(); ++i) {
+    hash ^= data[i];
+    hash *= kPrime;
+  }
+  hash ^= hash >> 29;
+  hash &= kFingerprintMask;
+  // 0 marks empty slots.
+  return hash == 0 ? UINT64_C(1) << kFingerprintShift : hash;
+}
+
+void QuicCompactTimeWaitList::Expire(quic::QuicTime now) {
+  if (now < current_start_ + slice_width_)
+    return;
+  int64_t elapsed_slices = (now - current_start_).ToMicroseconds() /
+                           slice_width_.ToMicroseconds();
+  size_t steps = static_cast<size_t>(
+      std::min<int64_t>(elapsed_slices, slices_.size()));
+  for (size_t i = 0; i < steps; ++i) {
+    current_ = (current_ + 1) % slices_.size();
+    Clear(&slices_[current_]);
+  }
+  current_start_ = current_start_ + quic::QuicTime::Delta::FromMicroseconds(
+                                        elapsed_slices *
+                                        slice_width_.ToMicroseconds());
+}
+
+void QuicCompactTimeWaitList::Clear(Slice* slice) {
+  size_ -= slice->size;
+  slice->size = 0;
+  std::vector<uint64_t>().swap(slice->slots);
+}
+
+// static
+uint64_t* QuicCompactTimeWaitList::FindSlot(Slice* slice, uint64_t key) {
+  DCHECK(!slice->slots.empty());
+  const size_t mask = slice->slots.size() - 1;
+  // The low bits carry no identity, so they are not used for the index.
+  size_t index = static_cast<size_t>(key >> kFingerprintShift) & mask;
+  while (true) {
+    uint64_t* slot = &slice->slots[index];
+    if (*slot == 0 || (*slot & kFingerprintMask) == key)
+      return slot;
+    index = (index + 1) & mask;
+  }
+}
+
+// static
+void QuicCompactTimeWaitList::Insert(Slice* slice, uint64_t fingerprint) {
+  if (slice->slots.empty())
+    slice->slots.resize(kInitialSlots);
+  // Keep the load factor at or below 3/4 so that probes stay short.
+  if ((slice->size + 1) * 4 > slice->slots.size() * 3) {
+    std::vector<uint64_t> old_slots(slice->slots.size() * 2);
+    old_slots.swap(slice->slots);
+    for (uint64_t old_slot : old_slots) {
+      if (old_slot != 0)
+        *FindSlot(slice, old_slot & kFingerprintMask) = old_slot;
+    }
+  }
+  *FindSlot(slice, fingerprint & kFingerprintMask) = fingerprint;
+  ++slice->size;
+}
+
+QuicCompactTimeWaitListManager::QuicCompactTimeWaitListManager(
+    quic::QuicPacketWriter* writer,
+    Visitor* visitor,
+    const quic::QuicClock* clock,
+    quic::QuicAlarmFactory* alarm_factory)
+    : quic::QuicTimeWaitListManager(writer, visitor, clock, alarm_factory),
+      clock_(clock),
+      compact_list_(quic::QuicTime::Delta::FromSeconds(
+                        GetQuicFlag(FLAGS_quic_time_wait_list_seconds)),
+                    GetQuicFlag(FLAGS_quic_time_wait_list_max_connections),
+                    kNumTimeWaitSlices) {}
+
+QuicCompactTimeWaitListManager::~QuicCompactTimeWaitListManager() = default;
+
+void QuicCompactTimeWaitListManager::AddConnectionIdToTimeWait(
+    quic::QuicConnectionId connection_id,
+    bool ietf_quic,
+    TimeWaitAction action,
+    quic::EncryptionLevel encryption_level,
+    std::vector<std::unique_ptr<quic::QuicEncryptedPacket>>*
+        termination_packets) {
+  bool compact =
+      action == SEND_STATELESS_RESET ||
+      (ietf_quic && action == SEND_TERMINATION_PACKETS &&
+       encryption_level == quic::ENCRYPTION_FORWARD_SECURE);
+  if (!compact || IsConnectionIdInTimeWait(connection_id)) {
+    quic::QuicTimeWaitListManager::AddConnectionIdToTimeWait(
+        connection_id, ietf_quic, action, encryption_level,
+        termination_packets);
+    return;
+  }
+  compact_list_.Add(connection_id, ietf_quic, clock_->ApproximateNow());
+}
+
+void QuicCompactTimeWaitListManager::ProcessPacket(
+    const quic::QuicSocketAddress& self_address,
+    const quic::QuicSocketAddress& peer_address,
+    quic::QuicConnectionId connection_id,
+    quic::PacketHeaderFormat header_format,
+    std::unique_ptr<quic::QuicPerPacketContext> packet_context) {
+  if (IsConnectionIdInTimeWait(connection_id)) {
+    quic::QuicTimeWaitListManager::ProcessPacket(
+        self_address, peer_address, connection_id, header_format,
+        std::move(packet_context));
+    return;
+  }
+  ProcessCompactPacket(self_address, peer_address, connection_id,
+                       header_format, std::move(packet_context));
+}
+
+bool QuicCompactTimeWaitListManager::ProcessCompactPacket(
+    const quic::QuicSocketAddress& self_address,
+    const quic::QuicSocketAddress& peer_address,
+    quic::QuicConnectionId connection_id,
+    quic::PacketHeaderFormat header_format,
+    std::unique_ptr<quic::QuicPerPacketContext> packet_context) {
+  bool ietf_quic = false;
+  uint32_t num_packets = 0;
+  if (!compact_list_.OnPacketReceived(connection_id, clock_->ApproximateNow(),
+                                      &ietf_quic, &num_packets)) {
+    return false;
+  }
+  // Like the base class, do not answer long header packets with a stateless
+  // reset.
+  if (ietf_quic && header_format == quic::IETF_QUIC_LONG_HEADER_PACKET)
+    return true;
+  // Like the base class, back off exponentially: only the packets whose count
+  // is a power of two are answered, so that spoofed or looping traffic cannot
+  // draw a reset per packet. Once the count saturates, nothing is sent.
+  if (num_packets >= QuicCompactTimeWaitList::kMaxPacketCount ||
+      (num_packets & (num_packets - 1)) != 0) {
+    return true;
+  }
+  SendPublicReset(self_address, peer_address, connection_id, ietf_quic,
+                  std::move(packet_context));
+  return true;
+}
+
+QuicCompactTimeWaitDispatcher::QuicCompactTimeWaitDispatcher(
+    const quic::QuicConfig* config,
+    const quic::QuicCryptoServerConfig* crypto_config,
+    quic::QuicVersionManager* version_manager,
+    std::unique_ptr<quic::QuicConnectionHelperInterface> helper,
+    std::unique_ptr<quic::QuicCryptoServerStreamBase::Helper> session_helper,
+    std::unique_ptr<quic::QuicAlarmFactory> alarm_factory,
+    quic::QuicSimpleServerBackend* quic_simple_server_backend,
+    uint8_t expected_server_connection_id_length,
+    bool compact_time_wait_list)
+    : quic::QuicSimpleDispatcher(config,
+                                 crypto_config,
+                                 version_manager,
+                                 std::move(helper),
+                                 std::move(session_helper),
+                                 std::move(alarm_factory),
+                                 quic_simple_server_backend,
+                                 expected_server_connection_id_length),
+      compact_time_wait_list_(compact_time_wait_list) {}
+
+QuicCompactTimeWaitDispatcher::~QuicCompactTimeWaitDispatcher() = default;
+
+quic::QuicTimeWaitListManager*
+QuicCompactTimeWaitDispatcher::CreateQuicTimeWaitListManager() {
+  if (!compact_time_wait_list_)
+    return quic::QuicSimpleDispatcher::CreateQuicTimeWaitListManager();
+  return new QuicCompactTimeWaitListManager(writer(), this,
+                                            helper()->GetClock(),
+                                            alarm_factory());
+}
+
+bool QuicCompactTimeWaitDispatcher::OnFailedToDispatchPacket(
+    const quic::ReceivedPacketInfo& packet_info) {
+  if (quic::QuicSimpleDispatcher::OnFailedToDispatchPacket(packet_info))
+    return true;
+  if (!compact_time_wait_list_)
+    return false;
+  // Called for every packet that matches no session, before the dispatcher
+  // checks IsConnectionIdInTimeWait() and would otherwise take the packet
+  // for a new connection.
+  auto* manager =
+      static_cast<QuicCompactTimeWaitListManager*>(time_wait_list_manager());
+  return manager->ProcessCompactPacket(
+      packet_info.self_address, packet_info.peer_address,
+      packet_info.destination_connection_id, packet_info.form,
+      GetPerPacketContext());
+}
+
+}  // namespace net
@@ -0,0 +1,197 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_COMPACT_TIME_WAIT_LIST_H_
+#define NET_TOOLS_QUIC_QUIC_COMPACT_TIME_WAIT_LIST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/macros.h"
+#include "net/third_party/quiche/src/quic/core/quic_connection_id.h"
+#include "net/third_party/quiche/src/quic/core/quic_packets.h"
+#include "net/third_party/quiche/src/quic/core/quic_time.h"
+#include "net/third_party/quiche/src/quic/core/quic_time_wait_list_manager.h"
+#include "net/third_party/quiche/src/quic/tools/quic_simple_dispatcher.h"
+
+namespace net {
+
+// Remembers connection IDs in time wait in 11 to 22 bytes each, by storing
+// only a salted 48-bit fingerprint of each ID, along with a count of the
+// packets received for it and whether its peer uses IETF QUIC, in one 64-bit
+// slot. Fingerprints live in a ring of
+// open-addressing hash tables, one per slice of the time-wait period; when
+// the ring wraps, the oldest table is dropped in one go, so expiry needs no
+// per-entry timestamps or list links. An entry is kept for at least
+// |time_wait_period| and at most one slice longer, unless |max_entries| is
+// reached first, in which case the oldest slice is dropped early.
+//
+// A lookup may return a false positive with probability about n / 2^48 for
+// n entries, which only costs an unneeded stateless reset.
+class QuicCompactTimeWaitList {
+ public:
+  QuicCompactTimeWaitList(quic::QuicTime::Delta time_wait_period,
+                          size_t max_entries,
+                          size_t num_slices);
+  ~QuicCompactTimeWaitList();
+
+  // Adds |connection_id|, whose peer uses IETF QUIC if |ietf_quic|. Does
+  // nothing if it is already present.
+  void Add(quic::QuicConnectionId connection_id,
+           bool ietf_quic,
+           quic::QuicTime now);
+
+  // Returns true if |connection_id| is in time wait, and sets |ietf_quic|.
+  bool Contains(quic::QuicConnectionId connection_id,
+                quic::QuicTime now,
+                bool* ietf_quic);
+
+  // Like Contains(), but also counts a packet received for |connection_id|
+  // and sets |num_packets| to the number of packets counted so far, which
+  // saturates at kMaxPacketCount.
+  bool OnPacketReceived(quic::QuicConnectionId connection_id,
+                        quic::QuicTime now,
+                        bool* ietf_quic,
+                        uint32_t* num_packets);
+
+  static const uint32_t kMaxPacketCount;
+
+  size_t size() const { return size_; }
+  // Number of entries dropped before their time-wait period ended because
+  // the list was full.
+  size_t num_evicted_early() const { return num_evicted_early_; }
+
+  // Returns the number of bytes held by this list.
+  size_t EstimateMemoryUsage() const;
+
+ private:
+  struct Slice {
+    Slice();
+    Slice(Slice&& other);
+    ~Slice();
+
+    // Fingerprints, or 0 for empty slots. The size is a power of two.
+    std::vector<uint64_t> slots;
+    size_t size = 0;
+  };
+
+  uint64_t Fingerprint(quic::QuicConnectionId connection_id) const;
+  // Returns the slot holding |connection_id| at |now|, or null.
+  uint64_t* Find(quic::QuicConnectionId connection_id, quic::QuicTime now);
+  // Drops slices that are older than the time-wait period at |now|.
+  void Expire(quic::QuicTime now);
+  // Empties |slice| and releases its memory.
+  void Clear(Slice* slice);
+  // Returns the slot of |slice| that holds |key|, or the empty slot where it
+  // would go.
+  static uint64_t* FindSlot(Slice* slice, uint64_t key);
+  static void Insert(Slice* slice, uint64_t fingerprint);
+
+  const quic::QuicTime::Delta slice_width_;
+  const size_t max_entries_;
+  // Keys the fingerprints, so that peers cannot pick colliding IDs.
+  const uint64_t salt_;
+
+  std::vector<Slice> slices_;
+  // Index of the slice new entries go into, and the time that slice started.
+  size_t current_;
+  quic::QuicTime current_start_;
+  size_t size_;
+  size_t num_evicted_early_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicCompactTimeWaitList);
+};
+
+// A time-wait list manager that keeps connections whose packets only need a
+// stateless reset in a QuicCompactTimeWaitList, and builds the reset when a
+// packet arrives instead of storing termination packets per connection.
+// IETF QUIC connections that were closed after the handshake completed are
+// kept this way too: their CONNECTION_CLOSE has been sent once already, and
+// a peer that keeps sending can be answered with a stateless reset instead
+// (RFC 9000 section 10.3). Other connections use the base class.
+//
+// Compact entries are not in the base class's map, so the dispatcher does
+// not see them through IsConnectionIdInTimeWait(), which is not virtual. Use
+// QuicCompactTimeWaitDispatcher, which offers them ProcessCompactPacket().
+class QuicCompactTimeWaitListManager : public quic::QuicTimeWaitListManager {
+ public:
+  QuicCompactTimeWaitListManager(quic::QuicPacketWriter* writer,
+                                 Visitor* visitor,
+                                 const quic::QuicClock* clock,
+                                 quic::QuicAlarmFactory* alarm_factory);
+  ~QuicCompactTimeWaitListManager() override;
+
+  // quic::QuicTimeWaitListManager methods:
+  void AddConnectionIdToTimeWait(
+      quic::QuicConnectionId connection_id,
+      bool ietf_quic,
+      TimeWaitAction action,
+      quic::EncryptionLevel encryption_level,
+      std::vector<std::unique_ptr<quic::QuicEncryptedPacket>>*
+          termination_packets) override;
+  void ProcessPacket(
+      const quic::QuicSocketAddress& self_address,
+      const quic::QuicSocketAddress& peer_address,
+      quic::QuicConnectionId connection_id,
+      quic::PacketHeaderFormat header_format,
+      std::unique_ptr<quic::QuicPerPacketContext> packet_context) override;
+
+  // Answers a packet for |connection_id| if it is in the compact list, and
+  // returns true. Returns false for other connection IDs.
+  bool ProcessCompactPacket(
+      const quic::QuicSocketAddress& self_address,
+      const quic::QuicSocketAddress& peer_address,
+      quic::QuicConnectionId connection_id,
+      quic::PacketHeaderFormat header_format,
+      std::unique_ptr<quic::QuicPerPacketContext> packet_context);
+
+  const QuicCompactTimeWaitList& compact_list() const { return compact_list_; }
+
+ private:
+  const quic::QuicClock* clock_;  // Not owned.
+  QuicCompactTimeWaitList compact_list_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicCompactTimeWaitListManager);
+};
+
+// A dispatcher whose time-wait list manager is a
+// QuicCompactTimeWaitListManager if |compact_time_wait_list| is true. Packets
+// that match no session are looked up in the compact list before the
+// dispatcher treats them as the start of a new connection. Subclasses that
+// override CreateQuicTimeWaitListManager() must return a
+// QuicCompactTimeWaitListManager when compact_time_wait_list() is true.
+class QuicCompactTimeWaitDispatcher : public quic::QuicSimpleDispatcher {
+ public:
+  QuicCompactTimeWaitDispatcher(
+      const quic::QuicConfig* config,
+      const quic::QuicCryptoServerConfig* crypto_config,
+      quic::QuicVersionManager* version_manager,
+      std::unique_ptr<quic::QuicConnectionHelperInterface> helper,
+      std::unique_ptr<quic::QuicCryptoServerStreamBase::Helper> session_helper,
+      std::unique_ptr<quic::QuicAlarmFactory> alarm_factory,
+      quic::QuicSimpleServerBackend* quic_simple_server_backend,
+      uint8_t expected_server_connection_id_length,
+      bool compact_time_wait_list);
+  ~QuicCompactTimeWaitDispatcher() override;
+
+ protected:
+  // quic::QuicSimpleDispatcher methods:
+  quic::QuicTimeWaitListManager* CreateQuicTimeWaitListManager() override;
+  bool OnFailedToDispatchPacket(
+      const quic::ReceivedPacketInfo& packet_info) override;
+
+  bool compact_time_wait_list() const { return compact_time_wait_list_; }
+
+ private:
+  const bool compact_time_wait_list_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicCompactTimeWaitDispatcher);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_COMPACT_TIME_WAIT_LIST_H_
@@ -0,0 +1,134 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares the memory the regular and compact time-wait lists use to hold
+// the default maximum number of connections, and how fast the compact list
+// adds and finds them.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/process/process_metrics.h"
+#include "base/timer/elapsed_timer.h"
+#include "net/third_party/quiche/src/quic/core/quic_time_wait_list_manager.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_flags.h"
+#include "net/third_party/quiche/src/quic/test_tools/mock_clock.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_test_utils.h"
+#include "net/tools/quic/quic_compact_time_wait_list.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace net {
+namespace test {
+namespace {
+
+// Size of the CONNECTION_CLOSE packet kept for each closed connection.
+const size_t kTerminationPacketSize = 64;
+
+const char kMetricPrefix[] = "QuicTimeWaitList.";
+const char kMetricMemory[] = "memory";
+const char kMetricBytesPerConnection[] = "bytes_per_connection";
+const char kMetricAddRate[] = "add_rate";
+const char kMetricLookupRate[] = "lookup_rate";
+
+size_t GetMallocUsage() {
+  return base::ProcessMetrics::CreateCurrentProcessMetrics()->GetMallocUsage();
+}
+
+size_t NumConnections() {
+  return GetQuicFlag(FLAGS_quic_time_wait_list_max_connections);
+}
+
+void ReportMemory(const std::string& story, size_t bytes) {
+  perf_test::PerfResultReporter reporter(kMetricPrefix, story);
+  reporter.RegisterImportantMetric(kMetricMemory, "bytes");
+  reporter.RegisterImportantMetric(kMetricBytesPerConnection, "bytes");
+  reporter.AddResult(kMetricMemory, bytes);
+  reporter.AddResult(kMetricBytesPerConnection,
+                     static_cast<double>(bytes) / NumConnections());
+}
+
+class QuicTimeWaitListPerfTest : public ::testing::Test {
+ protected:
+  QuicTimeWaitListPerfTest() {
+    clock_.AdvanceTime(quic::QuicTime::Delta::FromSeconds(1));
+  }
+
+  // Fills a regular time-wait list, with one termination packet per
+  // connection if |with_termination_packets|.
+  void RunRegular(const std::string& story, bool with_termination_packets) {
+    size_t malloc_before = GetMallocUsage();
+    auto manager = std::make_unique<quic::QuicTimeWaitListManager>(
+        &writer_, &visitor_, &clock_, &alarm_factory_);
+    for (size_t i = 0; i < NumConnections(); ++i) {
+      std::vector<std::unique_ptr<quic::QuicEncryptedPacket>> packets;
+      if (with_termination_packets) {
+        packets.push_back(std::make_unique<quic::QuicEncryptedPacket>(
+            new char[kTerminationPacketSize], kTerminationPacketSize,
+            /*owns_buffer=*/true));
+      }
+      manager->AddConnectionIdToTimeWait(
+          quic::test::TestConnectionId(i + 1), /*ietf_quic=*/true,
+          with_termination_packets
+              ? quic::QuicTimeWaitListManager::SEND_TERMINATION_PACKETS
+              : quic::QuicTimeWaitListManager::SEND_STATELESS_RESET,
+          quic::ENCRYPTION_FORWARD_SECURE, &packets);
+    }
+    ASSERT_EQ(NumConnections(), manager->num_connections());
+    ReportMemory(story, GetMallocUsage() - malloc_before);
+  }
+
+  testing::NiceMock<quic::test::MockPacketWriter> writer_;
+  testing::NiceMock<quic::test::MockQuicSessionVisitor> visitor_;
+  quic::MockClock clock_;
+  quic::test::MockAlarmFactory alarm_factory_;
+};
+
+TEST_F(QuicTimeWaitListPerfTest, Regular) {
+  RunRegular("regular", /*with_termination_packets=*/false);
+}
+
+TEST_F(QuicTimeWaitListPerfTest, RegularWithTerminationPackets) {
+  RunRegular("regular_with_termination_packets",
+             /*with_termination_packets=*/true);
+}
+
+TEST_F(QuicTimeWaitListPerfTest, Compact) {
+  size_t malloc_before = GetMallocUsage();
+  QuicCompactTimeWaitList list(
+      quic::QuicTime::Delta::FromSeconds(
+          GetQuicFlag(FLAGS_quic_time_wait_list_seconds)),
+      NumConnections(), /*num_slices=*/8);
+
+  base::ElapsedTimer add_timer;
+  for (size_t i = 0; i < NumConnections(); ++i) {
+    list.Add(quic::test::TestConnectionId(i + 1), /*ietf_quic=*/true,
+             clock_.ApproximateNow());
+  }
+  base::TimeDelta add_time = add_timer.Elapsed();
+  ASSERT_EQ(NumConnections(), list.size());
+  size_t malloc_bytes = GetMallocUsage() - malloc_before;
+
+  bool ietf_quic;
+  base::ElapsedTimer lookup_timer;
+  for (size_t i = 0; i < NumConnections(); ++i) {
+    ASSERT_TRUE(list.Contains(quic::test::TestConnectionId(i + 1),
+                              clock_.ApproximateNow(), &ietf_quic));
+  }
+  base::TimeDelta lookup_time = lookup_timer.Elapsed();
+
+  ReportMemory("compact", malloc_bytes);
+  perf_test::PerfResultReporter reporter(kMetricPrefix, "compact");
+  reporter.RegisterImportantMetric(kMetricAddRate, "runs/s");
+  reporter.RegisterImportantMetric(kMetricLookupRate, "runs/s");
+  reporter.AddResult(kMetricAddRate, NumConnections() / add_time.InSecondsF());
+  reporter.AddResult(kMetricLookupRate,
+                     NumConnections() / lookup_time.InSecondsF());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
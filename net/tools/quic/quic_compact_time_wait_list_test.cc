@@ -0,0 +1,284 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_compact_time_wait_list.h"
+
+#include <memory>
+
+#include "net/third_party/quiche/src/quic/core/crypto/quic_crypto_server_config.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/core/quic_version_manager.h"
+#include "net/third_party/quiche/src/quic/test_tools/crypto_test_utils.h"
+#include "net/third_party/quiche/src/quic/test_tools/mock_clock.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_dispatcher_peer.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_test_utils.h"
+#include "net/third_party/quiche/src/quic/tools/quic_memory_cache_backend.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using testing::_;
+using testing::Return;
+
+namespace net {
+namespace test {
+namespace {
+
+const size_t kNumSlices = 8;
+
+class QuicCompactTimeWaitListTest : public ::testing::Test {
+ protected:
+  QuicCompactTimeWaitListTest()
+      : period_(quic::QuicTime::Delta::FromSeconds(70)),
+        now_(quic::QuicTime::Zero() + quic::QuicTime::Delta::FromSeconds(1)),
+        list_(period_, 1000, kNumSlices) {}
+
+  bool Contains(uint64_t id) {
+    bool ietf_quic;
+    return list_.Contains(quic::test::TestConnectionId(id), now_, &ietf_quic);
+  }
+
+  const quic::QuicTime::Delta period_;
+  quic::QuicTime now_;
+  QuicCompactTimeWaitList list_;
+};
+
+TEST_F(QuicCompactTimeWaitListTest, AddAndContains) {
+  list_.Add(quic::test::TestConnectionId(1), /*ietf_quic=*/true, now_);
+  list_.Add(quic::test::TestConnectionId(2), /*ietf_quic=*/false, now_);
+  list_.Add(quic::test::TestConnectionId(2), /*ietf_quic=*/false, now_);
+  EXPECT_EQ(2u, list_.size());
+
+  bool ietf_quic = false;
+  EXPECT_TRUE(
+      list_.Contains(quic::test::TestConnectionId(1), now_, &ietf_quic));
+  EXPECT_TRUE(ietf_quic);
+  EXPECT_TRUE(
+      list_.Contains(quic::test::TestConnectionId(2), now_, &ietf_quic));
+  EXPECT_FALSE(ietf_quic);
+  EXPECT_FALSE(Contains(3));
+}
+
+TEST_F(QuicCompactTimeWaitListTest, GrowsAndKeepsEntries) {
+  for (uint64_t id = 1; id <= 500; ++id)
+    list_.Add(quic::test::TestConnectionId(id), true, now_);
+  EXPECT_EQ(500u, list_.size());
+  for (uint64_t id = 1; id <= 500; ++id)
+    EXPECT_TRUE(Contains(id)) << id;
+  EXPECT_FALSE(Contains(501));
+  // 8-byte slots at a load factor of at least 3/8.
+  EXPECT_LE(list_.EstimateMemoryUsage(), 500u * 22 + 1024);
+}
+
+TEST_F(QuicCompactTimeWaitListTest, ExpiresAfterPeriod) {
+  list_.Add(quic::test::TestConnectionId(1), true, now_);
+  now_ = now_ + period_;
+  list_.Add(quic::test::TestConnectionId(2), true, now_);
+  EXPECT_TRUE(Contains(1));
+
+  // Entries outlive the period by at most one slice.
+  now_ = now_ + period_ * (1.0 / (kNumSlices - 1));
+  EXPECT_FALSE(Contains(1));
+  EXPECT_TRUE(Contains(2));
+  EXPECT_EQ(1u, list_.size());
+
+  now_ = now_ + period_ * 10;
+  EXPECT_FALSE(Contains(2));
+  EXPECT_EQ(0u, list_.size());
+}
+
+TEST_F(QuicCompactTimeWaitListTest, EvictsOldestSliceWhenFull) {
+  QuicCompactTimeWaitList list(period_, 10, kNumSlices);
+  for (uint64_t id = 1; id <= 5; ++id)
+    list.Add(quic::test::TestConnectionId(id), true, now_);
+  now_ = now_ + period_ * (1.0 / (kNumSlices - 1));
+  for (uint64_t id = 6; id <= 11; ++id)
+    list.Add(quic::test::TestConnectionId(id), true, now_);
+
+  bool ietf_quic;
+  EXPECT_EQ(5u, list.num_evicted_early());
+  EXPECT_EQ(6u, list.size());
+  EXPECT_FALSE(
+      list.Contains(quic::test::TestConnectionId(1), now_, &ietf_quic));
+  EXPECT_TRUE(
+      list.Contains(quic::test::TestConnectionId(11), now_, &ietf_quic));
+}
+
+TEST_F(QuicCompactTimeWaitListTest, CountsPackets) {
+  list_.Add(quic::test::TestConnectionId(1), /*ietf_quic=*/true, now_);
+  list_.Add(quic::test::TestConnectionId(2), /*ietf_quic=*/false, now_);
+
+  bool ietf_quic = false;
+  uint32_t num_packets = 0;
+  for (uint32_t i = 1; i <= 3; ++i) {
+    ASSERT_TRUE(list_.OnPacketReceived(quic::test::TestConnectionId(1), now_,
+                                       &ietf_quic, &num_packets));
+    EXPECT_EQ(i, num_packets);
+    EXPECT_TRUE(ietf_quic);
+  }
+  ASSERT_TRUE(list_.OnPacketReceived(quic::test::TestConnectionId(2), now_,
+                                     &ietf_quic, &num_packets));
+  EXPECT_EQ(1u, num_packets);
+  EXPECT_FALSE(ietf_quic);
+  EXPECT_FALSE(list_.OnPacketReceived(quic::test::TestConnectionId(3), now_,
+                                      &ietf_quic, &num_packets));
+
+  // The count saturates without touching the rest of the slot.
+  for (uint32_t i = 0; i < QuicCompactTimeWaitList::kMaxPacketCount; ++i) {
+    list_.OnPacketReceived(quic::test::TestConnectionId(1), now_, &ietf_quic,
+                           &num_packets);
+  }
+  EXPECT_EQ(QuicCompactTimeWaitList::kMaxPacketCount, num_packets);
+  EXPECT_TRUE(ietf_quic);
+  EXPECT_TRUE(Contains(1));
+  EXPECT_EQ(2u, list_.size());
+}
+
+class QuicCompactTimeWaitListManagerTest : public ::testing::Test {
+ protected:
+  QuicCompactTimeWaitListManagerTest()
+      : manager_(&writer_, &visitor_, &clock_, &alarm_factory_),
+        self_address_(quic::QuicIpAddress::Loopback4(), 443),
+        peer_address_(quic::QuicIpAddress::Loopback4(), 12345) {
+    clock_.AdvanceTime(quic::QuicTime::Delta::FromSeconds(1));
+  }
+
+  void ProcessPacket(quic::QuicConnectionId connection_id) {
+    manager_.ProcessPacket(self_address_, peer_address_, connection_id,
+                           quic::IETF_QUIC_SHORT_HEADER_PACKET,
+                           std::make_unique<quic::QuicPerPacketContext>());
+  }
+
+  testing::NiceMock<quic::test::MockPacketWriter> writer_;
+  testing::NiceMock<quic::test::MockQuicSessionVisitor> visitor_;
+  quic::MockClock clock_;
+  quic::test::MockAlarmFactory alarm_factory_;
+  QuicCompactTimeWaitListManager manager_;
+  quic::QuicSocketAddress self_address_;
+  quic::QuicSocketAddress peer_address_;
+};
+
+TEST_F(QuicCompactTimeWaitListManagerTest, StatelessResetOnDemand) {
+  quic::QuicConnectionId connection_id = quic::test::TestConnectionId(7);
+  manager_.AddConnectionIdToTimeWait(
+      connection_id, /*ietf_quic=*/true,
+      quic::QuicTimeWaitListManager::SEND_STATELESS_RESET,
+      quic::ENCRYPTION_INITIAL, nullptr);
+  EXPECT_FALSE(manager_.IsConnectionIdInTimeWait(connection_id));
+  EXPECT_EQ(1u, manager_.compact_list().size());
+
+  EXPECT_CALL(writer_, WritePacket(_, _, _, _, _))
+      .WillOnce(Return(quic::WriteResult(quic::WRITE_STATUS_OK, 0)));
+  ProcessPacket(connection_id);
+
+  // Unknown connection IDs are ignored.
+  ProcessPacket(quic::test::TestConnectionId(8));
+}
+
+TEST_F(QuicCompactTimeWaitListManagerTest, ResponsesBackOff) {
+  quic::QuicConnectionId connection_id = quic::test::TestConnectionId(7);
+  manager_.AddConnectionIdToTimeWait(
+      connection_id, /*ietf_quic=*/true,
+      quic::QuicTimeWaitListManager::SEND_STATELESS_RESET,
+      quic::ENCRYPTION_INITIAL, nullptr);
+
+  // Only packets 1, 2, 4, 8, 16, 32 and 64 are answered.
+  EXPECT_CALL(writer_, WritePacket(_, _, _, _, _))
+      .Times(7)
+      .WillRepeatedly(Return(quic::WriteResult(quic::WRITE_STATUS_OK, 0)));
+  for (int i = 0; i < 100; ++i)
+    ProcessPacket(connection_id);
+}
+
+TEST_F(QuicCompactTimeWaitListManagerTest, HandshakeCloseUsesBaseList) {
+  quic::QuicConnectionId connection_id = quic::test::TestConnectionId(7);
+  std::vector<std::unique_ptr<quic::QuicEncryptedPacket>> termination_packets;
+  termination_packets.push_back(std::make_unique<quic::QuicEncryptedPacket>(
+      new char[10], 10, /*owns_buffer=*/true));
+  manager_.AddConnectionIdToTimeWait(
+      connection_id, /*ietf_quic=*/true,
+      quic::QuicTimeWaitListManager::SEND_TERMINATION_PACKETS,
+      quic::ENCRYPTION_INITIAL, &termination_packets);
+  EXPECT_TRUE(manager_.IsConnectionIdInTimeWait(connection_id));
+  EXPECT_EQ(0u, manager_.compact_list().size());
+}
+
+class QuicCompactTimeWaitDispatcherTest : public ::testing::Test {
+ protected:
+  QuicCompactTimeWaitDispatcherTest()
+      : crypto_config_(quic::QuicCryptoServerConfig::TESTING,
+                       quic::QuicRandom::GetInstance(),
+                       quic::test::crypto_test_utils::ProofSourceForTesting(),
+                       quic::KeyExchangeSource::Default()),
+        version_manager_(quic::AllSupportedVersions()),
+        helper_(new quic::test::MockQuicConnectionHelper),
+        dispatcher_(&config_,
+                    &crypto_config_,
+                    &version_manager_,
+                    std::unique_ptr<quic::QuicConnectionHelperInterface>(
+                        helper_),
+                    std::make_unique<testing::NiceMock<
+                        quic::test::MockQuicCryptoServerStreamHelper>>(),
+                    std::make_unique<quic::test::MockAlarmFactory>(),
+                    &backend_,
+                    quic::kQuicDefaultConnectionIdLength,
+                    /*compact_time_wait_list=*/true),
+        writer_(new testing::NiceMock<quic::test::MockPacketWriter>),
+        self_address_(quic::QuicIpAddress::Loopback4(), 443),
+        peer_address_(quic::QuicIpAddress::Loopback4(), 12345) {
+    // Takes ownership of |writer_|.
+    dispatcher_.InitializeWithWriter(writer_);
+    helper_->AdvanceTime(quic::QuicTime::Delta::FromSeconds(1));
+  }
+
+  void ProcessPacket(quic::QuicConnectionId connection_id, bool version_flag) {
+    std::unique_ptr<quic::QuicEncryptedPacket> packet(
+        quic::test::ConstructEncryptedPacket(
+            connection_id, quic::EmptyQuicConnectionId(), version_flag,
+            /*reset_flag=*/false, /*packet_number=*/1, "data"));
+    std::unique_ptr<quic::QuicReceivedPacket> received(
+        quic::test::ConstructReceivedPacket(*packet,
+                                            helper_->GetClock()->Now()));
+    dispatcher_.ProcessPacket(self_address_, peer_address_, *received);
+  }
+
+  quic::QuicConfig config_;
+  quic::QuicCryptoServerConfig crypto_config_;
+  quic::QuicVersionManager version_manager_;
+  quic::QuicMemoryCacheBackend backend_;
+  quic::test::MockQuicConnectionHelper* helper_;  // Owned by |dispatcher_|.
+  QuicCompactTimeWaitDispatcher dispatcher_;
+  quic::test::MockPacketWriter* writer_;  // Owned by |dispatcher_|.
+  quic::QuicSocketAddress self_address_;
+  quic::QuicSocketAddress peer_address_;
+};
+
+TEST_F(QuicCompactTimeWaitDispatcherTest, PacketsForClosedConnection) {
+  quic::QuicConnectionId connection_id = quic::test::TestConnectionId(7);
+  quic::QuicTimeWaitListManager* manager =
+      quic::test::QuicDispatcherPeer::GetTimeWaitListManager(&dispatcher_);
+  manager->AddConnectionIdToTimeWait(
+      connection_id, /*ietf_quic=*/true,
+      quic::QuicTimeWaitListManager::SEND_STATELESS_RESET,
+      quic::ENCRYPTION_INITIAL, nullptr);
+  ASSERT_FALSE(manager->IsConnectionIdInTimeWait(connection_id));
+
+  // A versioned packet is dropped, rather than buffered as the first packet
+  // of a new connection.
+  EXPECT_CALL(*writer_, WritePacket(_, _, _, _, _)).Times(0);
+  ProcessPacket(connection_id, /*version_flag=*/true);
+  EXPECT_FALSE(quic::test::QuicDispatcherPeer::GetBufferedPackets(&dispatcher_)
+                   ->HasBufferedPackets(connection_id));
+  EXPECT_EQ(0u, dispatcher_.NumSessions());
+  testing::Mock::VerifyAndClearExpectations(writer_);
+
+  // A short header packet is answered with a stateless reset.
+  EXPECT_CALL(*writer_, WritePacket(_, _, _, _, _))
+      .WillOnce(Return(quic::WriteResult(quic::WRITE_STATUS_OK, 0)));
+  ProcessPacket(connection_id, /*version_flag=*/false);
+  EXPECT_FALSE(manager->IsConnectionIdInTimeWait(connection_id));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -0,0 +1,335 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_compressed_cache_backend.h"
+
+#include <list>
+#include <utility>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "base/task/thread_pool.h"
+#include "third_party/brotli/include/brotli/encode.h"
+#include "third_party/zlib/zlib.h"
+
+namespace net {
+
+namespace {
+
+const char kAcceptEncoding[] = "accept-encoding";
+const char kContentEncoding[] = "content-encoding";
+const char kVary[] = "vary";
+
+const char* const kEncodingNames[] = {"identity", "gzip", "br"};
+
+bool IsCompressibleContentType(quiche::QuicheStringPiece content_type) {
+  static const char* const kCompressibleTypes[] = {
+      "text/",           "application/javascript", "application/json",
+      "application/xml", "application/wasm",       "image/svg+xml",
+  };
+  for (const char* type : kCompressibleTypes) {
+    if (base::StartsWith(content_type, type,
+                         base::CompareCase::INSENSITIVE_ASCII)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool GzipCompress(const std::string& input, std::string* output) {
+  z_stream stream = {};
+  if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED,
+                   16 + MAX_WBITS /* gzip wrapper */, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  output->resize(deflateBound(&stream, input.size()));
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = input.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&(*output)[0]);
+  stream.avail_out = output->size();
+  int rv = deflate(&stream, Z_FINISH);
+  deflateEnd(&stream);
+  if (rv != Z_STREAM_END)
+    return false;
+  output->resize(stream.total_out);
+  return true;
+}
+
+bool BrotliCompress(const std::string& input, std::string* output) {
+  size_t encoded_size = BrotliEncoderMaxCompressedSize(input.size());
+  if (encoded_size == 0)
+    return false;
+  output->resize(encoded_size);
+  if (!BrotliEncoderCompress(
+          BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+          input.size(), reinterpret_cast<const uint8_t*>(input.data()),
+          &encoded_size, reinterpret_cast<uint8_t*>(&(*output)[0]))) {
+    return false;
+  }
+  output->resize(encoded_size);
+  return true;
+}
+
+// Returns true if |response| may be worth compressing.
+bool IsCompressible(const quic::QuicBackendResponse& response) {
+  if (response.response_type() !=
+          quic::QuicBackendResponse::REGULAR_RESPONSE ||
+      response.body().size() < kMinCompressibleBodySize ||
+      response.headers().find(kContentEncoding) != response.headers().end()) {
+    return false;
+  }
+  auto status = response.headers().find(":status");
+  auto content_type = response.headers().find("content-type");
+  return status != response.headers().end() && status->second == "200" &&
+         content_type != response.headers().end() &&
+         IsCompressibleContentType(content_type->second);
+}
+
+// Returns a copy of |response| with |body| and, unless |encoding| is
+// IDENTITY, the matching content-encoding.
+std::unique_ptr<quic::QuicBackendResponse> CreateVariant(
+    const quic::QuicBackendResponse& response,
+    QuicCompressedCacheBackend::Encoding encoding,
+    const std::string& body) {
+  spdy::SpdyHeaderBlock headers = response.headers().Clone();
+  if (encoding != QuicCompressedCacheBackend::IDENTITY)
+    headers[kContentEncoding] = kEncodingNames[encoding];
+  headers["content-length"] = base::NumberToString(body.size());
+  auto vary = headers.find(kVary);
+  if (vary == headers.end()) {
+    headers[kVary] = kAcceptEncoding;
+  } else if (vary->second.find(kAcceptEncoding) == std::string::npos) {
+    headers[kVary] = std::string(vary->second) + ", " + kAcceptEncoding;
+  }
+
+  auto variant = std::make_unique<quic::QuicBackendResponse>();
+  variant->set_response_type(response.response_type());
+  variant->set_headers(std::move(headers));
+  variant->set_trailers(response.trailers().Clone());
+  variant->set_body(body);
+  return variant;
+}
+
+}  // namespace
+
+QuicCompressedCacheBackend::Variants::Variants() = default;
+
+QuicCompressedCacheBackend::Variants::~Variants() = default;
+
+// static
+const base::TimeDelta QuicCompressedCacheBackend::kStatsLogInterval =
+    base::TimeDelta::FromMinutes(10);
+
+QuicCompressedCacheBackend::QuicCompressedCacheBackend(
+    std::unique_ptr<quic::QuicMemoryCacheBackend> cache)
+    : cache_(std::move(cache)) {
+  stats_timer_.Start(FROM_HERE, kStatsLogInterval,
+                     base::BindRepeating(
+                         &QuicCompressedCacheBackend::MaybeLogStats,
+                         base::Unretained(this)));
+}
+
+QuicCompressedCacheBackend::~QuicCompressedCacheBackend() {
+  MaybeLogStats();
+}
+
+base::Value QuicCompressedCacheBackend::StatsToValue() const {
+  base::Value dict(base::Value::Type::DICTIONARY);
+  dict.SetIntKey("responses_with_variants",
+                 static_cast<int>(stats_.responses_with_variants));
+  // base::Value has no 64-bit integers.
+  dict.SetStringKey("original_body_bytes",
+                    base::NumberToString(stats_.original_body_bytes));
+  dict.SetStringKey("memory_used_bytes",
+                    base::NumberToString(stats_.variant_body_bytes));
+  dict.SetStringKey("bytes_served", base::NumberToString(stats_.bytes_served));
+  dict.SetStringKey("bytes_saved",
+                    base::NumberToString(stats_.uncompressed_bytes_served -
+                                         stats_.bytes_served));
+  return dict;
+}
+
+// static
+QuicCompressedCacheBackend::Encoding
+QuicCompressedCacheBackend::SelectEncoding(
+    quiche::QuicheStringPiece accept_encoding,
+    uint32_t available) {
+  // Quality values of each encoding; -1 if not listed.
+  double qvalues[NUM_ENCODINGS] = {-1, -1, -1};
+  double wildcard_qvalue = -1;
+  for (const base::StringPiece& item :
+       base::SplitStringPiece(accept_encoding, ",", base::TRIM_WHITESPACE,
+                              base::SPLIT_WANT_NONEMPTY)) {
+    std::vector<base::StringPiece> parts = base::SplitStringPiece(
+        item, ";", base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+    if (parts.empty())
+      continue;
+    double qvalue = 1;
+    for (size_t i = 1; i < parts.size(); ++i) {
+      if (base::StartsWith(parts[i], "q=",
+                           base::CompareCase::INSENSITIVE_ASCII) &&
+          !base::StringToDouble(parts[i].substr(2), &qvalue)) {
+        qvalue = 0;
+      }
+    }
+    if (parts[0] == "*") {
+      wildcard_qvalue = qvalue;
+      continue;
+    }
+    for (int encoding = 0; encoding < NUM_ENCODINGS; ++encoding) {
+      if (base::EqualsCaseInsensitiveASCII(parts[0],
+                                           kEncodingNames[encoding])) {
+        qvalues[encoding] = qvalue;
+      }
+    }
+  }
+
+  // Among the acceptable encodings with the highest quality, prefer the one
+  // that compresses best.
+  Encoding selected = IDENTITY;
+  double selected_qvalue = 0;
+  for (Encoding encoding : {BROTLI, GZIP}) {
+    if (!(available & (1 << encoding)))
+      continue;
+    double qvalue =
+        qvalues[encoding] >= 0 ? qvalues[encoding] : wildcard_qvalue;
+    if (qvalue > selected_qvalue) {
+      selected = encoding;
+      selected_qvalue = qvalue;
+    }
+  }
+  return selected;
+}
+
+bool QuicCompressedCacheBackend::InitializeBackend(
+    const std::string& cache_directory) {
+  return cache_->InitializeBackend(cache_directory);
+}
+
+bool QuicCompressedCacheBackend::IsBackendInitialized() const {
+  return cache_->IsBackendInitialized();
+}
+
+void QuicCompressedCacheBackend::FetchResponseFromBackend(
+    const spdy::SpdyHeaderBlock& request_headers,
+    const std::string& request_body,
+    quic::QuicSimpleServerBackend::RequestHandler* request_handler) {
+  auto authority = request_headers.find(":authority");
+  auto path = request_headers.find(":path");
+  const quic::QuicBackendResponse* response = nullptr;
+  if (authority != request_headers.end() && path != request_headers.end())
+    response = cache_->GetResponse(authority->second, path->second);
+  if (!response) {
+    cache_->FetchResponseFromBackend(request_headers, request_body,
+                                     request_handler);
+    return;
+  }
+
+  const Variants* variants = GetVariants(*response);
+  if (!variants || !variants->available) {
+    cache_->FetchResponseFromBackend(request_headers, request_body,
+                                     request_handler);
+    return;
+  }
+
+  auto accept_encoding = request_headers.find(kAcceptEncoding);
+  Encoding encoding = SelectEncoding(
+      accept_encoding == request_headers.end() ? quiche::QuicheStringPiece()
+                                               : accept_encoding->second,
+      variants->available);
+  const quic::QuicBackendResponse* selected =
+      variants->responses[encoding].get();
+  stats_.bytes_served += selected->body().size();
+  stats_.uncompressed_bytes_served += response->body().size();
+
+  std::list<quic::QuicBackendResponse::ServerPushInfo> resources =
+      cache_->GetServerPushResources(std::string(authority->second) +
+                                     std::string(path->second));
+  request_handler->OnResponseBackendComplete(selected, resources);
+}
+
+void QuicCompressedCacheBackend::CloseBackendResponseStream(
+    quic::QuicSimpleServerBackend::RequestHandler* request_handler) {
+  cache_->CloseBackendResponseStream(request_handler);
+}
+
+const QuicCompressedCacheBackend::Variants*
+QuicCompressedCacheBackend::GetVariants(
+    const quic::QuicBackendResponse& response) {
+  auto it = variants_.find(&response);
+  if (it != variants_.end())
+    return it->second.get();
+
+  if (!IsCompressible(response)) {
+    it = variants_.emplace(&response, std::make_unique<Variants>()).first;
+    return it->second.get();
+  }
+
+  variants_.emplace(&response, nullptr);
+  base::ThreadPool::PostTaskAndReplyWithResult(
+      FROM_HERE,
+      {base::TaskPriority::USER_VISIBLE,
+       base::TaskShutdownBehavior::SKIP_ON_SHUTDOWN},
+      base::BindOnce(&QuicCompressedCacheBackend::CompressBody,
+                     std::string(response.body())),
+      base::BindOnce(&QuicCompressedCacheBackend::OnBodyCompressed,
+                     weak_factory_.GetWeakPtr(), &response));
+  return nullptr;
+}
+
+void QuicCompressedCacheBackend::OnBodyCompressed(
+    const quic::QuicBackendResponse* response,
+    std::unique_ptr<CompressedBodies> compressed) {
+  auto variants = std::make_unique<Variants>();
+  for (Encoding encoding : {BROTLI, GZIP}) {
+    const std::string& body = compressed->bodies[encoding];
+    if (body.empty())
+      continue;
+    variants->responses[encoding] = CreateVariant(*response, encoding, body);
+    variants->available |= 1 << encoding;
+    stats_.variant_body_bytes += body.size();
+  }
+  if (variants->available) {
+    // The uncompressed response must also vary on accept-encoding.
+    const std::string body(response->body());
+    variants->responses[IDENTITY] = CreateVariant(*response, IDENTITY, body);
+    variants->available |= 1 << IDENTITY;
+    stats_.variant_body_bytes += body.size();
+    ++stats_.responses_with_variants;
+    stats_.original_body_bytes += body.size();
+  }
+  variants_[response] = std::move(variants);
+}
+
+void QuicCompressedCacheBackend::MaybeLogStats() {
+  if (stats_.variant_body_bytes == logged_stats_.variant_body_bytes &&
+      stats_.bytes_served == logged_stats_.bytes_served) {
+    return;
+  }
+  logged_stats_ = stats_;
+  LOG(INFO) << "Compressed response stats: " << StatsToValue();
+}
+
+// static
+std::unique_ptr<QuicCompressedCacheBackend::CompressedBodies>
+QuicCompressedCacheBackend::CompressBody(const std::string& body) {
+  auto compressed = std::make_unique<CompressedBodies>();
+  const size_t max_size = body.size() * kMaxCompressionRatio;
+  std::string* brotli = &compressed->bodies[BROTLI];
+  if (!BrotliCompress(body, brotli) || brotli->size() > max_size)
+    brotli->clear();
+  std::string* gzip = &compressed->bodies[GZIP];
+  if (!GzipCompress(body, gzip) || gzip->size() > max_size)
+    gzip->clear();
+  return compressed;
+}
+
+}  // namespace net
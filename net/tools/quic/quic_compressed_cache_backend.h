@@ -0,0 +1,135 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_COMPRESSED_CACHE_BACKEND_H_
+#define NET_TOOLS_QUIC_QUIC_COMPRESSED_CACHE_BACKEND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "base/macros.h"
+#include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "base/values.h"
+#include "net/third_party/quiche/src/quic/tools/quic_backend_response.h"
+#include "net/third_party/quiche/src/quic/tools/quic_memory_cache_backend.h"
+#include "net/third_party/quiche/src/quic/tools/quic_simple_server_backend.h"
+
+namespace net {
+
+// Bodies smaller than this are never compressed.
+const size_t kMinCompressibleBodySize = 1024;
+// A compressed variant is only kept if it is at most this fraction of the
+// original body.
+const double kMaxCompressionRatio = 0.9;
+
+// Serves a QuicMemoryCacheBackend with gzip and brotli variants of its
+// compressible responses, chosen by the request's accept-encoding header.
+// Variants are built once per response, on a worker thread, after the first
+// request for it; that request and any others until the variants are ready
+// get the cached response unchanged. Variants are kept for the lifetime of
+// the backend. Every response that has variants, including the uncompressed
+// one, carries "vary: accept-encoding". The backend logs its stats every
+// kStatsLogInterval while they change, and when it is destroyed.
+class QuicCompressedCacheBackend : public quic::QuicSimpleServerBackend {
+ public:
+  enum Encoding {
+    IDENTITY = 0,
+    GZIP = 1,
+    BROTLI = 2,
+    NUM_ENCODINGS,
+  };
+
+  struct Stats {
+    // Responses with at least one compressed variant.
+    size_t responses_with_variants = 0;
+    // Bodies of those responses, and of their variants, including the
+    // uncompressed copy that adds the vary header.
+    uint64_t original_body_bytes = 0;
+    uint64_t variant_body_bytes = 0;
+    // Body bytes sent, and what they would have been without variants.
+    uint64_t bytes_served = 0;
+    uint64_t uncompressed_bytes_served = 0;
+  };
+
+  static const base::TimeDelta kStatsLogInterval;
+
+  explicit QuicCompressedCacheBackend(
+      std::unique_ptr<quic::QuicMemoryCacheBackend> cache);
+  ~QuicCompressedCacheBackend() override;
+
+  // Returns the most preferred encoding in |accept_encoding| among those of
+  // |available|, a bitmask of (1 << Encoding).
+  static Encoding SelectEncoding(quiche::QuicheStringPiece accept_encoding,
+                                 uint32_t available);
+
+  const Stats& stats() const { return stats_; }
+  // Returns the stats, plus the memory the variants use and the body bytes
+  // they saved.
+  base::Value StatsToValue() const;
+
+  // quic::QuicSimpleServerBackend implementation.
+  bool InitializeBackend(const std::string& cache_directory) override;
+  bool IsBackendInitialized() const override;
+  void FetchResponseFromBackend(
+      const spdy::SpdyHeaderBlock& request_headers,
+      const std::string& request_body,
+      quic::QuicSimpleServerBackend::RequestHandler* request_handler) override;
+  void CloseBackendResponseStream(
+      quic::QuicSimpleServerBackend::RequestHandler* request_handler) override;
+
+ private:
+  struct Variants {
+    Variants();
+    ~Variants();
+
+    // Bitmask of (1 << Encoding) for the variants below that are set. Empty
+    // if the response is not worth compressing, in which case the cached
+    // response is served unchanged.
+    uint32_t available = 0;
+    std::unique_ptr<quic::QuicBackendResponse> responses[NUM_ENCODINGS];
+  };
+
+  // Compressed copies of a body, empty where compression did not pay off.
+  struct CompressedBodies {
+    std::string bodies[NUM_ENCODINGS];
+  };
+
+  // Returns the variants of |response|, or null if they are not built yet,
+  // in which case building them is started.
+  const Variants* GetVariants(const quic::QuicBackendResponse& response);
+  void OnBodyCompressed(const quic::QuicBackendResponse* response,
+                        std::unique_ptr<CompressedBodies> compressed);
+
+  // Compresses |body| with each encoding at maximum quality, which takes too
+  // long to do on the network thread.
+  static std::unique_ptr<CompressedBodies> CompressBody(
+      const std::string& body);
+
+  // Logs the stats if they changed since they were last logged.
+  void MaybeLogStats();
+
+  std::unique_ptr<quic::QuicMemoryCacheBackend> cache_;
+  // Keyed by the cached response, which the cache owns for its lifetime. A
+  // null entry means that the body is being compressed.
+  std::map<const quic::QuicBackendResponse*, std::unique_ptr<Variants>>
+      variants_;
+  Stats stats_;
+  // The stats when they were last logged.
+  Stats logged_stats_;
+  base::RepeatingTimer stats_timer_;
+
+  base::WeakPtrFactory<QuicCompressedCacheBackend> weak_factory_{this};
+
+  DISALLOW_COPY_AND_ASSIGN(QuicCompressedCacheBackend);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_COMPRESSED_CACHE_BACKEND_H_
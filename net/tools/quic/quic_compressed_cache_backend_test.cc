@@ -0,0 +1,213 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_compressed_cache_backend.h"
+
+#include <list>
+#include <memory>
+#include <utility>
+
+#include "base/strings/string_number_conversions.h"
+#include "net/test/test_with_task_environment.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_test_utils.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/brotli/include/brotli/decode.h"
+
+namespace net {
+namespace test {
+namespace {
+
+const char kHost[] = "www.example.org";
+
+class TestRequestHandler
+    : public quic::QuicSimpleServerBackend::RequestHandler {
+ public:
+  quic::QuicConnectionId connection_id() const override {
+    return quic::test::TestConnectionId(123);
+  }
+  quic::QuicStreamId stream_id() const override { return 5; }
+  std::string peer_host() const override { return "127.0.0.1"; }
+
+  void OnResponseBackendComplete(
+      const quic::QuicBackendResponse* response,
+      std::list<quic::QuicBackendResponse::ServerPushInfo> resources) override {
+    response_ = response;
+  }
+
+  const quic::QuicBackendResponse* response() const { return response_; }
+
+ private:
+  const quic::QuicBackendResponse* response_ = nullptr;
+};
+
+std::string Header(const quic::QuicBackendResponse* response,
+                   const std::string& name) {
+  auto it = response->headers().find(name);
+  return it == response->headers().end() ? "" : std::string(it->second);
+}
+
+class QuicCompressedCacheBackendTest : public TestWithTaskEnvironment {
+ protected:
+  QuicCompressedCacheBackendTest() {
+    auto cache = std::make_unique<quic::QuicMemoryCacheBackend>();
+    cache_ = cache.get();
+    AddResponse("/index.html", "text/html", std::string(4096, 'a'));
+    AddResponse("/small.js", "application/javascript", std::string(100, 'a'));
+    AddResponse("/image.png", "image/png", std::string(4096, 'a'));
+    backend_ = std::make_unique<QuicCompressedCacheBackend>(std::move(cache));
+  }
+
+  void AddResponse(const std::string& path,
+                   const std::string& content_type,
+                   const std::string& body) {
+    spdy::SpdyHeaderBlock headers;
+    headers[":status"] = "200";
+    headers["content-type"] = content_type;
+    headers["content-length"] = base::NumberToString(body.size());
+    cache_->AddResponse(kHost, path, std::move(headers), body);
+  }
+
+  const quic::QuicBackendResponse* Fetch(const std::string& path,
+                                         const std::string& accept_encoding) {
+    spdy::SpdyHeaderBlock headers;
+    headers[":method"] = "GET";
+    headers[":authority"] = kHost;
+    headers[":path"] = path;
+    if (!accept_encoding.empty())
+      headers["accept-encoding"] = accept_encoding;
+    TestRequestHandler handler;
+    backend_->FetchResponseFromBackend(headers, "", &handler);
+    return handler.response();
+  }
+
+  // Requests |path| once and waits for its variants to be built.
+  void Warm(const std::string& path) {
+    Fetch(path, "");
+    RunUntilIdle();
+  }
+
+  quic::QuicMemoryCacheBackend* cache_;
+  std::unique_ptr<QuicCompressedCacheBackend> backend_;
+};
+
+TEST_F(QuicCompressedCacheBackendTest, SelectEncoding) {
+  const uint32_t kAll = (1 << QuicCompressedCacheBackend::IDENTITY) |
+                        (1 << QuicCompressedCacheBackend::GZIP) |
+                        (1 << QuicCompressedCacheBackend::BROTLI);
+  const uint32_t kGzip = (1 << QuicCompressedCacheBackend::IDENTITY) |
+                         (1 << QuicCompressedCacheBackend::GZIP);
+  EXPECT_EQ(QuicCompressedCacheBackend::BROTLI,
+            QuicCompressedCacheBackend::SelectEncoding("gzip, deflate, br",
+                                                       kAll));
+  EXPECT_EQ(QuicCompressedCacheBackend::GZIP,
+            QuicCompressedCacheBackend::SelectEncoding("gzip, deflate, br",
+                                                       kGzip));
+  EXPECT_EQ(QuicCompressedCacheBackend::GZIP,
+            QuicCompressedCacheBackend::SelectEncoding("br;q=0.5, GZIP",
+                                                       kAll));
+  EXPECT_EQ(QuicCompressedCacheBackend::IDENTITY,
+            QuicCompressedCacheBackend::SelectEncoding("br;q=0", kAll));
+  EXPECT_EQ(QuicCompressedCacheBackend::BROTLI,
+            QuicCompressedCacheBackend::SelectEncoding("*", kAll));
+  EXPECT_EQ(QuicCompressedCacheBackend::IDENTITY,
+            QuicCompressedCacheBackend::SelectEncoding("", kAll));
+  EXPECT_EQ(QuicCompressedCacheBackend::IDENTITY,
+            QuicCompressedCacheBackend::SelectEncoding("deflate", kAll));
+}
+
+TEST_F(QuicCompressedCacheBackendTest, ServesOriginalUntilCompressed) {
+  EXPECT_EQ(cache_->GetResponse(kHost, "/index.html"),
+            Fetch("/index.html", "br"));
+  EXPECT_EQ(cache_->GetResponse(kHost, "/index.html"),
+            Fetch("/index.html", "br"));
+  EXPECT_EQ(0u, backend_->stats().responses_with_variants);
+
+  RunUntilIdle();
+  const quic::QuicBackendResponse* response = Fetch("/index.html", "br");
+  ASSERT_TRUE(response);
+  EXPECT_EQ("br", Header(response, "content-encoding"));
+  EXPECT_EQ(1u, backend_->stats().responses_with_variants);
+}
+
+TEST_F(QuicCompressedCacheBackendTest, ServesBrotli) {
+  Warm("/index.html");
+  const quic::QuicBackendResponse* response =
+      Fetch("/index.html", "gzip, deflate, br");
+  ASSERT_TRUE(response);
+  EXPECT_EQ("br", Header(response, "content-encoding"));
+  EXPECT_EQ("accept-encoding", Header(response, "vary"));
+  EXPECT_EQ(base::NumberToString(response->body().size()),
+            Header(response, "content-length"));
+
+  std::string decoded(4096, '\0');
+  size_t decoded_size = decoded.size();
+  ASSERT_EQ(BROTLI_DECODER_RESULT_SUCCESS,
+            BrotliDecoderDecompress(
+                response->body().size(),
+                reinterpret_cast<const uint8_t*>(response->body().data()),
+                &decoded_size, reinterpret_cast<uint8_t*>(&decoded[0])));
+  EXPECT_EQ(std::string(4096, 'a'), decoded.substr(0, decoded_size));
+}
+
+TEST_F(QuicCompressedCacheBackendTest, ServesGzip) {
+  Warm("/index.html");
+  const quic::QuicBackendResponse* response = Fetch("/index.html", "gzip");
+  ASSERT_TRUE(response);
+  EXPECT_EQ("gzip", Header(response, "content-encoding"));
+  ASSERT_GE(response->body().size(), 2u);
+  // gzip magic number.
+  EXPECT_EQ('\x1f', response->body()[0]);
+  EXPECT_EQ('\x8b', response->body()[1]);
+}
+
+TEST_F(QuicCompressedCacheBackendTest, IdentityVaries) {
+  Warm("/index.html");
+  const quic::QuicBackendResponse* response = Fetch("/index.html", "");
+  ASSERT_TRUE(response);
+  EXPECT_EQ("", Header(response, "content-encoding"));
+  EXPECT_EQ("accept-encoding", Header(response, "vary"));
+  EXPECT_EQ(4096u, response->body().size());
+}
+
+TEST_F(QuicCompressedCacheBackendTest, SkipsSmallAndIncompressible) {
+  Warm("/small.js");
+  Warm("/image.png");
+  EXPECT_EQ(cache_->GetResponse(kHost, "/small.js"),
+            Fetch("/small.js", "br"));
+  EXPECT_EQ(cache_->GetResponse(kHost, "/image.png"),
+            Fetch("/image.png", "br"));
+  EXPECT_EQ(0u, backend_->stats().responses_with_variants);
+}
+
+TEST_F(QuicCompressedCacheBackendTest, Stats) {
+  Warm("/index.html");
+  Fetch("/index.html", "br");
+  Fetch("/index.html", "");
+  const QuicCompressedCacheBackend::Stats& stats = backend_->stats();
+  EXPECT_EQ(1u, stats.responses_with_variants);
+  EXPECT_EQ(4096u, stats.original_body_bytes);
+  EXPECT_GT(stats.variant_body_bytes, 4096u);
+  EXPECT_EQ(2 * 4096u, stats.uncompressed_bytes_served);
+  EXPECT_LT(stats.bytes_served, 2 * 4096u);
+  EXPECT_GT(stats.bytes_served, 4096u);
+
+  base::Value value = backend_->StatsToValue();
+  EXPECT_EQ(1, value.FindIntKey("responses_with_variants"));
+  const std::string* memory_used = value.FindStringKey("memory_used_bytes");
+  ASSERT_TRUE(memory_used);
+  EXPECT_EQ(base::NumberToString(stats.variant_body_bytes), *memory_used);
+  const std::string* bytes_saved = value.FindStringKey("bytes_saved");
+  ASSERT_TRUE(bytes_saved);
+  EXPECT_EQ(
+      base::NumberToString(stats.uncompressed_bytes_served -
+                           stats.bytes_served),
+      *bytes_saved);
+  uint64_t saved;
+  ASSERT_TRUE(base::StringToUint64(*bytes_saved, &saved));
+  EXPECT_GT(saved, 0u);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -0,0 +1,123 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_digesting_server_session.h"
+
+#include <map>
+#include <string>
+
+#include "base/logging.h"
+#include "net/third_party/quiche/src/common/platform/api/quiche_string_piece.h"
+
+namespace net {
+
+namespace {
+
+const char kContentDigestHeader[] = "content-digest";
+
+}  // namespace
+
+QuicDigestingServerStream::QuicDigestingServerStream(
+    quic::QuicStreamId id,
+    quic::QuicSpdySession* session,
+    quic::QuicSimpleServerBackend* quic_simple_server_backend,
+    const QuicBodyDigesterFactory& body_digester_factory)
+    : quic::QuicSimpleServerStream(id,
+                                   session,
+                                   quic::BIDIRECTIONAL,
+                                   quic_simple_server_backend),
+      body_bytes_digested_(0) {
+  if (!body_digester_factory.is_null()) {
+    body_digests_ =
+        std::make_unique<QuicBodyDigestSet>(body_digester_factory.Run());
+  }
+}
+
+QuicDigestingServerStream::~QuicDigestingServerStream() = default;
+
+void QuicDigestingServerStream::OnBodyAvailable() {
+  // The base class appends what it reads to body(), and may send the
+  // response before returning.
+  quic::QuicSimpleServerStream::OnBodyAvailable();
+  DigestNewBodyBytes();
+}
+
+void QuicDigestingServerStream::SendResponse() {
+  // Only the server sets the digest header, whether or not it digests.
+  request_headers()->erase(kQuicBodyDigestHeader);
+  if (body_digests_ && !FinishBodyDigests())
+    return;
+  quic::QuicSimpleServerStream::SendResponse();
+}
+
+void QuicDigestingServerStream::DigestNewBodyBytes() {
+  if (!body_digests_ || body().size() <= body_bytes_digested_)
+    return;
+  body_digests_->Update(
+      quiche::QuicheStringPiece(body()).substr(body_bytes_digested_));
+  body_bytes_digested_ = body().size();
+}
+
+bool QuicDigestingServerStream::FinishBodyDigests() {
+  DigestNewBodyBytes();
+  std::map<std::string, std::string> digests = body_digests_->Finish();
+  body_digests_.reset();
+
+  auto it = request_headers()->find(kContentDigestHeader);
+  if (it != request_headers()->end()) {
+    std::map<std::string, std::string> client_digests;
+    if (!ParseQuicContentDigest(it->second, &client_digests)) {
+      DVLOG(1) << "Malformed " << kContentDigestHeader << " on stream "
+               << id();
+      SendErrorResponse(400);
+      return false;
+    }
+    for (const auto& algorithm_and_digest : client_digests) {
+      auto digest = digests.find(algorithm_and_digest.first);
+      if (digest != digests.end() &&
+          digest->second != algorithm_and_digest.second) {
+        DVLOG(1) << algorithm_and_digest.first
+                 << " digest mismatch on stream " << id();
+        SendErrorResponse(400);
+        return false;
+      }
+    }
+  }
+  (*request_headers())[kQuicBodyDigestHeader] =
+      FormatQuicContentDigest(digests);
+  return true;
+}
+
+QuicDigestingServerSession::QuicDigestingServerSession(
+    const quic::QuicConfig& config,
+    const quic::ParsedQuicVersionVector& supported_versions,
+    quic::QuicConnection* connection,
+    quic::QuicSession::Visitor* visitor,
+    quic::QuicCryptoServerStreamBase::Helper* helper,
+    const quic::QuicCryptoServerConfig* crypto_config,
+    quic::QuicCompressedCertsCache* compressed_certs_cache,
+    quic::QuicSimpleServerBackend* quic_simple_server_backend)
+    : quic::QuicSimpleServerSession(config,
+                                    supported_versions,
+                                    connection,
+                                    visitor,
+                                    helper,
+                                    crypto_config,
+                                    compressed_certs_cache,
+                                    quic_simple_server_backend) {}
+
+QuicDigestingServerSession::~QuicDigestingServerSession() = default;
+
+quic::QuicSpdyStream* QuicDigestingServerSession::CreateIncomingStream(
+    quic::QuicStreamId id) {
+  if (!ShouldCreateIncomingStream(id))
+    return nullptr;
+  auto stream = std::make_unique<QuicDigestingServerStream>(
+      id, this, server_backend(), body_digester_factory_);
+  QuicDigestingServerStream* stream_ptr = stream.get();
+  ActivateStream(std::move(stream));
+  return stream_ptr;
+}
+
+}  // namespace net
@@ -0,0 +1,93 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_DIGESTING_SERVER_SESSION_H_
+#define NET_TOOLS_QUIC_QUIC_DIGESTING_SERVER_SESSION_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <utility>
+
+#include "base/macros.h"
+#include "net/third_party/quiche/src/quic/tools/quic_simple_server_session.h"
+#include "net/third_party/quiche/src/quic/tools/quic_simple_server_stream.h"
+#include "net/tools/quic/quic_body_digester.h"
+
+namespace net {
+
+// A QuicSimpleServerStream that, if it has a body digester factory, digests
+// the request body as it arrives and passes the digests to the backend in the
+// kQuicBodyDigestHeader request header. Requests whose Content-Digest header
+// disagrees with a computed digest are answered with a 400. Whether or not it
+// digests, a kQuicBodyDigestHeader sent by the client never reaches the
+// backend.
+class QuicDigestingServerStream : public quic::QuicSimpleServerStream {
+ public:
+  // |body_digester_factory| may be null.
+  QuicDigestingServerStream(
+      quic::QuicStreamId id,
+      quic::QuicSpdySession* session,
+      quic::QuicSimpleServerBackend* quic_simple_server_backend,
+      const QuicBodyDigesterFactory& body_digester_factory);
+  ~QuicDigestingServerStream() override;
+
+  // quic::QuicSimpleServerStream methods:
+  void OnBodyAvailable() override;
+
+ protected:
+  // quic::QuicSimpleServerStream methods:
+  void SendResponse() override;
+
+ private:
+  void DigestNewBodyBytes();
+  // Adds the digests of the complete body to the request headers. Returns
+  // false, having sent an error response, if they disagree with those the
+  // client sent.
+  bool FinishBodyDigests();
+
+  // Digests of the request body, until the response is sent.
+  std::unique_ptr<QuicBodyDigestSet> body_digests_;
+  size_t body_bytes_digested_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicDigestingServerStream);
+};
+
+// A QuicSimpleServerSession whose request streams are
+// QuicDigestingServerStreams.
+class QuicDigestingServerSession : public quic::QuicSimpleServerSession {
+ public:
+  QuicDigestingServerSession(
+      const quic::QuicConfig& config,
+      const quic::ParsedQuicVersionVector& supported_versions,
+      quic::QuicConnection* connection,
+      quic::QuicSession::Visitor* visitor,
+      quic::QuicCryptoServerStreamBase::Helper* helper,
+      const quic::QuicCryptoServerConfig* crypto_config,
+      quic::QuicCompressedCertsCache* compressed_certs_cache,
+      quic::QuicSimpleServerBackend* quic_simple_server_backend);
+  ~QuicDigestingServerSession() override;
+
+  // Sets the factory of the digesters of each request body. Without one,
+  // bodies are not digested. Must be called before streams are created.
+  void set_body_digester_factory(QuicBodyDigesterFactory factory) {
+    body_digester_factory_ = std::move(factory);
+  }
+  const QuicBodyDigesterFactory& body_digester_factory() const {
+    return body_digester_factory_;
+  }
+
+ protected:
+  // quic::QuicSimpleServerSession methods:
+  quic::QuicSpdyStream* CreateIncomingStream(quic::QuicStreamId id) override;
+
+ private:
+  QuicBodyDigesterFactory body_digester_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicDigestingServerSession);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_DIGESTING_SERVER_SESSION_H_
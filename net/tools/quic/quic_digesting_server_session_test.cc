@@ -0,0 +1,243 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_digesting_server_session.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "net/third_party/quiche/src/common/platform/api/quiche_string_piece.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_crypto_server_config.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/core/http/http_encoder.h"
+#include "net/third_party/quiche/src/quic/core/http/quic_header_list.h"
+#include "net/third_party/quiche/src/quic/core/quic_versions.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_test.h"
+#include "net/third_party/quiche/src/quic/test_tools/crypto_test_utils.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_config_peer.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_session_peer.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_test_utils.h"
+#include "net/third_party/quiche/src/quic/tools/quic_memory_cache_backend.h"
+#include "net/third_party/quiche/src/spdy/core/spdy_header_block.h"
+#include "net/tools/quic/quic_body_digester.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using testing::_;
+using testing::Invoke;
+
+namespace net {
+namespace test {
+namespace {
+
+const char kHost[] = "www.example.org";
+const char kPath[] = "/upload";
+
+// Records the requests passed to the backend.
+class TestBackend : public quic::QuicMemoryCacheBackend {
+ public:
+  TestBackend() = default;
+
+  void FetchResponseFromBackend(
+      const spdy::SpdyHeaderBlock& request_headers,
+      const std::string& request_body,
+      quic::QuicSimpleServerBackend::RequestDelegate* delegate) override {
+    ++num_requests_;
+    last_request_headers_ = request_headers.Clone();
+    last_request_body_ = request_body;
+    quic::QuicMemoryCacheBackend::FetchResponseFromBackend(
+        request_headers, request_body, delegate);
+  }
+
+  int num_requests() const { return num_requests_; }
+  const spdy::SpdyHeaderBlock& last_request_headers() const {
+    return last_request_headers_;
+  }
+  const std::string& last_request_body() const { return last_request_body_; }
+
+ private:
+  int num_requests_ = 0;
+  spdy::SpdyHeaderBlock last_request_headers_;
+  std::string last_request_body_;
+
+  DISALLOW_COPY_AND_ASSIGN(TestBackend);
+};
+
+// Writes go to a mock instead of the connection.
+class TestDigestingServerSession : public QuicDigestingServerSession {
+ public:
+  using QuicDigestingServerSession::QuicDigestingServerSession;
+
+  MOCK_METHOD6(WritevData,
+               quic::QuicConsumedData(
+                   quic::QuicStreamId id,
+                   size_t write_length,
+                   quic::QuicStreamOffset offset,
+                   quic::StreamSendingState state,
+                   quic::TransmissionType type,
+                   quiche::QuicheOptional<quic::EncryptionLevel> level));
+};
+
+class QuicDigestingServerSessionTest
+    : public QuicTestWithParam<quic::ParsedQuicVersion> {
+ protected:
+  QuicDigestingServerSessionTest()
+      : crypto_config_(quic::QuicCryptoServerConfig::TESTING,
+                       quic::QuicRandom::GetInstance(),
+                       quic::test::crypto_test_utils::ProofSourceForTesting(),
+                       quic::KeyExchangeSource::Default()),
+        compressed_certs_cache_(
+            quic::QuicCompressedCertsCache::kQuicCompressedCertsCacheSize) {
+    quic::test::QuicConfigPeer::SetReceivedMaxBidirectionalStreams(&config_,
+                                                                   10);
+    quic::test::QuicConfigPeer::SetReceivedMaxUnidirectionalStreams(&config_,
+                                                                    10);
+    backend_.AddSimpleResponse(kHost, kPath, 200, "ok");
+
+    // Owned by |session_|.
+    connection_ = new testing::NiceMock<quic::test::MockQuicConnection>(
+        &helper_, &alarm_factory_, quic::Perspective::IS_SERVER,
+        quic::test::SupportedVersions(GetParam()));
+    ON_CALL(*connection_, SendControlFrame(_))
+        .WillByDefault(Invoke(&quic::test::ClearControlFrame));
+    session_ = std::make_unique<testing::NiceMock<TestDigestingServerSession>>(
+        config_, quic::test::SupportedVersions(GetParam()), connection_,
+        &owner_, &stream_helper_, &crypto_config_, &compressed_certs_cache_,
+        &backend_);
+    ON_CALL(*session_, WritevData(_, _, _, _, _, _))
+        .WillByDefault(
+            Invoke(this, &QuicDigestingServerSessionTest::ConsumeData));
+    session_->Initialize();
+    session_->OnConfigNegotiated();
+  }
+
+  // Sends a POST request for kPath on the first client-initiated stream,
+  // with |extra_headers|, and a body made of |chunks|, each in its own frame.
+  quic::QuicStreamId SendPostRequest(const spdy::SpdyHeaderBlock& extra_headers,
+                                     const std::vector<std::string>& chunks) {
+    quic::QuicStreamId id =
+        quic::test::GetNthClientInitiatedBidirectionalStreamId(
+            GetParam().transport_version, 0);
+    auto* stream = static_cast<quic::QuicSpdyStream*>(
+        quic::test::QuicSessionPeer::GetOrCreateStream(session_.get(), id));
+    spdy::SpdyHeaderBlock headers;
+    headers[":method"] = "POST";
+    headers[":scheme"] = "https";
+    headers[":authority"] = kHost;
+    headers[":path"] = kPath;
+    for (const auto& header : extra_headers)
+      headers[header.first] = header.second;
+    quic::QuicHeaderList header_list = quic::test::AsHeaderList(headers);
+    stream->OnStreamHeaderList(/*fin=*/false,
+                               header_list.uncompressed_header_bytes(),
+                               header_list);
+    quic::QuicStreamOffset offset = 0;
+    for (const std::string& chunk : chunks) {
+      std::string data = chunk;
+      if (quic::VersionUsesHttp3(GetParam().transport_version)) {
+        std::unique_ptr<char[]> buffer;
+        quic::QuicByteCount header_length =
+            quic::HttpEncoder::SerializeDataFrameHeader(chunk.size(), &buffer);
+        data = std::string(buffer.get(), header_length) + chunk;
+      }
+      stream->OnStreamFrame(
+          quic::QuicStreamFrame(id, /*fin=*/false, offset, data));
+      offset += data.size();
+    }
+    stream->OnStreamFrame(quic::QuicStreamFrame(id, /*fin=*/true, offset,
+                                                quiche::QuicheStringPiece()));
+    return id;
+  }
+
+  // Digests the request bodies with SHA-256 and CRC32C.
+  void EnableBodyDigests() {
+    session_->set_body_digester_factory(
+        CreateQuicBodyDigesterFactory({"sha-256", "crc32c"}));
+  }
+
+  // Returns the value of kQuicBodyDigestHeader for |body|.
+  static std::string BodyDigests(const std::string& body) {
+    QuicBodyDigestSet digests(
+        CreateQuicBodyDigesterFactory({"sha-256", "crc32c"}).Run());
+    digests.Update(body);
+    return FormatQuicContentDigest(digests.Finish());
+  }
+
+  bool HasFinished(quic::QuicStreamId id) const {
+    return finished_streams_.count(id) > 0;
+  }
+
+  quic::QuicConfig config_;
+  quic::QuicCryptoServerConfig crypto_config_;
+  quic::QuicCompressedCertsCache compressed_certs_cache_;
+  quic::test::MockQuicConnectionHelper helper_;
+  quic::test::MockAlarmFactory alarm_factory_;
+  testing::NiceMock<quic::test::MockQuicSessionVisitor> owner_;
+  testing::NiceMock<quic::test::MockQuicCryptoServerStreamHelper>
+      stream_helper_;
+  TestBackend backend_;
+  testing::NiceMock<quic::test::MockQuicConnection>* connection_;
+  std::unique_ptr<testing::NiceMock<TestDigestingServerSession>> session_;
+
+ private:
+  // Consumes every write, and records which streams wrote their fin.
+  quic::QuicConsumedData ConsumeData(
+      quic::QuicStreamId id,
+      size_t write_length,
+      quic::QuicStreamOffset offset,
+      quic::StreamSendingState state,
+      quic::TransmissionType type,
+      quiche::QuicheOptional<quic::EncryptionLevel> level) {
+    bool fin = state != quic::NO_FIN;
+    if (fin)
+      finished_streams_.insert(id);
+    return quic::QuicConsumedData(write_length, fin);
+  }
+
+  std::set<quic::QuicStreamId> finished_streams_;
+};
+
+INSTANTIATE_TEST_SUITE_P(Version,
+                         QuicDigestingServerSessionTest,
+                         ::testing::ValuesIn(quic::AllSupportedVersions()),
+                         ::testing::PrintToStringParamName());
+
+TEST_P(QuicDigestingServerSessionTest, BodyDigestsPassedToBackend) {
+  EnableBodyDigests();
+  spdy::SpdyHeaderBlock headers;
+  headers[kQuicBodyDigestHeader] = "sha-256=:AAAA:";
+  quic::QuicStreamId id =
+      SendPostRequest(headers, {"first chunk, ", "second chunk, ", "last"});
+  EXPECT_TRUE(HasFinished(id));
+  ASSERT_EQ(1, backend_.num_requests());
+  EXPECT_EQ("first chunk, second chunk, last", backend_.last_request_body());
+  auto it = backend_.last_request_headers().find(kQuicBodyDigestHeader);
+  ASSERT_TRUE(it != backend_.last_request_headers().end());
+  EXPECT_EQ(BodyDigests("first chunk, second chunk, last"), it->second);
+}
+
+TEST_P(QuicDigestingServerSessionTest, ContentDigestMismatchIsRejected) {
+  EnableBodyDigests();
+  spdy::SpdyHeaderBlock headers;
+  headers["content-digest"] = BodyDigests("other body");
+  quic::QuicStreamId id = SendPostRequest(headers, {"bo", "dy"});
+  EXPECT_TRUE(HasFinished(id));
+  EXPECT_EQ(0, backend_.num_requests());
+}
+
+TEST_P(QuicDigestingServerSessionTest, ClientBodyDigestHeaderIsStripped) {
+  spdy::SpdyHeaderBlock headers;
+  headers[kQuicBodyDigestHeader] = BodyDigests("body");
+  quic::QuicStreamId id = SendPostRequest(headers, {"body"});
+  EXPECT_TRUE(HasFinished(id));
+  ASSERT_EQ(1, backend_.num_requests());
+  EXPECT_FALSE(backend_.last_request_headers().contains(kQuicBodyDigestHeader));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -0,0 +1,193 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_http3_priority_scheduler.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+
+namespace net {
+
+QuicHttp3Priority ParseQuicHttp3Priority(base::StringPiece value) {
+  QuicHttp3Priority priority;
+  for (base::StringPiece member :
+       base::SplitStringPiece(value, ",", base::TRIM_WHITESPACE,
+                              base::SPLIT_WANT_NONEMPTY)) {
+    // Parameters of dictionary members carry no meaning here.
+    member = member.substr(0, member.find(';'));
+    base::StringPiece key = member;
+    base::StringPiece item;
+    size_t equals = member.find('=');
+    if (equals != base::StringPiece::npos) {
+      key = member.substr(0, equals);
+      item = member.substr(equals + 1);
+    }
+    key = base::TrimWhitespaceASCII(key, base::TRIM_ALL);
+    item = base::TrimWhitespaceASCII(item, base::TRIM_ALL);
+
+    if (key == "u") {
+      int urgency;
+      if (base::StringToInt(item, &urgency) && urgency >= 0 &&
+          urgency <= kQuicHttp3MaxUrgency) {
+        priority.urgency = urgency;
+      }
+    } else if (key == "i") {
+      // A bare key is the boolean true.
+      if (equals == base::StringPiece::npos || item == "?1") {
+        priority.incremental = true;
+      } else if (item == "?0") {
+        priority.incremental = false;
+      }
+    }
+  }
+  return priority;
+}
+
+QuicHttp3PriorityScheduler::Level::Level() = default;
+
+QuicHttp3PriorityScheduler::Level::~Level() = default;
+
+QuicHttp3PriorityScheduler::QuicHttp3PriorityScheduler()
+    : num_ready_streams_(0), num_writing_streams_(0) {}
+
+QuicHttp3PriorityScheduler::~QuicHttp3PriorityScheduler() = default;
+
+void QuicHttp3PriorityScheduler::RegisterStream(
+    quic::QuicStreamId id,
+    const QuicHttp3Priority& priority) {
+  DCHECK(!IsRegistered(id));
+  DCHECK_LE(priority.urgency, kQuicHttp3MaxUrgency);
+  streams_[id].priority = priority;
+}
+
+void QuicHttp3PriorityScheduler::UnregisterStream(quic::QuicStreamId id) {
+  auto it = streams_.find(id);
+  if (it == streams_.end())
+    return;
+  Detach(id, &it->second);
+  streams_.erase(it);
+}
+
+bool QuicHttp3PriorityScheduler::IsRegistered(quic::QuicStreamId id) const {
+  return streams_.find(id) != streams_.end();
+}
+
+void QuicHttp3PriorityScheduler::UpdateStreamPriority(
+    quic::QuicStreamId id,
+    const QuicHttp3Priority& priority) {
+  DCHECK_LE(priority.urgency, kQuicHttp3MaxUrgency);
+  auto it = streams_.find(id);
+  DCHECK(it != streams_.end());
+  StreamState* stream = &it->second;
+  if (stream->priority == priority)
+    return;
+  State state = stream->state;
+  Detach(id, stream);
+  stream->priority = priority;
+  Attach(id, stream, state);
+}
+
+QuicHttp3Priority QuicHttp3PriorityScheduler::GetStreamPriority(
+    quic::QuicStreamId id) const {
+  auto it = streams_.find(id);
+  DCHECK(it != streams_.end());
+  return it->second.priority;
+}
+
+void QuicHttp3PriorityScheduler::MarkStreamReady(quic::QuicStreamId id) {
+  auto it = streams_.find(id);
+  DCHECK(it != streams_.end());
+  if (it->second.state != IDLE)
+    return;
+  Attach(id, &it->second, READY);
+}
+
+bool QuicHttp3PriorityScheduler::PopNextStartableStream(
+    quic::QuicStreamId* id) {
+  if (num_ready_streams_ == 0)
+    return false;
+  for (Level& level : levels_) {
+    if (level.num_writing_non_incremental > 0)
+      continue;
+    if (!level.ready_non_incremental.empty()) {
+      if (level.num_writing > 0)
+        continue;
+      *id = *level.ready_non_incremental.begin();
+    } else if (!level.ready_incremental.empty()) {
+      *id = level.ready_incremental.front();
+    } else {
+      continue;
+    }
+    StreamState* stream = &streams_[*id];
+    Detach(*id, stream);
+    Attach(*id, stream, WRITING);
+    return true;
+  }
+  return false;
+}
+
+void QuicHttp3PriorityScheduler::OnStreamDone(quic::QuicStreamId id) {
+  auto it = streams_.find(id);
+  DCHECK(it != streams_.end());
+  if (it->second.state == WRITING)
+    Detach(id, &it->second);
+}
+
+void QuicHttp3PriorityScheduler::Detach(quic::QuicStreamId id,
+                                        StreamState* stream) {
+  Level& level = levels_[stream->priority.urgency];
+  switch (stream->state) {
+    case IDLE:
+      break;
+    case READY:
+      if (stream->priority.incremental) {
+        level.ready_incremental.erase(
+            std::find(level.ready_incremental.begin(),
+                      level.ready_incremental.end(), id));
+      } else {
+        level.ready_non_incremental.erase(id);
+      }
+      --num_ready_streams_;
+      break;
+    case WRITING:
+      --level.num_writing;
+      if (!stream->priority.incremental)
+        --level.num_writing_non_incremental;
+      --num_writing_streams_;
+      break;
+  }
+  stream->state = IDLE;
+}
+
+void QuicHttp3PriorityScheduler::Attach(quic::QuicStreamId id,
+                                        StreamState* stream,
+                                        State state) {
+  DCHECK_EQ(IDLE, stream->state);
+  Level& level = levels_[stream->priority.urgency];
+  switch (state) {
+    case IDLE:
+      break;
+    case READY:
+      if (stream->priority.incremental) {
+        level.ready_incremental.push_back(id);
+      } else {
+        level.ready_non_incremental.insert(id);
+      }
+      ++num_ready_streams_;
+      break;
+    case WRITING:
+      ++level.num_writing;
+      if (!stream->priority.incremental)
+        ++level.num_writing_non_incremental;
+      ++num_writing_streams_;
+      break;
+  }
+  stream->state = state;
+}
+
+}  // namespace net
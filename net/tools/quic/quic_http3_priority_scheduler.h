@@ -0,0 +1,116 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_HTTP3_PRIORITY_SCHEDULER_H_
+#define NET_TOOLS_QUIC_QUIC_HTTP3_PRIORITY_SCHEDULER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <set>
+
+#include "base/containers/circular_deque.h"
+#include "base/macros.h"
+#include "base/strings/string_piece.h"
+#include "net/third_party/quiche/src/quic/core/quic_types.h"
+
+namespace net {
+
+// Range and default of RFC 9218 urgencies.
+const uint8_t kQuicHttp3MaxUrgency = 7;
+const uint8_t kQuicHttp3DefaultUrgency = 3;
+
+// Extensible priority of an HTTP response (RFC 9218). Lower urgencies are
+// more important. Incremental responses are useful to the client as they
+// arrive and can share bandwidth; non-incremental ones are only useful once
+// complete and are best sent one at a time.
+struct QuicHttp3Priority {
+  uint8_t urgency = kQuicHttp3DefaultUrgency;
+  bool incremental = false;
+
+  bool operator==(const QuicHttp3Priority& other) const {
+    return urgency == other.urgency && incremental == other.incremental;
+  }
+};
+
+// Parses the value of a priority header or PRIORITY_UPDATE frame, e.g.
+// "u=1, i". Unknown or malformed parameters are ignored and leave the
+// corresponding default in place, as RFC 9218 section 4 requires.
+QuicHttp3Priority ParseQuicHttp3Priority(base::StringPiece value);
+
+// Decides in which order a server starts writing responses that are ready to
+// send. Responses already being written are arbitrated by urgency in the
+// session's write blocked list; this class adds what that list cannot
+// express: a non-incremental response does not start while another response
+// of the same urgency is being written, and a ready non-incremental response
+// holds back the incremental ones queued behind it, so that non-incremental
+// responses complete one after the other in stream ID order.
+class QuicHttp3PriorityScheduler {
+ public:
+  QuicHttp3PriorityScheduler();
+  ~QuicHttp3PriorityScheduler();
+
+  // Streams must be registered before any other call refers to them.
+  void RegisterStream(quic::QuicStreamId id,
+                      const QuicHttp3Priority& priority);
+  void UnregisterStream(quic::QuicStreamId id);
+  bool IsRegistered(quic::QuicStreamId id) const;
+
+  void UpdateStreamPriority(quic::QuicStreamId id,
+                            const QuicHttp3Priority& priority);
+  QuicHttp3Priority GetStreamPriority(quic::QuicStreamId id) const;
+
+  // Called when the response of |id| is ready to be written.
+  void MarkStreamReady(quic::QuicStreamId id);
+
+  // Returns the next ready stream that may start writing and marks it as
+  // writing, or returns false if no ready stream may start now.
+  bool PopNextStartableStream(quic::QuicStreamId* id);
+
+  // Called when |id| has written all of its response.
+  void OnStreamDone(quic::QuicStreamId id);
+
+  size_t num_ready_streams() const { return num_ready_streams_; }
+  size_t num_writing_streams() const { return num_writing_streams_; }
+
+ private:
+  enum State {
+    IDLE,
+    READY,
+    WRITING,
+  };
+
+  struct StreamState {
+    QuicHttp3Priority priority;
+    State state = IDLE;
+  };
+
+  struct Level {
+    Level();
+    ~Level();
+
+    std::set<quic::QuicStreamId> ready_non_incremental;
+    base::circular_deque<quic::QuicStreamId> ready_incremental;
+    size_t num_writing = 0;
+    size_t num_writing_non_incremental = 0;
+  };
+
+  // Removes |stream| from the bookkeeping of its urgency level and returns it
+  // to IDLE.
+  void Detach(quic::QuicStreamId id, StreamState* stream);
+  // Adds an IDLE |stream| in |state| to the bookkeeping of its urgency level.
+  void Attach(quic::QuicStreamId id, StreamState* stream, State state);
+
+  std::map<quic::QuicStreamId, StreamState> streams_;
+  Level levels_[kQuicHttp3MaxUrgency + 1];
+  size_t num_ready_streams_;
+  size_t num_writing_streams_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicHttp3PriorityScheduler);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_HTTP3_PRIORITY_SCHEDULER_H_
@@ -0,0 +1,123 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_http3_priority_scheduler.h"
+
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+QuicHttp3Priority Priority(uint8_t urgency, bool incremental) {
+  QuicHttp3Priority priority;
+  priority.urgency = urgency;
+  priority.incremental = incremental;
+  return priority;
+}
+
+TEST(QuicHttp3PriorityTest, Parse) {
+  EXPECT_EQ(Priority(3, false), ParseQuicHttp3Priority(""));
+  EXPECT_EQ(Priority(0, false), ParseQuicHttp3Priority("u=0"));
+  EXPECT_EQ(Priority(5, true), ParseQuicHttp3Priority("u=5, i"));
+  EXPECT_EQ(Priority(3, true), ParseQuicHttp3Priority("i=?1"));
+  EXPECT_EQ(Priority(1, false), ParseQuicHttp3Priority("i=?0,u=1"));
+  EXPECT_EQ(Priority(2, true), ParseQuicHttp3Priority("u=2;foo=bar, i;x"));
+  // Out of range, malformed and unknown parameters are ignored.
+  EXPECT_EQ(Priority(3, false), ParseQuicHttp3Priority("u=8"));
+  EXPECT_EQ(Priority(3, false), ParseQuicHttp3Priority("u=-1, i=1"));
+  EXPECT_EQ(Priority(4, false), ParseQuicHttp3Priority("u=abc, u=4, x=?1"));
+}
+
+class QuicHttp3PrioritySchedulerTest : public ::testing::Test {
+ protected:
+  void Ready(quic::QuicStreamId id, uint8_t urgency, bool incremental) {
+    scheduler_.RegisterStream(id, Priority(urgency, incremental));
+    scheduler_.MarkStreamReady(id);
+  }
+
+  // Starts every stream that may start now, in order.
+  std::vector<quic::QuicStreamId> StartAll() {
+    std::vector<quic::QuicStreamId> started;
+    quic::QuicStreamId id;
+    while (scheduler_.PopNextStartableStream(&id))
+      started.push_back(id);
+    return started;
+  }
+
+  QuicHttp3PriorityScheduler scheduler_;
+};
+
+TEST_F(QuicHttp3PrioritySchedulerTest, UrgencyOrder) {
+  Ready(0, 5, true);
+  Ready(4, 0, true);
+  Ready(8, 3, true);
+  EXPECT_EQ(std::vector<quic::QuicStreamId>({4, 8, 0}), StartAll());
+  EXPECT_EQ(0u, scheduler_.num_ready_streams());
+  EXPECT_EQ(3u, scheduler_.num_writing_streams());
+}
+
+TEST_F(QuicHttp3PrioritySchedulerTest, NonIncrementalOneAtATime) {
+  Ready(8, 3, false);
+  Ready(4, 3, false);
+  Ready(0, 3, true);
+  // The lowest ID goes first and holds back everything else at its urgency.
+  EXPECT_EQ(std::vector<quic::QuicStreamId>({4}), StartAll());
+  scheduler_.OnStreamDone(4);
+  EXPECT_EQ(std::vector<quic::QuicStreamId>({8}), StartAll());
+  scheduler_.OnStreamDone(8);
+  EXPECT_EQ(std::vector<quic::QuicStreamId>({0}), StartAll());
+}
+
+TEST_F(QuicHttp3PrioritySchedulerTest, IncrementalShare) {
+  Ready(0, 3, true);
+  Ready(4, 3, true);
+  EXPECT_EQ(std::vector<quic::QuicStreamId>({0, 4}), StartAll());
+
+  // A non-incremental response waits for the incremental ones to finish.
+  Ready(8, 3, false);
+  EXPECT_TRUE(StartAll().empty());
+  scheduler_.OnStreamDone(0);
+  EXPECT_TRUE(StartAll().empty());
+  scheduler_.UnregisterStream(4);
+  EXPECT_EQ(std::vector<quic::QuicStreamId>({8}), StartAll());
+}
+
+TEST_F(QuicHttp3PrioritySchedulerTest, MoreUrgentStartsWhileOthersWrite) {
+  Ready(0, 3, false);
+  EXPECT_EQ(std::vector<quic::QuicStreamId>({0}), StartAll());
+  Ready(4, 1, false);
+  Ready(8, 3, false);
+  EXPECT_EQ(std::vector<quic::QuicStreamId>({4}), StartAll());
+}
+
+TEST_F(QuicHttp3PrioritySchedulerTest, UpdatePriority) {
+  Ready(0, 3, false);
+  Ready(4, 3, false);
+  scheduler_.UpdateStreamPriority(4, Priority(1, false));
+  EXPECT_EQ(Priority(1, false), scheduler_.GetStreamPriority(4));
+  EXPECT_EQ(std::vector<quic::QuicStreamId>({4, 0}), StartAll());
+
+  // Updating a writing stream moves its slot to the new urgency.
+  scheduler_.UpdateStreamPriority(0, Priority(6, true));
+  Ready(8, 3, false);
+  EXPECT_EQ(std::vector<quic::QuicStreamId>({8}), StartAll());
+  EXPECT_EQ(3u, scheduler_.num_writing_streams());
+}
+
+TEST_F(QuicHttp3PrioritySchedulerTest, Unregister) {
+  Ready(0, 3, true);
+  Ready(4, 3, false);
+  scheduler_.UnregisterStream(4);
+  scheduler_.UnregisterStream(0);
+  EXPECT_FALSE(scheduler_.IsRegistered(0));
+  EXPECT_EQ(0u, scheduler_.num_ready_streams());
+  EXPECT_TRUE(StartAll().empty());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -0,0 +1,130 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_lb_connection_id.h"
+
+#include <string.h>
+
+#include "base/logging.h"
+#include "base/memory/ptr_util.h"
+#include "net/third_party/quiche/src/quic/core/quic_constants.h"
+
+namespace net {
+
+namespace {
+
+const size_t kMinNonceLength = 8;
+const size_t kMaxNonceLength = 16;
+const size_t kKeyLength = 16;
+const uint8_t kLengthMask = 0x3f;
+
+}  // namespace
+
+QuicLbConfig::QuicLbConfig() = default;
+
+QuicLbConfig::QuicLbConfig(const QuicLbConfig& other) = default;
+
+QuicLbConfig::~QuicLbConfig() = default;
+
+// static
+std::unique_ptr<QuicLbConnectionIdCodec> QuicLbConnectionIdCodec::Create(
+    const QuicLbConfig& config) {
+  if (config.config_id >= kQuicLbUnroutableConfigId ||
+      config.server_id_length == 0) {
+    return nullptr;
+  }
+  if (!config.server_id.empty() &&
+      config.server_id.size() != config.server_id_length) {
+    return nullptr;
+  }
+  size_t min_length = 1 + config.server_id_length;
+  if (config.mode == QuicLbConfig::STREAM_CIPHER) {
+    if (config.nonce_length < kMinNonceLength ||
+        config.nonce_length > kMaxNonceLength ||
+        config.key.size() != kKeyLength ||
+        config.server_id_length > AES_BLOCK_SIZE) {
+      return nullptr;
+    }
+    min_length += config.nonce_length;
+  }
+  if (config.connection_id_length < min_length ||
+      config.connection_id_length >
+          quic::kQuicMaxConnectionIdWithLengthPrefixLength) {
+    return nullptr;
+  }
+  return base::WrapUnique(new QuicLbConnectionIdCodec(config));
+}
+
+QuicLbConnectionIdCodec::QuicLbConnectionIdCodec(const QuicLbConfig& config)
+    : config_(config) {
+  if (config_.mode == QuicLbConfig::STREAM_CIPHER) {
+    AES_set_encrypt_key(reinterpret_cast<const uint8_t*>(config_.key.data()),
+                        kKeyLength * 8, &aes_key_);
+  }
+}
+
+QuicLbConnectionIdCodec::~QuicLbConnectionIdCodec() = default;
+
+quic::QuicConnectionId QuicLbConnectionIdCodec::GenerateConnectionId(
+    quic::QuicRandom* random) const {
+  DCHECK_EQ(config_.server_id_length, config_.server_id.size());
+  char buffer[quic::kQuicMaxConnectionIdWithLengthPrefixLength];
+  const uint8_t length = config_.connection_id_length;
+  random->RandBytes(buffer, length);
+
+  uint8_t first_octet = config_.config_id << 6;
+  if (config_.self_encode_length) {
+    first_octet |= (length - 1) & kLengthMask;
+  } else {
+    first_octet |= static_cast<uint8_t>(buffer[0]) & kLengthMask;
+  }
+  buffer[0] = first_octet;
+
+  if (config_.mode == QuicLbConfig::PLAINTEXT) {
+    memcpy(buffer + 1, config_.server_id.data(), config_.server_id_length);
+  } else {
+    // The random bytes after the first octet serve as the nonce.
+    uint8_t mask[AES_BLOCK_SIZE];
+    ComputeMask(buffer + 1, mask);
+    char* encrypted_server_id = buffer + 1 + config_.nonce_length;
+    for (size_t i = 0; i < config_.server_id_length; ++i)
+      encrypted_server_id[i] = config_.server_id[i] ^ mask[i];
+  }
+  return quic::QuicConnectionId(buffer, length);
+}
+
+bool QuicLbConnectionIdCodec::ExtractServerId(
+    const quic::QuicConnectionId& connection_id,
+    std::string* server_id) const {
+  const char* data = connection_id.data();
+  size_t min_length = 1 + config_.server_id_length;
+  if (config_.mode == QuicLbConfig::STREAM_CIPHER)
+    min_length += config_.nonce_length;
+  if (connection_id.length() < min_length ||
+      (static_cast<uint8_t>(data[0]) >> 6) != config_.config_id) {
+    return false;
+  }
+
+  if (config_.mode == QuicLbConfig::PLAINTEXT) {
+    server_id->assign(data + 1, config_.server_id_length);
+    return true;
+  }
+  uint8_t mask[AES_BLOCK_SIZE];
+  ComputeMask(data + 1, mask);
+  const char* encrypted_server_id = data + 1 + config_.nonce_length;
+  server_id->resize(config_.server_id_length);
+  for (size_t i = 0; i < config_.server_id_length; ++i)
+    (*server_id)[i] = encrypted_server_id[i] ^ mask[i];
+  return true;
+}
+
+void QuicLbConnectionIdCodec::ComputeMask(
+    const char* nonce,
+    uint8_t mask[AES_BLOCK_SIZE]) const {
+  uint8_t padded_nonce[AES_BLOCK_SIZE] = {};
+  memcpy(padded_nonce, nonce, config_.nonce_length);
+  AES_encrypt(padded_nonce, mask, &aes_key_);
+}
+
+}  // namespace net
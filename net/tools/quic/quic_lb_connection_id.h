@@ -0,0 +1,96 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_LB_CONNECTION_ID_H_
+#define NET_TOOLS_QUIC_QUIC_LB_CONNECTION_ID_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "base/macros.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/core/quic_connection_id.h"
+#include "third_party/boringssl/src/include/openssl/aes.h"
+
+namespace net {
+
+// Config rotation codepoint reserved for connection IDs that load balancers
+// cannot route.
+const uint8_t kQuicLbUnroutableConfigId = 3;
+
+// A QUIC-LB configuration (draft-ietf-quic-load-balancers-02), shared by a
+// fleet of servers and the stateless load balancers in front of them.
+struct QuicLbConfig {
+  enum Mode {
+    // The server ID follows the first octet in the clear.
+    PLAINTEXT,
+    // The server ID is XORed with AES-ECB(key, nonce) and follows a random
+    // nonce, so that connection IDs are unlinkable to observers without the
+    // key.
+    STREAM_CIPHER,
+  };
+
+  QuicLbConfig();
+  QuicLbConfig(const QuicLbConfig& other);
+  ~QuicLbConfig();
+
+  Mode mode = PLAINTEXT;
+  // Config rotation codepoint, in the two high bits of the first octet. Lets
+  // load balancers decode connection IDs issued under the previous config
+  // while a new one is rolled out.
+  uint8_t config_id = 0;
+  // Length of the server IDs in this config.
+  size_t server_id_length = 0;
+  // This server's ID. Empty on load balancers, which only decode.
+  std::string server_id;
+  // Length of the nonce and 16-byte AES key; STREAM_CIPHER only.
+  size_t nonce_length = 8;
+  std::string key;
+  // Length of the generated connection IDs.
+  uint8_t connection_id_length = 0;
+  // If true, the six low bits of the first octet encode the connection ID
+  // length minus one, so that load balancers can find the end of the
+  // connection ID in short header packets.
+  bool self_encode_length = true;
+};
+
+// Encodes the server ID into connection IDs issued by a server, and extracts
+// it from connection IDs on load balancers.
+class QuicLbConnectionIdCodec {
+ public:
+  // Returns nullptr if |config| is not valid.
+  static std::unique_ptr<QuicLbConnectionIdCodec> Create(
+      const QuicLbConfig& config);
+
+  ~QuicLbConnectionIdCodec();
+
+  // Returns a new connection ID that routes to this server. Must only be
+  // called if the config has a server ID.
+  quic::QuicConnectionId GenerateConnectionId(quic::QuicRandom* random) const;
+
+  // Sets |server_id| to the server ID encoded in |connection_id|. Returns
+  // false if |connection_id| was not issued under this config.
+  bool ExtractServerId(const quic::QuicConnectionId& connection_id,
+                       std::string* server_id) const;
+
+  uint8_t connection_id_length() const { return config_.connection_id_length; }
+
+ private:
+  explicit QuicLbConnectionIdCodec(const QuicLbConfig& config);
+
+  // Sets |mask| to AES-ECB(key, nonce padded with zeros).
+  void ComputeMask(const char* nonce, uint8_t mask[AES_BLOCK_SIZE]) const;
+
+  const QuicLbConfig config_;
+  AES_KEY aes_key_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicLbConnectionIdCodec);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_LB_CONNECTION_ID_H_
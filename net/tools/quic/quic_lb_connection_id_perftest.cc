@@ -0,0 +1,74 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how many QUIC-LB connection IDs a server can issue, and a load
+// balancer decode, per second in each mode.
+
+#include <string>
+#include <vector>
+
+#include "base/timer/elapsed_timer.h"
+#include "net/tools/quic/quic_lb_connection_id.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace net {
+namespace test {
+namespace {
+
+const int kNumConnectionIds = 1000000;
+
+const char kMetricPrefix[] = "QuicLbConnectionId.";
+const char kMetricEncodeRate[] = "encode_rate";
+const char kMetricDecodeRate[] = "decode_rate";
+
+void RunCodec(const std::string& story, const QuicLbConfig& config) {
+  auto codec = QuicLbConnectionIdCodec::Create(config);
+  ASSERT_TRUE(codec);
+  quic::QuicRandom* random = quic::QuicRandom::GetInstance();
+
+  std::vector<quic::QuicConnectionId> connection_ids;
+  connection_ids.reserve(kNumConnectionIds);
+  base::ElapsedTimer encode_timer;
+  for (int i = 0; i < kNumConnectionIds; ++i)
+    connection_ids.push_back(codec->GenerateConnectionId(random));
+  base::TimeDelta encode_time = encode_timer.Elapsed();
+
+  std::string server_id;
+  base::ElapsedTimer decode_timer;
+  for (const quic::QuicConnectionId& connection_id : connection_ids)
+    ASSERT_TRUE(codec->ExtractServerId(connection_id, &server_id));
+  base::TimeDelta decode_time = decode_timer.Elapsed();
+  EXPECT_EQ(config.server_id, server_id);
+
+  perf_test::PerfResultReporter reporter(kMetricPrefix, story);
+  reporter.RegisterImportantMetric(kMetricEncodeRate, "runs/s");
+  reporter.RegisterImportantMetric(kMetricDecodeRate, "runs/s");
+  reporter.AddResult(kMetricEncodeRate,
+                     kNumConnectionIds / encode_time.InSecondsF());
+  reporter.AddResult(kMetricDecodeRate,
+                     kNumConnectionIds / decode_time.InSecondsF());
+}
+
+TEST(QuicLbConnectionIdPerfTest, Plaintext) {
+  QuicLbConfig config;
+  config.server_id_length = 4;
+  config.server_id = std::string("\x0a\x00\x00\x01", 4);
+  config.connection_id_length = 8;
+  RunCodec("plaintext", config);
+}
+
+TEST(QuicLbConnectionIdPerfTest, StreamCipher) {
+  QuicLbConfig config;
+  config.mode = QuicLbConfig::STREAM_CIPHER;
+  config.server_id_length = 4;
+  config.server_id = std::string("\x0a\x00\x00\x01", 4);
+  config.key = std::string(16, 'k');
+  config.connection_id_length = 13;
+  RunCodec("stream_cipher", config);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -0,0 +1,143 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_lb_connection_id.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+QuicLbConfig PlaintextConfig() {
+  QuicLbConfig config;
+  config.config_id = 1;
+  config.server_id_length = 3;
+  config.server_id = "\x01\x02\x03";
+  config.connection_id_length = 8;
+  return config;
+}
+
+QuicLbConfig StreamCipherConfig() {
+  QuicLbConfig config = PlaintextConfig();
+  config.mode = QuicLbConfig::STREAM_CIPHER;
+  config.key = std::string(16, 'k');
+  config.connection_id_length = 12;
+  return config;
+}
+
+// Returns |config| as seen by a load balancer, which has no server ID.
+QuicLbConfig LoadBalancerConfig(QuicLbConfig config) {
+  config.server_id.clear();
+  return config;
+}
+
+TEST(QuicLbConnectionIdTest, PlaintextRoundTrip) {
+  auto server = QuicLbConnectionIdCodec::Create(PlaintextConfig());
+  auto load_balancer =
+      QuicLbConnectionIdCodec::Create(LoadBalancerConfig(PlaintextConfig()));
+  ASSERT_TRUE(server);
+  ASSERT_TRUE(load_balancer);
+
+  quic::QuicConnectionId connection_id =
+      server->GenerateConnectionId(quic::QuicRandom::GetInstance());
+  ASSERT_EQ(8u, connection_id.length());
+  // Config rotation bits, then the self-encoded length minus one.
+  EXPECT_EQ((1 << 6) | 7, static_cast<uint8_t>(connection_id.data()[0]));
+  EXPECT_EQ("\x01\x02\x03", std::string(connection_id.data() + 1, 3));
+
+  std::string server_id;
+  ASSERT_TRUE(load_balancer->ExtractServerId(connection_id, &server_id));
+  EXPECT_EQ("\x01\x02\x03", server_id);
+}
+
+TEST(QuicLbConnectionIdTest, StreamCipherRoundTrip) {
+  auto server = QuicLbConnectionIdCodec::Create(StreamCipherConfig());
+  auto load_balancer =
+      QuicLbConnectionIdCodec::Create(LoadBalancerConfig(StreamCipherConfig()));
+  ASSERT_TRUE(server);
+  ASSERT_TRUE(load_balancer);
+
+  quic::QuicConnectionId first =
+      server->GenerateConnectionId(quic::QuicRandom::GetInstance());
+  quic::QuicConnectionId second =
+      server->GenerateConnectionId(quic::QuicRandom::GetInstance());
+  ASSERT_EQ(12u, first.length());
+  EXPECT_NE(first, second);
+
+  for (const quic::QuicConnectionId& connection_id : {first, second}) {
+    std::string server_id;
+    ASSERT_TRUE(load_balancer->ExtractServerId(connection_id, &server_id));
+    EXPECT_EQ("\x01\x02\x03", server_id);
+  }
+}
+
+TEST(QuicLbConnectionIdTest, StreamCipherWrongKey) {
+  auto server = QuicLbConnectionIdCodec::Create(StreamCipherConfig());
+  QuicLbConfig other_config = LoadBalancerConfig(StreamCipherConfig());
+  other_config.key = std::string(16, 'x');
+  auto load_balancer = QuicLbConnectionIdCodec::Create(other_config);
+  ASSERT_TRUE(load_balancer);
+
+  std::string server_id;
+  ASSERT_TRUE(load_balancer->ExtractServerId(
+      server->GenerateConnectionId(quic::QuicRandom::GetInstance()),
+      &server_id));
+  EXPECT_NE("\x01\x02\x03", server_id);
+}
+
+TEST(QuicLbConnectionIdTest, ConfigRotation) {
+  auto server = QuicLbConnectionIdCodec::Create(PlaintextConfig());
+  QuicLbConfig next_config = LoadBalancerConfig(PlaintextConfig());
+  next_config.config_id = 2;
+  auto load_balancer = QuicLbConnectionIdCodec::Create(next_config);
+  ASSERT_TRUE(load_balancer);
+
+  std::string server_id;
+  EXPECT_FALSE(load_balancer->ExtractServerId(
+      server->GenerateConnectionId(quic::QuicRandom::GetInstance()),
+      &server_id));
+}
+
+TEST(QuicLbConnectionIdTest, ShortConnectionId) {
+  auto load_balancer =
+      QuicLbConnectionIdCodec::Create(LoadBalancerConfig(PlaintextConfig()));
+  std::string server_id;
+  EXPECT_FALSE(load_balancer->ExtractServerId(
+      quic::QuicConnectionId("\x40\x01", 2), &server_id));
+}
+
+TEST(QuicLbConnectionIdTest, InvalidConfigs) {
+  QuicLbConfig config = PlaintextConfig();
+  config.config_id = kQuicLbUnroutableConfigId;
+  EXPECT_FALSE(QuicLbConnectionIdCodec::Create(config));
+
+  config = PlaintextConfig();
+  config.server_id = "\x01";
+  EXPECT_FALSE(QuicLbConnectionIdCodec::Create(config));
+
+  config = PlaintextConfig();
+  config.connection_id_length = 3;
+  EXPECT_FALSE(QuicLbConnectionIdCodec::Create(config));
+
+  config = PlaintextConfig();
+  config.connection_id_length = 21;
+  EXPECT_FALSE(QuicLbConnectionIdCodec::Create(config));
+
+  config = StreamCipherConfig();
+  config.key = "short";
+  EXPECT_FALSE(QuicLbConnectionIdCodec::Create(config));
+
+  config = StreamCipherConfig();
+  config.nonce_length = 4;
+  EXPECT_FALSE(QuicLbConnectionIdCodec::Create(config));
+
+  config = StreamCipherConfig();
+  config.connection_id_length = 8;
+  EXPECT_FALSE(QuicLbConnectionIdCodec::Create(config));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
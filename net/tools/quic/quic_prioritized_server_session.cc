@@ -0,0 +1,234 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_prioritized_server_session.h"
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "base/logging.h"
+#include "net/third_party/quiche/src/quic/core/http/quic_header_list.h"
+#include "net/third_party/quiche/src/quic/core/quic_utils.h"
+#include "net/third_party/quiche/src/spdy/core/spdy_protocol.h"
+
+namespace net {
+
+namespace {
+
+const char kPriorityHeader[] = "priority";
+
+}  // namespace
+
+// Defers writing its response until the session lets it start.
+class QuicPrioritizedServerSession::Stream : public QuicDigestingServerStream {
+ public:
+  Stream(quic::QuicStreamId id,
+         QuicPrioritizedServerSession* session,
+         quic::QuicSimpleServerBackend* quic_simple_server_backend)
+      : QuicDigestingServerStream(id,
+                                  session,
+                                  quic_simple_server_backend,
+                                  session->body_digester_factory()),
+        session_(session),
+        response_(nullptr),
+        registered_(false),
+        writing_(false) {}
+
+  ~Stream() override = default;
+
+  // QuicDigestingServerStream methods:
+  void OnInitialHeadersComplete(
+      bool fin,
+      size_t frame_len,
+      const quic::QuicHeaderList& header_list) override {
+    // Registers before the base class handles the headers, since that may
+    // fetch the response right away.
+    QuicHttp3Priority priority;
+    for (const auto& header : header_list) {
+      if (header.first == kPriorityHeader) {
+        priority = ParseQuicHttp3Priority(header.second);
+        break;
+      }
+    }
+    priority = session_->OnRequestPriority(id(), priority);
+    registered_ = true;
+    SetPriority(spdy::SpdyStreamPrecedence(priority.urgency));
+    QuicDigestingServerStream::OnInitialHeadersComplete(fin, frame_len,
+                                                        header_list);
+  }
+
+  void OnResponseBackendComplete(
+      const quic::QuicBackendResponse* response,
+      std::list<quic::QuicBackendResponse::ServerPushInfo> resources)
+      override {
+    if (!registered_) {
+      QuicDigestingServerStream::OnResponseBackendComplete(
+          response, std::move(resources));
+      return;
+    }
+    response_ = response;
+    resources_ = std::move(resources);
+    session_->OnResponseReady(id());
+  }
+
+  void OnCanWrite() override {
+    QuicDigestingServerStream::OnCanWrite();
+    MaybeSignalDone();
+  }
+
+  void OnClose() override {
+    registered_ = false;
+    writing_ = false;
+    session_->OnPrioritizedStreamClosed(id());
+    QuicDigestingServerStream::OnClose();
+  }
+
+  // Writes the response held since OnResponseBackendComplete().
+  void StartResponse() {
+    writing_ = true;
+    QuicDigestingServerStream::OnResponseBackendComplete(
+        response_, std::move(resources_));
+    MaybeSignalDone();
+  }
+
+ private:
+  void MaybeSignalDone() {
+    if (!writing_ || BufferedDataBytes() > 0)
+      return;
+    writing_ = false;
+    session_->OnResponseDone(id());
+  }
+
+  QuicPrioritizedServerSession* session_;  // Not owned.
+  const quic::QuicBackendResponse* response_;
+  std::list<quic::QuicBackendResponse::ServerPushInfo> resources_;
+  bool registered_;
+  bool writing_;
+
+  DISALLOW_COPY_AND_ASSIGN(Stream);
+};
+
+QuicPrioritizedServerSession::QuicPrioritizedServerSession(
+    const quic::QuicConfig& config,
+    const quic::ParsedQuicVersionVector& supported_versions,
+    quic::QuicConnection* connection,
+    quic::QuicSession::Visitor* visitor,
+    quic::QuicCryptoServerStreamBase::Helper* helper,
+    const quic::QuicCryptoServerConfig* crypto_config,
+    quic::QuicCompressedCertsCache* compressed_certs_cache,
+    quic::QuicSimpleServerBackend* quic_simple_server_backend)
+    : QuicDigestingServerSession(config,
+                                 supported_versions,
+                                 connection,
+                                 visitor,
+                                 helper,
+                                 crypto_config,
+                                 compressed_certs_cache,
+                                 quic_simple_server_backend),
+      next_incoming_stream_id_(
+          quic::QuicUtils::GetFirstBidirectionalStreamId(
+              transport_version(),
+              quic::Perspective::IS_CLIENT)),
+      starting_responses_(false) {}
+
+QuicPrioritizedServerSession::~QuicPrioritizedServerSession() = default;
+
+bool QuicPrioritizedServerSession::OnPriorityUpdateForRequestStream(
+    quic::QuicStreamId stream_id,
+    int urgency) {
+  // The base class validates the frame and updates the stream's precedence.
+  if (!QuicDigestingServerSession::OnPriorityUpdateForRequestStream(
+          stream_id, urgency)) {
+    return false;
+  }
+  if (urgency < 0 || urgency > kQuicHttp3MaxUrgency)
+    return true;
+  if (!scheduler_.IsRegistered(stream_id)) {
+    // Updates for streams whose request has come and gone are stale.
+    if (!IsClosedStream(stream_id) && MayOpenIncomingStream(stream_id))
+      pending_priority_updates_[stream_id] = urgency;
+    return true;
+  }
+  QuicHttp3Priority priority = scheduler_.GetStreamPriority(stream_id);
+  priority.urgency = urgency;
+  scheduler_.UpdateStreamPriority(stream_id, priority);
+  StartResponses();
+  return true;
+}
+
+QuicHttp3Priority QuicPrioritizedServerSession::OnRequestPriority(
+    quic::QuicStreamId id,
+    const QuicHttp3Priority& priority) {
+  QuicHttp3Priority stream_priority = priority;
+  auto it = pending_priority_updates_.find(id);
+  if (it != pending_priority_updates_.end()) {
+    stream_priority.urgency = it->second;
+    pending_priority_updates_.erase(it);
+  }
+  scheduler_.RegisterStream(id, stream_priority);
+  return stream_priority;
+}
+
+void QuicPrioritizedServerSession::OnResponseReady(quic::QuicStreamId id) {
+  scheduler_.MarkStreamReady(id);
+  StartResponses();
+}
+
+void QuicPrioritizedServerSession::OnResponseDone(quic::QuicStreamId id) {
+  scheduler_.OnStreamDone(id);
+  StartResponses();
+}
+
+void QuicPrioritizedServerSession::OnPrioritizedStreamClosed(
+    quic::QuicStreamId id) {
+  scheduler_.UnregisterStream(id);
+  streams_.erase(id);
+  pending_priority_updates_.erase(id);
+  StartResponses();
+}
+
+quic::QuicSpdyStream* QuicPrioritizedServerSession::CreateIncomingStream(
+    quic::QuicStreamId id) {
+  if (!ShouldCreateIncomingStream(id))
+    return nullptr;
+  auto stream = std::make_unique<Stream>(id, this, server_backend());
+  Stream* stream_ptr = stream.get();
+  streams_[id] = stream_ptr;
+  ActivateStream(std::move(stream));
+  next_incoming_stream_id_ =
+      std::max(next_incoming_stream_id_,
+               id + quic::QuicUtils::StreamIdDelta(transport_version()));
+  return stream_ptr;
+}
+
+bool QuicPrioritizedServerSession::MayOpenIncomingStream(
+    quic::QuicStreamId id) const {
+  // The client may open at most as many streams beyond those it has opened
+  // as it may have open at once.
+  const quic::QuicStreamId limit =
+      next_incoming_stream_id_ +
+      quic::QuicUtils::StreamIdDelta(transport_version()) *
+          max_open_incoming_bidirectional_streams();
+  return id < limit;
+}
+
+void QuicPrioritizedServerSession::StartResponses() {
+  // Streams signal completion from inside StartResponse(), which must not
+  // restart this loop.
+  if (starting_responses_)
+    return;
+  starting_responses_ = true;
+  quic::QuicStreamId id;
+  while (scheduler_.PopNextStartableStream(&id)) {
+    auto it = streams_.find(id);
+    DCHECK(it != streams_.end());
+    it->second->StartResponse();
+  }
+  starting_responses_ = false;
+}
+
+}  // namespace net
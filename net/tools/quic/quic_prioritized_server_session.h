@@ -0,0 +1,89 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_PRIORITIZED_SERVER_SESSION_H_
+#define NET_TOOLS_QUIC_QUIC_PRIORITIZED_SERVER_SESSION_H_
+
+#include <stddef.h>
+
+#include <map>
+
+#include "base/macros.h"
+#include "net/tools/quic/quic_digesting_server_session.h"
+#include "net/tools/quic/quic_http3_priority_scheduler.h"
+
+namespace net {
+
+// A QuicDigestingServerSession that writes responses according to their
+// RFC 9218 priority, taken from the request's priority header and from
+// PRIORITY_UPDATE frames. The urgency of a stream becomes its precedence in
+// the session's write blocked list, so a more urgent response preempts the
+// data of less urgent ones, and a QuicHttp3PriorityScheduler decides when
+// each response starts, so that non-incremental responses of equal urgency
+// are written one after the other rather than interleaved.
+class QuicPrioritizedServerSession : public QuicDigestingServerSession {
+ public:
+  QuicPrioritizedServerSession(
+      const quic::QuicConfig& config,
+      const quic::ParsedQuicVersionVector& supported_versions,
+      quic::QuicConnection* connection,
+      quic::QuicSession::Visitor* visitor,
+      quic::QuicCryptoServerStreamBase::Helper* helper,
+      const quic::QuicCryptoServerConfig* crypto_config,
+      quic::QuicCompressedCertsCache* compressed_certs_cache,
+      quic::QuicSimpleServerBackend* quic_simple_server_backend);
+  ~QuicPrioritizedServerSession() override;
+
+  // quic::QuicSpdySession methods:
+  bool OnPriorityUpdateForRequestStream(quic::QuicStreamId stream_id,
+                                        int urgency) override;
+
+  // Called by streams once their request headers have been received.
+  // Returns the priority the stream should use, which is |priority| unless a
+  // PRIORITY_UPDATE frame for the stream arrived first.
+  QuicHttp3Priority OnRequestPriority(quic::QuicStreamId id,
+                                      const QuicHttp3Priority& priority);
+  // Called by streams when their response is ready to be written.
+  void OnResponseReady(quic::QuicStreamId id);
+  // Called by streams once their response is fully written.
+  void OnResponseDone(quic::QuicStreamId id);
+  // Called by streams when they close.
+  void OnPrioritizedStreamClosed(quic::QuicStreamId id);
+
+  const QuicHttp3PriorityScheduler& scheduler() const { return scheduler_; }
+  size_t num_pending_priority_updates() const {
+    return pending_priority_updates_.size();
+  }
+
+ protected:
+  // QuicDigestingServerSession methods:
+  quic::QuicSpdyStream* CreateIncomingStream(quic::QuicStreamId id) override;
+
+ private:
+  class Stream;
+
+  // Starts writing every ready response the scheduler allows.
+  void StartResponses();
+  // Returns true if the client has opened stream |id|, or may open it within
+  // the current stream limit.
+  bool MayOpenIncomingStream(quic::QuicStreamId id) const;
+
+  QuicHttp3PriorityScheduler scheduler_;
+  // Open request streams, owned by the base class.
+  std::map<quic::QuicStreamId, Stream*> streams_;
+  // Urgencies received in PRIORITY_UPDATE frames for open streams whose
+  // request headers have not arrived yet, and for streams the client may open
+  // next. Entries are dropped when the stream closes, so the map holds at
+  // most twice the stream limit.
+  std::map<quic::QuicStreamId, int> pending_priority_updates_;
+  // The stream ID following the highest one the client has opened.
+  quic::QuicStreamId next_incoming_stream_id_;
+  bool starting_responses_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicPrioritizedServerSession);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_PRIORITIZED_SERVER_SESSION_H_
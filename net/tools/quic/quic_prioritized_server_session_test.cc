@@ -0,0 +1,439 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_prioritized_server_session.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "net/third_party/quiche/src/common/platform/api/quiche_string_piece.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_crypto_server_config.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/core/http/http_encoder.h"
+#include "net/third_party/quiche/src/quic/core/http/quic_header_list.h"
+#include "net/third_party/quiche/src/quic/core/quic_versions.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_test.h"
+#include "net/third_party/quiche/src/quic/test_tools/crypto_test_utils.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_config_peer.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_session_peer.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_test_utils.h"
+#include "net/third_party/quiche/src/quic/tools/quic_memory_cache_backend.h"
+#include "net/third_party/quiche/src/spdy/core/spdy_header_block.h"
+#include "net/tools/quic/quic_body_digester.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using testing::_;
+using testing::Invoke;
+
+namespace net {
+namespace test {
+namespace {
+
+const char kHost[] = "www.example.org";
+const char kLargePath[] = "/large";
+const char kSmallPath[] = "/small";
+
+// Responses to kLargePath do not fit in a stream's initial send window.
+const quic::QuicByteCount kStreamWindow = quic::kMinimumFlowControlSendWindow;
+const quic::QuicByteCount kSessionWindow = 16 * kStreamWindow;
+const size_t kLargeBodySize = 2 * kStreamWindow;
+
+// Records the requests passed to the backend.
+class TestBackend : public quic::QuicMemoryCacheBackend {
+ public:
+  TestBackend() = default;
+
+  void FetchResponseFromBackend(
+      const spdy::SpdyHeaderBlock& request_headers,
+      const std::string& request_body,
+      quic::QuicSimpleServerBackend::RequestDelegate* delegate) override {
+    ++num_requests_;
+    last_request_headers_ = request_headers.Clone();
+    last_request_body_ = request_body;
+    quic::QuicMemoryCacheBackend::FetchResponseFromBackend(
+        request_headers, request_body, delegate);
+  }
+
+  int num_requests() const { return num_requests_; }
+  const spdy::SpdyHeaderBlock& last_request_headers() const {
+    return last_request_headers_;
+  }
+  const std::string& last_request_body() const { return last_request_body_; }
+
+ private:
+  int num_requests_ = 0;
+  spdy::SpdyHeaderBlock last_request_headers_;
+  std::string last_request_body_;
+
+  DISALLOW_COPY_AND_ASSIGN(TestBackend);
+};
+
+// Writes go to a mock instead of the connection, so that tests control how
+// much the session may write.
+class TestPrioritizedServerSession : public QuicPrioritizedServerSession {
+ public:
+  using QuicPrioritizedServerSession::QuicPrioritizedServerSession;
+
+  MOCK_METHOD6(WritevData,
+               quic::QuicConsumedData(
+                   quic::QuicStreamId id,
+                   size_t write_length,
+                   quic::QuicStreamOffset offset,
+                   quic::StreamSendingState state,
+                   quic::TransmissionType type,
+                   quiche::QuicheOptional<quic::EncryptionLevel> level));
+};
+
+class QuicPrioritizedServerSessionTest
+    : public QuicTestWithParam<quic::ParsedQuicVersion> {
+ protected:
+  QuicPrioritizedServerSessionTest()
+      : crypto_config_(quic::QuicCryptoServerConfig::TESTING,
+                       quic::QuicRandom::GetInstance(),
+                       quic::test::crypto_test_utils::ProofSourceForTesting(),
+                       quic::KeyExchangeSource::Default()),
+        compressed_certs_cache_(
+            quic::QuicCompressedCertsCache::kQuicCompressedCertsCacheSize) {
+    quic::test::QuicConfigPeer::SetReceivedInitialSessionFlowControlWindow(
+        &config_, kSessionWindow);
+    quic::test::QuicConfigPeer::SetReceivedInitialStreamFlowControlWindow(
+        &config_, kStreamWindow);
+    quic::test::QuicConfigPeer::
+        SetReceivedInitialMaxStreamDataBytesIncomingBidirectional(
+            &config_, kStreamWindow);
+    quic::test::QuicConfigPeer::
+        SetReceivedInitialMaxStreamDataBytesOutgoingBidirectional(
+            &config_, kStreamWindow);
+    quic::test::QuicConfigPeer::SetReceivedMaxBidirectionalStreams(&config_,
+                                                                   10);
+    quic::test::QuicConfigPeer::SetReceivedMaxUnidirectionalStreams(&config_,
+                                                                    10);
+
+    backend_.AddSimpleResponse(kHost, kLargePath, 200,
+                               std::string(kLargeBodySize, 'a'));
+    backend_.AddSimpleResponse(kHost, kSmallPath, 200, "small");
+
+    // Owned by |session_|.
+    connection_ = new testing::NiceMock<quic::test::MockQuicConnection>(
+        &helper_, &alarm_factory_, quic::Perspective::IS_SERVER,
+        quic::test::SupportedVersions(GetParam()));
+    ON_CALL(*connection_, SendControlFrame(_))
+        .WillByDefault(Invoke(&quic::test::ClearControlFrame));
+    session_ =
+        std::make_unique<testing::NiceMock<TestPrioritizedServerSession>>(
+            config_, quic::test::SupportedVersions(GetParam()), connection_,
+            &owner_, &stream_helper_, &crypto_config_,
+            &compressed_certs_cache_, &backend_);
+    ON_CALL(*session_, WritevData(_, _, _, _, _, _))
+        .WillByDefault(
+            Invoke(this, &QuicPrioritizedServerSessionTest::ConsumeData));
+    session_->Initialize();
+    session_->OnConfigNegotiated();
+  }
+
+  // Sends a complete GET request for |path| on the |n|th client-initiated
+  // stream, with a priority header of |priority| unless it is empty.
+  quic::QuicStreamId SendRequest(int n,
+                                 const std::string& path,
+                                 const std::string& priority) {
+    quic::QuicStreamId id =
+        quic::test::GetNthClientInitiatedBidirectionalStreamId(
+            GetParam().transport_version, n);
+    quic::QuicSpdyStream* stream = GetStream(id);
+    spdy::SpdyHeaderBlock headers;
+    headers[":method"] = "GET";
+    headers[":scheme"] = "https";
+    headers[":authority"] = kHost;
+    headers[":path"] = path;
+    if (!priority.empty())
+      headers["priority"] = priority;
+    quic::QuicHeaderList header_list = quic::test::AsHeaderList(headers);
+    stream->OnStreamHeaderList(/*fin=*/false,
+                               header_list.uncompressed_header_bytes(),
+                               header_list);
+    stream->OnStreamFrame(quic::QuicStreamFrame(id, /*fin=*/true, 0,
+                                                quiche::QuicheStringPiece()));
+    return id;
+  }
+
+  // Sends a POST request for kSmallPath on the |n|th client-initiated stream,
+  // with |extra_headers|, and a body made of |chunks|, each in its own frame.
+  quic::QuicStreamId SendPostRequest(int n,
+                                     const spdy::SpdyHeaderBlock& extra_headers,
+                                     const std::vector<std::string>& chunks) {
+    quic::QuicStreamId id =
+        quic::test::GetNthClientInitiatedBidirectionalStreamId(
+            GetParam().transport_version, n);
+    quic::QuicSpdyStream* stream = GetStream(id);
+    spdy::SpdyHeaderBlock headers;
+    headers[":method"] = "POST";
+    headers[":scheme"] = "https";
+    headers[":authority"] = kHost;
+    headers[":path"] = kSmallPath;
+    for (const auto& header : extra_headers)
+      headers[header.first] = header.second;
+    quic::QuicHeaderList header_list = quic::test::AsHeaderList(headers);
+    stream->OnStreamHeaderList(/*fin=*/false,
+                               header_list.uncompressed_header_bytes(),
+                               header_list);
+    quic::QuicStreamOffset offset = 0;
+    for (const std::string& chunk : chunks) {
+      std::string data = chunk;
+      if (quic::VersionUsesHttp3(GetParam().transport_version)) {
+        std::unique_ptr<char[]> buffer;
+        quic::QuicByteCount header_length =
+            quic::HttpEncoder::SerializeDataFrameHeader(chunk.size(), &buffer);
+        data = std::string(buffer.get(), header_length) + chunk;
+      }
+      stream->OnStreamFrame(
+          quic::QuicStreamFrame(id, /*fin=*/false, offset, data));
+      offset += data.size();
+    }
+    stream->OnStreamFrame(quic::QuicStreamFrame(id, /*fin=*/true, offset,
+                                                quiche::QuicheStringPiece()));
+    return id;
+  }
+
+  // Digests the request bodies with SHA-256 and CRC32C.
+  void EnableBodyDigests() {
+    session_->set_body_digester_factory(
+        CreateQuicBodyDigesterFactory({"sha-256", "crc32c"}));
+  }
+
+  // Returns the value of kQuicBodyDigestHeader for |body|.
+  static std::string BodyDigests(const std::string& body) {
+    QuicBodyDigestSet digests(
+        CreateQuicBodyDigesterFactory({"sha-256", "crc32c"}).Run());
+    digests.Update(body);
+    return FormatQuicContentDigest(digests.Finish());
+  }
+
+  quic::QuicSpdyStream* GetStream(quic::QuicStreamId id) {
+    return static_cast<quic::QuicSpdyStream*>(
+        quic::test::QuicSessionPeer::GetOrCreateStream(session_.get(), id));
+  }
+
+  // Lets |id| write the rest of its response.
+  void UnblockStream(quic::QuicStreamId id) {
+    quic::QuicSpdyStream* stream = GetStream(id);
+    stream->OnWindowUpdateFrame(quic::QuicWindowUpdateFrame(
+        quic::kInvalidControlFrameId, id, 4 * kStreamWindow));
+    stream->OnCanWrite();
+  }
+
+  bool HasStarted(quic::QuicStreamId id) const {
+    return started_streams_.count(id) > 0;
+  }
+  bool HasFinished(quic::QuicStreamId id) const {
+    return finished_streams_.count(id) > 0;
+  }
+
+  const QuicHttp3PriorityScheduler& scheduler() const {
+    return session_->scheduler();
+  }
+
+  quic::QuicConfig config_;
+  quic::QuicCryptoServerConfig crypto_config_;
+  quic::QuicCompressedCertsCache compressed_certs_cache_;
+  quic::test::MockQuicConnectionHelper helper_;
+  quic::test::MockAlarmFactory alarm_factory_;
+  testing::NiceMock<quic::test::MockQuicSessionVisitor> owner_;
+  testing::NiceMock<quic::test::MockQuicCryptoServerStreamHelper>
+      stream_helper_;
+  TestBackend backend_;
+  testing::NiceMock<quic::test::MockQuicConnection>* connection_;
+  std::unique_ptr<testing::NiceMock<TestPrioritizedServerSession>> session_;
+
+ private:
+  // Consumes every write, and records which streams wrote data and which
+  // wrote their fin.
+  quic::QuicConsumedData ConsumeData(
+      quic::QuicStreamId id,
+      size_t write_length,
+      quic::QuicStreamOffset offset,
+      quic::StreamSendingState state,
+      quic::TransmissionType type,
+      quiche::QuicheOptional<quic::EncryptionLevel> level) {
+    if (write_length > 0)
+      started_streams_.insert(id);
+    bool fin = state != quic::NO_FIN;
+    if (fin)
+      finished_streams_.insert(id);
+    return quic::QuicConsumedData(write_length, fin);
+  }
+
+  std::set<quic::QuicStreamId> started_streams_;
+  std::set<quic::QuicStreamId> finished_streams_;
+};
+
+INSTANTIATE_TEST_SUITE_P(Version,
+                         QuicPrioritizedServerSessionTest,
+                         ::testing::ValuesIn(quic::AllSupportedVersions()),
+                         ::testing::PrintToStringParamName());
+
+TEST_P(QuicPrioritizedServerSessionTest, MoreUrgentResponseStartsFirst) {
+  quic::QuicStreamId large1 = SendRequest(0, kLargePath, "u=3");
+  EXPECT_TRUE(HasStarted(large1));
+  EXPECT_FALSE(HasFinished(large1));
+
+  // Waits for the response of equal urgency being written.
+  quic::QuicStreamId large2 = SendRequest(1, kLargePath, "u=3");
+  EXPECT_FALSE(HasStarted(large2));
+  EXPECT_EQ(1u, scheduler().num_ready_streams());
+
+  // Does not wait for less urgent responses.
+  quic::QuicStreamId urgent = SendRequest(2, kSmallPath, "u=0");
+  EXPECT_TRUE(HasFinished(urgent));
+  EXPECT_FALSE(HasStarted(large2));
+  EXPECT_EQ(1u, scheduler().num_writing_streams());
+}
+
+TEST_P(QuicPrioritizedServerSessionTest, IncrementalResponsesShareBandwidth) {
+  quic::QuicStreamId large1 = SendRequest(0, kLargePath, "u=3, i");
+  quic::QuicStreamId large2 = SendRequest(1, kLargePath, "u=3, i");
+  EXPECT_TRUE(HasStarted(large1));
+  EXPECT_TRUE(HasStarted(large2));
+  EXPECT_EQ(2u, scheduler().num_writing_streams());
+}
+
+TEST_P(QuicPrioritizedServerSessionTest, FlowControlStallHoldsEqualUrgency) {
+  // Stalls on stream flow control with the rest of its response buffered.
+  quic::QuicStreamId large = SendRequest(0, kLargePath, "");
+  quic::QuicStreamId small = SendRequest(1, kSmallPath, "");
+  EXPECT_TRUE(HasStarted(large));
+  EXPECT_FALSE(HasFinished(large));
+  EXPECT_FALSE(HasStarted(small));
+
+  UnblockStream(large);
+  EXPECT_TRUE(HasFinished(large));
+  EXPECT_TRUE(HasFinished(small));
+  EXPECT_EQ(0u, scheduler().num_ready_streams());
+  EXPECT_EQ(0u, scheduler().num_writing_streams());
+}
+
+TEST_P(QuicPrioritizedServerSessionTest, ResetWritingStreamStartsWaiting) {
+  quic::QuicStreamId large = SendRequest(0, kLargePath, "");
+  quic::QuicStreamId small1 = SendRequest(1, kSmallPath, "");
+  quic::QuicStreamId small2 = SendRequest(2, kSmallPath, "");
+  EXPECT_FALSE(HasStarted(small1));
+  EXPECT_FALSE(HasStarted(small2));
+
+  // Closing |large| starts |small1| from within its OnClose(). |small1|
+  // finishes and closes while the session is starting responses, which must
+  // not stop |small2| from starting next.
+  GetStream(large)->Reset(quic::QUIC_STREAM_CANCELLED);
+  EXPECT_TRUE(HasFinished(small1));
+  EXPECT_TRUE(HasFinished(small2));
+  EXPECT_FALSE(scheduler().IsRegistered(large));
+  EXPECT_FALSE(scheduler().IsRegistered(small1));
+  EXPECT_FALSE(scheduler().IsRegistered(small2));
+  EXPECT_EQ(0u, scheduler().num_writing_streams());
+}
+
+TEST_P(QuicPrioritizedServerSessionTest, PriorityUpdateBeforeRequest) {
+  if (!quic::VersionUsesHttp3(GetParam().transport_version))
+    return;
+  SendRequest(0, kLargePath, "");
+  quic::QuicStreamId id =
+      quic::test::GetNthClientInitiatedBidirectionalStreamId(
+          GetParam().transport_version, 1);
+  EXPECT_TRUE(session_->OnPriorityUpdateForRequestStream(id, 1));
+  EXPECT_EQ(1u, session_->num_pending_priority_updates());
+
+  SendRequest(1, kLargePath, "u=3");
+  EXPECT_EQ(1, scheduler().GetStreamPriority(id).urgency);
+  EXPECT_EQ(0u, session_->num_pending_priority_updates());
+}
+
+TEST_P(QuicPrioritizedServerSessionTest, StalePriorityUpdatesAreDropped) {
+  if (!quic::VersionUsesHttp3(GetParam().transport_version))
+    return;
+  const quic::QuicTransportVersion version = GetParam().transport_version;
+  quic::QuicStreamId done = SendRequest(0, kSmallPath, "");
+  ASSERT_TRUE(HasFinished(done));
+  session_->OnPriorityUpdateForRequestStream(done, 0);
+  EXPECT_EQ(0u, session_->num_pending_priority_updates());
+
+  // Only updates for streams the client may open next are kept, however many
+  // arrive.
+  const size_t max_streams =
+      session_->max_open_incoming_bidirectional_streams();
+  for (size_t n = 1; n <= 3 * max_streams; ++n) {
+    session_->OnPriorityUpdateForRequestStream(
+        quic::test::GetNthClientInitiatedBidirectionalStreamId(version, n), 0);
+  }
+  EXPECT_EQ(max_streams, session_->num_pending_priority_updates());
+
+  // Once a stream has come and gone, the next one may get an update.
+  SendRequest(1, kSmallPath, "");
+  EXPECT_EQ(max_streams - 1, session_->num_pending_priority_updates());
+  session_->OnPriorityUpdateForRequestStream(
+      quic::test::GetNthClientInitiatedBidirectionalStreamId(version,
+                                                             max_streams + 1),
+      0);
+  EXPECT_EQ(max_streams, session_->num_pending_priority_updates());
+}
+
+TEST_P(QuicPrioritizedServerSessionTest, BodyDigestsPassedToBackend) {
+  EnableBodyDigests();
+  // The body arrives in several frames, and is digested as it does. A value
+  // sent by the client is replaced.
+  spdy::SpdyHeaderBlock headers;
+  headers[kQuicBodyDigestHeader] = "sha-256=:AAAA:";
+  quic::QuicStreamId id =
+      SendPostRequest(0, headers, {"first chunk, ", "second chunk, ", "last"});
+  EXPECT_TRUE(HasFinished(id));
+  ASSERT_EQ(1, backend_.num_requests());
+  EXPECT_EQ("first chunk, second chunk, last", backend_.last_request_body());
+  auto it = backend_.last_request_headers().find(kQuicBodyDigestHeader);
+  ASSERT_TRUE(it != backend_.last_request_headers().end());
+  EXPECT_EQ(BodyDigests("first chunk, second chunk, last"), it->second);
+}
+
+TEST_P(QuicPrioritizedServerSessionTest, MatchingContentDigestIsAccepted) {
+  EnableBodyDigests();
+  spdy::SpdyHeaderBlock headers;
+  headers["content-digest"] = BodyDigests("body");
+  quic::QuicStreamId id = SendPostRequest(0, headers, {"bo", "dy"});
+  EXPECT_TRUE(HasFinished(id));
+  EXPECT_EQ(1, backend_.num_requests());
+}
+
+TEST_P(QuicPrioritizedServerSessionTest, ContentDigestMismatchIsRejected) {
+  EnableBodyDigests();
+  spdy::SpdyHeaderBlock headers;
+  headers["content-digest"] = BodyDigests("other body");
+  quic::QuicStreamId id = SendPostRequest(0, headers, {"bo", "dy"});
+  // The 400 is sent without asking the backend.
+  EXPECT_TRUE(HasFinished(id));
+  EXPECT_EQ(0, backend_.num_requests());
+}
+
+TEST_P(QuicPrioritizedServerSessionTest, MalformedContentDigestIsRejected) {
+  EnableBodyDigests();
+  spdy::SpdyHeaderBlock headers;
+  headers["content-digest"] = "sha-256=abc";
+  quic::QuicStreamId id = SendPostRequest(0, headers, {"body"});
+  EXPECT_TRUE(HasFinished(id));
+  EXPECT_EQ(0, backend_.num_requests());
+}
+
+TEST_P(QuicPrioritizedServerSessionTest, ClientBodyDigestHeaderIsStripped) {
+  // Without digests, the client still cannot pass digests off as the
+  // server's.
+  spdy::SpdyHeaderBlock headers;
+  headers[kQuicBodyDigestHeader] = BodyDigests("body");
+  quic::QuicStreamId id = SendPostRequest(0, headers, {"body"});
+  EXPECT_TRUE(HasFinished(id));
+  ASSERT_EQ(1, backend_.num_requests());
+  EXPECT_FALSE(backend_.last_request_headers().contains(kQuicBodyDigestHeader));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
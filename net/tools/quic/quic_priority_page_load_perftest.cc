@@ -0,0 +1,168 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Loads a page whose render-blocking stylesheet is requested after its
+// images, as happens when the stylesheet is discovered late, from a
+// QuicSimpleServer on loopback, and reports how long the stylesheet and the
+// whole page take with and without response prioritization.
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/timer/elapsed_timer.h"
+#include "net/base/ip_address.h"
+#include "net/base/ip_endpoint.h"
+#include "net/quic/address_utils.h"
+#include "net/test/test_with_task_environment.h"
+#include "net/third_party/quiche/src/quic/test_tools/crypto_test_utils.h"
+#include "net/third_party/quiche/src/quic/tools/quic_memory_cache_backend.h"
+#include "net/tools/quic/quic_simple_client.h"
+#include "net/tools/quic/quic_simple_server.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace net {
+namespace test {
+namespace {
+
+const char kHost[] = "test.example.com";
+const char kStylesheetPath[] = "/style.css";
+const size_t kStylesheetSize = 64 * 1024;
+const int kNumImages = 8;
+const size_t kImageSize = 512 * 1024;
+const int kNumRuns = 5;
+
+const char kMetricPrefix[] = "QuicPriorityPageLoad.";
+const char kMetricTimeToCriticalResource[] = "time_to_critical_resource";
+const char kMetricPageLoadTime[] = "page_load_time";
+
+perf_test::PerfResultReporter SetUpReporter(const std::string& story) {
+  perf_test::PerfResultReporter reporter(kMetricPrefix, story);
+  reporter.RegisterImportantMetric(kMetricTimeToCriticalResource, "ms");
+  reporter.RegisterImportantMetric(kMetricPageLoadTime, "ms");
+  return reporter;
+}
+
+std::string ImagePath(int i) {
+  return "/image" + base::NumberToString(i) + ".jpg";
+}
+
+// Records when the stylesheet and the last response complete.
+class PageLoadListener : public quic::QuicSpdyClientBase::ResponseListener {
+ public:
+  PageLoadListener(const base::ElapsedTimer* timer,
+                   base::TimeDelta* time_to_critical_resource,
+                   base::TimeDelta* page_load_time)
+      : timer_(timer),
+        time_to_critical_resource_(time_to_critical_resource),
+        page_load_time_(page_load_time) {}
+
+  void OnCompleteResponse(quic::QuicStreamId id,
+                          const spdy::SpdyHeaderBlock& response_headers,
+                          const std::string& response_body) override {
+    if (response_body.size() == kStylesheetSize)
+      *time_to_critical_resource_ = timer_->Elapsed();
+    *page_load_time_ = timer_->Elapsed();
+  }
+
+ private:
+  const base::ElapsedTimer* timer_;
+  base::TimeDelta* time_to_critical_resource_;
+  base::TimeDelta* page_load_time_;
+};
+
+class QuicPriorityPageLoadPerfTest : public TestWithTaskEnvironment {
+ protected:
+  QuicPriorityPageLoadPerfTest() {
+    AddResponse(kStylesheetPath, "text/css", kStylesheetSize);
+    for (int i = 0; i < kNumImages; ++i)
+      AddResponse(ImagePath(i), "image/jpeg", kImageSize);
+  }
+
+  void AddResponse(const std::string& path,
+                   const std::string& content_type,
+                   size_t size) {
+    spdy::SpdyHeaderBlock headers;
+    headers[":status"] = "200";
+    headers["content-type"] = content_type;
+    headers["content-length"] = base::NumberToString(size);
+    backend_.AddResponse(kHost, path, std::move(headers),
+                         std::string(size, 'x'));
+  }
+
+  void SendRequest(QuicSimpleClient* client,
+                   const std::string& path,
+                   const std::string& priority) {
+    spdy::SpdyHeaderBlock headers;
+    headers[":method"] = "GET";
+    headers[":scheme"] = "https";
+    headers[":authority"] = kHost;
+    headers[":path"] = path;
+    headers["priority"] = priority;
+    client->SendRequest(headers, "", /*fin=*/true);
+  }
+
+  void LoadPage(const std::string& story, bool prioritize_responses) {
+    QuicSimpleServer server(
+        quic::test::crypto_test_utils::ProofSourceForTesting(),
+        quic::QuicConfig(), quic::QuicCryptoServerConfig::ConfigOptions(),
+        quic::AllSupportedVersions(), &backend_);
+    server.set_prioritize_responses(prioritize_responses);
+    ASSERT_TRUE(server.Listen(IPEndPoint(IPAddress::IPv4Localhost(), 0)));
+
+    base::TimeDelta total_time_to_critical_resource;
+    base::TimeDelta total_page_load_time;
+    for (int run = 0; run < kNumRuns; ++run) {
+      QuicSimpleClient client(
+          ToQuicSocketAddress(server.server_address()),
+          quic::QuicServerId(kHost, server.server_address().port(), false),
+          quic::AllSupportedVersions(),
+          quic::test::crypto_test_utils::ProofVerifierForTesting());
+      ASSERT_TRUE(client.Initialize());
+      ASSERT_TRUE(client.Connect());
+
+      base::ElapsedTimer timer;
+      base::TimeDelta time_to_critical_resource;
+      base::TimeDelta page_load_time;
+      client.set_response_listener(std::make_unique<PageLoadListener>(
+          &timer, &time_to_critical_resource, &page_load_time));
+      // Images are low urgency and useful as they arrive; the stylesheet
+      // blocks rendering.
+      for (int i = 0; i < kNumImages; ++i)
+        SendRequest(&client, ImagePath(i), "u=5, i");
+      SendRequest(&client, kStylesheetPath, "u=0");
+      while (client.WaitForEvents()) {
+      }
+      ASSERT_FALSE(time_to_critical_resource.is_zero());
+
+      total_time_to_critical_resource += time_to_critical_resource;
+      total_page_load_time += page_load_time;
+      client.Disconnect();
+    }
+    server.Shutdown();
+
+    perf_test::PerfResultReporter reporter = SetUpReporter(story);
+    reporter.AddResult(
+        kMetricTimeToCriticalResource,
+        total_time_to_critical_resource.InMillisecondsF() / kNumRuns);
+    reporter.AddResult(kMetricPageLoadTime,
+                       total_page_load_time.InMillisecondsF() / kNumRuns);
+  }
+
+  quic::QuicMemoryCacheBackend backend_;
+};
+
+TEST_F(QuicPriorityPageLoadPerfTest, Unprioritized) {
+  LoadPage("unprioritized", /*prioritize_responses=*/false);
+}
+
+TEST_F(QuicPriorityPageLoadPerfTest, Prioritized) {
+  LoadPage("prioritized", /*prioritize_responses=*/true);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
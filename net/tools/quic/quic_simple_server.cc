@@ -6,6 +6,8 @@
 
 #include <string.h>
 
+#include <utility>
+
 #include "base/bind.h"
 #include "base/location.h"
 #include "base/run_loop.h"
@@ -16,15 +18,21 @@
 #include "net/log/net_log_source.h"
 #include "net/quic/address_utils.h"
 #include "net/socket/udp_server_socket.h"
+#include "net/third_party/quiche/src/common/platform/api/quiche_string_piece.h"
 #include "net/third_party/quiche/src/quic/core/crypto/crypto_handshake.h"
 #include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/core/quic_connection.h"
 #include "net/third_party/quiche/src/quic/core/quic_crypto_stream.h"
 #include "net/third_party/quiche/src/quic/core/quic_data_reader.h"
 #include "net/third_party/quiche/src/quic/core/quic_packets.h"
-#include "net/third_party/quiche/src/quic/tools/quic_simple_dispatcher.h"
+#include "net/tools/quic/quic_admission_dispatcher.h"
+#include "net/tools/quic/quic_compact_time_wait_list.h"
+#include "net/tools/quic/quic_digesting_server_session.h"
+#include "net/tools/quic/quic_prioritized_server_session.h"
 #include "net/tools/quic/quic_simple_server_packet_writer.h"
 #include "net/tools/quic/quic_simple_server_session_helper.h"
 #include "net/tools/quic/quic_simple_server_socket.h"
+#include "net/tools/quic/quic_stateless_packet_cache.h"
 
 namespace net {
 
@@ -37,6 +45,130 @@ const size_t kNumSessionsToCreatePerSocketEvent = 16;
 // the limit.
 const int kReadBufferSize = 2 * quic::kMaxIncomingPacketSize;
 
+// Optionally replaces client-chosen connection IDs with ones that encode
+// this server's QUIC-LB server ID, creates sessions that write responses by
+// priority and digest request bodies, keeps closed connections in a compact
+// time-wait list, sends stateless responses from pre-serialized templates,
+// and rate limits new connections.
+class ServerDispatcher : public QuicAdmissionDispatcher {
+ public:
+  ServerDispatcher(
+      const quic::QuicConfig* config,
+      const quic::QuicCryptoServerConfig* crypto_config,
+      quic::QuicVersionManager* version_manager,
+      std::unique_ptr<quic::QuicConnectionHelperInterface> helper,
+      std::unique_ptr<quic::QuicCryptoServerStreamBase::Helper> session_helper,
+      std::unique_ptr<quic::QuicAlarmFactory> alarm_factory,
+      quic::QuicSimpleServerBackend* quic_simple_server_backend,
+      std::unique_ptr<QuicLbConnectionIdCodec> lb_codec,
+      bool prioritize_responses,
+      QuicBodyDigesterFactory body_digester_factory,
+      bool compact_time_wait_list,
+      const base::Optional<QuicStatelessResponseRateLimit>&
+          stateless_response_rate_limit,
+      QuicAdmissionController* admission_controller)
+      : QuicAdmissionDispatcher(
+            config,
+            crypto_config,
+            version_manager,
+            std::move(helper),
+            std::move(session_helper),
+            std::move(alarm_factory),
+            quic_simple_server_backend,
+            lb_codec ? lb_codec->connection_id_length()
+                     : quic::kQuicDefaultConnectionIdLength,
+            compact_time_wait_list,
+            admission_controller),
+        lb_codec_(std::move(lb_codec)),
+        prioritize_responses_(prioritize_responses),
+        body_digester_factory_(std::move(body_digester_factory)),
+        stateless_response_rate_limit_(stateless_response_rate_limit) {}
+
+  void ProcessPacket(const quic::QuicSocketAddress& self_address,
+                     const quic::QuicSocketAddress& peer_address,
+                     const quic::QuicReceivedPacket& packet) override {
+    current_packet_length_ = packet.length();
+    QuicAdmissionDispatcher::ProcessPacket(self_address, peer_address, packet);
+  }
+
+  quic::QuicConnectionId GenerateNewServerConnectionId(
+      quic::ParsedQuicVersion version,
+      quic::QuicConnectionId connection_id) const override {
+    if (!lb_codec_) {
+      return QuicAdmissionDispatcher::GenerateNewServerConnectionId(
+          version, connection_id);
+    }
+    return lb_codec_->GenerateConnectionId(quic::QuicRandom::GetInstance());
+  }
+
+ protected:
+  quic::QuicTimeWaitListManager* CreateQuicTimeWaitListManager() override {
+    if (stateless_response_rate_limit_) {
+      // QuicSimpleServer::Listen() initializes this dispatcher with a
+      // QuicSimpleServerPacketWriter.
+      auto* writer = static_cast<QuicSimpleServerPacketWriter*>(this->writer());
+      if (compact_time_wait_list()) {
+        return new QuicCachedStatelessResponses<
+            QuicCompactTimeWaitListManager>(
+            writer, this, helper()->GetClock(), alarm_factory(),
+            helper()->GetRandomGenerator(), *stateless_response_rate_limit_);
+      }
+      return new QuicCachedStatelessResponses<quic::QuicTimeWaitListManager>(
+          writer, this, helper()->GetClock(), alarm_factory(),
+          helper()->GetRandomGenerator(), *stateless_response_rate_limit_);
+    }
+    return QuicAdmissionDispatcher::CreateQuicTimeWaitListManager();
+  }
+
+  // Lets QuicCachedStatelessResponses size stateless resets from the packets
+  // that trigger them.
+  std::unique_ptr<quic::QuicPerPacketContext> GetPerPacketContext()
+      const override {
+    if (!stateless_response_rate_limit_)
+      return QuicAdmissionDispatcher::GetPerPacketContext();
+    return std::make_unique<QuicStatelessResponseContext>(
+        current_packet_length_);
+  }
+
+  std::unique_ptr<quic::QuicSession> CreateQuicSession(
+      quic::QuicConnectionId connection_id,
+      const quic::QuicSocketAddress& client_address,
+      quiche::QuicheStringPiece alpn,
+      const quic::ParsedQuicVersion& version) override {
+    // The session takes ownership of |connection|.
+    quic::QuicConnection* connection = new quic::QuicConnection(
+        connection_id, client_address, helper(), alarm_factory(), writer(),
+        /*owns_writer=*/false, quic::Perspective::IS_SERVER,
+        quic::ParsedQuicVersionVector{version});
+    // Every session strips the client's body digest header, so it is created
+    // here whether or not responses are prioritized.
+    std::unique_ptr<QuicDigestingServerSession> session;
+    if (prioritize_responses_) {
+      session = std::make_unique<QuicPrioritizedServerSession>(
+          TakeSessionConfig(connection_id, version), GetSupportedVersions(),
+          connection, this, session_helper(), crypto_config(),
+          compressed_certs_cache(), server_backend());
+    } else {
+      session = std::make_unique<QuicDigestingServerSession>(
+          TakeSessionConfig(connection_id, version), GetSupportedVersions(),
+          connection, this, session_helper(), crypto_config(),
+          compressed_certs_cache(), server_backend());
+    }
+    session->set_body_digester_factory(body_digester_factory_);
+    session->Initialize();
+    return session;
+  }
+
+ private:
+  std::unique_ptr<QuicLbConnectionIdCodec> lb_codec_;
+  const bool prioritize_responses_;
+  const QuicBodyDigesterFactory body_digester_factory_;
+  const base::Optional<QuicStatelessResponseRateLimit>
+      stateless_response_rate_limit_;
+  // Length of the packet being processed.
+  size_t current_packet_length_ = 0;
+};
+
 }  // namespace
 
 QuicSimpleServer::QuicSimpleServer(
@@ -60,6 +192,8 @@ QuicSimpleServer::QuicSimpleServer(
                      quic::KeyExchangeSource::Default()),
       read_pending_(false),
       synchronous_read_count_(0),
+      prioritize_responses_(false),
+      compact_time_wait_list_(false),
       read_buffer_(base::MakeRefCounted<IOBufferWithSize>(kReadBufferSize)),
       quic_simple_server_backend_(quic_simple_server_backend) {
   DCHECK(quic_simple_server_backend);
@@ -104,17 +238,20 @@ void QuicSimpleServer::HandleEventsForever() {
 }
 
 bool QuicSimpleServer::Listen(const IPEndPoint& address) {
-  socket_ = CreateQuicSimpleServerSocket(address, &server_address_);
+  socket_ = CreateQuicSimpleServerSocket(address, &server_address_,
+                                         /*share_port=*/false);
   if (socket_ == nullptr)
     return false;
 
-  dispatcher_.reset(new quic::QuicSimpleDispatcher(
+  dispatcher_.reset(new ServerDispatcher(
       &config_, &crypto_config_, &version_manager_,
       std::unique_ptr<quic::QuicConnectionHelperInterface>(helper_),
       std::unique_ptr<quic::QuicCryptoServerStreamBase::Helper>(
           new QuicSimpleServerSessionHelper(quic::QuicRandom::GetInstance())),
       std::unique_ptr<quic::QuicAlarmFactory>(alarm_factory_),
-      quic_simple_server_backend_, quic::kQuicDefaultConnectionIdLength));
+      quic_simple_server_backend_, std::move(lb_codec_),
+      prioritize_responses_, body_digester_factory_, compact_time_wait_list_,
+      stateless_response_rate_limit_, admission_controller_.get()));
   QuicSimpleServerPacketWriter* writer =
       new QuicSimpleServerPacketWriter(socket_.get(), dispatcher_.get());
   dispatcher_->InitializeWithWriter(writer);
@@ -124,8 +261,49 @@ bool QuicSimpleServer::Listen(const IPEndPoint& address) {
   return true;
 }
 
+bool QuicSimpleServer::SetLoadBalancerConfig(const QuicLbConfig& config) {
+  DCHECK(!dispatcher_);
+  std::unique_ptr<QuicLbConnectionIdCodec> lb_codec =
+      QuicLbConnectionIdCodec::Create(config);
+  if (!lb_codec || config.server_id.empty())
+    return false;
+  // The dispatcher only replaces a client-chosen connection ID if its length
+  // differs from the length it expects, and clients pick
+  // kQuicDefaultConnectionIdLength bytes. Issuing IDs of that length would
+  // leave their connections on unroutable IDs.
+  if (lb_codec->connection_id_length() == quic::kQuicDefaultConnectionIdLength)
+    return false;
+  lb_codec_ = std::move(lb_codec);
+  return true;
+}
+
+void QuicSimpleServer::EnableAdmissionControl(
+    const QuicAdmissionController::Params& params) {
+  DCHECK(!dispatcher_);
+  admission_controller_ =
+      std::make_unique<QuicAdmissionController>(params, &clock_);
+}
+
+void QuicSimpleServer::EnableCachedStatelessResponses(
+    const QuicStatelessResponseRateLimit& rate_limit) {
+  DCHECK(!dispatcher_);
+  stateless_response_rate_limit_ = rate_limit;
+}
+
 void QuicSimpleServer::Shutdown() {
   LOG(WARNING) << "QuicSimpleServer is shutting down";
+  if (admission_controller_ && admission_controller_->num_rejected() > 0) {
+    // Listen() creates a ServerDispatcher.
+    auto* dispatcher =
+        static_cast<QuicAdmissionDispatcher*>(dispatcher_.get());
+    LOG(WARNING) << "Rejected " << admission_controller_->num_rejected()
+                 << " client hellos: sent "
+                 << dispatcher->num_retries_sent() << " retries, of which "
+                 << dispatcher->num_retries_validated()
+                 << " were completed, and dropped " << dispatcher->num_dropped()
+                 << ". Top talkers: "
+                 << admission_controller_->TopTalkersToValue();
+  }
   // Before we shut down the epoll server, give all active sessions a chance to
   // notify clients that they're closing.
   dispatcher_->Shutdown();
@@ -9,8 +9,10 @@
 #define NET_TOOLS_QUIC_QUIC_SIMPLE_SERVER_H_
 
 #include <memory>
+#include <utility>
 
 #include "base/macros.h"
+#include "base/optional.h"
 #include "net/base/io_buffer.h"
 #include "net/base/ip_endpoint.h"
 #include "net/quic/platform/impl/quic_chromium_clock.h"
@@ -21,6 +23,10 @@
 #include "net/third_party/quiche/src/quic/core/quic_version_manager.h"
 #include "net/third_party/quiche/src/quic/tools/quic_simple_server_backend.h"
 #include "net/third_party/quiche/src/quic/tools/quic_spdy_server_base.h"
+#include "net/tools/quic/quic_admission_controller.h"
+#include "net/tools/quic/quic_body_digester.h"
+#include "net/tools/quic/quic_lb_connection_id.h"
+#include "net/tools/quic/quic_stateless_packet_cache.h"
 
 namespace net {
 
@@ -55,6 +61,43 @@ class QuicSimpleServer : public quic::QuicSpdyServerBase {
   // Start listening on the specified address. Returns true on success.
   bool Listen(const IPEndPoint& address);
 
+  // Makes the connection IDs this server issues routable by QUIC-LB load
+  // balancers sharing |config|. Must be called before Listen(). Returns false
+  // if |config| is not valid, or if its connection IDs have the length
+  // clients choose, which the dispatcher would not replace.
+  bool SetLoadBalancerConfig(const QuicLbConfig& config);
+
+  // Rate limits new connections per source prefix before their session is
+  // created. Over-budget IETF clients are sent a RETRY, and over-budget Google
+  // QUIC client hellos are dropped. Must be called before Listen().
+  void EnableAdmissionControl(const QuicAdmissionController::Params& params);
+
+  // Sends IETF version negotiation packets and stateless resets from
+  // pre-serialized templates, without copying them, and at most at the rate
+  // |rate_limit| allows per source prefix. Must be called before Listen().
+  void EnableCachedStatelessResponses(
+      const QuicStatelessResponseRateLimit& rate_limit);
+
+  // Whether responses are written according to their RFC 9218 priority.
+  // Defaults to false. Must be called before Listen().
+  void set_prioritize_responses(bool prioritize_responses) {
+    prioritize_responses_ = prioritize_responses;
+  }
+
+  // Digests request bodies with the digesters |factory| creates, and passes
+  // the digests to the backend in the kQuicBodyDigestHeader request header,
+  // whether or not responses are prioritized. Must be called before Listen().
+  void set_body_digester_factory(QuicBodyDigesterFactory factory) {
+    body_digester_factory_ = std::move(factory);
+  }
+
+  // Whether connections that only need a stateless reset are kept in a
+  // QuicCompactTimeWaitList once closed. Defaults to false. Must be called
+  // before Listen().
+  void set_compact_time_wait_list(bool compact_time_wait_list) {
+    compact_time_wait_list_ = compact_time_wait_list;
+  }
+
   // Server deletion is imminent. Start cleaning up.
   void Shutdown();
 
@@ -70,6 +113,10 @@ class QuicSimpleServer : public quic::QuicSpdyServerBase {
 
   IPEndPoint server_address() const { return server_address_; }
 
+  QuicAdmissionController* admission_controller() {
+    return admission_controller_.get();
+  }
+
  private:
   friend class test::QuicSimpleServerPeer;
 
@@ -121,6 +168,23 @@ class QuicSimpleServer : public quic::QuicSpdyServerBase {
 
   quic::QuicSimpleServerBackend* quic_simple_server_backend_;
 
+  bool prioritize_responses_;
+
+  // Creates the digesters of each request body, if set.
+  QuicBodyDigesterFactory body_digester_factory_;
+
+  bool compact_time_wait_list_;
+
+  // Rate limit of stateless responses, if they are sent from templates.
+  base::Optional<QuicStatelessResponseRateLimit>
+      stateless_response_rate_limit_;
+
+  // Decides which client hellos to process, if set.
+  std::unique_ptr<QuicAdmissionController> admission_controller_;
+
+  // Generates load-balancer-routable connection IDs, if set.
+  std::unique_ptr<QuicLbConnectionIdCodec> lb_codec_;
+
   base::WeakPtrFactory<QuicSimpleServer> weak_factory_{this};
 
   DISALLOW_COPY_AND_ASSIGN(QuicSimpleServer);
@@ -3,7 +3,17 @@
 // found in the LICENSE file.
 
 #include "net/tools/quic/quic_simple_server_backend_factory.h"
+
+#include <string>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/macros.h"
 #include "net/third_party/quiche/src/quic/platform/api/quic_flags.h"
+#include "net/third_party/quiche/src/quic/tools/quic_backend_response.h"
+#include "net/third_party/quiche/src/quic/tools/quic_memory_cache_backend.h"
+#include "net/tools/quic/quic_async_server_backend.h"
+#include "net/tools/quic/quic_compressed_cache_backend.h"
 #include "net/tools/quic/quic_http_proxy_backend_stream.h"
 
 DEFINE_QUIC_COMMAND_LINE_FLAG(
@@ -20,13 +30,98 @@ DEFINE_QUIC_COMMAND_LINE_FLAG(
     "URL with http/https, IP address or host name and the port number of the "
     "backend server.");
 
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    bool,
+    quic_compress_responses,
+    false,
+    "In cache mode, serve gzip and brotli variants of compressible responses "
+    "to clients that accept them.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    bool,
+    quic_async_backend,
+    false,
+    "In cache mode, look responses up on the thread pool, through a "
+    "QuicAsyncServerBackend, rather than on the QUIC thread. Cannot be "
+    "combined with --quic_compress_responses.");
+
 namespace net {
 
+namespace {
+
+// Returns a copy of the response |cache| holds for the request, or null if
+// there is none. Runs on the thread pool; the cache locks its responses.
+std::unique_ptr<quic::QuicBackendResponse> CopyCachedResponse(
+    quic::QuicMemoryCacheBackend* cache,
+    const spdy::SpdyHeaderBlock& request_headers,
+    const std::string& request_body) {
+  auto authority = request_headers.find(":authority");
+  auto path = request_headers.find(":path");
+  if (authority == request_headers.end() || path == request_headers.end())
+    return nullptr;
+  const quic::QuicBackendResponse* cached =
+      cache->GetResponse(authority->second, path->second);
+  if (!cached)
+    return nullptr;
+  auto response = std::make_unique<quic::QuicBackendResponse>();
+  response->set_response_type(cached->response_type());
+  response->set_headers(cached->headers().Clone());
+  response->set_body(cached->body());
+  response->set_trailers(cached->trailers().Clone());
+  return response;
+}
+
+// Serves a QuicMemoryCacheBackend from the thread pool.
+class AsyncCacheBackend : public QuicAsyncServerBackend {
+ public:
+  // The handler owns |cache|, so that it outlives handlers still running on
+  // workers when the backend is destroyed.
+  explicit AsyncCacheBackend(
+      std::unique_ptr<quic::QuicMemoryCacheBackend> cache)
+      : AsyncCacheBackend(cache.release()) {}
+
+  bool InitializeBackend(const std::string& cache_directory) override {
+    return cache_->InitializeBackend(cache_directory);
+  }
+  bool IsBackendInitialized() const override {
+    return cache_->IsBackendInitialized();
+  }
+
+ private:
+  explicit AsyncCacheBackend(quic::QuicMemoryCacheBackend* cache)
+      : QuicAsyncServerBackend(
+            "MemoryCache",
+            base::BindRepeating(&CopyCachedResponse, base::Owned(cache))),
+        cache_(cache) {}
+
+  quic::QuicMemoryCacheBackend* const cache_;  // Owned by the handler.
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncCacheBackend);
+};
+
+}  // namespace
+
 std::unique_ptr<quic::QuicSimpleServerBackend>
 QuicSimpleServerBackendFactory::CreateBackend() {
   if (GetQuicFlag(FLAGS_quic_mode) == "cache") {
     quic::QuicToyServer::MemoryCacheBackendFactory backend_factory;
-    return backend_factory.CreateBackend();
+    std::unique_ptr<quic::QuicSimpleServerBackend> backend =
+        backend_factory.CreateBackend();
+    const bool compress = GetQuicFlag(FLAGS_quic_compress_responses);
+    const bool async = GetQuicFlag(FLAGS_quic_async_backend);
+    if (compress && async) {
+      LOG(ERROR) << "--quic_compress_responses and --quic_async_backend "
+                    "cannot be combined";
+      return nullptr;
+    }
+    if (!compress && !async)
+      return backend;
+    // MemoryCacheBackendFactory always creates a QuicMemoryCacheBackend.
+    std::unique_ptr<quic::QuicMemoryCacheBackend> cache(
+        static_cast<quic::QuicMemoryCacheBackend*>(backend.release()));
+    if (async)
+      return std::make_unique<AsyncCacheBackend>(std::move(cache));
+    return std::make_unique<QuicCompressedCacheBackend>(std::move(cache));
   }
 
   if (GetQuicFlag(FLAGS_quic_mode) != "proxy") {
@@ -10,7 +10,10 @@
 namespace net {
 
 // A factory for creating either QuicMemoryCacheBackend or QuicHttpProxyBackend
-// instances.
+// instances. In cache mode, the cache may be served through a
+// QuicCompressedCacheBackend, or through a QuicAsyncServerBackend which looks
+// responses up on the thread pool. Other QuicAsyncServerBackend handlers are
+// created directly by their embedder.
 class QuicSimpleServerBackendFactory
     : public quic::QuicToyServer::BackendFactory {
  public:
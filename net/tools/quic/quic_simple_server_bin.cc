@@ -7,24 +7,181 @@
 
 #include <vector>
 
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "net/third_party/quiche/src/quic/core/quic_constants.h"
 #include "net/third_party/quiche/src/quic/core/quic_versions.h"
 #include "net/third_party/quiche/src/quic/platform/api/quic_flags.h"
 #include "net/third_party/quiche/src/quic/platform/api/quic_ptr_util.h"
 #include "net/third_party/quiche/src/quic/platform/api/quic_system_event_loop.h"
 #include "net/third_party/quiche/src/quic/tools/quic_simple_server_backend.h"
 #include "net/third_party/quiche/src/quic/tools/quic_toy_server.h"
+#include "net/tools/quic/quic_body_digester.h"
 #include "net/tools/quic/quic_simple_server.h"
 #include "net/tools/quic/quic_simple_server_backend_factory.h"
 
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    quic_lb_server_id,
+    "",
+    "Hex-encoded QUIC-LB server ID. If set, issued connection IDs can be "
+    "routed to this server by QUIC-LB load balancers.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(int32_t,
+                              quic_lb_config_id,
+                              0,
+                              "QUIC-LB config rotation codepoint, 0-2.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    quic_lb_key,
+    "",
+    "Hex-encoded 16-byte QUIC-LB key. If set, server IDs are encrypted with "
+    "the stream cipher algorithm; otherwise they are sent in plaintext.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(int32_t,
+                              quic_lb_nonce_length,
+                              8,
+                              "Length of the QUIC-LB stream cipher nonce.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    quic_lb_connection_id_length,
+    0,
+    "Length of QUIC-LB connection IDs. If 0, the shortest length that holds "
+    "the server ID is used. Must not be 8, the length clients choose, as "
+    "client-chosen IDs are only replaced if their length differs.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    max_chlos_per_second_per_prefix,
+    0,
+    "If positive, client hellos are rate limited to this many per second "
+    "per /24 (IPv4) or /48 (IPv6) source prefix.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    bool,
+    quic_prioritize_responses,
+    false,
+    "If true, responses are written according to the RFC 9218 priority "
+    "of their request, from its priority header and PRIORITY_UPDATE frames.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    quic_body_digests,
+    "",
+    "Comma-separated digest algorithms, \"sha-256\" or \"crc32c\", of "
+    "request bodies to pass to the backend in the x-quic-body-digest "
+    "header.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    bool,
+    quic_compact_time_wait_list,
+    false,
+    "If true, closed connections that only need a stateless reset are kept "
+    "as connection ID fingerprints, and resets are built on demand.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    max_stateless_responses_per_second_per_prefix,
+    0,
+    "If positive, version negotiation packets and stateless resets are sent "
+    "from pre-serialized templates, at most this many per second per /24 "
+    "(IPv4) or /48 (IPv6) source prefix.");
+
+namespace {
+
+// Returns false if the QUIC-LB flags are not valid.
+bool GetLoadBalancerConfig(net::QuicLbConfig* config) {
+  std::vector<uint8_t> server_id;
+  if (!base::HexStringToBytes(GetQuicFlag(FLAGS_quic_lb_server_id),
+                              &server_id)) {
+    return false;
+  }
+  config->server_id.assign(server_id.begin(), server_id.end());
+  config->server_id_length = server_id.size();
+  int32_t config_id = GetQuicFlag(FLAGS_quic_lb_config_id);
+  if (config_id < 0 || config_id >= net::kQuicLbUnroutableConfigId)
+    return false;
+  config->config_id = config_id;
+  size_t min_length = 1 + server_id.size();
+
+  std::string key_hex = GetQuicFlag(FLAGS_quic_lb_key);
+  if (!key_hex.empty()) {
+    std::vector<uint8_t> key;
+    if (!base::HexStringToBytes(key_hex, &key))
+      return false;
+    config->mode = net::QuicLbConfig::STREAM_CIPHER;
+    config->key.assign(key.begin(), key.end());
+    config->nonce_length = GetQuicFlag(FLAGS_quic_lb_nonce_length);
+    min_length += config->nonce_length;
+  }
+  int32_t length = GetQuicFlag(FLAGS_quic_lb_connection_id_length);
+  if (length <= 0) {
+    // Skip the length clients choose, so that their IDs are always replaced.
+    length = min_length;
+    if (length == quic::kQuicDefaultConnectionIdLength)
+      ++length;
+  }
+  if (length > quic::kQuicMaxConnectionIdWithLengthPrefixLength)
+    return false;
+  config->connection_id_length = length;
+  return true;
+}
+
+}  // namespace
+
 class QuicSimpleServerFactory : public quic::QuicToyServer::ServerFactory {
   std::unique_ptr<quic::QuicSpdyServerBase> CreateServer(
       quic::QuicSimpleServerBackend* backend,
       std::unique_ptr<quic::ProofSource> proof_source,
       const quic::ParsedQuicVersionVector& supported_versions) override {
-    return std::make_unique<net::QuicSimpleServer>(
+    auto server = std::make_unique<net::QuicSimpleServer>(
         std::move(proof_source), config_,
         quic::QuicCryptoServerConfig::ConfigOptions(), supported_versions,
         backend);
+    server->set_prioritize_responses(
+        GetQuicFlag(FLAGS_quic_prioritize_responses));
+    std::vector<std::string> body_digests =
+        base::SplitString(GetQuicFlag(FLAGS_quic_body_digests), ",",
+                          base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+    if (!body_digests.empty()) {
+      for (const std::string& algorithm : body_digests) {
+        if (!net::CreateQuicBodyDigester(algorithm)) {
+          LOG(ERROR) << "Unsupported body digest algorithm: " << algorithm;
+          exit(1);
+        }
+      }
+      server->set_body_digester_factory(
+          net::CreateQuicBodyDigesterFactory(body_digests));
+    }
+    server->set_compact_time_wait_list(
+        GetQuicFlag(FLAGS_quic_compact_time_wait_list));
+    int32_t max_chlos = GetQuicFlag(FLAGS_max_chlos_per_second_per_prefix);
+    if (max_chlos > 0) {
+      net::QuicAdmissionController::Params params;
+      params.chlos_per_second = max_chlos;
+      params.burst = 2 * max_chlos;
+      server->EnableAdmissionControl(params);
+    }
+    int32_t max_stateless_responses =
+        GetQuicFlag(FLAGS_max_stateless_responses_per_second_per_prefix);
+    if (max_stateless_responses > 0) {
+      net::QuicStatelessResponseRateLimit rate_limit;
+      rate_limit.responses_per_second = max_stateless_responses;
+      rate_limit.burst = 2 * max_stateless_responses;
+      server->EnableCachedStatelessResponses(rate_limit);
+    }
+    if (!GetQuicFlag(FLAGS_quic_lb_server_id).empty()) {
+      net::QuicLbConfig lb_config;
+      if (!GetLoadBalancerConfig(&lb_config) ||
+          !server->SetLoadBalancerConfig(lb_config)) {
+        LOG(ERROR) << "Invalid QUIC-LB configuration";
+        exit(1);
+      }
+    }
+    return server;
   }
 
  private:
@@ -50,13 +50,20 @@ quic::WriteResult QuicSimpleServerPacketWriter::WritePacket(
     const quic::QuicIpAddress& self_address,
     const quic::QuicSocketAddress& peer_address,
     quic::PerPacketOptions* options) {
-  scoped_refptr<StringIOBuffer> buf =
-      base::MakeRefCounted<StringIOBuffer>(std::string(buffer, buf_len));
+  return WritePacketBuffer(
+      base::MakeRefCounted<StringIOBuffer>(std::string(buffer, buf_len)),
+      buf_len, peer_address);
+}
+
+quic::WriteResult QuicSimpleServerPacketWriter::WritePacketBuffer(
+    scoped_refptr<IOBuffer> buffer,
+    size_t buf_len,
+    const quic::QuicSocketAddress& peer_address) {
   DCHECK(!IsWriteBlocked());
   int rv;
   if (buf_len <= static_cast<size_t>(std::numeric_limits<int>::max())) {
     rv = socket_->SendTo(
-        buf.get(), static_cast<int>(buf_len), ToIPEndPoint(peer_address),
+        buffer.get(), static_cast<int>(buf_len), ToIPEndPoint(peer_address),
         base::BindOnce(&QuicSimpleServerPacketWriter::OnWriteComplete,
                        weak_factory_.GetWeakPtr()));
   } else {
@@ -9,6 +9,7 @@
 
 #include "base/callback.h"
 #include "base/macros.h"
+#include "base/memory/scoped_refptr.h"
 #include "base/memory/weak_ptr.h"
 #include "net/third_party/quiche/src/quic/core/quic_connection.h"
 #include "net/third_party/quiche/src/quic/core/quic_packet_writer.h"
@@ -18,6 +19,7 @@ namespace quic {
 class QuicDispatcher;
 }  // namespace quic
 namespace net {
+class IOBuffer;
 class UDPServerSocket;
 }  // namespace net
 namespace quic {
@@ -41,6 +43,13 @@ class QuicSimpleServerPacketWriter : public quic::QuicPacketWriter {
                                 const quic::QuicSocketAddress& peer_address,
                                 quic::PerPacketOptions* options) override;
 
+  // Writes the first |buf_len| bytes of |buffer| without copying them.
+  // Virtual for testing.
+  virtual quic::WriteResult WritePacketBuffer(
+      scoped_refptr<IOBuffer> buffer,
+      size_t buf_len,
+      const quic::QuicSocketAddress& peer_address);
+
   void OnWriteComplete(int rv);
 
   // quic::QuicPacketWriter implementation:
@@ -12,11 +12,16 @@ namespace net {
 
 std::unique_ptr<UDPServerSocket> CreateQuicSimpleServerSocket(
     const IPEndPoint& address,
-    IPEndPoint* server_address) {
+    IPEndPoint* server_address,
+    bool share_port) {
   auto socket =
       std::make_unique<UDPServerSocket>(/*net_log=*/nullptr, NetLogSource());
 
   socket->AllowAddressReuse();
+  // Despite its name, this sets SO_REUSEPORT where it exists, which is what
+  // lets the kernel balance unicast flows between the sockets.
+  if (share_port)
+    socket->AllowAddressSharingForMulticast();
 
   int rc = socket->Listen(address);
   if (rc < 0) {
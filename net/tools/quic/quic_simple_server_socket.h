@@ -10,10 +10,13 @@
 
 namespace net {
 
-// Creates a UDP server socket tuned for use in a QUIC server.
+// Creates a UDP server socket tuned for use in a QUIC server. If
+// |share_port| is true, several such sockets can listen on the same port,
+// with the kernel spreading flows across them.
 std::unique_ptr<UDPServerSocket> CreateQuicSimpleServerSocket(
     const IPEndPoint& address,
-    IPEndPoint* server_address);
+    IPEndPoint* server_address,
+    bool share_port);
 
 }  // namespace net
 
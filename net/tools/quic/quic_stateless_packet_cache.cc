@@ -0,0 +1,134 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_stateless_packet_cache.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/core/quic_constants.h"
+
+namespace net {
+
+namespace {
+
+// Buffers kept for reuse. Stateless packets are written one at a time, so
+// more are only needed while writes complete asynchronously.
+const size_t kMaxPooledBuffers = 8;
+
+const uint8_t kLongHeaderBit = 0x80;
+const uint8_t kFixedBit = 0x40;
+// Version negotiation packets carry version 0.
+const size_t kVersionLength = 4;
+
+void AppendVersionLabel(quic::QuicVersionLabel label, std::string* out) {
+  out->push_back(static_cast<char>(label >> 24));
+  out->push_back(static_cast<char>(label >> 16));
+  out->push_back(static_cast<char>(label >> 8));
+  out->push_back(static_cast<char>(label));
+}
+
+char* AppendConnectionId(quic::QuicConnectionId connection_id, char* out) {
+  *out++ = static_cast<char>(connection_id.length());
+  memcpy(out, connection_id.data(), connection_id.length());
+  return out + connection_id.length();
+}
+
+}  // namespace
+
+QuicAdmissionController::Params
+QuicStatelessResponseRateLimit::ToAdmissionControllerParams() const {
+  QuicAdmissionController::Params params;
+  params.chlos_per_second = responses_per_second;
+  params.burst = burst;
+  return params;
+}
+
+const size_t QuicStatelessPacketCache::kMinStatelessResetLength;
+const size_t QuicStatelessPacketCache::kMaxStatelessResetLength;
+
+QuicStatelessPacketCache::QuicStatelessPacketCache(quic::QuicRandom* random)
+    : random_(random), num_buffers_allocated_(0) {}
+
+QuicStatelessPacketCache::~QuicStatelessPacketCache() = default;
+
+scoped_refptr<IOBuffer> QuicStatelessPacketCache::BuildVersionNegotiationPacket(
+    quic::QuicConnectionId server_connection_id,
+    quic::QuicConnectionId client_connection_id,
+    const quic::ParsedQuicVersionVector& supported_versions,
+    size_t* length) {
+  if (supported_versions != versions_)
+    UpdateVersionsTemplate(supported_versions);
+
+  scoped_refptr<IOBufferWithSize> buffer = GetBuffer();
+  char* out = buffer->data();
+  uint8_t first_byte;
+  random_->InsecureRandBytes(&first_byte, sizeof(first_byte));
+  *out++ = static_cast<char>(first_byte | kLongHeaderBit);
+  memset(out, 0, kVersionLength);
+  out += kVersionLength;
+  // The packet goes back to the client, so the connection IDs swap roles.
+  out = AppendConnectionId(client_connection_id, out);
+  out = AppendConnectionId(server_connection_id, out);
+  memcpy(out, versions_template_.data(), versions_template_.size());
+  out += versions_template_.size();
+  *length = out - buffer->data();
+  DCHECK_LE(*length, static_cast<size_t>(buffer->size()));
+  return buffer;
+}
+
+scoped_refptr<IOBuffer> QuicStatelessPacketCache::BuildStatelessResetPacket(
+    quic::QuicUint128 token,
+    size_t received_packet_length,
+    size_t* length) {
+  if (received_packet_length <= kMinStatelessResetLength)
+    return nullptr;
+  const size_t reset_length =
+      std::min(received_packet_length - 1, kMaxStatelessResetLength);
+  scoped_refptr<IOBufferWithSize> buffer = GetBuffer();
+  char* out = buffer->data();
+  const size_t random_length = reset_length - sizeof(token);
+  random_->InsecureRandBytes(out, random_length);
+  // A short header packet: long header bit clear, fixed bit set.
+  out[0] = static_cast<char>((out[0] & ~kLongHeaderBit) | kFixedBit);
+  memcpy(out + random_length, &token, sizeof(token));
+  *length = reset_length;
+  return buffer;
+}
+
+scoped_refptr<IOBufferWithSize> QuicStatelessPacketCache::GetBuffer() {
+  for (const scoped_refptr<IOBufferWithSize>& buffer : buffers_) {
+    if (buffer->HasOneRef())
+      return buffer;
+  }
+  ++num_buffers_allocated_;
+  auto buffer =
+      base::MakeRefCounted<IOBufferWithSize>(quic::kMaxOutgoingPacketSize);
+  if (buffers_.size() < kMaxPooledBuffers)
+    buffers_.push_back(buffer);
+  return buffer;
+}
+
+void QuicStatelessPacketCache::UpdateVersionsTemplate(
+    const quic::ParsedQuicVersionVector& supported_versions) {
+  versions_ = supported_versions;
+  versions_template_.clear();
+  // Greases the list so that clients do not come to rely on its contents.
+  AppendVersionLabel(quic::CreateRandomVersionLabelForNegotiation(),
+                     &versions_template_);
+  for (const quic::ParsedQuicVersion& version : supported_versions) {
+    AppendVersionLabel(quic::CreateQuicVersionLabel(version),
+                       &versions_template_);
+  }
+  // Connection IDs are echoed back, and their length prefix allows up to 255
+  // bytes each. Real version lists leave plenty of room for that.
+  const size_t kMaxHeaderLength = 1 + kVersionLength + 2 * (1 + 255);
+  DCHECK_LE(kMaxHeaderLength + versions_template_.size(),
+            quic::kMaxOutgoingPacketSize);
+}
+
+}  // namespace net
@@ -0,0 +1,248 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_STATELESS_PACKET_CACHE_H_
+#define NET_TOOLS_QUIC_QUIC_STATELESS_PACKET_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/memory/scoped_refptr.h"
+#include "net/base/io_buffer.h"
+#include "net/quic/address_utils.h"
+#include "net/third_party/quiche/src/quic/core/quic_connection_id.h"
+#include "net/third_party/quiche/src/quic/core/quic_time_wait_list_manager.h"
+#include "net/third_party/quiche/src/quic/core/quic_versions.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_uint128.h"
+#include "net/tools/quic/quic_admission_controller.h"
+#include "net/tools/quic/quic_simple_server_packet_writer.h"
+
+namespace quic {
+class QuicRandom;
+}  // namespace quic
+namespace net {
+
+// Builds the packets a server sends without connection state, IETF version
+// negotiation and stateless reset packets, from pre-serialized templates:
+// only the connection IDs, reset token and random bits are written per
+// packet. Packets are built in a small pool of buffers that are reused once
+// the socket no longer references them, so that they can be written without
+// a copy.
+class QuicStatelessPacketCache {
+ public:
+  // Stateless resets are one byte shorter than the packet that triggered
+  // them, so that two endpoints cannot reset each other forever, and no
+  // longer than a short header packet with a 20-byte connection ID, which
+  // leaves a peer unable to tell them apart (RFC 9000 section 10.3). Shorter
+  // resets than kMinStatelessResetLength are not sent.
+  static const size_t kMinStatelessResetLength = 1 + 4 + 16;
+  static const size_t kMaxStatelessResetLength = 1 + 20 + 4 + 16;
+
+  explicit QuicStatelessPacketCache(quic::QuicRandom* random);
+  ~QuicStatelessPacketCache();
+
+  // Returns a version negotiation packet with length-prefixed connection IDs
+  // that answers a packet from |client_connection_id| to
+  // |server_connection_id|, and sets |length|. The returned buffer must be
+  // released before it can be reused.
+  scoped_refptr<IOBuffer> BuildVersionNegotiationPacket(
+      quic::QuicConnectionId server_connection_id,
+      quic::QuicConnectionId client_connection_id,
+      const quic::ParsedQuicVersionVector& supported_versions,
+      size_t* length);
+
+  // Returns a stateless reset carrying |token| that answers a packet of
+  // |received_packet_length| bytes, and sets |length|. Returns null if that
+  // packet is too short to be answered.
+  scoped_refptr<IOBuffer> BuildStatelessResetPacket(
+      quic::QuicUint128 token,
+      size_t received_packet_length,
+      size_t* length);
+
+  size_t num_buffers_allocated() const { return num_buffers_allocated_; }
+
+ private:
+  // Returns a buffer no one else references.
+  scoped_refptr<IOBufferWithSize> GetBuffer();
+  // Serializes the versions list that ends version negotiation packets.
+  void UpdateVersionsTemplate(
+      const quic::ParsedQuicVersionVector& supported_versions);
+
+  quic::QuicRandom* random_;  // Not owned.
+  std::vector<scoped_refptr<IOBufferWithSize>> buffers_;
+  size_t num_buffers_allocated_;
+  quic::ParsedQuicVersionVector versions_;
+  std::string versions_template_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicStatelessPacketCache);
+};
+
+// Limits the stateless responses sent per source prefix.
+struct QuicStatelessResponseRateLimit {
+  double responses_per_second = 100;
+  double burst = 200;
+
+  // Returns the parameters of a QuicAdmissionController that counts
+  // responses at this rate.
+  QuicAdmissionController::Params ToAdmissionControllerParams() const;
+};
+
+// The per-packet context the dispatcher passes to QuicCachedStatelessResponses
+// with each packet it answers.
+struct QuicStatelessResponseContext : public quic::QuicPerPacketContext {
+  explicit QuicStatelessResponseContext(size_t received_packet_length)
+      : received_packet_length(received_packet_length) {}
+
+  size_t received_packet_length;
+};
+
+// Makes a time-wait list manager answer IETF version negotiation and
+// stateless reset triggers from a QuicStatelessPacketCache, written straight
+// to a QuicSimpleServerPacketWriter, and at most at the rate |rate_limit|
+// allows per source prefix. Responses are dropped rather than queued when the
+// writer is blocked or the write fails. Google QUIC responses, and stateless
+// resets without a QuicStatelessResponseContext to size them from, are left
+// to |TimeWaitListManager|, which must be quic::QuicTimeWaitListManager or
+// derive from it.
+template <class TimeWaitListManager>
+class QuicCachedStatelessResponses : public TimeWaitListManager {
+ public:
+  QuicCachedStatelessResponses(
+      QuicSimpleServerPacketWriter* writer,
+      quic::QuicTimeWaitListManager::Visitor* visitor,
+      const quic::QuicClock* clock,
+      quic::QuicAlarmFactory* alarm_factory,
+      quic::QuicRandom* random,
+      const QuicStatelessResponseRateLimit& rate_limit)
+      : TimeWaitListManager(writer, visitor, clock, alarm_factory),
+        writer_(writer),
+        visitor_(visitor),
+        cache_(random),
+        rate_limiter_(rate_limit.ToAdmissionControllerParams(), clock),
+        num_rate_limited_(0),
+        num_triggers_too_short_(0),
+        num_dropped_write_blocked_(0),
+        num_write_errors_(0) {}
+  ~QuicCachedStatelessResponses() override = default;
+
+  // quic::QuicTimeWaitListManager methods:
+  void SendVersionNegotiationPacket(
+      quic::QuicConnectionId server_connection_id,
+      quic::QuicConnectionId client_connection_id,
+      bool ietf_quic,
+      bool use_length_prefix,
+      const quic::ParsedQuicVersionVector& supported_versions,
+      const quic::QuicSocketAddress& self_address,
+      const quic::QuicSocketAddress& peer_address,
+      std::unique_ptr<quic::QuicPerPacketContext> packet_context) override {
+    if (!ietf_quic || !use_length_prefix) {
+      TimeWaitListManager::SendVersionNegotiationPacket(
+          server_connection_id, client_connection_id, ietf_quic,
+          use_length_prefix, supported_versions, self_address, peer_address,
+          std::move(packet_context));
+      return;
+    }
+    if (!ShouldRespond(peer_address))
+      return;
+    size_t length;
+    scoped_refptr<IOBuffer> packet = cache_.BuildVersionNegotiationPacket(
+        server_connection_id, client_connection_id, supported_versions,
+        &length);
+    WriteResponse(std::move(packet), length, peer_address);
+  }
+
+  void SendPublicReset(
+      const quic::QuicSocketAddress& self_address,
+      const quic::QuicSocketAddress& peer_address,
+      quic::QuicConnectionId connection_id,
+      bool ietf_quic,
+      std::unique_ptr<quic::QuicPerPacketContext> packet_context) override {
+    // Only dispatchers which use this class pass a
+    // QuicStatelessResponseContext.
+    if (!ietf_quic || !packet_context) {
+      TimeWaitListManager::SendPublicReset(self_address, peer_address,
+                                           connection_id, ietf_quic,
+                                           std::move(packet_context));
+      return;
+    }
+    const size_t received_packet_length =
+        static_cast<QuicStatelessResponseContext*>(packet_context.get())
+            ->received_packet_length;
+    if (received_packet_length <=
+        QuicStatelessPacketCache::kMinStatelessResetLength) {
+      ++num_triggers_too_short_;
+      return;
+    }
+    if (!ShouldRespond(peer_address))
+      return;
+    size_t length;
+    scoped_refptr<IOBuffer> packet = cache_.BuildStatelessResetPacket(
+        this->GetStatelessResetToken(connection_id), received_packet_length,
+        &length);
+    WriteResponse(std::move(packet), length, peer_address);
+  }
+
+  uint64_t num_rate_limited() const { return num_rate_limited_; }
+  // Stateless reset triggers too short to be answered by a shorter reset.
+  uint64_t num_triggers_too_short() const { return num_triggers_too_short_; }
+  uint64_t num_dropped_write_blocked() const {
+    return num_dropped_write_blocked_;
+  }
+  uint64_t num_write_errors() const { return num_write_errors_; }
+
+ private:
+  bool ShouldRespond(const quic::QuicSocketAddress& peer_address) {
+    if (writer_->IsWriteBlocked()) {
+      ++num_dropped_write_blocked_;
+      return false;
+    }
+    if (!rate_limiter_.ShouldAccept(ToIPEndPoint(peer_address).address())) {
+      ++num_rate_limited_;
+      return false;
+    }
+    return true;
+  }
+
+  void WriteResponse(scoped_refptr<IOBuffer> packet,
+                     size_t length,
+                     const quic::QuicSocketAddress& peer_address) {
+    quic::WriteResult result =
+        writer_->WritePacketBuffer(std::move(packet), length, peer_address);
+    if (quic::IsWriteBlockedStatus(result.status)) {
+      // Like the base class, ask the dispatcher to report when the writer
+      // can be used again, so that packets queued in the meantime are sent.
+      visitor_->OnWriteBlocked(this);
+      if (result.status != quic::WRITE_STATUS_BLOCKED_DATA_BUFFERED)
+        ++num_dropped_write_blocked_;
+      return;
+    }
+    if (quic::IsWriteError(result.status)) {
+      ++num_write_errors_;
+      DVLOG(1) << "Failed to write stateless response to "
+               << peer_address.ToString() << ": " << result.error_code;
+    }
+  }
+
+  QuicSimpleServerPacketWriter* writer_;  // Not owned.
+  quic::QuicTimeWaitListManager::Visitor* visitor_;  // Not owned.
+  QuicStatelessPacketCache cache_;
+  QuicAdmissionController rate_limiter_;
+  uint64_t num_rate_limited_;
+  uint64_t num_triggers_too_short_;
+  uint64_t num_dropped_write_blocked_;
+  uint64_t num_write_errors_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicCachedStatelessResponses);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_STATELESS_PACKET_CACHE_H_
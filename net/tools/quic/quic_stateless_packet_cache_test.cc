@@ -0,0 +1,224 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_stateless_packet_cache.h"
+
+#include <string.h>
+
+#include <memory>
+
+#include "net/base/net_errors.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/core/quic_data_reader.h"
+#include "net/third_party/quiche/src/quic/test_tools/mock_clock.h"
+#include "net/third_party/quiche/src/quic/test_tools/quic_test_utils.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+class QuicStatelessPacketCacheTest : public ::testing::Test {
+ protected:
+  QuicStatelessPacketCacheTest()
+      : cache_(quic::QuicRandom::GetInstance()),
+        versions_(quic::AllSupportedVersions()) {}
+
+  QuicStatelessPacketCache cache_;
+  quic::ParsedQuicVersionVector versions_;
+};
+
+TEST_F(QuicStatelessPacketCacheTest, VersionNegotiation) {
+  quic::QuicConnectionId server_connection_id =
+      quic::test::TestConnectionId(1);
+  quic::QuicConnectionId client_connection_id =
+      quic::test::TestConnectionIdNineBytesLong(2);
+  size_t length;
+  scoped_refptr<IOBuffer> packet = cache_.BuildVersionNegotiationPacket(
+      server_connection_id, client_connection_id, versions_, &length);
+
+  quic::QuicDataReader reader(packet->data(), length);
+  uint8_t first_byte;
+  ASSERT_TRUE(reader.ReadUInt8(&first_byte));
+  EXPECT_TRUE(first_byte & 0x80);
+  uint32_t version;
+  ASSERT_TRUE(reader.ReadUInt32(&version));
+  EXPECT_EQ(0u, version);
+  quic::QuicConnectionId destination_connection_id;
+  ASSERT_TRUE(
+      reader.ReadLengthPrefixedConnectionId(&destination_connection_id));
+  EXPECT_EQ(client_connection_id, destination_connection_id);
+  quic::QuicConnectionId source_connection_id;
+  ASSERT_TRUE(reader.ReadLengthPrefixedConnectionId(&source_connection_id));
+  EXPECT_EQ(server_connection_id, source_connection_id);
+
+  // A greased version, then the supported ones.
+  ASSERT_EQ(4 * (versions_.size() + 1), reader.BytesRemaining());
+  uint32_t label;
+  ASSERT_TRUE(reader.ReadUInt32(&label));
+  EXPECT_EQ(0x0a0a0a0au, label & 0x0f0f0f0fu);
+  for (const quic::ParsedQuicVersion& supported_version : versions_) {
+    ASSERT_TRUE(reader.ReadUInt32(&label));
+    EXPECT_EQ(quic::CreateQuicVersionLabel(supported_version), label);
+  }
+}
+
+TEST_F(QuicStatelessPacketCacheTest, VersionsChange) {
+  size_t length;
+  cache_.BuildVersionNegotiationPacket(quic::test::TestConnectionId(1),
+                                       quic::EmptyQuicConnectionId(),
+                                       versions_, &length);
+  EXPECT_EQ(1 + 4 + 1 + 8 + 1 + 4 * (versions_.size() + 1), length);
+
+  quic::ParsedQuicVersionVector one_version = {versions_[0]};
+  cache_.BuildVersionNegotiationPacket(quic::test::TestConnectionId(1),
+                                       quic::EmptyQuicConnectionId(),
+                                       one_version, &length);
+  EXPECT_EQ(1 + 4 + 1 + 8 + 1 + 4 * 2u, length);
+}
+
+TEST_F(QuicStatelessPacketCacheTest, StatelessReset) {
+  quic::QuicUint128 token = quic::MakeQuicUint128(0x0123456789abcdef, 42);
+  size_t length;
+  scoped_refptr<IOBuffer> packet = cache_.BuildStatelessResetPacket(
+      token, quic::kDefaultMaxPacketSize, &length);
+  ASSERT_EQ(QuicStatelessPacketCache::kMaxStatelessResetLength, length);
+  EXPECT_EQ(0x40, packet->data()[0] & 0xc0);
+  EXPECT_EQ(0, memcmp(packet->data() + length - sizeof(token), &token,
+                      sizeof(token)));
+}
+
+TEST_F(QuicStatelessPacketCacheTest, StatelessResetShorterThanTrigger) {
+  quic::QuicUint128 token = quic::MakeQuicUint128(0x0123456789abcdef, 42);
+  size_t length;
+  scoped_refptr<IOBuffer> packet = cache_.BuildStatelessResetPacket(
+      token, QuicStatelessPacketCache::kMinStatelessResetLength + 5, &length);
+  ASSERT_TRUE(packet);
+  EXPECT_EQ(QuicStatelessPacketCache::kMinStatelessResetLength + 4, length);
+  EXPECT_EQ(0x40, packet->data()[0] & 0xc0);
+  EXPECT_EQ(0, memcmp(packet->data() + length - sizeof(token), &token,
+                      sizeof(token)));
+
+  // A reset shorter than its trigger would be too short to pass for a
+  // packet.
+  EXPECT_FALSE(cache_.BuildStatelessResetPacket(
+      token, QuicStatelessPacketCache::kMinStatelessResetLength, &length));
+}
+
+TEST_F(QuicStatelessPacketCacheTest, ReusesReleasedBuffers) {
+  quic::QuicUint128 token = quic::MakeQuicUint128(1, 2);
+  size_t length;
+  for (int i = 0; i < 10; ++i)
+    cache_.BuildStatelessResetPacket(token, quic::kDefaultMaxPacketSize,
+                                     &length);
+  EXPECT_EQ(1u, cache_.num_buffers_allocated());
+
+  // Buffers still referenced, e.g. by a pending write, are not reused.
+  scoped_refptr<IOBuffer> held = cache_.BuildStatelessResetPacket(
+      token, quic::kDefaultMaxPacketSize, &length);
+  scoped_refptr<IOBuffer> other = cache_.BuildStatelessResetPacket(
+      token, quic::kDefaultMaxPacketSize, &length);
+  EXPECT_NE(held.get(), other.get());
+  EXPECT_EQ(2u, cache_.num_buffers_allocated());
+}
+
+// Returns |result| from every write instead of writing to a socket.
+class TestPacketWriter : public QuicSimpleServerPacketWriter {
+ public:
+  TestPacketWriter()
+      : QuicSimpleServerPacketWriter(/*socket=*/nullptr,
+                                     /*dispatcher=*/nullptr),
+        result_(quic::WRITE_STATUS_OK, 0),
+        num_writes_(0) {}
+
+  quic::WriteResult WritePacketBuffer(
+      scoped_refptr<IOBuffer> buffer,
+      size_t buf_len,
+      const quic::QuicSocketAddress& peer_address) override {
+    ++num_writes_;
+    return result_;
+  }
+
+  void set_result(quic::WriteResult result) { result_ = result; }
+  int num_writes() const { return num_writes_; }
+
+ private:
+  quic::WriteResult result_;
+  int num_writes_;
+};
+
+class QuicCachedStatelessResponsesTest : public ::testing::Test {
+ protected:
+  QuicCachedStatelessResponsesTest()
+      : manager_(&writer_,
+                 &visitor_,
+                 &clock_,
+                 &alarm_factory_,
+                 quic::QuicRandom::GetInstance(),
+                 QuicStatelessResponseRateLimit()),
+        self_address_(quic::QuicIpAddress::Loopback4(), 443),
+        peer_address_(quic::QuicIpAddress::Loopback4(), 12345) {
+    clock_.AdvanceTime(quic::QuicTime::Delta::FromSeconds(1));
+  }
+
+  // Answers a packet of |received_packet_length| bytes with a stateless
+  // reset.
+  void SendStatelessReset(
+      size_t received_packet_length = quic::kDefaultMaxPacketSize) {
+    manager_.SendPublicReset(
+        self_address_, peer_address_, quic::test::TestConnectionId(1),
+        /*ietf_quic=*/true,
+        std::make_unique<QuicStatelessResponseContext>(
+            received_packet_length));
+  }
+
+  TestPacketWriter writer_;
+  testing::StrictMock<quic::test::MockQuicSessionVisitor> visitor_;
+  quic::MockClock clock_;
+  quic::test::MockAlarmFactory alarm_factory_;
+  QuicCachedStatelessResponses<quic::QuicTimeWaitListManager> manager_;
+  quic::QuicSocketAddress self_address_;
+  quic::QuicSocketAddress peer_address_;
+};
+
+TEST_F(QuicCachedStatelessResponsesTest, WriteBlocked) {
+  // The socket keeps the packet, and the dispatcher is asked to report when
+  // it can write again.
+  writer_.set_result(quic::WriteResult(
+      quic::WRITE_STATUS_BLOCKED_DATA_BUFFERED, ERR_IO_PENDING));
+  EXPECT_CALL(visitor_, OnWriteBlocked(&manager_));
+  SendStatelessReset();
+  EXPECT_EQ(1, writer_.num_writes());
+  EXPECT_EQ(0u, manager_.num_dropped_write_blocked());
+
+  // A blocked write that did not keep the packet drops the response.
+  writer_.set_result(quic::WriteResult(quic::WRITE_STATUS_BLOCKED, 0));
+  EXPECT_CALL(visitor_, OnWriteBlocked(&manager_));
+  SendStatelessReset();
+  EXPECT_EQ(1u, manager_.num_dropped_write_blocked());
+}
+
+TEST_F(QuicCachedStatelessResponsesTest, ShortTriggersAreNotAnswered) {
+  SendStatelessReset(QuicStatelessPacketCache::kMinStatelessResetLength);
+  EXPECT_EQ(0, writer_.num_writes());
+  EXPECT_EQ(1u, manager_.num_triggers_too_short());
+
+  SendStatelessReset(QuicStatelessPacketCache::kMinStatelessResetLength + 1);
+  EXPECT_EQ(1, writer_.num_writes());
+  EXPECT_EQ(1u, manager_.num_triggers_too_short());
+}
+
+TEST_F(QuicCachedStatelessResponsesTest, WriteError) {
+  writer_.set_result(
+      quic::WriteResult(quic::WRITE_STATUS_ERROR, ERR_ADDRESS_UNREACHABLE));
+  SendStatelessReset();
+  EXPECT_EQ(1, writer_.num_writes());
+  EXPECT_EQ(1u, manager_.num_write_errors());
+  EXPECT_EQ(0u, manager_.num_dropped_write_blocked());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
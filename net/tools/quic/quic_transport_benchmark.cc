@@ -0,0 +1,96 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_transport_benchmark.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "base/big_endian.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+
+namespace net {
+
+const char kQuicTransportDatagramEchoPath[] = "/benchmark/datagram-echo";
+const char kQuicTransportDatagramSinkPath[] = "/benchmark/datagram-sink";
+const char kQuicTransportStreamSinkPath[] = "/benchmark/stream-sink";
+const char kQuicTransportStreamSourcePath[] = "/benchmark/stream-source";
+
+const size_t QuicTransportBenchmarkDatagram::kHeaderSize;
+
+void QuicTransportBenchmarkDatagram::Serialize(char* data) const {
+  base::WriteBigEndian(data, sequence_number);
+  base::WriteBigEndian(data + sizeof(sequence_number),
+                       static_cast<uint64_t>(send_time_us));
+}
+
+bool QuicTransportBenchmarkDatagram::Parse(base::StringPiece datagram) {
+  if (datagram.size() < kHeaderSize)
+    return false;
+  uint64_t send_time;
+  base::ReadBigEndian(datagram.data(), &sequence_number);
+  base::ReadBigEndian(datagram.data() + sizeof(sequence_number), &send_time);
+  send_time_us = static_cast<int64_t>(send_time);
+  return true;
+}
+
+int64_t QuicTransportBenchmarkNowUs() {
+  return (base::TimeTicks::Now() - base::TimeTicks()).InMicroseconds();
+}
+
+QuicTransportDatagramSinkStats::QuicTransportDatagramSinkStats()
+    : num_received_(0),
+      num_bytes_(0),
+      num_reordered_(0),
+      next_sequence_number_(0),
+      total_latency_us_(0),
+      min_latency_us_(std::numeric_limits<int64_t>::max()),
+      max_latency_us_(0) {}
+
+QuicTransportDatagramSinkStats::~QuicTransportDatagramSinkStats() = default;
+
+void QuicTransportDatagramSinkStats::OnDatagram(
+    const QuicTransportBenchmarkDatagram& datagram,
+    size_t size,
+    int64_t receive_time_us) {
+  ++num_received_;
+  num_bytes_ += size;
+  if (datagram.sequence_number < next_sequence_number_) {
+    ++num_reordered_;
+  } else {
+    next_sequence_number_ = datagram.sequence_number + 1;
+  }
+  int64_t latency_us = std::max<int64_t>(
+      0, receive_time_us - datagram.send_time_us);
+  total_latency_us_ += latency_us;
+  min_latency_us_ = std::min(min_latency_us_, latency_us);
+  max_latency_us_ = std::max(max_latency_us_, latency_us);
+}
+
+uint64_t QuicTransportDatagramSinkStats::num_lost() const {
+  // Duplicates are counted as reordered datagrams, so they hide losses.
+  return next_sequence_number_ > num_received_
+             ? next_sequence_number_ - num_received_
+             : 0;
+}
+
+int64_t QuicTransportDatagramSinkStats::mean_latency_us() const {
+  return num_received_ == 0 ? 0 : total_latency_us_ / num_received_;
+}
+
+std::string QuicTransportDatagramSinkStats::ToString() const {
+  return base::StringPrintf(
+      "received=%llu bytes=%llu lost=%llu reordered=%llu "
+      "min_latency_us=%lld mean_latency_us=%lld max_latency_us=%lld",
+      static_cast<unsigned long long>(num_received_),
+      static_cast<unsigned long long>(num_bytes_),
+      static_cast<unsigned long long>(num_lost()),
+      static_cast<unsigned long long>(num_reordered_),
+      static_cast<long long>(num_received_ == 0 ? 0 : min_latency_us_),
+      static_cast<long long>(mean_latency_us()),
+      static_cast<long long>(max_latency_us_));
+}
+
+}  // namespace net
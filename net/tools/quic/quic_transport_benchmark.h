@@ -0,0 +1,86 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_TRANSPORT_BENCHMARK_H_
+#define NET_TOOLS_QUIC_QUIC_TRANSPORT_BENCHMARK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "base/strings/string_piece.h"
+
+namespace net {
+
+// Paths of the benchmark endpoints of QuicTransportSimpleServer.
+//
+// Echoes every datagram back.
+extern const char kQuicTransportDatagramEchoPath[];
+// Discards datagrams, accounting for their loss and latency. Closing a
+// bidirectional stream makes the server reply with its statistics.
+extern const char kQuicTransportDatagramSinkPath[];
+// Discards the data of incoming streams. Closing a bidirectional stream makes
+// the server reply with the number of bytes it received on it.
+extern const char kQuicTransportStreamSinkPath[];
+// Sends the number of bytes given by the "bytes" query parameter on a
+// unidirectional stream.
+extern const char kQuicTransportStreamSourcePath[];
+
+// Every benchmark datagram starts with this header, followed by padding.
+struct QuicTransportBenchmarkDatagram {
+  static const size_t kHeaderSize = 16;
+
+  uint64_t sequence_number = 0;
+  // Microseconds on the base::TimeTicks clock, so latencies are only
+  // meaningful when both ends run on the same host.
+  int64_t send_time_us = 0;
+
+  // Writes the header at the start of |data|, which must hold at least
+  // kHeaderSize bytes.
+  void Serialize(char* data) const;
+  // Returns false if |datagram| is too short to hold a header.
+  bool Parse(base::StringPiece datagram);
+};
+
+// Returns the current time on the clock benchmark datagrams use.
+int64_t QuicTransportBenchmarkNowUs();
+
+// Accounts for the datagrams received by a sink. Datagrams are numbered from
+// 0; those below the highest number received that never arrive are lost,
+// and those that arrive after a higher number are reordered.
+class QuicTransportDatagramSinkStats {
+ public:
+  QuicTransportDatagramSinkStats();
+  ~QuicTransportDatagramSinkStats();
+
+  void OnDatagram(const QuicTransportBenchmarkDatagram& datagram,
+                  size_t size,
+                  int64_t receive_time_us);
+
+  uint64_t num_received() const { return num_received_; }
+  uint64_t num_bytes() const { return num_bytes_; }
+  uint64_t num_reordered() const { return num_reordered_; }
+  // Datagrams sent before the last one received that are still missing.
+  uint64_t num_lost() const;
+  int64_t min_latency_us() const { return min_latency_us_; }
+  int64_t max_latency_us() const { return max_latency_us_; }
+  int64_t mean_latency_us() const;
+
+  // Returns the statistics as space-separated key=value pairs.
+  std::string ToString() const;
+
+ private:
+  uint64_t num_received_;
+  uint64_t num_bytes_;
+  uint64_t num_reordered_;
+  uint64_t next_sequence_number_;
+  int64_t total_latency_us_;
+  int64_t min_latency_us_;
+  int64_t max_latency_us_;
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_TRANSPORT_BENCHMARK_H_
@@ -0,0 +1,476 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Drives the benchmark endpoints of quic_transport_simple_server (started
+// with --enable_benchmark_endpoints) through QuicTransportClient, and prints
+// throughput, latency and CPU cost. The endpoint is chosen by the URL path:
+//
+//   quic_transport_benchmark_client \
+//       quic-transport://localhost:20557/benchmark/datagram-echo
+//   quic_transport_benchmark_client \
+//       quic-transport://localhost:20557/benchmark/datagram-sink
+//   quic_transport_benchmark_client \
+//       quic-transport://localhost:20557/benchmark/stream-sink
+//   quic_transport_benchmark_client \
+//       "quic-transport://localhost:20557/benchmark/stream-source?bytes=100000"
+//
+// Datagram latencies are one-way for the sink and round-trip for the echo
+// endpoint; the former is only meaningful when both ends share a host.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/memory/weak_ptr.h"
+#include "base/run_loop.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "net/base/network_isolation_key.h"
+#include "net/proxy_resolution/configured_proxy_resolution_service.h"
+#include "net/quic/quic_context.h"
+#include "net/quic/quic_transport_client.h"
+#include "net/third_party/quiche/src/quic/core/quic_buffer_allocator.h"
+#include "net/third_party/quiche/src/quic/core/quic_connection.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_flags.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_mem_slice.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_system_event_loop.h"
+#include "net/third_party/quiche/src/quic/quic_transport/quic_transport_client_session.h"
+#include "net/third_party/quiche/src/quic/quic_transport/quic_transport_stream.h"
+#include "net/tools/quic/quic_transport_benchmark.h"
+#include "net/url_request/url_request_context.h"
+#include "net/url_request/url_request_context_builder.h"
+#include "url/gurl.h"
+#include "url/origin.h"
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(std::string,
+                              origin,
+                              "https://localhost",
+                              "Origin the client claims to connect from.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    certificate_fingerprint,
+    "",
+    "SHA-256 fingerprint of the server certificate, as colon-separated hex, "
+    "for servers using short-lived self-signed certificates.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(int32_t,
+                              num_datagrams,
+                              10000,
+                              "Number of datagrams to send.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(int32_t,
+                              datagram_size,
+                              1000,
+                              "Size of the datagrams to send.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    max_outstanding_datagrams,
+    64,
+    "Number of datagrams the echo benchmark keeps in flight.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int64_t,
+    stream_bytes,
+    100 * 1024 * 1024,
+    "Number of bytes the stream sink benchmark sends.");
+
+namespace net {
+namespace {
+
+// Datagrams sent per task by the sink benchmark, so that incoming packets
+// (and acknowledgements in particular) are processed in between.
+const int kDatagramsPerTask = 32;
+// Delay before retrying to send once the datagram queue is blocked.
+constexpr base::TimeDelta kBlockedRetryDelay =
+    base::TimeDelta::FromMilliseconds(1);
+// Time without echoes after which outstanding datagrams are declared lost.
+constexpr base::TimeDelta kEchoTimeout = base::TimeDelta::FromMilliseconds(500);
+// Time the sink benchmark waits for its last datagrams to arrive before
+// requesting statistics.
+constexpr base::TimeDelta kSinkDrainDelay =
+    base::TimeDelta::FromMilliseconds(500);
+// Interval at which the stream source benchmark resends its start datagram
+// until the stream arrives.
+constexpr base::TimeDelta kSourceStartInterval =
+    base::TimeDelta::FromMilliseconds(200);
+const size_t kStreamChunkSize = 64 * 1024;
+
+class BenchmarkClient : public QuicTransportClient::Visitor {
+ public:
+  BenchmarkClient(const GURL& url,
+                  URLRequestContext* context,
+                  const QuicTransportClient::Parameters& parameters,
+                  base::OnceClosure done_callback)
+      : url_(url),
+        done_callback_(std::move(done_callback)),
+        datagram_padding_(std::max<int32_t>(GetQuicFlag(FLAGS_datagram_size),
+                                            QuicTransportBenchmarkDatagram::
+                                                kHeaderSize),
+                          'd') {
+    url::Origin origin =
+        url::Origin::Create(GURL(GetQuicFlag(FLAGS_origin)));
+    client_ = std::make_unique<QuicTransportClient>(
+        url, origin, this, NetworkIsolationKey(origin, origin), context,
+        parameters);
+  }
+
+  void Start() { client_->Connect(); }
+
+  bool succeeded() const { return succeeded_; }
+
+  // QuicTransportClient::Visitor implementation.
+  void OnConnected() override {
+    start_time_ = base::TimeTicks::Now();
+    if (base::ThreadTicks::IsSupported())
+      start_cpu_time_ = base::ThreadTicks::Now();
+
+    const std::string path = url_.path();
+    if (path == kQuicTransportDatagramEchoPath) {
+      SendEchoDatagrams();
+    } else if (path == kQuicTransportDatagramSinkPath) {
+      SendSinkDatagrams();
+    } else if (path == kQuicTransportStreamSinkPath) {
+      stream_bytes_remaining_ = GetQuicFlag(FLAGS_stream_bytes);
+      OpenStatsStream();
+    } else if (path == kQuicTransportStreamSourcePath) {
+      source_timer_.Start(FROM_HERE, kSourceStartInterval, this,
+                          &BenchmarkClient::SendSourceStartDatagram);
+      SendSourceStartDatagram();
+    } else {
+      LOG(ERROR) << "Not a benchmark endpoint: " << url_;
+      Finish(false);
+    }
+  }
+
+  void OnConnectionFailed() override {
+    LOG(ERROR) << "Connection failed: " << client_->error();
+    Finish(false);
+  }
+
+  void OnClosed() override { Finish(false); }
+
+  void OnError() override {
+    LOG(ERROR) << "Session error: " << client_->error();
+    Finish(false);
+  }
+
+  void OnIncomingBidirectionalStreamAvailable() override {}
+
+  void OnIncomingUnidirectionalStreamAvailable() override {
+    quic::QuicTransportStream* stream =
+        client_->session()->AcceptIncomingUnidirectionalStream();
+    if (stream == nullptr)
+      return;
+    source_timer_.Stop();
+    stream->set_visitor(std::make_unique<StreamVisitor>(this, stream));
+  }
+
+  void OnDatagramReceived(base::StringPiece datagram) override {
+    QuicTransportBenchmarkDatagram header;
+    if (url_.path() != kQuicTransportDatagramEchoPath ||
+        !header.Parse(datagram))
+      return;
+    // Echoes which arrive after their timeout were already counted as lost.
+    if (outstanding_.erase(header.sequence_number) == 0)
+      return;
+    round_trip_times_us_.push_back(QuicTransportBenchmarkNowUs() -
+                                   header.send_time_us);
+    SendEchoDatagrams();
+  }
+
+  void OnCanCreateNewOutgoingBidirectionalStream() override {
+    if (stats_stream_pending_)
+      OpenStatsStream();
+  }
+
+  void OnCanCreateNewOutgoingUnidirectionalStream() override {}
+
+ private:
+  // Reads everything an incoming stream carries; writes |stream_bytes| on
+  // the stream of the stream sink benchmark.
+  class StreamVisitor : public quic::QuicTransportStream::Visitor {
+   public:
+    StreamVisitor(BenchmarkClient* client, quic::QuicTransportStream* stream)
+        : client_(client), stream_(stream) {}
+
+    void OnCanRead() override {
+      size_t previous_size = data_.size();
+      stream_->Read(&data_);
+      client_->stream_bytes_received_ += data_.size() - previous_size;
+      // Only replies are kept; bulk data is counted and dropped.
+      if (stream_->type() != quic::BIDIRECTIONAL)
+        data_.clear();
+    }
+
+    void OnFinRead() override { client_->OnStreamFinished(data_); }
+
+    void OnCanWrite() override { client_->WriteStream(stream_); }
+
+   private:
+    BenchmarkClient* client_;
+    quic::QuicTransportStream* stream_;
+    std::string data_;
+
+    DISALLOW_COPY_AND_ASSIGN(StreamVisitor);
+  };
+
+  // Sends one datagram, with sequence number |*sequence_number| if not null,
+  // returning false if it had to be queued.
+  bool SendDatagram(uint64_t* sequence_number = nullptr) {
+    QuicTransportBenchmarkDatagram header;
+    header.sequence_number = num_sent_++;
+    if (sequence_number)
+      *sequence_number = header.sequence_number;
+    header.send_time_us = QuicTransportBenchmarkNowUs();
+    header.Serialize(&datagram_padding_[0]);
+
+    quic::QuicConnection* connection = client_->session()->connection();
+    quic::QuicUniqueBufferPtr buffer = quic::MakeUniqueBuffer(
+        connection->helper()->GetStreamSendBufferAllocator(),
+        datagram_padding_.size());
+    memcpy(buffer.get(), datagram_padding_.data(), datagram_padding_.size());
+    quic::MessageStatus status =
+        client_->session()->datagram_queue()->SendOrQueueDatagram(
+            quic::QuicMemSlice(std::move(buffer), datagram_padding_.size()));
+    return status != quic::MESSAGE_STATUS_BLOCKED;
+  }
+
+  void SendSourceStartDatagram() { SendDatagram(); }
+
+  void SendEchoDatagrams() {
+    const int32_t num_datagrams = GetQuicFlag(FLAGS_num_datagrams);
+    const size_t max_outstanding =
+        std::max(GetQuicFlag(FLAGS_max_outstanding_datagrams), 0);
+    while (outstanding_.size() < max_outstanding &&
+           num_sent_ < static_cast<uint64_t>(num_datagrams)) {
+      uint64_t sequence_number;
+      SendDatagram(&sequence_number);
+      outstanding_.insert(sequence_number);
+    }
+    if (outstanding_.empty()) {
+      ReportDatagramEcho();
+      Finish(true);
+      return;
+    }
+    echo_timer_.Start(FROM_HERE, kEchoTimeout, this,
+                      &BenchmarkClient::OnEchoTimeout);
+  }
+
+  void OnEchoTimeout() {
+    num_echoes_lost_ += outstanding_.size();
+    outstanding_.clear();
+    SendEchoDatagrams();
+  }
+
+  void SendSinkDatagrams() {
+    const uint64_t num_datagrams = GetQuicFlag(FLAGS_num_datagrams);
+    for (int i = 0; i < kDatagramsPerTask && num_sent_ < num_datagrams; ++i) {
+      if (!SendDatagram()) {
+        base::ThreadTaskRunnerHandle::Get()->PostDelayedTask(
+            FROM_HERE,
+            base::BindOnce(&BenchmarkClient::SendSinkDatagrams,
+                           weak_factory_.GetWeakPtr()),
+            kBlockedRetryDelay);
+        return;
+      }
+    }
+    if (num_sent_ < num_datagrams) {
+      base::ThreadTaskRunnerHandle::Get()->PostTask(
+          FROM_HERE, base::BindOnce(&BenchmarkClient::SendSinkDatagrams,
+                                    weak_factory_.GetWeakPtr()));
+      return;
+    }
+    send_duration_ = base::TimeTicks::Now() - start_time_;
+    base::ThreadTaskRunnerHandle::Get()->PostDelayedTask(
+        FROM_HERE,
+        base::BindOnce(&BenchmarkClient::OpenStatsStream,
+                       weak_factory_.GetWeakPtr()),
+        kSinkDrainDelay);
+  }
+
+  // Opens the bidirectional stream the server replies on with its
+  // statistics once it is finished.
+  void OpenStatsStream() {
+    quic::QuicTransportClientSession* session = client_->session();
+    if (!session->CanOpenNextOutgoingBidirectionalStream()) {
+      stats_stream_pending_ = true;
+      return;
+    }
+    stats_stream_pending_ = false;
+    quic::QuicTransportStream* stream =
+        session->OpenOutgoingBidirectionalStream();
+    stream->set_visitor(std::make_unique<StreamVisitor>(this, stream));
+    WriteStream(stream);
+  }
+
+  void WriteStream(quic::QuicTransportStream* stream) {
+    if (stream_fin_sent_)
+      return;
+    std::string chunk(kStreamChunkSize, 'c');
+    while (stream_bytes_remaining_ > 0) {
+      size_t size = static_cast<size_t>(
+          std::min<int64_t>(stream_bytes_remaining_, chunk.size()));
+      if (!stream->Write(quiche::QuicheStringPiece(chunk.data(), size)))
+        return;
+      stream_bytes_remaining_ -= size;
+    }
+    stream_fin_sent_ = stream->SendFin();
+  }
+
+  void OnStreamFinished(const std::string& reply) {
+    const std::string path = url_.path();
+    if (path == kQuicTransportStreamSinkPath) {
+      ReportStreamThroughput(GetQuicFlag(FLAGS_stream_bytes));
+    } else if (path == kQuicTransportStreamSourcePath) {
+      ReportStreamThroughput(stream_bytes_received_);
+    } else if (path == kQuicTransportDatagramSinkPath) {
+      printf("datagrams_sent: %llu\n",
+             static_cast<unsigned long long>(num_sent_));
+      printf("send_rate_datagrams_per_second: %.0f\n",
+             num_sent_ / send_duration_.InSecondsF());
+      ReportClientCpu(num_sent_);
+    }
+    if (!reply.empty())
+      printf("server: %s\n", reply.c_str());
+    Finish(true);
+  }
+
+  void ReportDatagramEcho() {
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start_time_;
+    std::vector<int64_t>& rtts = round_trip_times_us_;
+    std::sort(rtts.begin(), rtts.end());
+    printf("datagrams_sent: %llu\n",
+           static_cast<unsigned long long>(num_sent_));
+    printf("datagrams_echoed: %zu\n", rtts.size());
+    printf("datagrams_lost: %llu\n",
+           static_cast<unsigned long long>(num_echoes_lost_));
+    printf("echo_rate_datagrams_per_second: %.0f\n",
+           rtts.size() / elapsed.InSecondsF());
+    if (!rtts.empty()) {
+      printf("rtt_us_p50: %lld\n",
+             static_cast<long long>(rtts[rtts.size() / 2]));
+      printf("rtt_us_p90: %lld\n",
+             static_cast<long long>(rtts[rtts.size() * 9 / 10]));
+      printf("rtt_us_p99: %lld\n",
+             static_cast<long long>(rtts[rtts.size() * 99 / 100]));
+    }
+    ReportClientCpu(num_sent_);
+  }
+
+  void ReportStreamThroughput(uint64_t bytes) {
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start_time_;
+    printf("stream_bytes: %llu\n", static_cast<unsigned long long>(bytes));
+    printf("throughput_megabits_per_second: %.1f\n",
+           bytes * 8 / elapsed.InSecondsF() / 1e6);
+    ReportClientCpu(0);
+  }
+
+  // Prints the CPU time the client spent, per datagram if |num_datagrams| is
+  // not zero.
+  void ReportClientCpu(uint64_t num_datagrams) {
+    if (start_cpu_time_.is_null())
+      return;
+    base::TimeDelta cpu_time = base::ThreadTicks::Now() - start_cpu_time_;
+    printf("client_cpu_us: %lld\n",
+           static_cast<long long>(cpu_time.InMicroseconds()));
+    if (num_datagrams > 0) {
+      printf("client_cpu_us_per_datagram: %.2f\n",
+             cpu_time.InMicrosecondsF() / num_datagrams);
+    }
+  }
+
+  void Finish(bool succeeded) {
+    if (!done_callback_)
+      return;
+    succeeded_ = succeeded;
+    echo_timer_.Stop();
+    source_timer_.Stop();
+    std::move(done_callback_).Run();
+  }
+
+  const GURL url_;
+  base::OnceClosure done_callback_;
+  std::unique_ptr<QuicTransportClient> client_;
+  bool succeeded_ = false;
+
+  // Datagram sent next; starts with a QuicTransportBenchmarkDatagram.
+  std::string datagram_padding_;
+  uint64_t num_sent_ = 0;
+  // Sequence numbers of the echo datagrams not echoed back yet.
+  std::set<uint64_t> outstanding_;
+  uint64_t num_echoes_lost_ = 0;
+  std::vector<int64_t> round_trip_times_us_;
+  base::OneShotTimer echo_timer_;
+  base::RepeatingTimer source_timer_;
+  base::TimeDelta send_duration_;
+
+  bool stats_stream_pending_ = false;
+  int64_t stream_bytes_remaining_ = 0;
+  bool stream_fin_sent_ = false;
+  uint64_t stream_bytes_received_ = 0;
+
+  base::TimeTicks start_time_;
+  base::ThreadTicks start_cpu_time_;
+
+  base::WeakPtrFactory<BenchmarkClient> weak_factory_{this};
+
+  DISALLOW_COPY_AND_ASSIGN(BenchmarkClient);
+};
+
+}  // namespace
+}  // namespace net
+
+int main(int argc, char** argv) {
+  const char* usage = "quic_transport_benchmark_client <url>";
+  QuicSystemEventLoop event_loop("quic_transport_benchmark_client");
+  std::vector<std::string> urls =
+      quic::QuicParseCommandLineFlags(usage, argc, argv);
+  if (urls.size() != 1) {
+    quic::QuicPrintCommandLineFlagHelp(usage);
+    return 1;
+  }
+  GURL url(urls[0]);
+  if (!url.is_valid()) {
+    LOG(ERROR) << "Invalid URL: " << urls[0];
+    return 1;
+  }
+
+  quic::QuicEnableVersion(
+      net::QuicTransportClient::kQuicVersionForOriginTrial);
+  net::URLRequestContextBuilder builder;
+  builder.set_proxy_resolution_service(
+      net::ConfiguredProxyResolutionService::CreateDirect());
+  auto quic_context = std::make_unique<net::QuicContext>();
+  // Bypasses the check that only allows known certificate roots in QUIC.
+  quic_context->params()->origins_to_force_quic_on.insert(
+      net::HostPortPair(url.host(), 0));
+  builder.set_quic_context(std::move(quic_context));
+  std::unique_ptr<net::URLRequestContext> context = builder.Build();
+
+  net::QuicTransportClient::Parameters parameters;
+  const std::string fingerprint = GetQuicFlag(FLAGS_certificate_fingerprint);
+  if (!fingerprint.empty()) {
+    parameters.server_certificate_fingerprints.push_back(
+        quic::CertificateFingerprint{quic::CertificateFingerprint::kSha256,
+                                     fingerprint});
+  }
+
+  base::RunLoop run_loop;
+  net::BenchmarkClient client(url, context.get(), parameters,
+                              run_loop.QuitClosure());
+  client.Start();
+  run_loop.Run();
+  return client.succeeded() ? 0 : 1;
+}
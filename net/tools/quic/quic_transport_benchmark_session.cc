@@ -0,0 +1,310 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_transport_benchmark_session.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/stringprintf.h"
+#include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/core/quic_buffer_allocator.h"
+#include "net/third_party/quiche/src/quic/core/quic_connection.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_mem_slice.h"
+
+namespace net {
+
+namespace {
+
+// Size of the writes STREAM_SOURCE makes.
+const size_t kSourceChunkSize = 64 * 1024;
+
+}  // namespace
+
+// Reads and discards the data of an incoming stream. On a bidirectional
+// stream, replies with GetStreamReply() once the peer has sent a FIN.
+class QuicTransportBenchmarkSession::SinkVisitor
+    : public quic::QuicTransportStream::Visitor {
+ public:
+  SinkVisitor(QuicTransportBenchmarkSession* session,
+              quic::QuicTransportStream* stream)
+      : session_(session), stream_(stream), bytes_received_(0) {}
+
+  void OnCanRead() override {
+    std::string buffer;
+    size_t bytes_read = stream_->Read(&buffer);
+    bytes_received_ += bytes_read;
+    session_->stream_bytes_received_ += bytes_read;
+  }
+
+  void OnFinRead() override {
+    if (stream_->type() != quic::BIDIRECTIONAL)
+      return;
+    reply_ = session_->GetStreamReply(bytes_received_);
+    OnCanWrite();
+  }
+
+  void OnCanWrite() override {
+    if (reply_.empty() || !stream_->Write(reply_))
+      return;
+    reply_.clear();
+    stream_->SendFin();
+  }
+
+ private:
+  QuicTransportBenchmarkSession* session_;
+  quic::QuicTransportStream* stream_;
+  uint64_t bytes_received_;
+  // Reply waiting for the stream to become writable.
+  std::string reply_;
+
+  DISALLOW_COPY_AND_ASSIGN(SinkVisitor);
+};
+
+// Writes a given number of bytes on an outgoing stream, then a FIN.
+class QuicTransportBenchmarkSession::SourceVisitor
+    : public quic::QuicTransportStream::Visitor {
+ public:
+  SourceVisitor(quic::QuicTransportStream* stream, uint64_t bytes)
+      : stream_(stream),
+        bytes_remaining_(bytes),
+        chunk_(kSourceChunkSize, 's'),
+        fin_sent_(false) {}
+
+  void OnCanRead() override {}
+  void OnFinRead() override {}
+
+  void OnCanWrite() override {
+    while (bytes_remaining_ > 0) {
+      size_t size = static_cast<size_t>(
+          std::min<uint64_t>(bytes_remaining_, chunk_.size()));
+      if (!stream_->Write(quiche::QuicheStringPiece(chunk_.data(), size)))
+        return;
+      bytes_remaining_ -= size;
+    }
+    if (!fin_sent_)
+      fin_sent_ = stream_->SendFin();
+  }
+
+ private:
+  quic::QuicTransportStream* stream_;
+  uint64_t bytes_remaining_;
+  const std::string chunk_;
+  bool fin_sent_;
+
+  DISALLOW_COPY_AND_ASSIGN(SourceVisitor);
+};
+
+QuicTransportBenchmarkSession::QuicTransportBenchmarkSession(
+    quic::QuicConnection* connection,
+    bool owns_connection,
+    Visitor* owner,
+    const quic::QuicConfig& config,
+    const quic::ParsedQuicVersionVector& supported_versions,
+    const quic::QuicCryptoServerConfig* crypto_config,
+    quic::QuicCompressedCertsCache* compressed_certs_cache,
+    std::vector<url::Origin> accepted_origins)
+    : quic::QuicTransportSimpleServerSession(connection,
+                                             owns_connection,
+                                             owner,
+                                             config,
+                                             supported_versions,
+                                             crypto_config,
+                                             compressed_certs_cache,
+                                             std::move(accepted_origins)),
+      mode_(NONE),
+      source_bytes_(0),
+      source_started_(false),
+      stream_bytes_received_(0) {}
+
+QuicTransportBenchmarkSession::~QuicTransportBenchmarkSession() {
+  if (mode_ != NONE) {
+    LOG(INFO) << "QuicTransport benchmark session closed: "
+              << GetStreamReply(0);
+  }
+}
+
+bool QuicTransportBenchmarkSession::ProcessPath(const GURL& url) {
+  const std::string path = url.path();
+  if (path == kQuicTransportDatagramEchoPath) {
+    mode_ = DATAGRAM_ECHO;
+  } else if (path == kQuicTransportDatagramSinkPath) {
+    mode_ = DATAGRAM_SINK;
+  } else if (path == kQuicTransportStreamSinkPath) {
+    mode_ = STREAM_SINK;
+  } else if (path == kQuicTransportStreamSourcePath) {
+    base::StringPairs parameters;
+    base::SplitStringIntoKeyValuePairs(url.query(), '=', '&', &parameters);
+    for (const auto& parameter : parameters) {
+      if (parameter.first == "bytes" &&
+          base::StringToUint64(parameter.second, &source_bytes_)) {
+        mode_ = STREAM_SOURCE;
+      }
+    }
+    if (mode_ != STREAM_SOURCE) {
+      LOG(ERROR) << "Missing or invalid bytes parameter in " << url;
+      return false;
+    }
+  } else {
+    return quic::QuicTransportSimpleServerSession::ProcessPath(url);
+  }
+  if (base::ThreadTicks::IsSupported())
+    start_cpu_time_ = base::ThreadTicks::Now();
+  return true;
+}
+
+void QuicTransportBenchmarkSession::OnMessageReceived(
+    quiche::QuicheStringPiece message) {
+  switch (mode_) {
+    case NONE:
+      quic::QuicTransportSimpleServerSession::OnMessageReceived(message);
+      return;
+    case DATAGRAM_ECHO: {
+      quic::QuicUniqueBufferPtr buffer = quic::MakeUniqueBuffer(
+          connection()->helper()->GetStreamSendBufferAllocator(),
+          message.size());
+      memcpy(buffer.get(), message.data(), message.size());
+      datagram_queue()->SendOrQueueDatagram(
+          quic::QuicMemSlice(std::move(buffer), message.size()));
+      return;
+    }
+    case DATAGRAM_SINK: {
+      QuicTransportBenchmarkDatagram datagram;
+      if (datagram.Parse(
+              base::StringPiece(message.data(), message.size()))) {
+        datagram_stats_.OnDatagram(datagram, message.size(),
+                                   QuicTransportBenchmarkNowUs());
+      }
+      return;
+    }
+    case STREAM_SINK:
+      return;
+    case STREAM_SOURCE:
+      // The session is ready by the time the client can send a datagram, so
+      // the client starts the transfer with one.
+      MaybeStartSource();
+      return;
+  }
+}
+
+void QuicTransportBenchmarkSession::OnIncomingDataStream(
+    quic::QuicTransportStream* stream) {
+  if (mode_ == NONE) {
+    quic::QuicTransportSimpleServerSession::OnIncomingDataStream(stream);
+    return;
+  }
+  stream->set_visitor(std::make_unique<SinkVisitor>(this, stream));
+}
+
+void QuicTransportBenchmarkSession::OnCanCreateNewOutgoingStream(
+    bool unidirectional) {
+  if (mode_ == NONE) {
+    quic::QuicTransportSimpleServerSession::OnCanCreateNewOutgoingStream(
+        unidirectional);
+    return;
+  }
+  if (unidirectional && mode_ == STREAM_SOURCE)
+    MaybeStartSource();
+}
+
+std::string QuicTransportBenchmarkSession::GetStreamReply(
+    uint64_t bytes_received) const {
+  std::string reply = base::StringPrintf(
+      "stream_bytes=%llu total_stream_bytes=%llu thread_cpu_us=%lld",
+      static_cast<unsigned long long>(bytes_received),
+      static_cast<unsigned long long>(stream_bytes_received_),
+      static_cast<long long>(GetThreadCpuTime().InMicroseconds()));
+  if (mode_ == DATAGRAM_SINK)
+    reply += " " + datagram_stats_.ToString();
+  return reply;
+}
+
+void QuicTransportBenchmarkSession::MaybeStartSource() {
+  if (source_started_ || !IsSessionReady() ||
+      !CanOpenNextOutgoingUnidirectionalStream()) {
+    return;
+  }
+  source_started_ = true;
+  auto owned_stream = std::make_unique<quic::QuicTransportStream>(
+      GetNextOutgoingUnidirectionalStreamId(), this, this);
+  quic::QuicTransportStream* stream = owned_stream.get();
+  ActivateStream(std::move(owned_stream));
+  auto visitor = std::make_unique<SourceVisitor>(stream, source_bytes_);
+  SourceVisitor* visitor_ptr = visitor.get();
+  stream->set_visitor(std::move(visitor));
+  visitor_ptr->OnCanWrite();
+}
+
+base::TimeDelta QuicTransportBenchmarkSession::GetThreadCpuTime() const {
+  if (start_cpu_time_.is_null())
+    return base::TimeDelta();
+  return base::ThreadTicks::Now() - start_cpu_time_;
+}
+
+QuicTransportBenchmarkDispatcher::QuicTransportBenchmarkDispatcher(
+    const quic::QuicConfig* config,
+    const quic::QuicCryptoServerConfig* crypto_config,
+    quic::QuicVersionManager* version_manager,
+    std::unique_ptr<quic::QuicConnectionHelperInterface> helper,
+    std::unique_ptr<quic::QuicCryptoServerStreamBase::Helper> session_helper,
+    std::unique_ptr<quic::QuicAlarmFactory> alarm_factory,
+    const QuicLbConnectionIdCodec* connection_id_codec,
+    std::vector<url::Origin> accepted_origins)
+    : quic::QuicTransportSimpleServerDispatcher(
+          config,
+          crypto_config,
+          version_manager,
+          std::move(helper),
+          std::move(session_helper),
+          std::move(alarm_factory),
+          connection_id_codec ? connection_id_codec->connection_id_length()
+                              : quic::kQuicDefaultConnectionIdLength,
+          accepted_origins),
+      connection_id_codec_(connection_id_codec),
+      accepted_origins_(std::move(accepted_origins)),
+      enable_benchmark_endpoints_(false) {}
+
+QuicTransportBenchmarkDispatcher::~QuicTransportBenchmarkDispatcher() =
+    default;
+
+std::unique_ptr<quic::QuicSession>
+QuicTransportBenchmarkDispatcher::CreateQuicSession(
+    quic::QuicConnectionId server_connection_id,
+    const quic::QuicSocketAddress& peer_address,
+    quiche::QuicheStringPiece alpn,
+    const quic::ParsedQuicVersion& version) {
+  if (!enable_benchmark_endpoints_) {
+    return quic::QuicTransportSimpleServerDispatcher::CreateQuicSession(
+        server_connection_id, peer_address, alpn, version);
+  }
+  auto connection = std::make_unique<quic::QuicConnection>(
+      server_connection_id, peer_address, helper(), alarm_factory(), writer(),
+      /*owns_writer=*/false, quic::Perspective::IS_SERVER,
+      quic::ParsedQuicVersionVector{version});
+  auto session = std::make_unique<QuicTransportBenchmarkSession>(
+      connection.release(), /*owns_connection=*/true, this, config(),
+      GetSupportedVersions(), crypto_config(), compressed_certs_cache(),
+      accepted_origins_);
+  session->Initialize();
+  return session;
+}
+
+quic::QuicConnectionId
+QuicTransportBenchmarkDispatcher::GenerateNewServerConnectionId(
+    quic::ParsedQuicVersion version,
+    quic::QuicConnectionId connection_id) const {
+  if (!connection_id_codec_) {
+    return quic::QuicTransportSimpleServerDispatcher::
+        GenerateNewServerConnectionId(version, connection_id);
+  }
+  return connection_id_codec_->GenerateConnectionId(
+      quic::QuicRandom::GetInstance());
+}
+
+}  // namespace net
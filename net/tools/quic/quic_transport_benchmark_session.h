@@ -0,0 +1,130 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_TRANSPORT_BENCHMARK_SESSION_H_
+#define NET_TOOLS_QUIC_QUIC_TRANSPORT_BENCHMARK_SESSION_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/time/time.h"
+#include "net/third_party/quiche/src/quic/quic_transport/quic_transport_stream.h"
+#include "net/third_party/quiche/src/quic/tools/quic_transport_simple_server_dispatcher.h"
+#include "net/third_party/quiche/src/quic/tools/quic_transport_simple_server_session.h"
+#include "net/tools/quic/quic_lb_connection_id.h"
+#include "net/tools/quic/quic_transport_benchmark.h"
+#include "url/gurl.h"
+#include "url/origin.h"
+
+namespace net {
+
+// QuicTransport session that serves the benchmark endpoints declared in
+// quic_transport_benchmark.h in addition to the paths of
+// QuicTransportSimpleServerSession.
+class QuicTransportBenchmarkSession
+    : public quic::QuicTransportSimpleServerSession {
+ public:
+  enum Mode {
+    // Not a benchmark path; everything is handled by the base class.
+    NONE,
+    DATAGRAM_ECHO,
+    DATAGRAM_SINK,
+    STREAM_SINK,
+    STREAM_SOURCE,
+  };
+
+  QuicTransportBenchmarkSession(
+      quic::QuicConnection* connection,
+      bool owns_connection,
+      Visitor* owner,
+      const quic::QuicConfig& config,
+      const quic::ParsedQuicVersionVector& supported_versions,
+      const quic::QuicCryptoServerConfig* crypto_config,
+      quic::QuicCompressedCertsCache* compressed_certs_cache,
+      std::vector<url::Origin> accepted_origins);
+  ~QuicTransportBenchmarkSession() override;
+
+  // QuicTransportSimpleServerSession implementation.
+  bool ProcessPath(const GURL& url) override;
+  void OnMessageReceived(quiche::QuicheStringPiece message) override;
+  void OnIncomingDataStream(quic::QuicTransportStream* stream) override;
+  void OnCanCreateNewOutgoingStream(bool unidirectional) override;
+
+  Mode mode() const { return mode_; }
+  const QuicTransportDatagramSinkStats& datagram_stats() const {
+    return datagram_stats_;
+  }
+
+ private:
+  class SinkVisitor;
+  class SourceVisitor;
+
+  // Returns what the server replies on a bidirectional stream once the peer
+  // has finished it, after sending |bytes_received| bytes on it.
+  std::string GetStreamReply(uint64_t bytes_received) const;
+  // Opens the stream of STREAM_SOURCE once the peer allows it.
+  void MaybeStartSource();
+  // Returns the CPU time the server thread spent since the session started.
+  // This covers every session the thread served in the meantime, not only
+  // this one, so it is reported as thread_cpu_us.
+  base::TimeDelta GetThreadCpuTime() const;
+
+  Mode mode_;
+  // Bytes that STREAM_SOURCE still has to open a stream for.
+  uint64_t source_bytes_;
+  bool source_started_;
+  uint64_t stream_bytes_received_;
+  QuicTransportDatagramSinkStats datagram_stats_;
+  base::ThreadTicks start_cpu_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicTransportBenchmarkSession);
+};
+
+// Dispatcher creating QuicTransportBenchmarkSession instead of
+// QuicTransportSimpleServerSession when benchmark endpoints are enabled. If
+// |connection_id_codec| is not null, it issues the server connection IDs.
+class QuicTransportBenchmarkDispatcher
+    : public quic::QuicTransportSimpleServerDispatcher {
+ public:
+  QuicTransportBenchmarkDispatcher(
+      const quic::QuicConfig* config,
+      const quic::QuicCryptoServerConfig* crypto_config,
+      quic::QuicVersionManager* version_manager,
+      std::unique_ptr<quic::QuicConnectionHelperInterface> helper,
+      std::unique_ptr<quic::QuicCryptoServerStreamBase::Helper> session_helper,
+      std::unique_ptr<quic::QuicAlarmFactory> alarm_factory,
+      const QuicLbConnectionIdCodec* connection_id_codec,
+      std::vector<url::Origin> accepted_origins);
+  ~QuicTransportBenchmarkDispatcher() override;
+
+  void set_enable_benchmark_endpoints(bool enable) {
+    enable_benchmark_endpoints_ = enable;
+  }
+
+ protected:
+  // quic::QuicTransportSimpleServerDispatcher implementation.
+  std::unique_ptr<quic::QuicSession> CreateQuicSession(
+      quic::QuicConnectionId server_connection_id,
+      const quic::QuicSocketAddress& peer_address,
+      quiche::QuicheStringPiece alpn,
+      const quic::ParsedQuicVersion& version) override;
+  quic::QuicConnectionId GenerateNewServerConnectionId(
+      quic::ParsedQuicVersion version,
+      quic::QuicConnectionId connection_id) const override;
+
+ private:
+  const QuicLbConnectionIdCodec* const connection_id_codec_;  // Not owned.
+  const std::vector<url::Origin> accepted_origins_;
+  bool enable_benchmark_endpoints_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicTransportBenchmarkDispatcher);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_TRANSPORT_BENCHMARK_SESSION_H_
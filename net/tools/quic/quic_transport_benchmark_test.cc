@@ -0,0 +1,81 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_transport_benchmark.h"
+
+#include <string>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+QuicTransportBenchmarkDatagram MakeDatagram(uint64_t sequence_number,
+                                            int64_t send_time_us) {
+  QuicTransportBenchmarkDatagram datagram;
+  datagram.sequence_number = sequence_number;
+  datagram.send_time_us = send_time_us;
+  return datagram;
+}
+
+TEST(QuicTransportBenchmarkDatagramTest, RoundTrip) {
+  std::string data(100, 'x');
+  MakeDatagram(0x0102030405060708, 123456789).Serialize(&data[0]);
+
+  QuicTransportBenchmarkDatagram parsed;
+  ASSERT_TRUE(parsed.Parse(data));
+  EXPECT_EQ(0x0102030405060708u, parsed.sequence_number);
+  EXPECT_EQ(123456789, parsed.send_time_us);
+  EXPECT_EQ(0x01, data[0]);
+  EXPECT_EQ('x', data[QuicTransportBenchmarkDatagram::kHeaderSize]);
+}
+
+TEST(QuicTransportBenchmarkDatagramTest, TooShort) {
+  std::string data(QuicTransportBenchmarkDatagram::kHeaderSize - 1, 0);
+  QuicTransportBenchmarkDatagram parsed;
+  EXPECT_FALSE(parsed.Parse(data));
+}
+
+TEST(QuicTransportDatagramSinkStatsTest, Empty) {
+  QuicTransportDatagramSinkStats stats;
+  EXPECT_EQ(0u, stats.num_received());
+  EXPECT_EQ(0u, stats.num_lost());
+  EXPECT_EQ(0, stats.mean_latency_us());
+  EXPECT_EQ(
+      "received=0 bytes=0 lost=0 reordered=0 min_latency_us=0 "
+      "mean_latency_us=0 max_latency_us=0",
+      stats.ToString());
+}
+
+TEST(QuicTransportDatagramSinkStatsTest, LossAndReordering) {
+  QuicTransportDatagramSinkStats stats;
+  stats.OnDatagram(MakeDatagram(0, 1000), 100, 1010);
+  stats.OnDatagram(MakeDatagram(2, 1000), 100, 1030);
+  stats.OnDatagram(MakeDatagram(5, 1000), 100, 1020);
+  EXPECT_EQ(3u, stats.num_lost());
+  EXPECT_EQ(0u, stats.num_reordered());
+
+  // A late datagram is no longer lost.
+  stats.OnDatagram(MakeDatagram(1, 1000), 100, 1040);
+  EXPECT_EQ(4u, stats.num_received());
+  EXPECT_EQ(400u, stats.num_bytes());
+  EXPECT_EQ(2u, stats.num_lost());
+  EXPECT_EQ(1u, stats.num_reordered());
+
+  EXPECT_EQ(10, stats.min_latency_us());
+  EXPECT_EQ(25, stats.mean_latency_us());
+  EXPECT_EQ(40, stats.max_latency_us());
+}
+
+TEST(QuicTransportDatagramSinkStatsTest, ClockSkewClampsLatency) {
+  QuicTransportDatagramSinkStats stats;
+  stats.OnDatagram(MakeDatagram(0, 2000), 100, 1000);
+  EXPECT_EQ(0, stats.min_latency_us());
+  EXPECT_EQ(0, stats.max_latency_us());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -0,0 +1,214 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_transport_sharded_server.h"
+
+#include <stdlib.h>
+
+#include <string>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "net/third_party/quiche/src/quic/core/quic_constants.h"
+#include "net/third_party/quiche/src/quic/core/quic_packets.h"
+#include "net/tools/quic/quic_transport_simple_server.h"
+
+namespace net {
+
+namespace {
+
+// Offset of the destination connection ID length in long header packets,
+// after the first octet and the version (RFC 8999).
+const size_t kLongHeaderConnectionIdLengthOffset = 5;
+
+}  // namespace
+
+// A QuicTransportSimpleServer and the thread it runs on. Everything but
+// thread() and SteerPacket() runs on that thread.
+class QuicTransportShardedServer::Shard {
+ public:
+  Shard(QuicTransportShardedServer* owner, size_t index)
+      : owner_(owner),
+        index_(index),
+        thread_("QuicTransportShard" + base::NumberToString(index)),
+        codec_(CreateConnectionIdCodec(index)) {}
+
+  ~Shard() { DCHECK(!server_); }
+
+  base::Thread* thread() { return &thread_; }
+  const IPEndPoint& server_address() const { return server_address_; }
+
+  void Start(int port,
+             std::unique_ptr<quic::ProofSource> proof_source,
+             base::WaitableEvent* started,
+             int* result) {
+    server_ = std::make_unique<QuicTransportSimpleServer>(
+        port, owner_->accepted_origins_, std::move(proof_source),
+        CreateConnectionIdCodec(index_));
+    server_->set_share_port(true);
+    server_->set_enable_benchmark_endpoints(
+        owner_->enable_benchmark_endpoints_);
+    server_->set_packet_steering_callback(base::BindRepeating(
+        &Shard::SteerPacket, base::Unretained(this)));
+    if (owner_->read_error_callback_) {
+      server_->set_read_error_callback(
+          QuicTransportSimpleServer::ReadErrorCallback(
+              owner_->read_error_callback_));
+    }
+    *result = server_->Start();
+    server_address_ = server_->server_address();
+    started->Signal();
+  }
+
+  void Stop() { server_.reset(); }
+
+ private:
+  bool SteerPacket(const IPEndPoint& client_address,
+                   const quic::QuicReceivedPacket& packet) {
+    size_t shard_index;
+    if (!GetShardForPacket(*codec_, packet.data(), packet.length(),
+                           &shard_index) ||
+        shard_index == index_ || shard_index >= owner_->shards_.size()) {
+      return false;
+    }
+    Shard* target = owner_->shards_[shard_index].get();
+    target->thread()->task_runner()->PostTask(
+        FROM_HERE,
+        base::BindOnce(&Shard::ProcessForwardedPacket,
+                       base::Unretained(target), client_address,
+                       packet.Clone()));
+    return true;
+  }
+
+  void ProcessForwardedPacket(
+      const IPEndPoint& client_address,
+      std::unique_ptr<quic::QuicReceivedPacket> packet) {
+    // The server is gone if the shard is shutting down.
+    if (server_)
+      server_->ProcessPacket(client_address, *packet);
+  }
+
+  QuicTransportShardedServer* const owner_;
+  const size_t index_;
+  base::Thread thread_;
+  // Decodes the shard index of incoming packets.
+  const std::unique_ptr<QuicLbConnectionIdCodec> codec_;
+  std::unique_ptr<QuicTransportSimpleServer> server_;
+  IPEndPoint server_address_;
+
+  DISALLOW_COPY_AND_ASSIGN(Shard);
+};
+
+QuicTransportShardedServer::QuicTransportShardedServer(
+    int port,
+    std::vector<url::Origin> accepted_origins,
+    ProofSourceFactory proof_source_factory,
+    size_t num_shards)
+    : port_(port),
+      accepted_origins_(std::move(accepted_origins)),
+      proof_source_factory_(std::move(proof_source_factory)),
+      enable_benchmark_endpoints_(false) {
+  DCHECK_GT(num_shards, 0u);
+  DCHECK_LE(num_shards, kQuicTransportMaxShards);
+  for (size_t i = 0; i < num_shards; ++i)
+    shards_.push_back(std::make_unique<Shard>(this, i));
+}
+
+QuicTransportShardedServer::~QuicTransportShardedServer() {
+  // Servers are destroyed on their threads before any thread stops, so that
+  // packets forwarded in the meantime find no server rather than a dangling
+  // one.
+  for (const auto& shard : shards_) {
+    if (shard->thread()->IsRunning()) {
+      shard->thread()->task_runner()->PostTask(
+          FROM_HERE, base::BindOnce(&Shard::Stop,
+                                    base::Unretained(shard.get())));
+    }
+  }
+  for (const auto& shard : shards_)
+    shard->thread()->Stop();
+}
+
+int QuicTransportShardedServer::Start() {
+  int port = port_;
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    Shard* shard = shards_[i].get();
+    base::Thread::Options options;
+    options.message_pump_type = base::MessagePumpType::IO;
+    if (!shard->thread()->StartWithOptions(options))
+      return EXIT_FAILURE;
+
+    base::WaitableEvent started;
+    int result = EXIT_FAILURE;
+    shard->thread()->task_runner()->PostTask(
+        FROM_HERE,
+        base::BindOnce(&Shard::Start, base::Unretained(shard), port,
+                       proof_source_factory_.Run(), &started, &result));
+    started.Wait();
+    if (result != EXIT_SUCCESS)
+      return result;
+    // Later shards join the port the first one bound, which matters if
+    // |port_| is 0.
+    if (i == 0) {
+      server_address_ = shard->server_address();
+      port = server_address_.port();
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+// static
+std::unique_ptr<QuicLbConnectionIdCodec>
+QuicTransportShardedServer::CreateConnectionIdCodec(size_t shard_index) {
+  DCHECK_LT(shard_index, kQuicTransportMaxShards);
+  QuicLbConfig config;
+  config.mode = QuicLbConfig::PLAINTEXT;
+  config.server_id_length = 1;
+  config.server_id = std::string(1, static_cast<char>(shard_index));
+  config.connection_id_length = quic::kQuicDefaultConnectionIdLength + 1;
+  return QuicLbConnectionIdCodec::Create(config);
+}
+
+// static
+bool QuicTransportShardedServer::GetShardForPacket(
+    const QuicLbConnectionIdCodec& codec,
+    const char* data,
+    size_t length,
+    size_t* shard_index) {
+  if (length == 0)
+    return false;
+  size_t connection_id_offset;
+  size_t connection_id_length;
+  if (data[0] & 0x80) {
+    if (length <= kLongHeaderConnectionIdLengthOffset)
+      return false;
+    connection_id_offset = kLongHeaderConnectionIdLengthOffset + 1;
+    connection_id_length =
+        static_cast<uint8_t>(data[kLongHeaderConnectionIdLengthOffset]);
+  } else {
+    connection_id_offset = 1;
+    connection_id_length = codec.connection_id_length();
+  }
+  if (connection_id_length != codec.connection_id_length() ||
+      length < connection_id_offset + connection_id_length) {
+    return false;
+  }
+
+  std::string server_id;
+  if (!codec.ExtractServerId(
+          quic::QuicConnectionId(data + connection_id_offset,
+                                 static_cast<uint8_t>(connection_id_length)),
+          &server_id) ||
+      server_id.size() != 1) {
+    return false;
+  }
+  *shard_index = static_cast<uint8_t>(server_id[0]);
+  return true;
+}
+
+}  // namespace net
@@ -0,0 +1,89 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_TRANSPORT_SHARDED_SERVER_H_
+#define NET_TOOLS_QUIC_QUIC_TRANSPORT_SHARDED_SERVER_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "net/base/ip_endpoint.h"
+#include "net/third_party/quiche/src/quic/core/crypto/proof_source.h"
+#include "net/tools/quic/quic_lb_connection_id.h"
+#include "url/origin.h"
+
+namespace net {
+
+// Shard indices must fit in the one-octet server ID of the connection IDs.
+const size_t kQuicTransportMaxShards = 256;
+
+// Runs one QuicTransportSimpleServer per thread, all listening on the same
+// port with SO_REUSEPORT. The kernel spreads flows across the threads by
+// address 4-tuple. Server connection IDs carry the index of the shard that
+// issued them, and a shard forwards packets for another shard's connection
+// IDs, e.g. after a client's NAT rebinding, to that shard. Each session
+// therefore lives on exactly one thread.
+class QuicTransportShardedServer {
+ public:
+  using ProofSourceFactory =
+      base::RepeatingCallback<std::unique_ptr<quic::ProofSource>()>;
+  // May run on any shard thread.
+  using ReadErrorCallback = base::RepeatingCallback<void(int)>;
+
+  QuicTransportShardedServer(int port,
+                             std::vector<url::Origin> accepted_origins,
+                             ProofSourceFactory proof_source_factory,
+                             size_t num_shards);
+  ~QuicTransportShardedServer();
+
+  // Starts the shard threads and blocks until every shard listens.
+  int Start();
+
+  IPEndPoint server_address() const { return server_address_; }
+  size_t num_shards() const { return shards_.size(); }
+
+  // Must be called before Start().
+  void set_enable_benchmark_endpoints(bool enable) {
+    enable_benchmark_endpoints_ = enable;
+  }
+  void set_read_error_callback(ReadErrorCallback callback) {
+    read_error_callback_ = std::move(callback);
+  }
+
+  // Returns the codec the shard at |shard_index| issues connection IDs with.
+  // Their length differs from the default client-chosen length, so that the
+  // dispatcher always replaces client-chosen connection IDs.
+  static std::unique_ptr<QuicLbConnectionIdCodec> CreateConnectionIdCodec(
+      size_t shard_index);
+
+  // Sets |shard_index| to the shard that issued the destination connection
+  // ID of the packet in |data|. Returns false if no shard issued it, e.g.
+  // for the first packets of a connection, which carry a client-chosen ID.
+  static bool GetShardForPacket(const QuicLbConnectionIdCodec& codec,
+                                const char* data,
+                                size_t length,
+                                size_t* shard_index);
+
+ private:
+  class Shard;
+
+  const int port_;
+  const std::vector<url::Origin> accepted_origins_;
+  ProofSourceFactory proof_source_factory_;
+  bool enable_benchmark_endpoints_;
+  ReadErrorCallback read_error_callback_;
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  IPEndPoint server_address_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicTransportShardedServer);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_TRANSPORT_SHARDED_SERVER_H_
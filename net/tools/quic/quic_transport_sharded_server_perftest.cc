@@ -0,0 +1,322 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how the datagram echo rate of a QuicTransportShardedServer scales
+// with its number of shards. Clients, each on its own thread and connection,
+// keep datagrams in flight to the datagram echo endpoint over loopback. The
+// clients run on the same host as the server, so stories with more shards
+// than half the processors are skipped: they would measure contention with
+// the clients rather than the server.
+
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/barrier_closure.h"
+#include "base/bind.h"
+#include "base/callback.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/run_loop.h"
+#include "base/single_thread_task_runner.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/system/sys_info.h"
+#include "base/threading/thread.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "net/base/host_port_pair.h"
+#include "net/base/net_errors.h"
+#include "net/base/network_isolation_key.h"
+#include "net/cert/mock_cert_verifier.h"
+#include "net/dns/mock_host_resolver.h"
+#include "net/proxy_resolution/configured_proxy_resolution_service.h"
+#include "net/quic/quic_context.h"
+#include "net/quic/quic_transport_client.h"
+#include "net/test/test_with_task_environment.h"
+#include "net/third_party/quiche/src/quic/core/quic_buffer_allocator.h"
+#include "net/third_party/quiche/src/quic/core/quic_connection.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_mem_slice.h"
+#include "net/third_party/quiche/src/quic/quic_transport/quic_transport_client_session.h"
+#include "net/third_party/quiche/src/quic/test_tools/crypto_test_utils.h"
+#include "net/tools/quic/quic_transport_benchmark.h"
+#include "net/tools/quic/quic_transport_sharded_server.h"
+#include "net/url_request/url_request_context.h"
+#include "net/url_request/url_request_context_builder.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+#include "url/gurl.h"
+#include "url/origin.h"
+
+namespace net {
+namespace test {
+namespace {
+
+const char kHost[] = "test.example.com";
+const int kNumClients = 8;
+const uint64_t kDatagramsPerClient = 20000;
+const int kMaxOutstandingDatagrams = 64;
+const size_t kDatagramSize = 1000;
+// Time without echoes after which outstanding datagrams are declared lost.
+constexpr base::TimeDelta kEchoTimeout = base::TimeDelta::FromMilliseconds(500);
+
+const char kMetricPrefix[] = "QuicTransportShardedServer.";
+const char kMetricEchoRate[] = "echo_rate";
+const char kMetricEchoesLost[] = "echoes_lost";
+
+// Sends kDatagramsPerClient datagrams to the echo endpoint, keeping
+// kMaxOutstandingDatagrams in flight, and reports the echoes to the thread
+// that created it. Start() and Stop() must run on the client's own thread.
+class EchoClient : public QuicTransportClient::Visitor {
+ public:
+  using DoneCallback = base::OnceCallback<
+      void(uint64_t num_echoed, uint64_t num_lost, base::TimeDelta elapsed)>;
+
+  EchoClient(const GURL& url,
+             const url::Origin& origin,
+             DoneCallback done_callback)
+      : url_(url),
+        origin_(origin),
+        done_callback_(std::move(done_callback)),
+        done_task_runner_(base::ThreadTaskRunnerHandle::Get()),
+        datagram_(kDatagramSize, 'd') {}
+
+  ~EchoClient() override = default;
+
+  void Start() {
+    URLRequestContextBuilder builder;
+    builder.set_proxy_resolution_service(
+        ConfiguredProxyResolutionService::CreateDirect());
+    auto cert_verifier = std::make_unique<MockCertVerifier>();
+    cert_verifier->set_default_result(OK);
+    builder.SetCertVerifier(std::move(cert_verifier));
+    auto host_resolver = std::make_unique<MockHostResolver>();
+    host_resolver->rules()->AddRule(kHost, "127.0.0.1");
+    builder.set_host_resolver(std::move(host_resolver));
+    auto quic_context = std::make_unique<QuicContext>();
+    // Bypasses the check that only allows known certificate roots in QUIC.
+    quic_context->params()->origins_to_force_quic_on.insert(
+        HostPortPair(kHost, 0));
+    builder.set_quic_context(std::move(quic_context));
+    context_ = builder.Build();
+
+    client_ = std::make_unique<QuicTransportClient>(
+        url_, origin_, this, NetworkIsolationKey(origin_, origin_),
+        context_.get(), QuicTransportClient::Parameters());
+    client_->Connect();
+  }
+
+  void Stop() {
+    echo_timer_.Stop();
+    client_.reset();
+    context_.reset();
+  }
+
+  // QuicTransportClient::Visitor implementation.
+  void OnConnected() override {
+    start_time_ = base::TimeTicks::Now();
+    SendDatagrams();
+  }
+
+  void OnConnectionFailed() override {
+    LOG(ERROR) << "Connection failed: " << client_->error();
+    Finish();
+  }
+
+  void OnClosed() override { Finish(); }
+
+  void OnError() override {
+    LOG(ERROR) << "Session error: " << client_->error();
+    Finish();
+  }
+
+  void OnIncomingBidirectionalStreamAvailable() override {}
+  void OnIncomingUnidirectionalStreamAvailable() override {}
+
+  void OnDatagramReceived(base::StringPiece datagram) override {
+    ++num_echoed_;
+    if (num_outstanding_ > 0)
+      --num_outstanding_;
+    SendDatagrams();
+  }
+
+  void OnCanCreateNewOutgoingBidirectionalStream() override {}
+  void OnCanCreateNewOutgoingUnidirectionalStream() override {}
+
+ private:
+  void SendDatagrams() {
+    while (num_outstanding_ < kMaxOutstandingDatagrams &&
+           num_sent_ < kDatagramsPerClient) {
+      SendDatagram();
+      ++num_outstanding_;
+    }
+    if (num_outstanding_ == 0) {
+      Finish();
+      return;
+    }
+    echo_timer_.Start(FROM_HERE, kEchoTimeout, this,
+                      &EchoClient::OnEchoTimeout);
+  }
+
+  void SendDatagram() {
+    QuicTransportBenchmarkDatagram header;
+    header.sequence_number = num_sent_++;
+    header.send_time_us = QuicTransportBenchmarkNowUs();
+    header.Serialize(&datagram_[0]);
+
+    quic::QuicConnection* connection = client_->session()->connection();
+    quic::QuicUniqueBufferPtr buffer = quic::MakeUniqueBuffer(
+        connection->helper()->GetStreamSendBufferAllocator(),
+        datagram_.size());
+    memcpy(buffer.get(), datagram_.data(), datagram_.size());
+    client_->session()->datagram_queue()->SendOrQueueDatagram(
+        quic::QuicMemSlice(std::move(buffer), datagram_.size()));
+  }
+
+  void OnEchoTimeout() {
+    num_lost_ += num_outstanding_;
+    num_outstanding_ = 0;
+    SendDatagrams();
+  }
+
+  void Finish() {
+    if (!done_callback_)
+      return;
+    echo_timer_.Stop();
+    base::TimeDelta elapsed = start_time_.is_null()
+                                  ? base::TimeDelta()
+                                  : base::TimeTicks::Now() - start_time_;
+    done_task_runner_->PostTask(
+        FROM_HERE, base::BindOnce(std::move(done_callback_), num_echoed_,
+                                  num_lost_, elapsed));
+  }
+
+  const GURL url_;
+  const url::Origin origin_;
+  DoneCallback done_callback_;
+  scoped_refptr<base::SingleThreadTaskRunner> done_task_runner_;
+
+  std::unique_ptr<URLRequestContext> context_;
+  std::unique_ptr<QuicTransportClient> client_;
+
+  // Datagram sent next; starts with a QuicTransportBenchmarkDatagram.
+  std::string datagram_;
+  uint64_t num_sent_ = 0;
+  int num_outstanding_ = 0;
+  uint64_t num_echoed_ = 0;
+  uint64_t num_lost_ = 0;
+  base::OneShotTimer echo_timer_;
+  base::TimeTicks start_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(EchoClient);
+};
+
+class QuicTransportShardedServerPerfTest : public TestWithTaskEnvironment {
+ protected:
+  QuicTransportShardedServerPerfTest()
+      : origin_(url::Origin::Create(GURL("https://example.org"))) {
+    quic::QuicEnableVersion(QuicTransportClient::kQuicVersionForOriginTrial);
+  }
+
+  void RunEcho(size_t num_shards) {
+    if (num_shards > 1 &&
+        num_shards * 2 >
+            static_cast<size_t>(base::SysInfo::NumberOfProcessors())) {
+      LOG(WARNING) << "Skipping " << num_shards << " shards on "
+                   << base::SysInfo::NumberOfProcessors() << " processors";
+      return;
+    }
+
+    QuicTransportShardedServer server(
+        /*port=*/0, std::vector<url::Origin>({origin_}),
+        base::BindRepeating(
+            &quic::test::crypto_test_utils::ProofSourceForTesting),
+        num_shards);
+    server.set_enable_benchmark_endpoints(true);
+    ASSERT_EQ(EXIT_SUCCESS, server.Start());
+    GURL url(base::StringPrintf("quic-transport://%s:%d%s", kHost,
+                                server.server_address().port(),
+                                kQuicTransportDatagramEchoPath));
+
+    total_echoed_ = 0;
+    total_lost_ = 0;
+    max_elapsed_ = base::TimeDelta();
+    base::RunLoop run_loop;
+    base::RepeatingClosure client_done =
+        base::BarrierClosure(kNumClients, run_loop.QuitClosure());
+    std::vector<std::unique_ptr<base::Thread>> threads;
+    std::vector<std::unique_ptr<EchoClient>> clients;
+    for (int i = 0; i < kNumClients; ++i) {
+      auto thread = std::make_unique<base::Thread>(
+          "EchoClient" + base::NumberToString(i));
+      ASSERT_TRUE(thread->StartWithOptions(
+          base::Thread::Options(base::MessagePumpType::IO, 0)));
+      auto client = std::make_unique<EchoClient>(
+          url, origin_,
+          base::BindOnce(&QuicTransportShardedServerPerfTest::OnClientDone,
+                         base::Unretained(this), client_done));
+      thread->task_runner()->PostTask(
+          FROM_HERE,
+          base::BindOnce(&EchoClient::Start, base::Unretained(client.get())));
+      threads.push_back(std::move(thread));
+      clients.push_back(std::move(client));
+    }
+    run_loop.Run();
+    for (int i = 0; i < kNumClients; ++i) {
+      threads[i]->task_runner()->PostTask(
+          FROM_HERE, base::BindOnce(&EchoClient::Stop,
+                                    base::Unretained(clients[i].get())));
+      threads[i]->Stop();
+    }
+
+    ASSERT_GT(total_echoed_, 0u);
+    perf_test::PerfResultReporter reporter(
+        kMetricPrefix, "shards_" + base::NumberToString(num_shards));
+    reporter.RegisterImportantMetric(kMetricEchoRate, "runs/s");
+    reporter.RegisterImportantMetric(kMetricEchoesLost, "count");
+    reporter.AddResult(kMetricEchoRate,
+                       total_echoed_ / max_elapsed_.InSecondsF());
+    reporter.AddResult(kMetricEchoesLost, static_cast<size_t>(total_lost_));
+  }
+
+ private:
+  void OnClientDone(base::RepeatingClosure done,
+                    uint64_t num_echoed,
+                    uint64_t num_lost,
+                    base::TimeDelta elapsed) {
+    total_echoed_ += num_echoed;
+    total_lost_ += num_lost;
+    max_elapsed_ = std::max(max_elapsed_, elapsed);
+    done.Run();
+  }
+
+  const url::Origin origin_;
+  uint64_t total_echoed_ = 0;
+  uint64_t total_lost_ = 0;
+  base::TimeDelta max_elapsed_;
+};
+
+TEST_F(QuicTransportShardedServerPerfTest, OneShard) {
+  RunEcho(1);
+}
+
+TEST_F(QuicTransportShardedServerPerfTest, TwoShards) {
+  RunEcho(2);
+}
+
+TEST_F(QuicTransportShardedServerPerfTest, FourShards) {
+  RunEcho(4);
+}
+
+TEST_F(QuicTransportShardedServerPerfTest, EightShards) {
+  RunEcho(8);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -0,0 +1,94 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_transport_sharded_server.h"
+
+#include <string>
+
+#include "net/third_party/quiche/src/quic/core/crypto/quic_random.h"
+#include "net/third_party/quiche/src/quic/core/quic_constants.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace test {
+namespace {
+
+// Returns a short header packet for |connection_id|.
+std::string MakeShortHeaderPacket(const quic::QuicConnectionId& connection_id) {
+  std::string packet(1, 0x40);
+  packet.append(connection_id.data(), connection_id.length());
+  packet.append(20, 'p');
+  return packet;
+}
+
+// Returns a long header packet for |connection_id|.
+std::string MakeLongHeaderPacket(const quic::QuicConnectionId& connection_id) {
+  std::string packet("\xc0\xff\x00\x00\x1d", 5);
+  packet.push_back(static_cast<char>(connection_id.length()));
+  packet.append(connection_id.data(), connection_id.length());
+  packet.push_back(0);  // Source connection ID length.
+  packet.append(20, 'p');
+  return packet;
+}
+
+TEST(QuicTransportShardedServerTest, ConnectionIdsRouteToTheirShard) {
+  std::unique_ptr<QuicLbConnectionIdCodec> decoder =
+      QuicTransportShardedServer::CreateConnectionIdCodec(0);
+  ASSERT_TRUE(decoder);
+  for (size_t shard : {0u, 1u, 7u, 255u}) {
+    std::unique_ptr<QuicLbConnectionIdCodec> codec =
+        QuicTransportShardedServer::CreateConnectionIdCodec(shard);
+    ASSERT_TRUE(codec);
+    quic::QuicConnectionId connection_id =
+        codec->GenerateConnectionId(quic::QuicRandom::GetInstance());
+    EXPECT_NE(quic::kQuicDefaultConnectionIdLength, connection_id.length());
+
+    size_t shard_index = 0;
+    std::string packet = MakeShortHeaderPacket(connection_id);
+    ASSERT_TRUE(QuicTransportShardedServer::GetShardForPacket(
+        *decoder, packet.data(), packet.size(), &shard_index));
+    EXPECT_EQ(shard, shard_index);
+
+    shard_index = 0;
+    packet = MakeLongHeaderPacket(connection_id);
+    ASSERT_TRUE(QuicTransportShardedServer::GetShardForPacket(
+        *decoder, packet.data(), packet.size(), &shard_index));
+    EXPECT_EQ(shard, shard_index);
+  }
+}
+
+TEST(QuicTransportShardedServerTest, ClientChosenConnectionIdIsNotRouted) {
+  std::unique_ptr<QuicLbConnectionIdCodec> decoder =
+      QuicTransportShardedServer::CreateConnectionIdCodec(0);
+  quic::QuicConnectionId client_chosen = quic::QuicConnectionId(
+      "\x01\x02\x03\x04\x05\x06\x07\x08", quic::kQuicDefaultConnectionIdLength);
+  std::string packet = MakeLongHeaderPacket(client_chosen);
+  size_t shard_index;
+  EXPECT_FALSE(QuicTransportShardedServer::GetShardForPacket(
+      *decoder, packet.data(), packet.size(), &shard_index));
+}
+
+TEST(QuicTransportShardedServerTest, TruncatedPackets) {
+  std::unique_ptr<QuicLbConnectionIdCodec> codec =
+      QuicTransportShardedServer::CreateConnectionIdCodec(3);
+  quic::QuicConnectionId connection_id =
+      codec->GenerateConnectionId(quic::QuicRandom::GetInstance());
+  size_t shard_index;
+  EXPECT_FALSE(QuicTransportShardedServer::GetShardForPacket(
+      *codec, nullptr, 0, &shard_index));
+
+  std::string packet = MakeShortHeaderPacket(connection_id);
+  EXPECT_FALSE(QuicTransportShardedServer::GetShardForPacket(
+      *codec, packet.data(), connection_id.length(), &shard_index));
+
+  packet = MakeLongHeaderPacket(connection_id);
+  EXPECT_FALSE(QuicTransportShardedServer::GetShardForPacket(
+      *codec, packet.data(), 5, &shard_index));
+  EXPECT_FALSE(QuicTransportShardedServer::GetShardForPacket(
+      *codec, packet.data(), 6 + connection_id.length() - 1, &shard_index));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace net
@@ -14,7 +14,6 @@
 #include "net/quic/quic_chromium_alarm_factory.h"
 #include "net/quic/quic_chromium_connection_helper.h"
 #include "net/socket/udp_server_socket.h"
-#include "net/third_party/quiche/src/quic/tools/quic_transport_simple_server_dispatcher.h"
 #include "net/tools/quic/quic_simple_server_packet_writer.h"
 #include "net/tools/quic/quic_simple_server_socket.h"
 
@@ -62,13 +61,25 @@ QuicTransportSimpleServer::QuicTransportSimpleServer(
     int port,
     std::vector<url::Origin> accepted_origins,
     std::unique_ptr<quic::ProofSource> proof_source)
+    : QuicTransportSimpleServer(port,
+                                std::move(accepted_origins),
+                                std::move(proof_source),
+                                /*connection_id_codec=*/nullptr) {}
+
+QuicTransportSimpleServer::QuicTransportSimpleServer(
+    int port,
+    std::vector<url::Origin> accepted_origins,
+    std::unique_ptr<quic::ProofSource> proof_source,
+    std::unique_ptr<QuicLbConnectionIdCodec> connection_id_codec)
     : port_(port),
+      share_port_(false),
       version_manager_(AllVersionsValidForQuicTransport()),
       clock_(QuicChromiumClock::GetInstance()),
       crypto_config_(kSourceAddressTokenSecret,
                      quic::QuicRandom::GetInstance(),
                      std::move(proof_source),
                      quic::KeyExchangeSource::Default()),
+      connection_id_codec_(std::move(connection_id_codec)),
       dispatcher_(&config_,
                   &crypto_config_,
                   &version_manager_,
@@ -79,7 +90,7 @@ QuicTransportSimpleServer::QuicTransportSimpleServer(
                   std::make_unique<QuicChromiumAlarmFactory>(
                       base::ThreadTaskRunnerHandle::Get().get(),
                       clock_),
-                  quic::kQuicDefaultConnectionIdLength,
+                  connection_id_codec_.get(),
                   accepted_origins),
       read_buffer_(base::MakeRefCounted<IOBufferWithSize>(kReadBufferSize)) {}
 
@@ -87,7 +98,8 @@ QuicTransportSimpleServer::~QuicTransportSimpleServer() {}
 
 int QuicTransportSimpleServer::Start() {
   socket_ = CreateQuicSimpleServerSocket(
-      IPEndPoint{IPAddress::IPv6AllZeros(), port_}, &server_address_);
+      IPEndPoint{IPAddress::IPv6AllZeros(), port_}, &server_address_,
+      share_port_);
   if (socket_ == nullptr)
     return EXIT_FAILURE;
 
@@ -138,8 +150,18 @@ void QuicTransportSimpleServer::ProcessReadPacket(int result) {
 
   quic::QuicReceivedPacket packet(read_buffer_->data(), /*length=*/result,
                                   clock_->Now(), /*owns_buffer=*/false);
+  if (packet_steering_callback_ &&
+      packet_steering_callback_.Run(client_address_, packet)) {
+    return;
+  }
+  ProcessPacket(client_address_, packet);
+}
+
+void QuicTransportSimpleServer::ProcessPacket(
+    const IPEndPoint& client_address,
+    const quic::QuicReceivedPacket& packet) {
   dispatcher_.ProcessPacket(ToQuicSocketAddress(server_address_),
-                            ToQuicSocketAddress(client_address_), packet);
+                            ToQuicSocketAddress(client_address), packet);
 }
 
 }  // namespace net
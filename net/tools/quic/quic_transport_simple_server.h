@@ -5,6 +5,7 @@
 #ifndef NET_TOOLS_QUIC_QUIC_TRANSPORT_SIMPLE_SERVER_H_
 #define NET_TOOLS_QUIC_QUIC_TRANSPORT_SIMPLE_SERVER_H_
 
+#include "base/callback.h"
 #include "base/memory/weak_ptr.h"
 #include "net/base/io_buffer.h"
 #include "net/base/ip_endpoint.h"
@@ -13,8 +14,9 @@
 #include "net/third_party/quiche/src/quic/core/crypto/quic_crypto_server_config.h"
 #include "net/third_party/quiche/src/quic/core/quic_config.h"
 #include "net/third_party/quiche/src/quic/core/quic_version_manager.h"
-#include "net/third_party/quiche/src/quic/tools/quic_transport_simple_server_dispatcher.h"
 #include "net/third_party/quiche/src/quic/tools/quic_transport_simple_server_session.h"
+#include "net/tools/quic/quic_lb_connection_id.h"
+#include "net/tools/quic/quic_transport_benchmark_session.h"
 #include "url/origin.h"
 
 namespace net {
@@ -25,20 +27,49 @@ namespace net {
 class QuicTransportSimpleServer {
  public:
   using ReadErrorCallback = base::OnceCallback<void(int)>;
+  // Called for every packet read before it is dispatched. Returns true if it
+  // took the packet over, e.g. to hand it to another server.
+  using PacketSteeringCallback =
+      base::RepeatingCallback<bool(const IPEndPoint& client_address,
+                                   const quic::QuicReceivedPacket& packet)>;
 
   QuicTransportSimpleServer(int port,
                             std::vector<url::Origin> accepted_origins,
                             std::unique_ptr<quic::ProofSource> proof_source);
+  // Issues server connection IDs from |connection_id_codec| if not null.
+  QuicTransportSimpleServer(
+      int port,
+      std::vector<url::Origin> accepted_origins,
+      std::unique_ptr<quic::ProofSource> proof_source,
+      std::unique_ptr<QuicLbConnectionIdCodec> connection_id_codec);
   ~QuicTransportSimpleServer();
 
   int Start();
 
+  // Dispatches a packet another server read on the port this one shares.
+  void ProcessPacket(const IPEndPoint& client_address,
+                     const quic::QuicReceivedPacket& packet);
+
   IPEndPoint server_address() const { return server_address_; }
 
   void set_read_error_callback(ReadErrorCallback callback) {
     read_error_callback_ = std::move(callback);
   }
 
+  // Serves the benchmark endpoints declared in quic_transport_benchmark.h.
+  // Must be called before Start().
+  void set_enable_benchmark_endpoints(bool enable) {
+    dispatcher_.set_enable_benchmark_endpoints(enable);
+  }
+
+  // Listens with SO_REUSEPORT, so that other servers can listen on the same
+  // port. Must be called before Start().
+  void set_share_port(bool share_port) { share_port_ = share_port; }
+
+  void set_packet_steering_callback(PacketSteeringCallback callback) {
+    packet_steering_callback_ = std::move(callback);
+  }
+
  private:
   // Schedules a ReadPackets() call on the next iteration of the event loop.
   void ScheduleReadPackets();
@@ -50,15 +81,18 @@ class QuicTransportSimpleServer {
   void ProcessReadPacket(int result);
 
   const int port_;
+  bool share_port_;
 
   ReadErrorCallback read_error_callback_;
+  PacketSteeringCallback packet_steering_callback_;
 
   quic::QuicVersionManager version_manager_;
   quic::QuicChromiumClock* clock_;  // Not owned.
   quic::QuicConfig config_;
   quic::QuicCryptoServerConfig crypto_config_;
+  std::unique_ptr<QuicLbConnectionIdCodec> connection_id_codec_;
 
-  quic::QuicTransportSimpleServerDispatcher dispatcher_;
+  QuicTransportBenchmarkDispatcher dispatcher_;
   std::unique_ptr<UDPServerSocket> socket_;
   IPEndPoint server_address_;
 
@@ -6,6 +6,7 @@
 #include "net/third_party/quiche/src/quic/platform/api/quic_default_proof_providers.h"
 #include "net/third_party/quiche/src/quic/platform/api/quic_flags.h"
 #include "net/third_party/quiche/src/quic/platform/api/quic_system_event_loop.h"
+#include "net/tools/quic/quic_transport_sharded_server.h"
 #include "net/tools/quic/quic_transport_simple_server.h"
 #include "url/gurl.h"
 
@@ -16,6 +17,20 @@ DEFINE_QUIC_COMMAND_LINE_FLAG(std::string,
                               "",
                               "Comma-separated list of accepted origins");
 
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    bool,
+    enable_benchmark_endpoints,
+    false,
+    "If true, serves the datagram and stream benchmark endpoints under "
+    "/benchmark/.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    num_threads,
+    1,
+    "Number of server threads. Each runs its own dispatcher on a socket "
+    "sharing the port through SO_REUSEPORT.");
+
 int main(int argc, char** argv) {
   const char* usage = "quic_transport_simple_server";
   QuicSystemEventLoop event_loop("quic_transport_simple_server");
@@ -39,9 +54,33 @@ int main(int argc, char** argv) {
     accepted_origins.push_back(url::Origin::Create(url));
   }
 
+  int32_t num_threads = GetQuicFlag(FLAGS_num_threads);
+  if (num_threads < 1 ||
+      num_threads > static_cast<int32_t>(net::kQuicTransportMaxShards)) {
+    LOG(ERROR) << "Invalid number of threads: " << num_threads;
+    return 1;
+  }
+  if (num_threads > 1) {
+    net::QuicTransportShardedServer server(
+        GetQuicFlag(FLAGS_port), accepted_origins,
+        base::BindRepeating(&quic::CreateDefaultProofSource), num_threads);
+    server.set_enable_benchmark_endpoints(
+        GetQuicFlag(FLAGS_enable_benchmark_endpoints));
+    server.set_read_error_callback(
+        base::BindRepeating([](int /*result*/) { exit(EXIT_FAILURE); }));
+    if (server.Start() != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+
+    base::RunLoop run_loop;
+    run_loop.Run();
+    return EXIT_SUCCESS;
+  }
+
   net::QuicTransportSimpleServer server(GetQuicFlag(FLAGS_port),
                                         accepted_origins,
                                         quic::CreateDefaultProofSource());
+  server.set_enable_benchmark_endpoints(
+      GetQuicFlag(FLAGS_enable_benchmark_endpoints));
   server.set_read_error_callback(
       base::BindOnce([](int /*result*/) { exit(EXIT_FAILURE); }));
   if (server.Start() != EXIT_SUCCESS)